@@ -13,6 +13,8 @@ LOCAL_SRC_FILES += $(Src)C++11/LWEUIManager.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWELocalization.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWEXML.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWEJson.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWEJsonTape.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWEJsonStream.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWEUI/LWEUI.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWEUI/LWEUIButton.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWEUI/LWEUILabel.cpp
@@ -9,11 +9,16 @@
 #include <LWVideo/LWShader.h>
 #include <LWVideo/LWPipeline.h>
 #include <LWAudio/LWAudioStream.h>
+#include <LWVideo/LWImage.h>
 #include <LWEVideoPlayer.h>
 #include <map>
+#include <vector>
+#include <string>
+#include <functional>
 #include <typeinfo>
 #include "LWETypes.h"
 #include "LWEXML.h"
+#include "LWEJobQueue.h"
 
 class LWEAsset {
 public:
@@ -24,7 +29,14 @@ public:
 		Video,
 		AudioStream,
 		Pipeline,
-		VideoBuffer
+		VideoBuffer,
+		TypeCount
+	};
+
+	/*!< \brief bits of GetFlag, kept apart from the asset types so they are never mistaken for one. */
+	enum AssetFlag {
+		Loading = 0x1, /*!< \brief the asset is still loading and GetAsset returns the placeholder for it's type. */
+		LoadFailed = 0x2 /*!< \brief the asset failed to load and keeps the placeholder. */
 	};
 
 	LWTexture *AsTexture(void);
@@ -47,15 +59,45 @@ public:
 
 	uint32_t GetType(void);
 
-	LWEAsset(uint32_t Type, void *Asset, const char *AssetPath);
+	uint32_t GetFlag(void);
+
+	LWEAsset &SetAsset(void *Asset, uint32_t Flag);
+
+	LWEAsset(uint32_t Type, void *Asset, const char *AssetPath, uint32_t Flag = 0);
 
 	LWEAsset();
 private:
 	char m_AssetPath[256];
 	uint32_t m_Type;
+	uint32_t m_Flag = 0;
 	void *m_Asset;
 };
 
+typedef std::function<void(LWEAsset &, bool, LWEAssetManager &)> LWEAssetCallback;
+
+struct LWEAssetLoad {
+	enum {
+		MaxGlyphRanges = 8
+	};
+	LWImage m_Image;
+	std::string m_Path;
+	std::vector<std::pair<std::string, uint32_t>> m_GlyphNames;
+	std::vector<LWEAssetCallback> m_Callbacks;
+	LWETaskHandle m_Task;
+	LWEAsset *m_Asset = nullptr;
+	LWEAssetLoad *m_Next = nullptr;
+	void *m_Result = nullptr;
+	uint32_t m_Type = 0;
+	uint32_t m_Flag = 0;
+	uint32_t m_Size = 0;
+	uint32_t m_ErrorGlyph = 0;
+	uint32_t m_RangeCount = 0;
+	uint32_t m_GlyphFirst[MaxGlyphRanges];
+	uint32_t m_GlyphLens[MaxGlyphRanges];
+	bool m_HasErrorGlyph = false;
+	bool m_Loaded = false;
+};
+
 class LWEAssetManager {
 public:
 	enum {
@@ -85,18 +127,39 @@ public:
 	Type *GetAsset(const LWText &Name) {
 		LWEAsset *A = GetAsset(Name);
 		if (!A) return nullptr;
-		if (typeid(Type) == typeid(LWTexture)) return (A->GetType() == LWEAsset::Texture) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWFont)) return (A->GetType() == LWEAsset::Font) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWShader)) return (A->GetType() == LWEAsset::Shader) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWPipeline)) return (A->GetType() == LWEAsset::Pipeline) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWAudioStream)) return (A->GetType() == LWEAsset::AudioStream) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWEVideoPlayer)) return (A->GetType() == LWEAsset::Video) ? (Type*)A->GetAsset() : nullptr;
-		else if (typeid(Type) == typeid(LWVideoBuffer)) return (A->GetType() == LWEAsset::VideoBuffer) ? (Type*)A->GetAsset() : nullptr;
-		return nullptr;
+		uint32_t AssetType = LWEAsset::TypeCount;
+		if (typeid(Type) == typeid(LWTexture)) AssetType = LWEAsset::Texture;
+		else if (typeid(Type) == typeid(LWFont)) AssetType = LWEAsset::Font;
+		else if (typeid(Type) == typeid(LWShader)) AssetType = LWEAsset::Shader;
+		else if (typeid(Type) == typeid(LWPipeline)) AssetType = LWEAsset::Pipeline;
+		else if (typeid(Type) == typeid(LWAudioStream)) AssetType = LWEAsset::AudioStream;
+		else if (typeid(Type) == typeid(LWEVideoPlayer)) AssetType = LWEAsset::Video;
+		else if (typeid(Type) == typeid(LWVideoBuffer)) AssetType = LWEAsset::VideoBuffer;
+		if (A->GetType() != AssetType) return nullptr;
+		//Callers of the typed getter expect the final object, so finish loading it now rather than handing out the placeholder.
+		if (A->GetFlag()&LWEAsset::Loading) WaitForAsset(A);
+		if (A->GetFlag()&LWEAsset::LoadFailed) return nullptr;
+		return (Type*)A->GetAsset();
 	}
 
 	bool InsertAsset(const LWText &Name, void *Asset, uint32_t AssetType, const char *AssetPath);
 
+	bool OnLoaded(const LWText &Name, const LWEAssetCallback &Callback);
+
+	uint32_t Update(uint32_t MaxFinalize = 0xFFFFFFFF);
+
+	LWEAssetManager &WaitForAsset(LWEAsset *Asset);
+
+	LWEAssetManager &WaitForLoads(void);
+
+	LWEAssetManager &SetJobQueue(LWEJobQueue *JobQueue);
+
+	LWEAssetManager &SetPlaceholder(uint32_t AssetType, void *Asset);
+
+	LWEJobQueue *GetJobQueue(void);
+
+	uint32_t GetPendingCount(void);
+
 	bool InsertAssetReference(const LWText &Name, const LWText &RefName);
 
 	LWVideoDriver *GetDriver(void);
@@ -113,12 +176,22 @@ public:
 
 	~LWEAssetManager();
 private:
+	static void RunLoad(LWEAssetLoad *Load, LWEAssetManager *AM);
+
+	LWEAsset *InsertLoad(const LWText &Name, LWEAssetLoad *Load);
+
+	bool FinalizeLoad(LWEAssetLoad *Load);
+
 	LWEAsset m_AssetTable[MaxAssets];
 	std::map<uint32_t, LWEAsset*> m_AssetMap;
+	void *m_Placeholders[LWEAsset::TypeCount];
+	LWEAssetLoad *m_Loads = nullptr;
+	LWEJobQueue *m_JobQueue = nullptr;
 	LWELocalization *m_Localization;
 	LWVideoDriver *m_Driver;
 	LWAllocator *m_Allocator;
 	uint32_t m_AssetCount;
+	uint32_t m_PendingCount = 0;
 };
 
 #endif
@@ -4,8 +4,83 @@
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include "LWETypes.h"
 
+typedef std::function<void(LWETask &, LWEJobThread &, LWEJobQueue &)> LWETaskFunc;
+
+typedef std::function<void(uint32_t, uint32_t, LWEJobThread &)> LWEParallelForFunc;
+
+struct LWETask {
+	enum {
+		MaxDependents = 16
+	};
+	LWETaskFunc m_Func;
+	void *m_UserData = nullptr;
+	LWETask *m_Parent = nullptr;
+	LWETask *m_NextFree = nullptr;
+	LWETask *m_Dependents[MaxDependents]; //Tasks waiting on this task to finish before they can be scheduled.
+	uint32_t m_DependentCount = 0;
+	std::atomic<uint32_t> m_Generation; //Incremented each time the task finishs, invalidating any outstanding handles.
+	std::atomic<uint32_t> m_UnfinishedCount; //This task plus any unfinished children.
+	std::atomic<uint32_t> m_PendingCount; //Unfinished dependencies plus one for the task not yet being submitted.
+	std::atomic<uint32_t> m_DependentLock;
+
+	/*!< \brief returns a handle to the task, only valid to call while the task has not finished(such as from inside it's own function). */
+	LWETaskHandle GetHandle(void);
+
+	LWETask();
+};
+
+struct LWETaskHandle {
+	LWETask *m_Task = nullptr;
+	uint32_t m_Generation = 0;
+
+	bool isFinished(void) const;
+
+	bool isValid(void) const;
+
+	LWETaskHandle(LWETask *Task, uint32_t Generation);
+
+	LWETaskHandle() = default;
+};
+
+/*!< \brief Chase-Lev work stealing deque, only the owning thread may Push/Pop while any thread may Steal. the deque grows as needed, retired buffers are kept until destruction as stealers may still be reading them. */
+class LWETaskDeque {
+public:
+	enum {
+		InitialSize = 256
+	};
+
+	LWETaskDeque &Push(LWETask *Task);
+
+	LWETask *Pop(void);
+
+	LWETask *Steal(void);
+
+	LWETaskDeque &SetAllocator(LWAllocator *Allocator);
+
+	uint32_t Length(void) const;
+
+	LWETaskDeque() = default;
+
+	~LWETaskDeque();
+private:
+	struct Buffer {
+		std::atomic<LWETask*> *m_Tasks;
+		Buffer *m_Prev;
+		int64_t m_Mask;
+	};
+
+	Buffer *MakeBuffer(int64_t Size, Buffer *Prev);
+
+	alignas(64) std::atomic<int64_t> m_Top = { 0 };
+	alignas(64) std::atomic<int64_t> m_Bottom = { 0 };
+	std::atomic<Buffer*> m_Buffer = { nullptr };
+	LWAllocator *m_Allocator = nullptr;
+};
+
 struct LWEJob {
 
 	std::function<void(LWEJob &, LWEJobThread &, LWEJobQueue &, uint64_t)> m_Func;
@@ -32,11 +107,53 @@ struct LWEJob {
 	LWEJob();
 };
 
+struct LWEJobEvent {
+	enum {
+		Job = 0,
+		Task,
+		Idle,
+		LockContention, //A job was ready to start but lost the race to set the lock flag.
+		Steal //A task was stolen from another thread's deque, ID is the victim thread index.
+	};
+	uint64_t m_Start;
+	uint64_t m_End;
+	uint32_t m_Type;
+	uint32_t m_ID;
+};
+
 struct LWEJobThread {
 	std::thread m_Thread;
+	LWETaskDeque m_Tasks;
+	LWEJobEvent *m_Events = nullptr; //Ring buffer of profiling events, only written by the owning thread.
+	std::atomic<uint32_t> m_EventPos = { 0 };
+	uint32_t m_EventMask = 0;
+	LWETask *m_FreeTasks = nullptr;
 	uint64_t m_TimeInJobs = 0;
 	uint32_t m_JobsRan = 0;
+	uint32_t m_TasksRan = 0;
+	uint32_t m_TasksStolen = 0;
+	uint32_t m_FreeTaskCount = 0;
+	uint32_t m_StealSeed = 0;
 	uint32_t m_ThreadID;
+	uint32_t m_ThreadIdx;
+};
+
+/*!< \brief fork/join helper, tasks ran through the group are children of a hidden root task which Wait submits and then helps execute until every child has finished. the group can be reused after Wait returns. */
+class LWETaskGroup {
+public:
+	LWETaskGroup &Run(const LWETaskFunc &Func, void *UserData = nullptr);
+
+	LWETaskGroup &Wait(void);
+
+	LWETaskHandle GetHandle(void) const;
+
+	LWETaskGroup(LWEJobQueue &Queue);
+
+	/*!< \brief waits for any outstanding tasks before the group is destroyed. */
+	~LWETaskGroup();
+private:
+	LWEJobQueue &m_Queue;
+	LWETaskHandle m_Root;
 };
 
 class LWEJobQueue {
@@ -44,11 +161,15 @@ public:
 	enum {
 		MaxThreads = 32,
 		MaxJobs = 64,
+		TaskBlockSize = 256, //Number of tasks allocated at once when the free lists run dry.
+		MaxCachedTasks = 512, //Number of free tasks a thread keeps before returning them to the shared pool.
+		IdleSpinCount = 64, //Number of yields a worker performs with no work before it begins sleeping.
 
 		Finished = 0x1,
 		Paused = 0x2,
 		AlwaysSleep = 0x4,
 		Joined = 0x8,
+		Profiling = 0x10,
 
 		JobNull = 0,
 		JobOpen = 1,
@@ -73,6 +194,15 @@ public:
 
 	LWEJobQueue &OutputThreadTimings(void);
 
+	/*!< \brief records an event into the threads profiling ring if profiling is enabled. */
+	static void RecordEvent(LWEJobThread &Thread, uint32_t Type, uint32_t ID, uint64_t Start, uint64_t End);
+
+	/*!< \brief enables recording of job, task, idle and lock contention events into a ring of EventsPerThread(rounded up to a power of 2) events for each thread, 0 disables profiling.  should only be changed while the queue is paused. */
+	LWEJobQueue &SetProfiling(uint32_t EventsPerThread);
+
+	/*!< \brief writes the recorded events as chrome trace event json(chrome://tracing or ui.perfetto.dev) into Buffer, returns the number of bytes needed to write the full trace(excluding the null terminator). events recorded while the trace is written may be torn, pause the queue first for an exact trace. */
+	uint32_t SerializeChromeTrace(char *Buffer, uint32_t BufferLen);
+
 	LWEJobQueue &SetFinished(bool isFinished);
 
 	LWEJobQueue &WaitForAllJoined(void);
@@ -83,6 +213,30 @@ public:
 
 	LWEJobQueue &SetSleep(bool Sleep);
 
+	/*!< \brief creates a one-shot task, the task does not run until SubmitTask is called. if Parent is valid the parent will not finish until this task has finished. */
+	LWETaskHandle CreateTask(const LWETaskFunc &Func, void *UserData = nullptr, const LWETaskHandle &Parent = LWETaskHandle());
+
+	/*!< \brief prevents Task from being scheduled until DependsOn has finished, Task must not have been submitted yet. returns false if DependsOn has no room for another dependent. */
+	bool AddDependency(const LWETaskHandle &Task, const LWETaskHandle &DependsOn);
+
+	/*!< \brief releases the task to be scheduled once all of it's dependencies have finished. */
+	LWEJobQueue &SubmitTask(const LWETaskHandle &Task);
+
+	/*!< \brief creates and immediately submits a task with no dependencies. */
+	LWETaskHandle PushTask(const LWETaskFunc &Func, void *UserData = nullptr, const LWETaskHandle &Parent = LWETaskHandle());
+
+	/*!< \brief splits [Begin, End) into ranges of at most Grain elements and runs Func over them across the worker threads, the calling thread helps execute and this returns once every range has finished. a Grain of 0 picks a grain that gives each thread several ranges to balance with. */
+	LWEJobQueue &ParallelFor(uint32_t Begin, uint32_t End, uint32_t Grain, const LWEParallelForFunc &Func);
+
+	/*!< \brief runs tasks on the calling thread until Task has finished. */
+	LWEJobQueue &WaitTask(const LWETaskHandle &Task);
+
+	/*!< \brief pops a task from the threads own deque, or the shared queue, or steals from another thread and runs it. returns false if no task was found. */
+	bool RunTask(LWEJobThread &Thread);
+
+	/*!< \brief returns the LWEJobThread associated with the calling thread, or null if the calling thread is not a worker or the main thread of this queue. */
+	LWEJobThread *GetCurrentThread(void);
+
 	LWEJobThread &GetMainThread(void);
 
 	uint32_t GetFlag(void) const;
@@ -97,11 +251,29 @@ public:
 
 	bool isJoined(void) const;
 
-	LWEJobQueue(uint32_t ThreadCnt = 0);
+	/*!< \brief constructs the queue, the constructing thread becomes the main thread.  Allocator is used for task storage and must be thread safe. */
+	LWEJobQueue(LWAllocator &Allocator, uint32_t ThreadCnt = 0);
 
 	~LWEJobQueue();
 private:
+	LWETask *AllocateTask(void);
+
+	LWEJobQueue &FreeTask(LWETask *Task);
+
+	LWEJobQueue &ScheduleTask(LWETask *Task);
+
+	LWEJobQueue &FinishTask(LWETask *Task);
+
+	LWETask *NextTask(LWEJobThread &Thread);
+
 	LWEJobThread m_Threads[MaxThreads];
+	LWETaskDeque m_SharedTasks; //Tasks submitted from threads which are not part of the queue.
+	std::mutex m_SharedTaskLock;
+	std::mutex m_TaskPoolLock;
+	std::vector<LWETask*> m_TaskBlocks;
+	LWETask *m_FreeTasks = nullptr;
+	LWAllocator &m_Allocator;
+	uint64_t m_ProfileStart = 0;
 	LWEJob m_Jobs[MaxJobs];
 	std::atomic<uint32_t> m_JobState[MaxJobs];
 	std::atomic<uint32_t> m_LockedFlag;
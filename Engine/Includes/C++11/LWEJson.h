@@ -93,7 +93,8 @@ struct LWEJObject {
 class LWEJson {
 public:
 	enum {
-		ElementPoolSize = 64
+		ElementPoolSize = 64,
+		CBORMaxDepth = 1024
 	};
 
 	static uint32_t EscapeString(const char *String, char *Buffer, uint32_t BufferLen);
@@ -104,8 +105,14 @@ public:
 
 	static bool Parse(LWEJson &JSon, const char *Buffer, LWEJObject *Parent = nullptr);
 
+	static bool Parse(LWEJson &JSon, const LWEJsonTape &Tape, LWEJObject *Parent = nullptr);
+
+	static bool ParseCBOR(LWEJson &JSon, LWByteBuffer &Buffer, LWEJObject *Parent = nullptr);
+
 	uint32_t Serialize(char *Buffer, uint32_t BufferLen, bool Format);
 
+	uint32_t SerializeCBOR(LWByteBuffer &Buffer);
+
 	LWEJObject *MakeElement(const char *Name, LWEJObject *Parent = nullptr);
 
 	LWEJObject *MakeElementf(const char *Fmt, LWEJObject *Parent, ...);
@@ -0,0 +1,230 @@
+#ifndef LWEJSONSTREAM_H
+#define LWEJSONSTREAM_H
+#include <LWCore/LWTypes.h>
+#include <functional>
+#include "LWETypes.h"
+
+/*!< \brief a pull parser which reads a json document one token at a time from a stream, only holding a single chunk of the source and the current token in memory.
+	 tokens are returned by Next, and the current key, string, or number is available with GetValue until the next call.  the reader validates the document structure as it goes, and returns Error for the rest of the stream after the first problem.
+*/
+class LWEJsonReader {
+public:
+	enum {
+		None = 0, /*!< \brief no token has been read yet. */
+		BeginObject, /*!< \brief an object was opened, it's members follow as a Key and then it's value. */
+		EndObject, /*!< \brief the current object was closed. */
+		BeginArray, /*!< \brief an array was opened. */
+		EndArray, /*!< \brief the current array was closed. */
+		Key, /*!< \brief the name of an object member, GetValue returns the unescaped name. */
+		String, /*!< \brief a string value, GetValue returns the unescaped string. */
+		Number, /*!< \brief a number value, GetValue returns it's text. */
+		Boolean, /*!< \brief a true or false value. */
+		Null, /*!< \brief a null value. */
+		EndOfDocument, /*!< \brief the root value has been completely read. */
+		Error, /*!< \brief the document was malformed, or the stream ended early. */
+
+		MaxDepth = 1024, /*!< \brief the max number of nested arrays and objects. */
+		DefaultBufferSize = 16384 /*!< \brief the default size of the chunk read from the stream at a time. */
+	};
+
+	/*!< \brief reads the next token, and returns it's type. */
+	uint32_t Next(void);
+
+	/*!< \brief skips the value that was just read, if the current token is BeginObject or BeginArray the reader advances past it's matching end, if the token is Key the member's value is skipped.
+		 \return false if an error occurred.
+	*/
+	bool Skip(void);
+
+	/*!< \brief returns the type of the current token. */
+	uint32_t GetToken(void) const;
+
+	/*!< \brief returns the null terminated text of the current Key, String, Number, or Boolean. */
+	const char *GetValue(void) const;
+
+	/*!< \brief returns the length in bytes of the current value's text. */
+	uint32_t GetValueLength(void) const;
+
+	/*!< \brief returns true if the current value's text equals Str. */
+	bool Equals(const char *Str) const;
+
+	/*!< \brief returns the number of arrays and objects currently open. */
+	uint32_t GetDepth(void) const;
+
+	/*!< \brief returns the line the reader is at, for reporting errors. */
+	uint32_t GetLine(void) const;
+
+	int32_t AsInt(void) const;
+
+	float AsFloat(void) const;
+
+	double AsDouble(void) const;
+
+	bool AsBoolean(void) const;
+
+	/*!< \brief constructs a reader which pulls data from ReadFunc, which is passed a buffer and it's length, and must return the number of bytes written, or 0 once the stream has ended. */
+	LWEJsonReader(std::function<uint32_t(char*, uint32_t)> ReadFunc, LWAllocator &Allocator, uint32_t BufferSize = DefaultBufferSize);
+
+	/*!< \brief constructs a reader which reads from the current position of the file stream, the stream must outlive the reader. */
+	LWEJsonReader(LWFileStream &Stream, LWAllocator &Allocator, uint32_t BufferSize = DefaultBufferSize);
+
+	/*!< \brief constructs a reader which reads from a byte stream, the stream must outlive the reader. */
+	LWEJsonReader(LWByteStream &Stream, LWAllocator &Allocator, uint32_t BufferSize = DefaultBufferSize);
+
+	~LWEJsonReader();
+private:
+	enum {
+		ExpectValue,
+		ExpectValueOrEnd,
+		ExpectKey,
+		ExpectKeyOrEnd,
+		ExpectCommaOrEnd,
+		Done,
+		Failed
+	};
+
+	/*!< \brief reads the next chunk of the stream, returns false if the stream has ended. */
+	bool Fill(void);
+
+	/*!< \brief skips whitespace and returns the next character without consuming it, or -1 at the end of the stream. */
+	int32_t Peek(void);
+
+	/*!< \brief appends Len bytes to the current value, growing the value buffer as needed. */
+	void AppendValue(const char *Text, uint32_t Len);
+
+	/*!< \brief reads a string from the stream into the value buffer, the opening quote must be the next character. */
+	bool ReadString(void);
+
+	/*!< \brief reads a number or literal into the value buffer, returning it's token type or Error. */
+	uint32_t ReadScalar(void);
+
+	/*!< \brief sets the reader into the failed state, and returns Error. */
+	uint32_t Fail(const char *Reason);
+
+	std::function<uint32_t(char*, uint32_t)> m_ReadFunc;
+	LWAllocator &m_Allocator;
+	char *m_Buffer;
+	char *m_Value;
+	uint32_t m_BufferSize;
+	uint32_t m_Position = 0;
+	uint32_t m_Length = 0;
+	uint32_t m_ValueLength = 0;
+	uint32_t m_ValueSize;
+	uint32_t m_Token = None;
+	uint32_t m_State = ExpectValue;
+	uint32_t m_Depth = 0;
+	uint32_t m_Line = 0;
+	bool m_EndOfStream = false;
+	uint8_t m_Stack[MaxDepth];
+};
+
+/*!< \brief writes a json document as it is built, without an LWEJson tree or a presized output buffer.
+	 output is collected in a fixed size buffer which is handed to the sink whenever it fills, the sink can write to a file, send over a socket, or anything else.  writers constructed without a sink instead grow the buffer to hold the whole document.
+	 commas and separators are inserted automatically, and every method returns the writer so calls may be chained.
+*/
+class LWEJsonWriter {
+public:
+	enum {
+		MaxDepth = 1024, /*!< \brief the max number of nested arrays and objects. */
+		DefaultBufferSize = 16384 /*!< \brief the default size of the output buffer. */
+	};
+
+	LWEJsonWriter &BeginObject(void);
+
+	LWEJsonWriter &EndObject(void);
+
+	LWEJsonWriter &BeginArray(void);
+
+	LWEJsonWriter &EndArray(void);
+
+	/*!< \brief writes the name of the next member of the current object. */
+	LWEJsonWriter &WriteKey(const char *Name);
+
+	/*!< \brief writes an escaped string value. */
+	LWEJsonWriter &WriteString(const char *Value);
+
+	/*!< \brief writes an escaped string value of Len bytes. */
+	LWEJsonWriter &WriteString(const char *Value, uint32_t Len);
+
+	LWEJsonWriter &WriteInt(int64_t Value);
+
+	LWEJsonWriter &WriteUInt(uint64_t Value);
+
+	/*!< \brief writes the number with the fewest digits that read back as the same double. */
+	LWEJsonWriter &WriteFloat(double Value);
+
+	LWEJsonWriter &WriteBoolean(bool Value);
+
+	LWEJsonWriter &WriteNull(void);
+
+	/*!< \brief writes Value as is, it must already be valid json. */
+	LWEJsonWriter &WriteRaw(const char *Value);
+
+	/*!< \brief writes the element and all of it's children, along with it's name if inside an object. */
+	LWEJsonWriter &WriteElement(LWEJson &Json, LWEJObject &Obj);
+
+	/*!< \brief writes the entire json document. */
+	LWEJsonWriter &WriteDocument(LWEJson &Json);
+
+	/*!< \brief hands any buffered output to the sink, returns false if the sink failed now or earlier. */
+	bool Flush(void);
+
+	/*!< \brief returns the output that has not been flushed, which for writers without a sink is the whole document. */
+	const char *GetData(void) const;
+
+	/*!< \brief returns the length of the output that has not been flushed. */
+	uint32_t GetLength(void) const;
+
+	/*!< \brief returns the total number of bytes written, including bytes that have been flushed. */
+	uint64_t GetBytesWritten(void) const;
+
+	/*!< \brief returns true if the sink failed to take the output, or the document was written out of order. */
+	bool isFailed(void) const;
+
+	/*!< \brief constructs a writer which passes each full buffer to WriteFunc, which must return false if it could not take the data. */
+	LWEJsonWriter(std::function<bool(const char*, uint32_t)> WriteFunc, LWAllocator &Allocator, bool Format = false, uint32_t BufferSize = DefaultBufferSize);
+
+	/*!< \brief constructs a writer which writes to the file stream. */
+	LWEJsonWriter(LWFileStream &Stream, LWAllocator &Allocator, bool Format = false, uint32_t BufferSize = DefaultBufferSize);
+
+	/*!< \brief constructs a writer which keeps the whole document in a growing buffer. */
+	LWEJsonWriter(LWAllocator &Allocator, bool Format = false, uint32_t BufferSize = DefaultBufferSize);
+
+	/*!< \brief flushes any remaining output and destroys the writer. */
+	~LWEJsonWriter();
+private:
+	enum {
+		InObject = 0x1,
+		HasElements = 0x2
+	};
+
+	/*!< \brief writes the separator and indentation before a value, returns false if a value is not allowed here. */
+	bool BeginValue(void);
+
+	/*!< \brief writes the name of the next member, escaping it if requested. */
+	LWEJsonWriter &WriteKey(const char *Name, bool Escape);
+
+	/*!< \brief appends Value as a quoted and escaped json string. */
+	LWEJsonWriter &AppendString(const char *Value, uint32_t Len);
+
+	/*!< \brief closes the current container if it is of the specified type. */
+	LWEJsonWriter &EndContainer(uint8_t Type, char Token);
+
+	LWEJsonWriter &Append(const char *Text, uint32_t Len);
+
+	LWEJsonWriter &Indent(void);
+
+	std::function<bool(const char*, uint32_t)> m_WriteFunc;
+	LWAllocator &m_Allocator;
+	char *m_Buffer;
+	uint32_t m_BufferSize;
+	uint32_t m_Length = 0;
+	uint64_t m_BytesWritten = 0;
+	uint32_t m_Depth = 0;
+	bool m_Format;
+	bool m_AfterKey = false;
+	bool m_RootWritten = false;
+	bool m_Failed = false;
+	uint8_t m_Stack[MaxDepth];
+};
+
+#endif
\ No newline at end of file
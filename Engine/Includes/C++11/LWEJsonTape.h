@@ -0,0 +1,114 @@
+#ifndef LWEJSONTAPE_H
+#define LWEJSONTAPE_H
+#include <LWCore/LWTypes.h>
+#include "LWETypes.h"
+
+/*!< \brief a single value on a LWEJsonTape, values are laid out in document order with an object's members stored as a key node followed by the value's nodes. */
+struct LWEJNode {
+	enum {
+		TypeBits = 0xFF, /*!< \brief bitwise and against m_Type to get the LWEJObject type of the node. */
+		Key = 0x100, /*!< \brief flag set on the name of an object member. */
+		Escaped = 0x200 /*!< \brief flag set on strings that contain escape sequences, and must be unescaped with LWEJsonTape::GetString. */
+	};
+	uint32_t m_Type; /*!< \brief the LWEJObject type of the value, along with the node flags. */
+	uint32_t m_Offset; /*!< \brief the offset into the source of the value's text, for strings this is the first character after the opening quote. */
+	uint32_t m_Length; /*!< \brief the length in bytes of the value's text, or the number of elements or members for arrays and objects. */
+	uint32_t m_Next; /*!< \brief the index of the first node after this value and all of it's children. */
+
+	/*!< \brief returns the LWEJObject type of the node. */
+	uint32_t GetType(void) const;
+
+	/*!< \brief returns true if the node is an object member's name. */
+	bool isKey(void) const;
+};
+
+/*!< \brief a flat json parser which does not copy or hash anything, built in two stages:
+	 first the source is classified 64 bytes at a time with sse2/avx2 to find every structural character and the start of every value outside of strings, then the tape of nodes is built by walking that index.
+	 string and number nodes reference the source buffer, so it must outlive the tape unless it was loaded with LoadFile.  nodes are addressed by index, with node 0 being the document's root value.
+*/
+class LWEJsonTape {
+public:
+	enum {
+		BlockSize = 64, /*!< \brief the number of bytes classified at a time when indexing the source. */
+		MaxDepth = 1024, /*!< \brief the max number of nested arrays and objects. */
+		InvalidNode = 0xFFFFFFFF /*!< \brief returned when a node could not be found. */
+	};
+
+	/*!< \brief writes the offset of every structural character, opening and closing quote, and the first character of every literal and number in Buffer to Indices.
+		 \param Indices must have room for BufferLen offsets.
+		 \return the number of offsets written, or InvalidNode if a string was not closed or contained an unescaped control character.
+	*/
+	static uint32_t IndexStructurals(const char *Buffer, uint32_t BufferLen, uint32_t *Indices);
+
+	/*!< \brief unescapes the Len bytes of a json string's contents into Buffer, \u escapes are written as utf-8.  Buffer may be Text to unescape in place.
+		 \return the number of bytes needed to store the unescaped text including the null terminator.
+	*/
+	static uint32_t UnEscapeText(const char *Text, uint32_t Len, char *Buffer, uint32_t BufferLen);
+
+	/*!< \brief returns true if the Len bytes of Text are a valid json number. */
+	static bool isNumber(const char *Text, uint32_t Len);
+
+	/*!< \brief parses BufferLen bytes of Buffer into the tape, the tape references Buffer so it must not be released or modified while the tape is used. */
+	static bool Parse(LWEJsonTape &Tape, const char *Buffer, uint32_t BufferLen);
+
+	/*!< \brief reads the file into a buffer owned by the tape, and parses it. */
+	static bool LoadFile(LWEJsonTape &Tape, const LWText &Path, LWAllocator &Allocator, LWFileStream *ExistingStream = nullptr);
+
+	/*!< \brief returns the node at the index, or null if it is out of range. */
+	const LWEJNode *GetNode(uint32_t Index) const;
+
+	/*!< \brief returns the index of the i'th element of an array, or the i'th member value of an object, or InvalidNode. */
+	uint32_t GetChild(uint32_t Index, uint32_t i) const;
+
+	/*!< \brief returns the index of the first child of an array or object(for objects this is the first member's key), or InvalidNode if it has none. */
+	uint32_t GetFirstChild(uint32_t Index) const;
+
+	/*!< \brief returns the index of the value of the member named Name in the object, or InvalidNode. */
+	uint32_t FindChild(uint32_t Index, const char *Name) const;
+
+	/*!< \brief returns the index of the value at the path, named the same way as LWEJson names its elements: "Object.Array[2].Member". */
+	uint32_t Find(const char *Path) const;
+
+	/*!< \brief returns true if the node's unescaped text is equal to the first Len bytes of Str. */
+	bool Equals(uint32_t Index, const char *Str, uint32_t Len) const;
+
+	/*!< \brief writes the unescaped text of a string, number, or literal node into buffer, and returns the number of bytes needed to store it including the null terminator. */
+	uint32_t GetString(uint32_t Index, char *Buffer, uint32_t BufferLen) const;
+
+	/*!< \brief returns a pointer to the node's text in the source, the text is m_Length bytes long and not null terminated. */
+	const char *GetText(uint32_t Index) const;
+
+	int32_t AsInt(uint32_t Index) const;
+
+	float AsFloat(uint32_t Index) const;
+
+	double AsDouble(uint32_t Index) const;
+
+	bool AsBoolean(uint32_t Index) const;
+
+	/*!< \brief returns the number of nodes in the tape. */
+	uint32_t GetNodeCount(void) const;
+
+	/*!< \brief returns the source the tape was parsed from. */
+	const char *GetSource(void) const;
+
+	/*!< \brief returns the allocator used for the tape's storage. */
+	LWAllocator &GetAllocator(void) const;
+
+	/*!< \brief constructs an empty tape, storage is kept between calls to Parse and only grows when a larger document is parsed. */
+	LWEJsonTape(LWAllocator &Allocator);
+
+	~LWEJsonTape();
+private:
+	LWAllocator *m_Allocator;
+	LWEJNode *m_Nodes = nullptr;
+	uint32_t *m_Indices = nullptr;
+	char *m_OwnedSource = nullptr;
+	const char *m_Source = nullptr;
+	uint32_t m_NodeCount = 0;
+	uint32_t m_NodePoolSize = 0;
+	uint32_t m_IndexPoolSize = 0;
+	uint32_t m_SourceLen = 0;
+};
+
+#endif
\ No newline at end of file
@@ -5,6 +5,106 @@
 #include <functional>
 #include <LWEJson.h>
 #include <LWCore/LWConcurrent/LWFIFO.h>
+#include <atomic>
+#include <vector>
+
+/*!< \brief refcounted heap buffer that request bodies are stored in, or sliced from when a body arrives whole in a single receive. */
+struct LWEHttpBuffer {
+	/*!< \brief allocates a buffer with Capacity bytes of data and a refcount of 1. */
+	static LWEHttpBuffer *Make(uint32_t Capacity, LWAllocator &Allocator);
+
+	LWEHttpBuffer *AddRef(void);
+
+	/*!< \brief drops a reference, the buffer is destroyed when the last reference is released. */
+	void Release(void);
+
+	/*!< \brief returns true if more then one reference is held. */
+	bool isShared(void) const;
+
+	char *GetData(void);
+
+	std::atomic<uint32_t> m_RefCount;
+	uint32_t m_Capacity;
+};
+
+/*!< \brief a request body, either a slice of a shared LWEHttpBuffer or an owned buffer that grows as data is appended.  copying a body shares it's buffer, so requests can be copied without copying their body. the data is always null terminated. */
+class LWEHttpBody {
+public:
+	/*!< \brief replaces the body with a copy of Data. */
+	bool Set(const char *Data, uint32_t Len, LWAllocator &Allocator);
+
+	/*!< \brief replaces the body with Len bytes at Offset in Buffer, Buffer[Offset+Len] must be null. */
+	LWEHttpBody &Slice(LWEHttpBuffer *Buffer, uint32_t Offset, uint32_t Len);
+
+	/*!< \brief appends Data to the body, copying it into an owned buffer first if it is shared.  returns false if the body would exceed MaxLength or allocation fails. */
+	bool Append(const char *Data, uint32_t Len, LWAllocator &Allocator, uint32_t MaxLength);
+
+	LWEHttpBody &Clear(void);
+
+	const char *GetData(void) const;
+
+	uint32_t GetLength(void) const;
+
+	LWEHttpBody &operator = (const LWEHttpBody &O);
+
+	LWEHttpBody &operator = (LWEHttpBody &&O);
+
+	LWEHttpBody(const LWEHttpBody &O);
+
+	LWEHttpBody(LWEHttpBody &&O);
+
+	LWEHttpBody() = default;
+
+	~LWEHttpBody();
+private:
+	LWEHttpBuffer *m_Buffer = nullptr;
+	uint32_t m_Offset = 0;
+	uint32_t m_Length = 0;
+};
+
+/*!< \brief a reusable zlib context for streaming gzip and deflate bodies, owned by a connection so it's state is reset between messages instead of being reallocated. */
+class LWEHttpZStream {
+public:
+	enum {
+		Inflate = 0,
+		Deflate,
+
+		OutputSize = 16 * 1024, /*!< \brief output is handed on in blocks of at most this size. */
+		CompressLevel = 6
+	};
+
+	/*!< \brief prepares the context for a new message.
+		 \param GZip for deflate contexts writes a gzip wrapper instead of a zlib wrapper, inflate contexts detect the wrapper themselves.
+	*/
+	bool Begin(bool GZip);
+
+	/*!< \brief prepares the context for a raw deflate stream with no wrapper, as used by websocket permessage-deflate. */
+	bool BeginRaw(uint32_t WindowBits);
+
+	/*!< \brief passes Len bytes of In through the context, handing output to Out as it is produced.  Finish flushes the end of a deflate stream.  returns false on a malformed stream or if Out returns false. */
+	bool Write(const char *In, uint32_t Len, bool Finish, const std::function<bool(const char*, uint32_t)> &Out);
+
+	/*!< \brief sync flushes a deflate context so everything written so far can be decoded, without ending the stream. */
+	bool Flush(const std::function<bool(const char*, uint32_t)> &Out);
+
+	/*!< \brief returns true if an inflate context has reached the end of it's stream. */
+	bool isEnded(void) const;
+
+	/*!< \brief returns true if nothing has been written to the context since it began. */
+	bool isEmpty(void) const;
+
+	LWEHttpZStream(uint32_t Mode, LWAllocator &Allocator);
+
+	~LWEHttpZStream();
+private:
+	bool Start(int32_t WindowBits);
+
+	LWAllocator &m_Allocator;
+	void *m_Stream = nullptr;
+	uint32_t m_Mode;
+	int32_t m_WindowBits = 0;
+	bool m_Ended = false;
+};
 
 struct LWEHttpRequest {
 	enum {
@@ -30,8 +130,8 @@ struct LWEHttpRequest {
 
 		ContentEncodeIdentity = 0x0,
 		ContentEncodeGZip = 0x20,
-		ContentEncodeCompress = 0x30,
-		ContentEncodeDeflate = 0x40,
+		ContentEncodeCompress = 0x40,
+		ContentEncodeDeflate = 0x60,
 		ContentEncodeBR = 0x80,
 		CONTENTENCODEBITS = 0xE0,
 		CONTENTENCODEOFFSET = 5,
@@ -41,8 +141,16 @@ struct LWEHttpRequest {
 		UPGRADEBITS = 0x100,
 		UPGRADEOFFSET = 8,
 
-		HeadersRead = 0x100,
-		ResponseReady = 0x200,
+		HeadersRead = 0x400,
+		ResponseReady = 0x800,
+		ContentLengthRead = 0x1000,
+		Retried = 0x2000,
+
+		AcceptGZip = 0x4000,
+		AcceptDeflate = 0x8000,
+		ACCEPTENCODEBITS = 0xC000,
+
+		StreamDecode = 0x10000,
 
 		Continue = 100,
 		SwitchingProtocols = 101,
@@ -53,10 +161,26 @@ struct LWEHttpRequest {
 		NotFound = 404,
 		InternalServerError = 500,
 		NotImplemented = 501,
-		BadGateway = 502
+		BadGateway = 502,
+
+		MaxBodyLength = 64 * 1024 * 1024, /*!< \brief requests with bodies larger then this are rejected. */
+		SliceBodyLength = 4 * 1024, /*!< \brief bodies at least this long which arrive whole in one receive reference the receive buffer instead of being copied. */
+		MaxLineLength = 8 * 1024, /*!< \brief the longest start, header or chunk line that is accepted, however it is split across receives. */
+		ParseError = 0xFFFFFFFF, /*!< \brief returned by Parse when the stream is malformed. */
+		MinCompressLength = 1024, /*!< \brief responses shorter then this are not worth compressing. */
+
+		ParseStartLine = 0,
+		ParseHeaders,
+		ParseBody,
+		ParseBodyRemaining,
+		ParseChunkSize,
+		ParseChunkData,
+		ParseChunkEnd,
+		ParseTrailers,
+		ParseDone
 	};
 
-	char m_Body[1024 * 256];
+	LWEHttpBody m_Body;
 	char m_Host[128];
 	char m_Path[128];
 	char m_Origin[128];
@@ -65,11 +189,18 @@ struct LWEHttpRequest {
 	char m_TransferEncoding[128];
 	char m_SecWebSockKey[128];
 	char m_SecWebSockProto[128];
+	char m_SecWebSockExt[128];
 	LWSocket *m_Socket;
+	LWAllocator *m_Allocator;
+	LWEHttpZStream *m_Inflater;
 	void *m_UserData;
 	std::function<void(LWEHttpRequest &, const char *)> m_Callback;
+	std::function<void(LWEHttpRequest &, const char *, uint32_t)> m_BodyCallback;
 	uint32_t m_ContentLength;
 	uint32_t m_ChunkLength;
+	uint32_t m_ParseState;
+	uint32_t m_LineLength;
+	char m_LineBuffer[MaxLineLength];
 	uint32_t m_WebSockVersion;
 	uint32_t m_Status;
 	uint32_t m_Flag;
@@ -83,8 +214,15 @@ struct LWEHttpRequest {
 
 	static uint32_t MakeJSONQueryString(LWEJson &Json, char *Buffer, uint32_t BufferLen);
 
+	/*!< \brief decompresses a gzip stream In into Buffer, returns the decompressed length, or 0 if the stream is malformed, truncated, or does not fit in BufferLen. */
 	static uint32_t GZipDecompress(const char *In, uint32_t InLen, char *Buffer, uint32_t BufferLen);
 
+	/*!< \brief decompresses a gzip or zlib stream In into Body, growing the output until the whole stream fits or MaxBodyLength is reached.  returns false if the stream is malformed or truncated. */
+	static bool GZipDecompress(const char *In, uint32_t InLen, LWEHttpBody &Body, LWAllocator &Allocator);
+
+	/*!< \brief returns a shared thread safe allocator used by requests which were not given one. */
+	static LWAllocator &GetDefaultAllocator(void);
+
 	/*!< \brief parses a uri and seperates it into 3 components: Hostname address of the domain, Path asked for on that domain, and leading protocol specefied, such that https://example.com/abc.html would get seperated into host: example.com protocol: https path: /abc.html, also supports specifying the port (i.e: https://example.com:100/abc.com well return the port of 100.
 		 \param URI the uri to be parsed.
 		 \param HostBuffer the buffer to store the host component.
@@ -103,7 +241,39 @@ struct LWEHttpRequest {
 
 	uint32_t Serialize(char *Buffer, uint32_t BufferLen, const char *UserAgent);
 
-	bool Deserialize(const char *Buffer, uint32_t Len);
+	/*!< \brief serializes everything before the body, so large bodies can be sent straight from m_Body. */
+	uint32_t SerializeHeaders(char *Buffer, uint32_t BufferLen, const char *UserAgent);
+
+	/*!< \brief writes the body with it's transfer framing through Send.  if CompressedBody is true the body is compressed block by block with Deflater, each block going out as it's own chunk, otherwise the body is sent straight from m_Body.
+		 \param Buffer scratch space used to frame chunks.
+	*/
+	bool SerializeBody(LWEHttpZStream *Deflater, char *Buffer, uint32_t BufferLen, const std::function<bool(const char*, uint32_t)> &Send);
+
+	/*!< \brief parses up to Len bytes of Buffer, resuming wherever the previous call stopped so a message may be split across any number of receives.  parsing stops at the end of a message, leaving pipelined messages for the next request.
+		 if m_Inflater is set gzip and deflate bodies are inflated as they arrive, otherwise they are collected and inflated once complete.
+		 a response body with no length or chunked framing is never finished here, LWEHttpConnection::FinishClosed finishes it when the connection closes.
+		 \param Source if Buffer points into Source(with Source's data null terminated after Len), a body arriving whole may reference it instead of being copied.
+		 \return the number of bytes consumed, or ParseError.
+	*/
+	uint32_t Parse(const char *Buffer, uint32_t Len, LWEHttpBuffer *Source = nullptr);
+
+	/*!< \brief processes one complete line(without it's line ending) for the current parse state. */
+	bool ParseLine(const char *Line, uint32_t Len);
+
+	/*!< \brief parses a "Name: Value" header line. */
+	bool ParseHeader(const char *Line, uint32_t Len);
+
+	/*!< \brief called once the last byte of a message has been parsed. */
+	bool FinishMessage(void);
+
+	/*!< \brief takes body bytes as they were sent, inflating them if the body is being decoded as it streams in. */
+	bool ReceiveBody(const char *Data, uint32_t Len);
+
+	/*!< \brief hands decoded body data to m_BodyCallback, or appends it to m_Body if there is no body callback. */
+	bool DeliverBody(const char *Data, uint32_t Len);
+
+	/*!< \brief parses Len bytes of Buffer, returning false if the stream is malformed. */
+	bool Deserialize(const char *Buffer, uint32_t Len, LWEHttpBuffer *Source = nullptr);
 
 	LWEHttpRequest &SetURI(const char *URI);
 
@@ -129,6 +299,10 @@ struct LWEHttpRequest {
 
 	LWEHttpRequest &SetWebSockProtof(const char *Fmt, ...);
 
+	LWEHttpRequest &SetWebSockExt(const char *Extensions);
+
+	LWEHttpRequest &SetWebSockExtf(const char *Fmt, ...);
+
 	LWEHttpRequest &SetAuthorization(const char *Auth);
 
 	LWEHttpRequest &SetAuthorizationf(const char *Fmt, ...);
@@ -139,10 +313,15 @@ struct LWEHttpRequest {
 
 	LWEHttpRequest &SetBody(const char *Body);
 
+	LWEHttpRequest &SetBody(const char *Body, uint32_t Len);
+
 	LWEHttpRequest &SetBodyf(const char *Fmt, ...);
 
 	LWEHttpRequest &SetCallback(std::function<void(LWEHttpRequest &, const char*)> Callback);
 
+	/*!< \brief receives the decoded body in pieces as it arrives instead of it being collected into m_Body, so large bodies never have to be held in full. */
+	LWEHttpRequest &SetBodyCallback(std::function<void(LWEHttpRequest &, const char*, uint32_t)> Callback);
+
 	LWEHttpRequest &SetMethod(uint32_t Method);
 
 	LWEHttpRequest &SetConnectionState(uint32_t ConnState);
@@ -159,6 +338,12 @@ struct LWEHttpRequest {
 
 	bool UpgradeConnection(void);
 
+	/*!< \brief returns true if the body is to be sent compressed with gzip or deflate. */
+	bool CompressedBody(void);
+
+	/*!< \brief returns the content encoding to use for a response to this request, based on it's Accept-Encoding header. */
+	uint32_t GetAcceptedEncoding(void);
+
 	uint32_t GetMethod(void);
 
 	uint32_t GetEncodeType(void);
@@ -170,24 +355,160 @@ struct LWEHttpRequest {
 		return SetCallback(std::bind(&Method, Inst, std::placeholders::_1, std::placeholders::_2));
 	}
 
-	LWEHttpRequest(const char *URI, uint32_t Flag);
+	LWEHttpRequest(const char *URI, uint32_t Flag, LWAllocator *Allocator = nullptr);
 
-	LWEHttpRequest();
+	LWEHttpRequest(LWAllocator *Allocator = nullptr);
+};
+
+/*!< \brief recycles heap allocated requests so they can be handed between threads by pointer. */
+class LWEHttpRequestPool {
+public:
+	enum {
+		MaxPooled = 64
+	};
+
+	/*!< \brief returns a reset request from the pool, or allocates a new one. */
+	LWEHttpRequest *Acquire(void);
+
+	/*!< \brief resets Request and returns it to the pool. */
+	void Release(LWEHttpRequest *Request);
+
+	LWAllocator &GetAllocator(void);
+
+	LWEHttpRequestPool(LWAllocator &Allocator);
+
+	~LWEHttpRequestPool();
+private:
+	LWConcurrentBoundedFIFO<LWEHttpRequest*, MaxPooled> m_Free;
+	LWAllocator &m_Allocator;
+};
+
+/*!< \brief per socket state of LWEProtocolHttp.  client connections may have several pipelined requests waiting on responses, server connections hold the request being parsed. */
+struct LWEHttpConnection {
+	enum {
+		MaxPipelined = 16, /*!< \brief the most requests that can be in flight on one connection. */
+
+		Client = 0x1, /*!< \brief the connection was opened to send requests. */
+		Pooled = 0x2, /*!< \brief the connection is kept alive and may be reused by other requests to the same host. */
+		Closing = 0x4 /*!< \brief the connection has been marked closable and takes no new requests. */
+	};
+
+	bool PushInFlight(LWEHttpRequest *Request);
+
+	/*!< \brief returns the oldest request awaiting a response, or null. */
+	LWEHttpRequest *GetInFlight(void);
+
+	LWEHttpRequest *PopInFlight(void);
+
+	/*!< \brief points the connection and every request it holds at Socket. */
+	LWEHttpConnection &SetSocket(LWSocket *Socket);
+
+	/*!< \brief called when the socket closes, finishes the in flight response whose body is delimited by the close and releases it to Requests.  returns true if a response was finished. */
+	bool FinishClosed(LWEHttpRequestPool &Requests);
+
+	LWEHttpConnection(LWSocket *Socket, uint32_t Flag, LWAllocator &Allocator);
+
+	LWEHttpZStream m_Inflater;
+	LWEHttpZStream m_Deflater;
+	LWEHttpRequest *m_InFlight[MaxPipelined];
+	LWEHttpRequest *m_Request = nullptr;
+	LWSocket *m_Socket;
+	char m_Host[128];
+	uint64_t m_LastActive;
+	uint32_t m_InFlightHead = 0;
+	uint32_t m_InFlightCount = 0;
+	uint32_t m_Flag;
+	uint16_t m_Port = 0;
+};
+
+/*!< \brief tracks client connections by host, so keep-alive requests reuse warm connections instead of connecting for every request. */
+class LWEHttpConnectionPool {
+public:
+	enum {
+		DefaultMaxPerHost = 6,
+		DefaultMaxPipelined = 4,
+		DefaultIdleTimeout = 30000,
+
+		SendOk = 0, /*!< \brief the send function wrote the buffers. */
+		SendPending, /*!< \brief the socket can not take data yet, nothing was written and the request should be retried later. */
+		SendFailed /*!< \brief the send failed and the connection should be closed. */
+	};
+
+	/*!< \brief finds a pooled connection for Request: an idle connection first, then the least loaded connection that can take another pipelined GET.
+		 \param Wait set to true if the host is at it's connection cap and every connection is busy, in which case the request should be retried later.
+		 \return the connection to send on, or null if a new connection should be opened(or Wait was set).
+	*/
+	LWEHttpConnection *Find(const LWEHttpRequest &Request, bool &Wait);
+
+	/*!< \brief creates the connection state for Socket.  if Request is not null the connection is a client connection to Request's host, which is pooled if Request is keep-alive, otherwise it is an accepted server connection. */
+	LWEHttpConnection *Create(LWSocket *Socket, const LWEHttpRequest *Request);
+
+	/*!< \brief destroys Connection.  in flight GET requests that received no part of their response are passed to Retry once, as a pooled connection may be closed by the server just as a request is sent.  all other requests are released to Requests. */
+	LWEHttpConnectionPool &Destroy(LWEHttpConnection *Connection, LWEHttpRequestPool &Requests, std::vector<LWEHttpRequest*> &Retry);
+
+	/*!< \brief marks pooled connections that have been idle longer then the idle timeout as closable. */
+	LWEHttpConnectionPool &CloseIdle(uint64_t Current);
+
+	LWEHttpConnectionPool &SetMaxPerHost(uint32_t MaxPerHost);
+
+	/*!< \brief sets how many GET requests may be in flight on a single connection, 1 disables pipelining. */
+	LWEHttpConnectionPool &SetMaxPipelined(uint32_t MaxPipelined);
+
+	/*!< \brief sets how long in milliseconds a pooled connection may sit idle before it is closed. */
+	LWEHttpConnectionPool &SetIdleTimeout(uint32_t Milliseconds);
+
+	uint32_t GetMaxPerHost(void) const;
+
+	uint32_t GetMaxPipelined(void) const;
+
+	/*!< \brief returns the number of connections currently open. */
+	uint32_t GetConnectionCount(void) const;
+
+	/*!< \brief parses Buffer received on Socket into it's connection's messages, creating the connection state under ProtocolID if the socket has none.
+		 finished responses are passed to their callback and released to Requests, finished requests are passed to Received which takes ownership of them if it returns true.
+		 \return false if the stream could not be parsed.
+	*/
+	bool ReadRequests(LWSocket &Socket, uint32_t ProtocolID, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source, LWEHttpRequestPool &Requests, const std::function<bool(LWEHttpRequest*)> &Received);
+
+	/*!< \brief serializes Request and writes it with Send, finding or opening a connection for it if it has no socket.
+		 \param ProtocolID the id the connection state is stored under on the socket.
+		 \param SocketProtocolID the protocol new sockets are created with.
+		 \param Waiting requests held back by the per host cap, or whose socket returned SendPending, are appended here to be sent on the next pass.
+		 \param Send writes the buffers in order to the socket, returning SendOk, SendPending or SendFailed.
+		 \return false if the request was dropped.
+	*/
+	bool SendRequest(LWEHttpRequest *Request, const char *Agent, const char *Server, uint32_t ProtocolID, uint32_t SocketProtocolID, LWProtocolManager &Manager, LWEHttpRequestPool &Requests, std::vector<LWEHttpRequest*> &Waiting, char *Buffer, uint32_t BufferLen, const std::function<uint32_t(LWSocket&, const LWSocketBuffer*, uint32_t)> &Send);
+
+	/*!< \brief destroys every connection, releasing their requests to Requests. */
+	LWEHttpConnectionPool &Clear(LWEHttpRequestPool &Requests);
+
+	LWEHttpConnectionPool(LWAllocator &Allocator);
+
+	~LWEHttpConnectionPool();
+private:
+	std::vector<LWEHttpConnection*> m_Connections;
+	LWAllocator &m_Allocator;
+	uint64_t m_IdleTimeout;
+	uint32_t m_MaxPerHost = DefaultMaxPerHost;
+	uint32_t m_MaxPipelined = DefaultMaxPipelined;
 };
 
 class LWEProtocolHttp : public LWProtocol {
 public:
 	enum {
-		RequestBufferSize = 64
+		RequestBufferSize = 64,
+		ReceiveBufferSize = 1024 * 64
 	};
 
 	virtual LWProtocol &Read(LWSocket &Socket, LWProtocolManager *Manager);
 
 	virtual LWProtocol &SocketChanged(LWSocket &Prev, LWSocket &New, LWProtocolManager *Manager);
 
+	virtual LWProtocol &SocketClosed(LWSocket &Socket, LWProtocolManager *Manager);
+
 	uint32_t Send(LWSocket &Socket, const char *Buffer, uint32_t Len);
 
-	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len);
+	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source = nullptr);
 
 	LWEProtocolHttp &ProcessRequests(uint32_t ProtocolID, LWProtocolManager &Manager);
 
@@ -197,26 +518,47 @@ public:
 
 	bool PushRequest(LWEHttpRequest &Request);
 
+	/*!< \brief queues a request taken from GetNextFromPool, ownership passes to the protocol. */
+	bool PushRequest(LWEHttpRequest *Request);
+
 	bool PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t lStatus);
 
+	bool PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t ResponseLen, uint32_t lStatus);
+
 	bool GetNextRequest(LWEHttpRequest &Request);
 
+	/*!< \brief pops the next received request without copying it, the caller owns the request and must pass it to ReleaseRequest. */
+	bool GetNextRequest(LWEHttpRequest **Request);
+
 	bool GetNextFromPool(LWEHttpRequest **Request);
 
+	LWEProtocolHttp &ReleaseRequest(LWEHttpRequest *Request);
+
+	/*!< \brief the pool of outgoing connections, used to configure per host limits, pipelining and idle timeouts. */
+	LWEHttpConnectionPool &GetConnectionPool(void);
+
 	LWEProtocolHttp &SetAgentString(const char *Agent);
 
 	LWEProtocolHttp &SetServerString(const char *Server);
 
+	LWEProtocolHttp(uint32_t ProtocolID, LWProtocolManager *Manager, LWAllocator &Allocator);
+
 	LWEProtocolHttp(uint32_t ProtocolID, LWProtocolManager *Manager);
 
 	LWEProtocolHttp();
+
+	~LWEProtocolHttp();
 protected:
 	char m_Agent[256];
 	char m_Server[256];
 	LWProtocolManager *m_Manager;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_Pool;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_OutRequests;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_InRequests;
+	LWEHttpRequestPool m_Pool;
+	LWEHttpConnectionPool m_Connections;
+	std::vector<LWEHttpRequest*> m_Waiting;
+	std::vector<LWSocket*> m_FlushList;
+	LWConcurrentBoundedFIFO<LWEHttpRequest*, RequestBufferSize> m_OutRequests;
+	LWConcurrentBoundedFIFO<LWEHttpRequest*, RequestBufferSize> m_InRequests;
+	LWEHttpBuffer *m_ReceiveBuffer = nullptr;
 	uint32_t m_ProtocolID;
 };
 
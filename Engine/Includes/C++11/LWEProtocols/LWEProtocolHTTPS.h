@@ -15,30 +15,48 @@ public:
 
 	virtual LWProtocol &ProcessTLSData(LWSocket &Socket, const char *Data, uint32_t DataLen);
 
-	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len);
+	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source = nullptr);
 
 	LWEProtocolHttps &ProcessRequests(uint32_t ProtocolID, LWProtocolManager &Manager);
 
 	bool PushRequest(LWEHttpRequest &Request);
 
+	/*!< \brief queues a request taken from GetNextFromPool, ownership passes to the protocol. */
+	bool PushRequest(LWEHttpRequest *Request);
+
 	bool PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t lStatus);
 
+	bool PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t ResponseLen, uint32_t lStatus);
+
 	bool GetNextRequest(LWEHttpRequest &Request);
 
+	/*!< \brief pops the next received request without copying it, the caller owns the request and must pass it to ReleaseRequest. */
+	bool GetNextRequest(LWEHttpRequest **Request);
+
 	bool GetNextFromPool(LWEHttpRequest **Request);
 
+	LWEProtocolHttps &ReleaseRequest(LWEHttpRequest *Request);
+
+	/*!< \brief the pool of outgoing connections, used to configure per host limits, pipelining and idle timeouts. */
+	LWEHttpConnectionPool &GetConnectionPool(void);
+
 	LWEProtocolHttps &SetAgentString(const char *Agent);
 
 	LWEProtocolHttps &SetServerString(const char *Server);
 
 	LWEProtocolHttps(uint32_t HttpsProtocolID, uint32_t TLSProtocolID, LWProtocolManager *Manager, LWAllocator &Allocator, const char *CertFile, const char *KeyFile);
+
+	~LWEProtocolHttps();
 protected:
 	char m_Agent[256];
 	char m_Server[256];
 	LWProtocolManager *m_Manager;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_Pool;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_OutRequests;
-	LWConcurrentFIFO<LWEHttpRequest, RequestBufferSize> m_InRequests;
+	LWEHttpRequestPool m_Pool;
+	LWEHttpConnectionPool m_Connections;
+	std::vector<LWEHttpRequest*> m_Waiting;
+	LWConcurrentBoundedFIFO<LWEHttpRequest*, RequestBufferSize> m_OutRequests;
+	LWConcurrentBoundedFIFO<LWEHttpRequest*, RequestBufferSize> m_InRequests;
+	LWEHttpBuffer *m_ReceiveBuffer = nullptr;
 	uint32_t m_hProtocolID;
 
 
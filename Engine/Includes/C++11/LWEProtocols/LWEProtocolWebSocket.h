@@ -3,7 +3,9 @@
 #include <LWNetwork/LWProtocol.h>
 #include <LWNetwork/LWProtocolManager.h>
 #include <LWCore/LWConcurrent/LWFIFO.h>
+#include "LWEProtocols/LWEProtocolHTTP.h"
 #include <functional>
+#include <deque>
 
 #define LWEWEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 #define LWEWEBSOCKET_SUPPVER 13
@@ -17,21 +19,40 @@ struct LWEWebPacket {
 		CONTROL_CLOSED,
 		CONTROL_PING,
 		CONTROL_PONG,
+		CONTROL_COMPRESSED=0x2000, /*!< \brief the message payload is permessage-deflate compressed(rsv1 was set on the first frame). */
 		CONTROL_CONNECT=0x4000,
 		CONTROL_FINISHED=0x8000,
+
+		MaxHeaderSize = 14,
+		ZeroCopyLength = 4096, /*!< \brief whole frames at least this large are referenced in the receive buffer rather then copied. */
+		MaxDataLength = 64 * 1024 * 1024 /*!< \brief messages larger then this are rejected. */
 	};
-	char *m_Data;
+	char *m_Data; /*!< \brief the payload, a view into m_Buffer. */
+	LWEHttpBuffer *m_Buffer; /*!< \brief the refcounted buffer holding the payload, which may be the receive buffer the frame arrived in. */
 	uint32_t m_DataLen;
 	uint32_t m_DataPos;
 	uint32_t m_FramePos;
+	uint32_t m_FrameLen; /*!< \brief payload bytes of the current frame still to be read. */
 	uint32_t m_ControlFlag;
 	uint32_t m_Mask;
+	uint32_t m_HeaderLen;
+	char m_Header[MaxHeaderSize];
 	LWEWebSocket *m_WebSocket;
 
-	uint32_t Deserialize(const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator);
+	/*!< \brief xors Len bytes of Data with the 4 byte Mask(in wire order), Offset is the position of Data within the frame's payload. */
+	static void ApplyMask(char *Data, uint32_t Len, uint32_t Mask, uint32_t Offset);
+
+	/*!< \brief reads frames from Buffer, resuming wherever the previous call stopped.  payloads are unmasked as they arrive and fragments are appended into one buffer that grows geometrically.
+		 \param Source if Buffer points into Source(with Source's data null terminated after BufferLen), a whole unfragmented frame is unmasked in place and referenced instead of being copied.
+		 \return the number of bytes consumed, or -1 if the stream is malformed.
+	*/
+	uint32_t Deserialize(const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator, LWEHttpBuffer *Source = nullptr);
 
 	uint32_t Serialize(char *Buffer, uint32_t BufferLen, bool isClient);
 
+	/*!< \brief serializes only the frame header, masking the payload in place for clients, so the payload can be sent straight from m_Data. */
+	uint32_t SerializeHeader(char *Buffer, uint32_t BufferLen, bool isClient);
+
 	uint32_t GetOp(void);
 
 	void WorkFinished(void);
@@ -46,6 +67,8 @@ struct LWEWebPacket {
 
 	LWEWebPacket(LWEWebPacket &&Other);
 
+	LWEWebPacket(const LWEWebPacket &Other);
+
 	LWEWebPacket(const char *Data, uint32_t DataLen, LWAllocator &Allocator, uint32_t ControlFlag, LWEWebSocket *WebSocket);
 
 	~LWEWebPacket();
@@ -57,6 +80,16 @@ struct LWEWebSocket {
 		CONNECTED_SERVER,
 		CONNECTING_CLIENT,
 		CONNECTING_SERVER,
+
+		PerMessageDeflate = 0x4, /*!< \brief permessage-deflate was negotiated, before connecting this marks that it should be offered. */
+		ServerNoContextTakeover = 0x8, /*!< \brief the server resets it's compressor after every message. */
+		ClientNoContextTakeover = 0x10, /*!< \brief the client resets it's compressor after every message. */
+		DEFLATEBITS = 0x1C,
+
+		MinWindowBits = 9, /*!< \brief zlib can't produce raw deflate streams with an 8 bit window, so offers requiring one are declined. */
+		MaxWindowBits = 15,
+
+		MaxPendingPackets = 1024 /*!< \brief a connection with this many outgoing frames held back is closed as too slow to keep up. */
 	};
 	char m_Host[128];
 	char m_Path[128];
@@ -64,8 +97,13 @@ struct LWEWebSocket {
 	char m_SecKey[128];
 	char m_SecProtocols[128];
 	LWEWebPacket m_ActivePacket;
+	LWEWebPacket m_ControlPacket; /*!< \brief control frames are read into here, so one arriving between the fragments of a message leaves m_ActivePacket intact. */
+	std::deque<LWEWebPacket> m_PendingPackets; /*!< \brief outgoing frames held back while upgrading or while the socket is not writable, sent in order before any newer frame. */
 	LWSocket *m_Socket;
+	LWEHttpZStream *m_Deflater = nullptr;
+	LWEHttpZStream *m_Inflater = nullptr;
 	uint32_t m_Flag;
+	uint32_t m_DeflateWindowBits = MaxWindowBits; /*!< \brief the window used for compressing outgoing messages. */
 	uint16_t m_Port;
 
 	LWEWebSocket &SetURI(const char *URI);
@@ -98,6 +136,30 @@ struct LWEWebSocket {
 
 	bool IsConnected(void);
 
+	bool isClient(void);
+
+	/*!< \brief server side, accepts the first permessage-deflate offer in the Sec-WebSocket-Extensions header that can be honored.  Flag and WindowBits are the server's own preferences.  returns true if compression was negotiated. */
+	bool AcceptDeflateOffer(const char *Offers, uint32_t Flag, uint32_t WindowBits);
+
+	/*!< \brief client side, applies the server's Sec-WebSocket-Extensions response to the offer that was made.  returns false if the response can not be honored and the connection should be failed. */
+	bool AcceptDeflateResponse(const char *Response);
+
+	/*!< \brief writes the Sec-WebSocket-Extensions value, the offer when connecting as a client or the agreed parameters as a server. */
+	uint32_t WriteDeflateExtension(char *Buffer, uint32_t BufferLen);
+
+	/*!< \brief compresses Packet's payload in place with the connection's deflate context. */
+	bool Deflate(LWEWebPacket &Packet, LWAllocator &Allocator);
+
+	/*!< \brief decompresses a received CONTROL_COMPRESSED packet in place with the connection's inflate context. */
+	bool Inflate(LWEWebPacket &Packet, LWAllocator &Allocator);
+
+	/*!< \brief reads the frames in Buffer received on Socket, control frames are read into m_ControlPacket so they may arrive between the fragments of m_ActivePacket.
+		 close frames mark Socket closable and pongs are discarded, every other finished message is inflated and passed to Received, which must move it out or call WorkFinished on it.
+		 \param Source the buffer Buffer is held in, large payloads reference it instead of being copied.
+		 \return false if the stream is malformed or Received returns false.
+	*/
+	bool ReadFrames(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator, LWEHttpBuffer *Source, const std::function<bool(LWEWebPacket &)> &Received);
+
 	LWEWebSocket(const char *URI, const char *Origin = nullptr);
 
 	~LWEWebSocket();
@@ -106,7 +168,9 @@ struct LWEWebSocket {
 class LWEProtocolWebSocket : public LWProtocol {
 public:
 	enum {
-		PacketBufferSize = 64
+		PacketBufferSize = 64,
+		ReceiveBufferSize = 64 * 1024,
+		DeflateMinLength = 256
 	};
 	virtual LWProtocol &Read(LWSocket &Socket, LWProtocolManager *Manager);
 
@@ -116,7 +180,7 @@ public:
 
 	bool Send(LWSocket &Socket, const char *Buffer, uint32_t Len);
 
-	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen);
+	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWEHttpBuffer *Source = nullptr);
 
 	LWEProtocolWebSocket &ProcessOutPackets(void);
 
@@ -132,6 +196,13 @@ public:
 
 	LWEProtocolWebSocket &SetSubProtocol(const char *SubProtocol);
 
+	/*!< \brief enables permessage-deflate negotiation.
+		 \param Flag LWEWebSocket::PerMessageDeflate, optionally with ServerNoContextTakeover/ClientNoContextTakeover to trade ratio for memory, 0 disables compression.
+		 \param MinLength messages shorter then this are sent uncompressed.
+		 \param WindowBits the largest window used to compress outgoing messages.
+	*/
+	LWEProtocolWebSocket &SetPerMessageDeflate(uint32_t Flag, uint32_t MinLength = DeflateMinLength, uint32_t WindowBits = LWEWebSocket::MaxWindowBits);
+
 	LWEProtocolWebSocket &SetWebSocketClosedCallback(std::function<bool(LWSocket &, LWEWebSocket*, LWProtocolManager*)> WebSocketClosedCallback);
 
 	LWEProtocolWebSocket &SetWebSocketChangedCallback(std::function<void(LWSocket &, LWSocket&, LWEWebSocket*, LWProtocolManager*)> WebSocketChangedCallback);
@@ -148,7 +219,11 @@ public:
 
 	LWEProtocolWebSocket(uint32_t ProtocolID, LWAllocator &Allocator, LWProtocolManager *Manager);
 
+	~LWEProtocolWebSocket();
 protected:
+	/*!< \brief compresses the frame if negotiated and appends it to it's socket's output queue, marking the socket closable on failure. */
+	bool QueueFrame(LWEWebPacket &Packet, char *Buffer, uint32_t BufferLen);
+
 	char m_Server[256];
 	char m_UserAgent[256];
 	char m_SubProtocol[256];
@@ -159,8 +234,14 @@ protected:
 	std::function<void(LWSocket &, LWSocket &, LWEWebSocket*, LWProtocolManager*)> m_WebSocketChangedCallback;
 	LWProtocolManager *m_Manager;
 	LWAllocator &m_Allocator;
+	LWEHttpBuffer *m_ReceiveBuffer = nullptr;
+	std::vector<LWSocket*> m_FlushList;
+	std::vector<LWEWebSocket*> m_PendingSockets;
 	uint32_t m_ProtocolID;
 	uint32_t m_KeySeed;
+	uint32_t m_DeflateFlag = 0;
+	uint32_t m_DeflateMinLength = DeflateMinLength;
+	uint32_t m_DeflateWindowBits = LWEWebSocket::MaxWindowBits;
 };
 
 #endif
\ No newline at end of file
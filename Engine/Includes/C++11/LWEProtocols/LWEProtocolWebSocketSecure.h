@@ -7,7 +7,8 @@
 class LWEProtocolWebSocketSecure : public LWEProtocolTLS {
 public:
 	enum {
-		PacketBufferSize = 64
+		PacketBufferSize = 64,
+		DeflateMinLength = 256
 	};
 
 	virtual LWProtocol &SocketClosed(LWSocket &Socket, LWProtocolManager *Manager);
@@ -16,7 +17,7 @@ public:
 
 	virtual LWProtocol &ProcessTLSData(LWSocket &Socket, const char *Data, uint32_t DataLen);
 
-	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen);
+	bool ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWEHttpBuffer *Source = nullptr);
 
 	LWEProtocolWebSocketSecure &ProcessOutPackets(void);
 
@@ -32,6 +33,9 @@ public:
 
 	LWEProtocolWebSocketSecure &SetSubProtocol(const char *SubProtocol);
 
+	/*!< \brief enables permessage-deflate negotiation, see LWEProtocolWebSocket::SetPerMessageDeflate. */
+	LWEProtocolWebSocketSecure &SetPerMessageDeflate(uint32_t Flag, uint32_t MinLength = DeflateMinLength, uint32_t WindowBits = LWEWebSocket::MaxWindowBits);
+
 	LWEProtocolWebSocketSecure &SetWebSocketClosedCallback(std::function<bool(LWSocket &, LWEWebSocket*, LWProtocolManager*)> WebSocketClosedCallback);
 
 	LWEProtocolWebSocketSecure &SetWebSocketChangedCallback(std::function<void(LWSocket &, LWSocket&, LWEWebSocket*, LWProtocolManager*)> WebSocketChangedCallback);
@@ -48,7 +52,11 @@ public:
 
 	LWEProtocolWebSocketSecure(uint32_t ProtocolID, uint32_t TLSProtocolID, LWAllocator &Allocator, LWProtocolManager *Manager, const char *CertFile = nullptr, const char *KeyFile = nullptr);
 
+	~LWEProtocolWebSocketSecure();
 protected:
+	/*!< \brief compresses the frame if negotiated and sends it, resuming from the bytes already sent.  returns false if the frame could not be sent whole yet and should be retried. */
+	bool SendFrame(LWEWebPacket &Packet, char *Buffer, uint32_t BufferLen);
+
 	char m_Server[256];
 	char m_UserAgent[256];
 	char m_SubProtocol[256];
@@ -59,8 +67,13 @@ protected:
 	std::function<void(LWSocket &, LWSocket &, LWEWebSocket*, LWProtocolManager*)> m_WebSocketChangedCallback;
 	LWProtocolManager *m_Manager;
 	LWAllocator &m_Allocator;
+	LWEHttpBuffer *m_ReceiveBuffer = nullptr;
+	std::vector<LWEWebSocket*> m_PendingSockets;
 	uint32_t m_wProtocolID;
 	uint32_t m_KeySeed;
+	uint32_t m_DeflateFlag = 0;
+	uint32_t m_DeflateMinLength = DeflateMinLength;
+	uint32_t m_DeflateWindowBits = LWEWebSocket::MaxWindowBits;
 };
 
 #endif
\ No newline at end of file
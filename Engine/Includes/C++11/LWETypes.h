@@ -6,6 +6,8 @@ class LWEAsset;
 
 class LWEAssetManager;
 
+struct LWEAssetLoad;
+
 class LWEUIManager;
 
 class LWEUI;
@@ -32,6 +34,14 @@ class LWEJson;
 
 struct LWEJObject;
 
+class LWEJsonTape;
+
+struct LWEJNode;
+
+class LWEJsonReader;
+
+class LWEJsonWriter;
+
 class LWEXML;
 
 struct LWEXMLNode;
@@ -44,6 +54,14 @@ struct LWEJob;
 
 struct LWEJobThread;
 
+struct LWETask;
+
+struct LWETaskHandle;
+
+class LWETaskDeque;
+
+class LWETaskGroup;
+
 class LWEJobQueue;
 
 class LWEGLTFParser;
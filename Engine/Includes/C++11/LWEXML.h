@@ -2,6 +2,7 @@
 #define LWEXML_H
 #include <LWCore/LWText.h>
 #include <functional>
+#include <unordered_map>
 #include "LWETypes.h"
 
 #define LWEXMLMAXNAMELEN 32
@@ -9,18 +10,22 @@
 #define LWEXMLMAXTEXTLEN 1024
 
 struct LWXMLAttribute {
-	char m_Name[LWEXMLMAXNAMELEN];
-	char m_Value[LWEXMLMAXVALUELEN];
+	char *m_Name;
+	char *m_Value;
+	uint32_t m_NameHash;
 };
 
 struct LWEXMLNode {
 	enum {
-		MaxAttributes = 32
+		AttributePoolSize = 4
 	};
-	LWXMLAttribute m_Attributes[MaxAttributes];
+	LWXMLAttribute *m_Attributes;
 	char m_Text[LWEXMLMAXTEXTLEN];
 	char m_Name[LWEXMLMAXNAMELEN];
+	uint32_t m_NameHash;
 	uint32_t m_AttributeCount;
+	uint32_t m_AttributePoolSize;
+	LWEXML *m_XML;
 	LWEXMLNode *m_Parent;
 	LWEXMLNode *m_Next;
 	LWEXMLNode *m_FirstChild;
@@ -28,6 +33,8 @@ struct LWEXMLNode {
 
 	bool PushAttribute(const char *Name, const char *Value);
 
+	bool PushAttribute(const char *Name, uint32_t NameLen, const char *Value, uint32_t ValueLen);
+
 	bool PushAttributef(const char *Name, const char *ValueFmt, ...);
 
 	bool RemoveAttribute(uint32_t i);
@@ -41,19 +48,25 @@ struct LWEXMLNode {
 	LWEXMLNode &SetTextf(const char *TextFmt, ...);
 
 	LWXMLAttribute *FindAttribute(const LWText &Name);
+
+	LWXMLAttribute *FindAttribute(uint32_t NameHash);
 };
 
 struct LWEXMLParser {
 	char m_Name[LWEXMLMAXNAMELEN];
 	std::function<bool(LWEXMLNode *, void *, LWEXML *)> m_Callback;
 	void *m_UserData;
+	uint32_t m_NameHash;
+	uint32_t m_Next;
 };
 
 class LWEXML {
 public:
 	enum {
 		NodePoolSize = 256,
-		MaxParsers = 32
+		ArenaBlockSize = 16384,
+		MaxParsers = 32,
+		InvalidParser = 0xFFFFFFFF
 	};
 
 	static bool LoadFile(LWEXML &XML, LWAllocator &Allocator, const LWText &Path, bool StripFormatting, LWEXMLNode *Parent, LWEXMLNode *Prev, LWFileStream *ExistingStream = nullptr);
@@ -83,6 +96,8 @@ public:
 
 	LWEXMLNode *GetInsertedNodeAfter(LWEXMLNode *Parent, LWEXMLNode *Prev, LWAllocator &Allocator);
 
+	char *AllocateArena(uint32_t Length);
+
 	LWEXMLNode *GetFirstNode(void);
 
 	LWEXMLNode *GetLastNode(void);
@@ -94,6 +109,12 @@ public:
 private:
 	LWEXMLNode **m_NodePool;
 	LWEXMLParser m_Parsers[MaxParsers];
+	std::unordered_map<uint32_t, uint32_t> m_ParserMap;
+	char **m_ArenaPool;
+	char *m_ArenaBlock;
+	LWAllocator *m_Allocator;
+	uint32_t m_ArenaCount;
+	uint32_t m_ArenaRemaining;
 	uint32_t m_NodeCount;
 	uint32_t m_ParserCount;
 	LWEXMLNode *m_FirstNode;
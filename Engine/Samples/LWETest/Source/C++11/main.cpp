@@ -0,0 +1,211 @@
+#include <LWCore/LWTypes.h>
+#include <LWCore/LWText.h>
+#include <LWCore/LWByteBuffer.h>
+#include <LWCore/LWTimer.h>
+#include <LWCore/LWAllocators/LWAllocator_Default.h>
+#include <LWPlatform/LWFileStream.h>
+#include <LWAudio/LWAudioStream.h>
+#include <LWEAsset.h>
+#include <LWEJobQueue.h>
+#include <LWEJson.h>
+#include <LWEXML.h>
+#include <iostream>
+#include <thread>
+
+bool WriteTestWav(const char *Path, uint32_t SampleCount, LWAllocator &Allocator) {
+	const uint32_t HeaderSize = 44;
+	int8_t *Buffer = Allocator.AllocateArray<int8_t>(HeaderSize + SampleCount * 2);
+	int8_t *B = Buffer;
+	B += LWByteBuffer::Write<uint32_t>(0x46464952, B); //"RIFF"
+	B += LWByteBuffer::Write<uint32_t>(HeaderSize - 8 + SampleCount * 2, B);
+	B += LWByteBuffer::Write<uint32_t>(0x45564157, B); //"WAVE"
+	B += LWByteBuffer::Write<uint32_t>(0x20746d66, B); //"fmt "
+	B += LWByteBuffer::Write<uint32_t>(16, B);
+	B += LWByteBuffer::Write<uint16_t>(1, B); //Linear PCM.
+	B += LWByteBuffer::Write<uint16_t>(1, B); //Channels.
+	B += LWByteBuffer::Write<uint32_t>(44100, B);
+	B += LWByteBuffer::Write<uint32_t>(44100 * 2, B);
+	B += LWByteBuffer::Write<uint16_t>(2, B);
+	B += LWByteBuffer::Write<uint16_t>(16, B);
+	B += LWByteBuffer::Write<uint32_t>(0x61746164, B); //"data"
+	B += LWByteBuffer::Write<uint32_t>(SampleCount * 2, B);
+	for (uint32_t i = 0; i < SampleCount; i++) B += LWByteBuffer::Write<int16_t>((int16_t)(i * 64), B);
+	LWFileStream Stream;
+	bool Result = LWFileStream::OpenStream(Stream, Path, LWFileStream::WriteMode | LWFileStream::BinaryMode, Allocator);
+	if (Result) Result = Stream.Write((const char*)Buffer, (uint32_t)(B - Buffer)) == (uint32_t)(B - Buffer);
+	LWAllocator::Destroy(Buffer);
+	return Result;
+}
+
+bool LoadTestAssets(LWEAssetManager &AM, const char *Assets, LWAllocator &Allocator) {
+	LWEXML X;
+	if (!LWEXML::ParseBuffer(X, Allocator, Assets, true)) return false;
+	X.PushParser("AssetManager", LWEAssetManager::XMLParser, &AM);
+	X.Process();
+	return true;
+}
+
+bool PerformLWEAssetManagerTest(void) {
+	std::cout << "Beginning LWEAssetManager test." << std::endl;
+	const char *Assets = "<AssetManager><AudioStream Name=\"A\" Path=\"AssetTest.wav\"/><AudioStream Name=\"B\" Path=\"AssetTest.wav\"/><AudioStream Name=\"C\" Path=\"AssetTest.wav\"/><AudioStream Name=\"Missing\" Path=\"AssetMissing.wav\"/></AssetManager>";
+	LWAllocator_Default Allocator;
+	LWAllocator_Default QueueAllocator;
+	if (!WriteTestWav("AssetTest.wav", 256, Allocator)) return false;
+	//The queue starts paused, so loads only run when the main thread waits on them until it is started.
+	LWEJobQueue Queue(QueueAllocator, 2);
+	//Placeholders are never dereferenced by the manager, so any address works without a video driver.
+	char PlaceholderStorage = 0;
+	void *Placeholder = &PlaceholderStorage;
+	uint32_t BaseBytes = Allocator.GetAllocatedBytes();
+	{
+		LWEAssetManager AM(nullptr, nullptr, Allocator);
+		AM.SetJobQueue(&Queue);
+		AM.SetPlaceholder(LWEAsset::AudioStream, Placeholder);
+		if (!LoadTestAssets(AM, Assets, Allocator)) return false;
+		std::cout << "Checking pending loads: " << AM.GetPendingCount() << std::endl;
+		if (AM.GetPendingCount() != 4 || AM.Update() != 4) return false;
+		LWEAsset *A = AM.GetAsset("A");
+		if (!A || A->GetFlag() != LWEAsset::Loading || A->GetAsset() != Placeholder) return false;
+
+		uint32_t ACalls = 0, MissingCalls = 0, CCalls = 0;
+		bool ALoaded = false, MissingLoaded = true;
+		if (!AM.OnLoaded("A", [&ACalls, &ALoaded](LWEAsset &, bool Loaded, LWEAssetManager &) { ACalls++; ALoaded = Loaded; })) return false;
+		if (ACalls) return false;
+
+		//The typed getter finishes the load rather then handing out the placeholder.
+		LWAudioStream *Stream = AM.GetAsset<LWAudioStream>("A");
+		if (!Stream || Stream->GetSampleLength() != 256 || A->GetFlag() != 0 || ACalls != 1 || !ALoaded) return false;
+		if (AM.GetAsset<LWAudioStream>("Missing")) return false;
+		LWEAsset *Missing = AM.GetAsset("Missing");
+		if (Missing->GetFlag() != LWEAsset::LoadFailed || Missing->GetAsset() != Placeholder) return false;
+		if (!AM.OnLoaded("Missing", [&MissingCalls, &MissingLoaded](LWEAsset &, bool Loaded, LWEAssetManager &) { MissingCalls++; MissingLoaded = Loaded; })) return false;
+		if (MissingCalls != 1 || MissingLoaded || AM.GetPendingCount() != 2) return false;
+
+		//B's callback waits on C while Update is finalizing, which unlinks C from the loads Update is walking.
+		AM.OnLoaded("B", [&CCalls](LWEAsset &, bool Loaded, LWEAssetManager &Manager) {
+			if (Loaded && Manager.GetAsset<LWAudioStream>("C")) CCalls++;
+		});
+		AM.OnLoaded("C", [&CCalls](LWEAsset &, bool, LWEAssetManager &) { CCalls++; });
+		Queue.Start();
+		uint32_t Pending = AM.GetPendingCount();
+		while (Pending) {
+			uint32_t Remaining = AM.Update(1);
+			if (Pending - Remaining > 2) return false;
+			Pending = Remaining;
+			std::this_thread::yield();
+		}
+		std::cout << "Checking nested waits: " << CCalls << std::endl;
+		if (CCalls != 2 || AM.GetAsset("B")->GetFlag() || AM.GetAsset("C")->GetFlag()) return false;
+		Queue.Pause();
+	}
+	{
+		//Destroying the manager with loads still queued waits on them and frees what they produced.
+		LWEAssetManager AM(nullptr, nullptr, Allocator);
+		AM.SetJobQueue(&Queue);
+		AM.SetPlaceholder(LWEAsset::AudioStream, Placeholder);
+		if (!LoadTestAssets(AM, Assets, Allocator)) return false;
+		if (AM.GetPendingCount() != 4) return false;
+	}
+	std::cout << "Checking allocated bytes: " << Allocator.GetAllocatedBytes() << " Expected: " << BaseBytes << std::endl;
+	return Allocator.GetAllocatedBytes() == BaseBytes;
+}
+
+bool PerformLWEJsonCBORTest(void) {
+	std::cout << "Beginning LWEJson CBOR test." << std::endl;
+	const uint32_t BufferSize = 64 * 1024;
+	const uint32_t ItemCount = 64;
+	const uint32_t Iterations = 200;
+	LWAllocator_Default Allocator;
+	char *Text = Allocator.AllocateArray<char>(BufferSize);
+	char *TextA = Allocator.AllocateArray<char>(BufferSize);
+	char *TextB = Allocator.AllocateArray<char>(BufferSize);
+	int8_t *CBORA = Allocator.AllocateArray<int8_t>(BufferSize);
+	int8_t *CBORB = Allocator.AllocateArray<int8_t>(BufferSize);
+	bool Result = false;
+	auto Cleanup = [&]()->bool {
+		LWAllocator::Destroy(Text);
+		LWAllocator::Destroy(TextA);
+		LWAllocator::Destroy(TextB);
+		LWAllocator::Destroy(CBORA);
+		LWAllocator::Destroy(CBORB);
+		return Result;
+	};
+	uint32_t o = snprintf(Text, BufferSize, "{\"Name\": \"Round \\\"trip\\\"\", \"Big\": 18446744073709551615, \"Small\": -9223372036854775808, \"Empty\": [], \"None\": {}, \"Items\": [");
+	for (uint32_t i = 0; i < ItemCount; i++) {
+		o += snprintf(Text + o, BufferSize - o, "%s{\"Id\": %u, \"Offset\": -%u, \"Scale\": 0.5, \"Weight\": 3.14159, \"Visible\": %s, \"Parent\": null, \"Tag\": \"Item %u\", \"Pos\": [1, -2, 2.25]}", i ? ", " : "", i, i * 1000 + 1, (i & 1) ? "true" : "false", i);
+	}
+	snprintf(Text + o, BufferSize - o, "]}");
+
+	{
+		LWEJson JA(Allocator);
+		LWEJson JB(Allocator);
+		LWEJson JC(Allocator);
+		if (!LWEJson::Parse(JA, Text)) return Cleanup();
+		LWByteBuffer BufA(CBORA, BufferSize, LWByteBuffer::BufferNotOwned);
+		uint32_t LenA = JA.SerializeCBOR(BufA);
+		LWByteBuffer ReadA((const int8_t*)CBORA, LenA);
+		if (!LWEJson::ParseCBOR(JB, ReadA)) return Cleanup();
+		uint32_t TextLenA = JA.Serialize(TextA, BufferSize, false);
+		uint32_t TextLenB = JB.Serialize(TextB, BufferSize, false);
+		std::cout << "Text: " << TextLenA << " CBOR: " << LenA << std::endl;
+		if (TextLenA != TextLenB || strcmp(TextA, TextB)) {
+			std::cout << "CBOR round trip changed the document: " << TextB << std::endl;
+			return Cleanup();
+		}
+		//Re-encoding the decoded document must produce identical bytes.
+		LWByteBuffer BufB(CBORB, BufferSize, LWByteBuffer::BufferNotOwned);
+		uint32_t LenB = JB.SerializeCBOR(BufB);
+		if (LenA != LenB || memcmp(CBORA, CBORB, LenA)) return Cleanup();
+
+		//Indefinite length arrays are accepted, but no other major type may use additional info 31.
+		const uint8_t Indefinite[] = { 0xA1, 0x61, 'a', 0x9F, 0x01, 0x20, 0xFF };
+		LWByteBuffer IndefiniteBuf((const int8_t*)Indefinite, sizeof(Indefinite));
+		if (!LWEJson::ParseCBOR(JC, IndefiniteBuf) || strcmp(JC.Find("a[1]")->m_Value, "-1")) return Cleanup();
+		const uint8_t BadHeads[] = { 0x1F, 0x3F, 0xDF, 0xFF };
+		for (uint32_t i = 0; i < sizeof(BadHeads); i++) {
+			LWEJson JD(Allocator);
+			const uint8_t Bad[] = { 0xA1, 0x61, 'a', BadHeads[i] };
+			LWByteBuffer BadBuf((const int8_t*)Bad, sizeof(Bad));
+			if (LWEJson::ParseCBOR(JD, BadBuf)) {
+				std::cout << "Accepted additional info 31 in: " << std::hex << (uint32_t)BadHeads[i] << std::dec << std::endl;
+				return Cleanup();
+			}
+		}
+
+		uint64_t Start = LWTimer::GetCurrent();
+		for (uint32_t i = 0; i < Iterations; i++) {
+			LWEJson J(Allocator);
+			LWEJson::Parse(J, Text);
+		}
+		uint64_t TextParse = LWTimer::GetCurrent() - Start;
+		Start = LWTimer::GetCurrent();
+		for (uint32_t i = 0; i < Iterations; i++) {
+			LWEJson J(Allocator);
+			LWByteBuffer Read((const int8_t*)CBORA, LenA);
+			LWEJson::ParseCBOR(J, Read);
+		}
+		uint64_t CBORParse = LWTimer::GetCurrent() - Start;
+		Start = LWTimer::GetCurrent();
+		for (uint32_t i = 0; i < Iterations; i++) JA.Serialize(TextB, BufferSize, false);
+		uint64_t TextWrite = LWTimer::GetCurrent() - Start;
+		Start = LWTimer::GetCurrent();
+		for (uint32_t i = 0; i < Iterations; i++) {
+			LWByteBuffer Buf(CBORB, BufferSize, LWByteBuffer::BufferNotOwned);
+			JA.SerializeCBOR(Buf);
+		}
+		uint64_t CBORWrite = LWTimer::GetCurrent() - Start;
+		double Scale = 1000000.0 / (double)(LWTimer::GetResolution() * Iterations);
+		std::cout << "Parse text: " << TextParse * Scale << "us CBOR: " << CBORParse * Scale << "us" << std::endl;
+		std::cout << "Serialize text: " << TextWrite * Scale << "us CBOR: " << CBORWrite * Scale << "us" << std::endl;
+	}
+	Result = true;
+	return Cleanup();
+}
+
+int main(int, char **) {
+	std::cout << "Testing LWEngine features." << std::endl;
+	if (!PerformLWEAssetManagerTest()) std::cout << "Error with LWEAssetManager test." << std::endl;
+	else if (!PerformLWEJsonCBORTest()) std::cout << "Error with LWEJson CBOR test." << std::endl;
+	else std::cout << "LWEngine successful test." << std::endl;
+	return 0;
+}
@@ -11,8 +11,10 @@
 #include "LWEUIManager.h"
 #include "LWELocalization.h"
 #include "LWEXML.h"
+#include "LWEJobQueue.h"
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 #pragma region LWEAsset
 
@@ -52,11 +54,21 @@ uint32_t LWEAsset::GetType(void) {
 	return m_Type;
 }
 
+uint32_t LWEAsset::GetFlag(void) {
+	return m_Flag;
+}
+
+LWEAsset &LWEAsset::SetAsset(void *Asset, uint32_t Flag) {
+	m_Asset = Asset;
+	m_Flag = Flag;
+	return *this;
+}
+
 const char *LWEAsset::GetAssetPath(void){
 	return m_AssetPath;
 }
 
-LWEAsset::LWEAsset(uint32_t Type, void *Asset, const char *AssetPath) : m_Type(Type), m_Asset(Asset) {
+LWEAsset::LWEAsset(uint32_t Type, void *Asset, const char *AssetPath, uint32_t Flag) : m_Type(Type), m_Flag(Flag), m_Asset(Asset) {
 	m_AssetPath[0] = '\0';
 	strncat(m_AssetPath, AssetPath, sizeof(m_AssetPath));
 }
@@ -125,6 +137,30 @@ bool LWEAssetManager::XMLParseFont(LWEXMLNode *N, LWEAssetManager *AM) {
 	const char *PathValue = PathAttr->m_Value;
 	if (Localize) PathValue = Localize->ParseLocalization(SBuffer, sizeof(SBuffer), PathAttr->m_Value);
 	uint32_t ExtType = LWFileStream::IsExtensions(PathValue, 3, "ttf", "fnt", "arfont");
+	//Only ttf fonts are rasterized in memory, fnt and arfont load their pages straight into textures so they stay on the calling thread.
+	if (ExtType == 0 && AM->GetJobQueue()) {
+		LWEAssetLoad *Load = AM->GetAllocator()->Allocate<LWEAssetLoad>();
+		Load->m_Type = LWEAsset::Font;
+		Load->m_Path = PathValue;
+		Load->m_Size = Size;
+		Load->m_RangeCount = std::min<uint32_t>(GlpyhCount, LWEAssetLoad::MaxGlyphRanges);
+		std::copy(GlyphFirst, GlyphFirst + Load->m_RangeCount, Load->m_GlyphFirst);
+		std::copy(GlyphLens, GlyphLens + Load->m_RangeCount, Load->m_GlyphLens);
+		if (ErrorGlyphAttr) {
+			Load->m_ErrorGlyph = atoi(ErrorGlyphAttr->m_Value);
+			Load->m_HasErrorGlyph = true;
+		}
+		for (LWEXMLNode *C = N->m_FirstChild; C; C = C->m_Next) {
+			uint32_t n = LWText::CompareMultiple(C->m_Name, 1, "GlyphName");
+			if (n == 0) {
+				LWXMLAttribute *GNameAttr = C->FindAttribute("Name");
+				LWXMLAttribute *GCodeAttr = C->FindAttribute("Code");
+				if (!GNameAttr || !GCodeAttr) continue;
+				Load->m_GlyphNames.emplace_back(GNameAttr->m_Value, atoi(GCodeAttr->m_Value));
+			}
+		}
+		return AM->InsertLoad(NameAttr->m_Value, Load) != nullptr;
+	}
 	if (!LWFileStream::OpenStream(FontFile, PathValue, LWFileStream::ReadMode | ((ExtType == 0 || ExtType==2) ? LWFileStream::BinaryMode : 0), *AM->GetAllocator())) {
 		std::cout << "Error opening font file: '" << PathValue << "'" << std::endl;
 		return false;
@@ -167,11 +203,6 @@ bool LWEAssetManager::XMLParseTexture(LWEXMLNode *N, LWEAssetManager *AM) {
 	const uint32_t TotalValues = sizeof(FlagValues) / sizeof(uint32_t);
 	const char *PathValue = PathAttr->m_Value;
 	if (Localize) PathValue = Localize->ParseLocalization(SBuffer, sizeof(SBuffer), PathAttr->m_Value);
-	LWImage Image;
-	if (!LWImage::LoadImage(Image, PathValue, *AM->GetAllocator())) {
-		std::cout << "Error loading image: '" << PathValue << "'" << std::endl;
-		return false;
-	}
 	uint32_t TextureState = 0;
 	if (StateAttr) {
 		for (char *C = StateAttr->m_Value; *C;C++) {
@@ -189,6 +220,18 @@ bool LWEAssetManager::XMLParseTexture(LWEXMLNode *N, LWEAssetManager *AM) {
 			if (!C) break;
 		}
 	}
+	if (AM->GetJobQueue()) {
+		LWEAssetLoad *Load = AM->GetAllocator()->Allocate<LWEAssetLoad>();
+		Load->m_Type = LWEAsset::Texture;
+		Load->m_Path = PathValue;
+		Load->m_Flag = TextureState;
+		return AM->InsertLoad(NameAttr->m_Value, Load) != nullptr;
+	}
+	LWImage Image;
+	if (!LWImage::LoadImage(Image, PathValue, *AM->GetAllocator())) {
+		std::cout << "Error loading image: '" << PathValue << "'" << std::endl;
+		return false;
+	}
 	LWTexture *Tex = AM->GetDriver()->CreateTexture(TextureState, Image, *AM->GetAllocator());
 	if (!AM->InsertAsset(NameAttr->m_Value, Tex, LWEAsset::Texture, PathValue)) {
 		std::cout << "Error inserting asset: '" << NameAttr->m_Value << "'" << std::endl;
@@ -468,7 +511,7 @@ bool LWEAssetManager::XMLParseShader(LWEXMLNode *N, LWEAssetManager *AM) {
 		uint32_t InputCount = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
 			LWXMLAttribute &A = N->m_Attributes[i];
-			uint32_t NameHash = LWText::MakeHash(A.m_Name);
+			uint32_t NameHash = A.m_NameHash;
 			uint32_t Length = 1;
 			sscanf(A.m_Value, "%[^[][%d]", TypeBuffer, &Length);
 			uint32_t TypeHash = LWText::MakeHash(TypeBuffer);
@@ -494,7 +537,7 @@ bool LWEAssetManager::XMLParseShader(LWEXMLNode *N, LWEAssetManager *AM) {
 		uint32_t ResourceNameHashs[LWShader::MaxResources];
 		uint32_t Count = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
-			ResourceNameHashs[Count++] = LWText::MakeHash(N->m_Attributes[i].m_Name);
+			ResourceNameHashs[Count++] = N->m_Attributes[i].m_NameHash;
 		}
 		S->SetResourceMap(Count, ResourceNameHashs);
 		return;
@@ -504,7 +547,7 @@ bool LWEAssetManager::XMLParseShader(LWEXMLNode *N, LWEAssetManager *AM) {
 		uint32_t BlockNameHashs[LWShader::MaxBlocks];
 		uint32_t Count = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
-			BlockNameHashs[Count++] = LWText::MakeHash(N->m_Attributes[i].m_Name);
+			BlockNameHashs[Count++] = N->m_Attributes[i].m_NameHash;
 		}
 		S->SetBlockMap(Count, BlockNameHashs);
 		return;
@@ -714,7 +757,7 @@ bool LWEAssetManager::XMLParseShaderBuilder(LWEXMLNode *N, LWEAssetManager *AM)
 		uint32_t Cnt = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
 			LWXMLAttribute &A = N->m_Attributes[i];
-			uint32_t NameHash = LWText::MakeHash(A.m_Name);
+			uint32_t NameHash = A.m_NameHash;
 			uint32_t Length = 1;
 			sscanf(A.m_Value, "%[^[][%d]", TypeBuffer, &Length);
 			uint32_t TypeHash = LWText::MakeHash(TypeBuffer);
@@ -739,7 +782,7 @@ bool LWEAssetManager::XMLParseShaderBuilder(LWEXMLNode *N, LWEAssetManager *AM)
 	auto ParseResourceMap = [](LWEXMLNode *N, uint32_t *HashNameList, LWEAssetManager *AM)->uint32_t {
 		uint32_t Count = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
-			HashNameList[Count++] = LWText::MakeHash(N->m_Attributes[i].m_Name);
+			HashNameList[Count++] = N->m_Attributes[i].m_NameHash;
 		}
 		return Count;
 	};
@@ -747,7 +790,7 @@ bool LWEAssetManager::XMLParseShaderBuilder(LWEXMLNode *N, LWEAssetManager *AM)
 	auto ParseBlockMap = [](LWEXMLNode *N, uint32_t *BlockNameList, LWEAssetManager *AM)->uint32_t {
 		uint32_t Count = 0;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
-			BlockNameList[Count++] = LWText::MakeHash(N->m_Attributes[i].m_Name);
+			BlockNameList[Count++] = N->m_Attributes[i].m_NameHash;
 		}
 		return Count;
 	};
@@ -1023,6 +1066,13 @@ bool LWEAssetManager::XMLParseAudioStream(LWEXMLNode *N, LWEAssetManager *AM) {
 	}
 	const char *PathValue = PathAttr->m_Value;
 	if (Localize) PathValue = Localize->ParseLocalization(SBuffer, sizeof(SBuffer), PathAttr->m_Value);
+	if (AM->GetJobQueue()) {
+		LWEAssetLoad *Load = AM->GetAllocator()->Allocate<LWEAssetLoad>();
+		Load->m_Type = LWEAsset::AudioStream;
+		Load->m_Path = PathValue;
+		Load->m_Flag = Flag;
+		return AM->InsertLoad(NameAttr->m_Value, Load) != nullptr;
+	}
 	LWAudioStream *Stream = LWAudioStream::Create(PathValue, Flag, *AM->GetAllocator());
 	if (!Stream) {
 		std::cout << "Audiostream: '" << NameAttr->m_Value << "' Could not be found at: '" << PathValue << "'" << std::endl;
@@ -1110,6 +1160,161 @@ bool LWEAssetManager::InsertAssetReference(const LWText &Name, const LWText &Ref
 	return Ret.second;
 }
 
+void LWEAssetManager::RunLoad(LWEAssetLoad *Load, LWEAssetManager *AM) {
+	LWAllocator &Allocator = *AM->GetAllocator();
+	if (Load->m_Type == LWEAsset::Texture) {
+		Load->m_Loaded = LWImage::LoadImage(Load->m_Image, Load->m_Path.c_str(), Allocator);
+		if (!Load->m_Loaded) std::cout << "Error loading image: '" << Load->m_Path << "'" << std::endl;
+	} else if (Load->m_Type == LWEAsset::Font) {
+		LWFileStream FontFile;
+		if (!LWFileStream::OpenStream(FontFile, Load->m_Path.c_str(), LWFileStream::ReadMode | LWFileStream::BinaryMode, Allocator)) {
+			std::cout << "Error opening font file: '" << Load->m_Path << "'" << std::endl;
+			return;
+		}
+		//The font is rasterized into m_Image, it's texture is created on the render thread by FinalizeLoad.
+		LWFont *F = LWFont::LoadFontTTF(&FontFile, AM->GetDriver(), Load->m_Size, Load->m_RangeCount, Load->m_GlyphFirst, Load->m_GlyphLens, Load->m_Image, Allocator);
+		if (!F) {
+			std::cout << "Error creating font file!" << std::endl;
+			return;
+		}
+		if (Load->m_HasErrorGlyph) F->SetErrorGlyph(Load->m_ErrorGlyph);
+		for (auto &&Glyph : Load->m_GlyphNames) F->InsertGlyphName(Glyph.first.c_str(), Glyph.second);
+		Load->m_Result = F;
+		Load->m_Loaded = true;
+	} else if (Load->m_Type == LWEAsset::AudioStream) {
+		Load->m_Result = LWAudioStream::Create(Load->m_Path.c_str(), Load->m_Flag, Allocator);
+		Load->m_Loaded = Load->m_Result != nullptr;
+		if (!Load->m_Loaded) std::cout << "Audiostream could not be found at: '" << Load->m_Path << "'" << std::endl;
+	}
+}
+
+LWEAsset *LWEAssetManager::InsertLoad(const LWText &Name, LWEAssetLoad *Load) {
+	void *Placeholder = m_Placeholders[Load->m_Type];
+	if (!InsertAsset(Name, Placeholder, Load->m_Type, Load->m_Path.c_str())) {
+		std::cout << "Error inserting asset: '" << Name << "'" << std::endl;
+		LWAllocator::Destroy(Load);
+		return nullptr;
+	}
+	LWEAsset *A = m_AssetTable + (m_AssetCount - 1);
+	A->SetAsset(Placeholder, LWEAsset::Loading);
+	Load->m_Asset = A;
+	Load->m_Next = m_Loads;
+	m_Loads = Load;
+	m_PendingCount++;
+	Load->m_Task = m_JobQueue->PushTask([Load, this](LWETask &, LWEJobThread &, LWEJobQueue &) { RunLoad(Load, this); });
+	return A;
+}
+
+bool LWEAssetManager::FinalizeLoad(LWEAssetLoad *Load) {
+	void *Asset = nullptr;
+	if (Load->m_Loaded) {
+		if (Load->m_Type == LWEAsset::Texture) Asset = m_Driver->CreateTexture(Load->m_Flag, Load->m_Image, *m_Allocator);
+		else if (Load->m_Type == LWEAsset::Font) {
+			LWFont *F = (LWFont*)Load->m_Result;
+			LWTexture *Tex = m_Driver->CreateTexture(LWTexture::MinLinear | LWTexture::MagLinear, Load->m_Image, *m_Allocator);
+			if (Tex) {
+				F->SetTexture(0, Tex);
+				Asset = F;
+			} else {
+				std::cout << "Error making texture!" << std::endl;
+				LWAllocator::Destroy(F);
+			}
+		} else Asset = Load->m_Result;
+	}
+	if (Asset) Load->m_Asset->SetAsset(Asset, 0);
+	else Load->m_Asset->SetAsset(m_Placeholders[Load->m_Type], LWEAsset::LoadFailed);
+	for (auto &&Callback : Load->m_Callbacks) Callback(*Load->m_Asset, Asset != nullptr, *this);
+	LWAllocator::Destroy(Load);
+	return Asset != nullptr;
+}
+
+bool LWEAssetManager::OnLoaded(const LWText &Name, const LWEAssetCallback &Callback) {
+	LWEAsset *A = GetAsset(Name);
+	if (!A) return false;
+	if (A->GetFlag()&LWEAsset::Loading) {
+		for (LWEAssetLoad *L = m_Loads; L; L = L->m_Next) {
+			if (L->m_Asset != A) continue;
+			L->m_Callbacks.push_back(Callback);
+			return true;
+		}
+	}
+	Callback(*A, (A->GetFlag()&LWEAsset::LoadFailed) == 0, *this);
+	return true;
+}
+
+uint32_t LWEAssetManager::Update(uint32_t MaxFinalize) {
+	//Unlink the finished loads first, so callbacks which wait on or start other loads don't modify the list being walked.
+	LWEAssetLoad *Finished = nullptr;
+	LWEAssetLoad **FinishedTail = &Finished;
+	uint32_t FinishedCount = 0;
+	for (LWEAssetLoad **Prev = &m_Loads; *Prev && FinishedCount < MaxFinalize;) {
+		LWEAssetLoad *Load = *Prev;
+		if (!Load->m_Task.isFinished()) {
+			Prev = &Load->m_Next;
+			continue;
+		}
+		*Prev = Load->m_Next;
+		Load->m_Next = nullptr;
+		*FinishedTail = Load;
+		FinishedTail = &Load->m_Next;
+		m_PendingCount--;
+		FinishedCount++;
+	}
+	while (Finished) {
+		LWEAssetLoad *Load = Finished;
+		Finished = Load->m_Next;
+		FinalizeLoad(Load);
+	}
+	return m_PendingCount;
+}
+
+LWEAssetManager &LWEAssetManager::WaitForAsset(LWEAsset *Asset) {
+	for (LWEAssetLoad **Prev = &m_Loads; *Prev; Prev = &(*Prev)->m_Next) {
+		LWEAssetLoad *Load = *Prev;
+		if (Load->m_Asset != Asset) continue;
+		m_JobQueue->WaitTask(Load->m_Task);
+		*Prev = Load->m_Next;
+		m_PendingCount--;
+		FinalizeLoad(Load);
+		break;
+	}
+	return *this;
+}
+
+LWEAssetManager &LWEAssetManager::WaitForLoads(void) {
+	while (m_Loads) {
+		LWEAssetLoad *Load = m_Loads;
+		m_JobQueue->WaitTask(Load->m_Task);
+		m_Loads = Load->m_Next;
+		m_PendingCount--;
+		FinalizeLoad(Load);
+	}
+	return *this;
+}
+
+LWEAssetManager &LWEAssetManager::SetJobQueue(LWEJobQueue *JobQueue) {
+	if (m_JobQueue) WaitForLoads();
+	m_JobQueue = JobQueue;
+	return *this;
+}
+
+LWEAssetManager &LWEAssetManager::SetPlaceholder(uint32_t AssetType, void *Asset) {
+	m_Placeholders[AssetType] = Asset;
+	for (uint32_t i = 0; i < m_AssetCount; i++) {
+		LWEAsset *A = m_AssetTable + i;
+		if (A->GetType() == AssetType && A->GetFlag()) A->SetAsset(Asset, A->GetFlag());
+	}
+	return *this;
+}
+
+LWEJobQueue *LWEAssetManager::GetJobQueue(void) {
+	return m_JobQueue;
+}
+
+uint32_t LWEAssetManager::GetPendingCount(void) {
+	return m_PendingCount;
+}
+
 LWVideoDriver *LWEAssetManager::GetDriver(void) {
 	return m_Driver;
 }
@@ -1130,11 +1335,23 @@ uint32_t LWEAssetManager::GetAssetCount(void){
 	return m_AssetCount;
 }
 
-LWEAssetManager::LWEAssetManager(LWVideoDriver *Driver, LWELocalization *Localization, LWAllocator &Allocator) : m_Driver(Driver), m_Localization(nullptr), m_Allocator(&Allocator), m_AssetCount(0) {}
+LWEAssetManager::LWEAssetManager(LWVideoDriver *Driver, LWELocalization *Localization, LWAllocator &Allocator) : m_Driver(Driver), m_Localization(nullptr), m_Allocator(&Allocator), m_AssetCount(0) {
+	std::fill(m_Placeholders, m_Placeholders + LWEAsset::TypeCount, nullptr);
+}
 
 LWEAssetManager::~LWEAssetManager() {
+	//Loads that were never finalized own whatever their task produced, placeholders are owned by the application.
+	while (m_Loads) {
+		LWEAssetLoad *Load = m_Loads;
+		m_Loads = Load->m_Next;
+		m_JobQueue->WaitTask(Load->m_Task);
+		if (Load->m_Type == LWEAsset::Font) LWAllocator::Destroy((LWFont*)Load->m_Result);
+		else if (Load->m_Type == LWEAsset::AudioStream) LWAllocator::Destroy((LWAudioStream*)Load->m_Result);
+		LWAllocator::Destroy(Load);
+	}
 	for(uint32_t i = 0;i<m_AssetCount;i++){
 		LWEAsset *A = m_AssetTable+i;
+		if (A->GetFlag()) continue;
 		uint32_t Type = A->GetType();
 		if (Type == LWEAsset::Font) LWAllocator::Destroy(A->AsFont());
 		else if (Type == LWEAsset::Texture) m_Driver->DestroyTexture(A->AsTexture());
@@ -1,8 +1,140 @@
 #include "LWEJobQueue.h"
 #include <LWCore/LWTimer.h>
+#include <LWCore/LWText.h>
+#include <LWCore/LWAllocator.h>
 #include <algorithm>
 #include <iostream>
 
+static thread_local LWEJobQueue *t_CurrentQueue = nullptr;
+static thread_local LWEJobThread *t_CurrentThread = nullptr;
+
+void LockTask(LWETask *Task) {
+	uint32_t Exp = 0;
+	while (!Task->m_DependentLock.compare_exchange_weak(Exp, 1, std::memory_order_acquire)) {
+		Exp = 0;
+		std::this_thread::yield();
+	}
+}
+
+void UnlockTask(LWETask *Task) {
+	Task->m_DependentLock.store(0, std::memory_order_release);
+}
+
+LWETaskHandle LWETask::GetHandle(void) {
+	return LWETaskHandle(this, m_Generation.load(std::memory_order_relaxed));
+}
+
+LWETask::LWETask() : m_Generation(0), m_UnfinishedCount(0), m_PendingCount(0), m_DependentLock(0) {}
+
+bool LWETaskHandle::isFinished(void) const {
+	if (!m_Task) return true;
+	return m_Task->m_Generation.load(std::memory_order_acquire) != m_Generation;
+}
+
+bool LWETaskHandle::isValid(void) const {
+	return m_Task != nullptr;
+}
+
+LWETaskHandle::LWETaskHandle(LWETask *Task, uint32_t Generation) : m_Task(Task), m_Generation(Generation) {}
+
+LWETaskGroup &LWETaskGroup::Run(const LWETaskFunc &Func, void *UserData) {
+	if (!m_Root.isValid()) m_Root = m_Queue.CreateTask(nullptr);
+	m_Queue.PushTask(Func, UserData, m_Root);
+	return *this;
+}
+
+LWETaskGroup &LWETaskGroup::Wait(void) {
+	if (!m_Root.isValid()) return *this;
+	m_Queue.SubmitTask(m_Root);
+	m_Queue.WaitTask(m_Root);
+	m_Root = LWETaskHandle();
+	return *this;
+}
+
+LWETaskHandle LWETaskGroup::GetHandle(void) const {
+	return m_Root;
+}
+
+LWETaskGroup::LWETaskGroup(LWEJobQueue &Queue) : m_Queue(Queue) {}
+
+LWETaskGroup::~LWETaskGroup() {
+	Wait();
+}
+
+LWETaskDeque::Buffer *LWETaskDeque::MakeBuffer(int64_t Size, Buffer *Prev) {
+	Buffer *B = m_Allocator->Allocate<Buffer>();
+	B->m_Tasks = m_Allocator->AllocateArray<std::atomic<LWETask*>>((uint32_t)Size);
+	B->m_Prev = Prev;
+	B->m_Mask = Size - 1;
+	return B;
+}
+
+LWETaskDeque &LWETaskDeque::Push(LWETask *Task) {
+	int64_t b = m_Bottom.load(std::memory_order_relaxed);
+	int64_t t = m_Top.load(std::memory_order_acquire);
+	Buffer *B = m_Buffer.load(std::memory_order_relaxed);
+	if (!B || b - t > B->m_Mask) {
+		//Grow the buffer, the old buffer is retired rather then destroyed as a stealer may still be reading from it.
+		Buffer *N = MakeBuffer(B ? (B->m_Mask + 1) * 2 : InitialSize, B);
+		for (int64_t i = t; i < b; i++) N->m_Tasks[i&N->m_Mask].store(B->m_Tasks[i&B->m_Mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		m_Buffer.store(N, std::memory_order_release);
+		B = N;
+	}
+	B->m_Tasks[b&B->m_Mask].store(Task, std::memory_order_relaxed);
+	m_Bottom.store(b + 1, std::memory_order_release);
+	return *this;
+}
+
+LWETask *LWETaskDeque::Pop(void) {
+	Buffer *B = m_Buffer.load(std::memory_order_relaxed);
+	if (!B) return nullptr;
+	int64_t b = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = m_Top.load(std::memory_order_relaxed);
+	if (t > b) {
+		m_Bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	LWETask *Task = B->m_Tasks[b&B->m_Mask].load(std::memory_order_relaxed);
+	if (t != b) return Task;
+	//Last element, race any stealers for it.
+	if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) Task = nullptr;
+	m_Bottom.store(b + 1, std::memory_order_relaxed);
+	return Task;
+}
+
+LWETask *LWETaskDeque::Steal(void) {
+	int64_t t = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = m_Bottom.load(std::memory_order_acquire);
+	if (t >= b) return nullptr;
+	Buffer *B = m_Buffer.load(std::memory_order_acquire);
+	LWETask *Task = B->m_Tasks[t&B->m_Mask].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+	return Task;
+}
+
+LWETaskDeque &LWETaskDeque::SetAllocator(LWAllocator *Allocator) {
+	m_Allocator = Allocator;
+	return *this;
+}
+
+uint32_t LWETaskDeque::Length(void) const {
+	int64_t Len = m_Bottom.load(std::memory_order_relaxed) - m_Top.load(std::memory_order_relaxed);
+	return Len > 0 ? (uint32_t)Len : 0;
+}
+
+LWETaskDeque::~LWETaskDeque() {
+	Buffer *B = m_Buffer.load();
+	while (B) {
+		Buffer *Prev = B->m_Prev;
+		LWAllocator::Destroy(B->m_Tasks);
+		LWAllocator::Destroy(B);
+		B = Prev;
+	}
+}
+
 LWEJob::LWEJob(std::function<void(LWEJob &, LWEJobThread &, LWEJobQueue &, uint64_t)> Func, void *UserData, uint64_t UpdateFrequency, uint32_t LockIDs, uint32_t UnlockIDs, uint32_t LockedOutIDs, uint32_t LockedInIDs, uint32_t LoopCount, uint32_t ThreadLimit) {
 	m_Func = Func;
 	m_UserData = UserData;
@@ -22,9 +154,12 @@ LWEJob::LWEJob(std::function<void(LWEJob &, LWEJobThread &, LWEJobQueue &, uint6
 LWEJob::LWEJob() {}
 
 void LWEJobQueue::RunThread(LWEJobThread *Thread, LWEJobQueue *Queue) {
+	t_CurrentQueue = Queue;
+	t_CurrentThread = Thread;
 	uint32_t Flag = Queue->GetFlag();
 	uint32_t JobIdx = 0;
 	uint32_t JobSleepCnt = 0;
+	uint32_t IdleCnt = 0;
 	while(!Queue->isFinished()){
 		Flag = Queue->GetFlag();
 		if (Flag&LWEJobQueue::Paused) {
@@ -32,15 +167,29 @@ void LWEJobQueue::RunThread(LWEJobThread *Thread, LWEJobQueue *Queue) {
 			JobSleepCnt = 0;
 			continue;
 		}
+		if (Queue->RunTask(*Thread)) {
+			IdleCnt = 0;
+			continue;
+		}
 		uint64_t CurrentTime = LWTimer::GetCurrent();
 		LWEJob *J = Queue->NextJob(*Thread, JobIdx, CurrentTime);
 		if (!J) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			//Spin briefly before sleeping so newly pushed tasks are picked up without a full sleep period of latency.
+			if (IdleCnt < IdleSpinCount) {
+				IdleCnt++;
+				std::this_thread::yield();
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				if (Thread->m_Events) RecordEvent(*Thread, LWEJobEvent::Idle, 0, CurrentTime, LWTimer::GetCurrent());
+			}
 			JobSleepCnt = 0;
 			continue;
-		}CurrentTime = LWTimer::GetCurrent();
+		}
+		IdleCnt = 0;
+		CurrentTime = LWTimer::GetCurrent();
 		J->m_Func(*J, *Thread, *Queue, CurrentTime);
 		uint64_t Elasped = LWTimer::GetCurrent() - CurrentTime;
+		if (Thread->m_Events) RecordEvent(*Thread, LWEJobEvent::Job, J->m_JobIdx, CurrentTime, CurrentTime + Elasped);
 		Thread->m_TimeInJobs += Elasped;
 		Thread->m_JobsRan++;
 		Queue->FinishedJob(*J, Elasped);
@@ -118,6 +267,7 @@ LWEJob *LWEJobQueue::NextJob(LWEJobThread &Thread, uint32_t &JobPos, uint64_t lC
 		}
 		if (m_Jobs[n].m_LockIDs) {
 			if (!m_LockedFlag.compare_exchange_weak(LockFlag, LockFlag | m_Jobs[n].m_LockIDs)) {
+				if (Thread.m_Events) RecordEvent(Thread, LWEJobEvent::LockContention, n, lCurrentTime, lCurrentTime);
 				m_JobState[n].store((uint32_t)JobOpen);
 				continue;
 			}
@@ -163,11 +313,67 @@ LWEJobQueue &LWEJobQueue::OutputJobTimings(void){
 LWEJobQueue &LWEJobQueue::OutputThreadTimings(void) {
 	for (uint32_t i = 0; i < m_ThreadCount; i++) {
 		uint64_t Average = m_Threads[i].m_JobsRan ? m_Threads[i].m_TimeInJobs / m_Threads[i].m_JobsRan : 0;
-		std::cout << "JThread " << i << ": Avg: " << LWTimer::ToMilliSecond(Average) << "ms Total: " << LWTimer::ToMilliSecond(m_Threads[i].m_TimeInJobs) << "ms Jobs ran: " << m_Threads[i].m_JobsRan << std::endl;
+		std::cout << "JThread " << i << ": Avg: " << LWTimer::ToMilliSecond(Average) << "ms Total: " << LWTimer::ToMilliSecond(m_Threads[i].m_TimeInJobs) << "ms Jobs ran: " << m_Threads[i].m_JobsRan << " Tasks ran: " << m_Threads[i].m_TasksRan << " Tasks stolen: " << m_Threads[i].m_TasksStolen << std::endl;
 	}
 	return *this;
 }
 
+void LWEJobQueue::RecordEvent(LWEJobThread &Thread, uint32_t Type, uint32_t ID, uint64_t Start, uint64_t End) {
+	uint32_t Pos = Thread.m_EventPos.load(std::memory_order_relaxed);
+	LWEJobEvent &E = Thread.m_Events[Pos&Thread.m_EventMask];
+	E.m_Start = Start;
+	E.m_End = End;
+	E.m_Type = Type;
+	E.m_ID = ID;
+	Thread.m_EventPos.store(Pos + 1, std::memory_order_release);
+}
+
+LWEJobQueue &LWEJobQueue::SetProfiling(uint32_t EventsPerThread) {
+	for (uint32_t i = 0; i < m_ThreadCount; i++) {
+		m_Threads[i].m_Events = LWAllocator::Destroy(m_Threads[i].m_Events);
+		m_Threads[i].m_EventMask = 0;
+		m_Threads[i].m_EventPos.store(0);
+	}
+	m_Flag &= ~Profiling;
+	if (!EventsPerThread) return *this;
+	uint32_t Size = 1;
+	while (Size < EventsPerThread) Size <<= 1;
+	for (uint32_t i = 0; i < m_ThreadCount; i++) {
+		m_Threads[i].m_Events = m_Allocator.AllocateArray<LWEJobEvent>(Size);
+		m_Threads[i].m_EventMask = Size - 1;
+	}
+	m_ProfileStart = LWTimer::GetCurrent();
+	m_Flag |= Profiling;
+	return *this;
+}
+
+uint32_t LWEJobQueue::SerializeChromeTrace(char *Buffer, uint32_t BufferLen) {
+	const char *TypeNames[] = { "Job", "Task", "Idle", "LockContention", "Steal" };
+	const char *Categorys[] = { "job", "task", "idle", "contention", "steal" };
+	double ToMicro = 1000000.0 / (double)LWTimer::GetResolution();
+	uint32_t o = 0;
+	LWText::Appendf(Buffer, BufferLen, o, "{\"traceEvents\":[");
+	bool First = true;
+	for (uint32_t i = 0; i < m_ThreadCount; i++) {
+		LWEJobThread &T = m_Threads[i];
+		LWText::Appendf(Buffer, BufferLen, o, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"JThread %u\"}}", First ? "" : ",", i, i);
+		First = false;
+		if (!T.m_Events) continue;
+		uint32_t End = T.m_EventPos.load(std::memory_order_acquire);
+		uint32_t Size = T.m_EventMask + 1;
+		uint32_t Begin = End > Size ? End - Size : 0;
+		for (uint32_t n = Begin; n < End; n++) {
+			LWEJobEvent &E = T.m_Events[n&T.m_EventMask];
+			if (E.m_Type > LWEJobEvent::Steal || E.m_Start < m_ProfileStart) continue;
+			double Ts = (double)(E.m_Start - m_ProfileStart)*ToMicro;
+			if (E.m_End == E.m_Start) LWText::Appendf(Buffer, BufferLen, o, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"id\":%u}}", TypeNames[E.m_Type], Categorys[E.m_Type], Ts, i, E.m_ID);
+			else LWText::Appendf(Buffer, BufferLen, o, ",\n{\"name\":\"%s %u\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}", TypeNames[E.m_Type], E.m_ID, Categorys[E.m_Type], Ts, (double)(E.m_End - E.m_Start)*ToMicro, i);
+		}
+	}
+	LWText::Appendf(Buffer, BufferLen, o, "\n]}\n");
+	return o;
+}
+
 LWEJobQueue &LWEJobQueue::SetFinished(bool isFinished) {
 	m_Flag |= isFinished ? Finished : 0;
 	return *this;
@@ -195,6 +401,207 @@ LWEJobQueue &LWEJobQueue::SetSleep(bool Sleep) {
 	return *this;
 }
 
+LWETaskHandle LWEJobQueue::CreateTask(const LWETaskFunc &Func, void *UserData, const LWETaskHandle &Parent) {
+	LWETask *Task = AllocateTask();
+	if (!Task) return LWETaskHandle();
+	Task->m_Func = Func;
+	Task->m_UserData = UserData;
+	Task->m_Parent = Parent.m_Task;
+	Task->m_DependentCount = 0;
+	Task->m_UnfinishedCount.store(1, std::memory_order_relaxed);
+	Task->m_PendingCount.store(1, std::memory_order_relaxed);
+	if (Parent.m_Task) Parent.m_Task->m_UnfinishedCount.fetch_add(1);
+	return LWETaskHandle(Task, Task->m_Generation.load(std::memory_order_relaxed));
+}
+
+bool LWEJobQueue::AddDependency(const LWETaskHandle &Task, const LWETaskHandle &DependsOn) {
+	if (!Task.m_Task || !DependsOn.m_Task) return true;
+	LWETask *D = DependsOn.m_Task;
+	LockTask(D);
+	if (D->m_Generation.load(std::memory_order_relaxed) != DependsOn.m_Generation) {
+		UnlockTask(D);
+		return true;
+	}
+	if (D->m_DependentCount >= LWETask::MaxDependents) {
+		UnlockTask(D);
+		return false;
+	}
+	Task.m_Task->m_PendingCount.fetch_add(1);
+	D->m_Dependents[D->m_DependentCount++] = Task.m_Task;
+	UnlockTask(D);
+	return true;
+}
+
+LWEJobQueue &LWEJobQueue::SubmitTask(const LWETaskHandle &Task) {
+	if (!Task.m_Task) return *this;
+	if (Task.m_Task->m_PendingCount.fetch_sub(1) == 1) ScheduleTask(Task.m_Task);
+	return *this;
+}
+
+LWETaskHandle LWEJobQueue::PushTask(const LWETaskFunc &Func, void *UserData, const LWETaskHandle &Parent) {
+	LWETaskHandle Task = CreateTask(Func, UserData, Parent);
+	SubmitTask(Task);
+	return Task;
+}
+
+LWEJobQueue &LWEJobQueue::ParallelFor(uint32_t Begin, uint32_t End, uint32_t Grain, const LWEParallelForFunc &Func) {
+	if (End <= Begin) return *this;
+	if (!Grain) Grain = std::max<uint32_t>((End - Begin) / (m_ThreadCount * 4), 1);
+	//Each range task splits off it's upper half as a child until it is within the grain size, so work spreads across the deques in log(n) steps and stealers take the largest ranges first.
+	std::function<void(uint32_t, uint32_t, LWETask &, LWEJobThread &)> Split;
+	Split = [this, Grain, &Func, &Split](uint32_t RangeBegin, uint32_t RangeEnd, LWETask &Task, LWEJobThread &Thread) {
+		while (RangeEnd - RangeBegin > Grain) {
+			uint32_t Mid = RangeBegin + (RangeEnd - RangeBegin) / 2;
+			PushTask([Mid, RangeEnd, &Split](LWETask &T, LWEJobThread &Th, LWEJobQueue &) { Split(Mid, RangeEnd, T, Th); }, nullptr, Task.GetHandle());
+			RangeEnd = Mid;
+		}
+		Func(RangeBegin, RangeEnd, Thread);
+	};
+	LWETaskHandle Root = CreateTask([Begin, End, &Split](LWETask &T, LWEJobThread &Th, LWEJobQueue &) { Split(Begin, End, T, Th); });
+	SubmitTask(Root);
+	return WaitTask(Root);
+}
+
+LWEJobQueue &LWEJobQueue::WaitTask(const LWETaskHandle &Task) {
+	LWEJobThread *Thread = GetCurrentThread();
+	while (!Task.isFinished()) {
+		if (Thread && RunTask(*Thread)) continue;
+		std::this_thread::yield();
+	}
+	return *this;
+}
+
+bool LWEJobQueue::RunTask(LWEJobThread &Thread) {
+	LWETask *Task = NextTask(Thread);
+	if (!Task) return false;
+	uint64_t Start = LWTimer::GetCurrent();
+	if (Task->m_Func) Task->m_Func(*Task, Thread, *this);
+	uint64_t End = LWTimer::GetCurrent();
+	Thread.m_TimeInJobs += End - Start;
+	if (Thread.m_Events) RecordEvent(Thread, LWEJobEvent::Task, Thread.m_TasksRan, Start, End);
+	Thread.m_TasksRan++;
+	if (Task->m_UnfinishedCount.fetch_sub(1) == 1) FinishTask(Task);
+	return true;
+}
+
+LWEJobThread *LWEJobQueue::GetCurrentThread(void) {
+	return t_CurrentQueue == this ? t_CurrentThread : nullptr;
+}
+
+LWETask *LWEJobQueue::AllocateTask(void) {
+	LWEJobThread *Thread = GetCurrentThread();
+	if (Thread && Thread->m_FreeTasks) {
+		LWETask *Task = Thread->m_FreeTasks;
+		Thread->m_FreeTasks = Task->m_NextFree;
+		Thread->m_FreeTaskCount--;
+		return Task;
+	}
+	std::lock_guard<std::mutex> Lock(m_TaskPoolLock);
+	if (!m_FreeTasks) {
+		LWETask *Block = m_Allocator.AllocateArray<LWETask>(TaskBlockSize);
+		if (!Block) return nullptr;
+		m_TaskBlocks.push_back(Block);
+		for (uint32_t i = 0; i < TaskBlockSize; i++) {
+			Block[i].m_NextFree = m_FreeTasks;
+			m_FreeTasks = Block + i;
+		}
+	}
+	LWETask *Task = m_FreeTasks;
+	m_FreeTasks = Task->m_NextFree;
+	if (!Thread) return Task;
+	//Refill the threads cache while we hold the lock so the next allocations don't need it.
+	for (uint32_t i = 0; i < TaskBlockSize && m_FreeTasks; i++) {
+		LWETask *F = m_FreeTasks;
+		m_FreeTasks = F->m_NextFree;
+		F->m_NextFree = Thread->m_FreeTasks;
+		Thread->m_FreeTasks = F;
+		Thread->m_FreeTaskCount++;
+	}
+	return Task;
+}
+
+LWEJobQueue &LWEJobQueue::FreeTask(LWETask *Task) {
+	Task->m_Func = nullptr;
+	Task->m_UserData = nullptr;
+	Task->m_Parent = nullptr;
+	LWEJobThread *Thread = GetCurrentThread();
+	if (Thread) {
+		Task->m_NextFree = Thread->m_FreeTasks;
+		Thread->m_FreeTasks = Task;
+		if (++Thread->m_FreeTaskCount < MaxCachedTasks) return *this;
+		//Return a block of the threads cache to the shared pool so threads which only create tasks don't starve.
+		std::lock_guard<std::mutex> Lock(m_TaskPoolLock);
+		for (uint32_t i = 0; i < TaskBlockSize; i++) {
+			LWETask *F = Thread->m_FreeTasks;
+			Thread->m_FreeTasks = F->m_NextFree;
+			F->m_NextFree = m_FreeTasks;
+			m_FreeTasks = F;
+		}
+		Thread->m_FreeTaskCount -= TaskBlockSize;
+		return *this;
+	}
+	std::lock_guard<std::mutex> Lock(m_TaskPoolLock);
+	Task->m_NextFree = m_FreeTasks;
+	m_FreeTasks = Task;
+	return *this;
+}
+
+LWEJobQueue &LWEJobQueue::ScheduleTask(LWETask *Task) {
+	LWEJobThread *Thread = GetCurrentThread();
+	if (Thread) {
+		Thread->m_Tasks.Push(Task);
+		return *this;
+	}
+	std::lock_guard<std::mutex> Lock(m_SharedTaskLock);
+	m_SharedTasks.Push(Task);
+	return *this;
+}
+
+LWEJobQueue &LWEJobQueue::FinishTask(LWETask *Task) {
+	LWETask *Dependents[LWETask::MaxDependents];
+	while (Task) {
+		LockTask(Task);
+		uint32_t DependentCount = Task->m_DependentCount;
+		std::copy(Task->m_Dependents, Task->m_Dependents + DependentCount, Dependents);
+		Task->m_DependentCount = 0;
+		Task->m_Generation.fetch_add(1, std::memory_order_release);
+		UnlockTask(Task);
+		LWETask *Parent = Task->m_Parent;
+		FreeTask(Task);
+		for (uint32_t i = 0; i < DependentCount; i++) {
+			if (Dependents[i]->m_PendingCount.fetch_sub(1) == 1) ScheduleTask(Dependents[i]);
+		}
+		Task = (Parent && Parent->m_UnfinishedCount.fetch_sub(1) == 1) ? Parent : nullptr;
+	}
+	return *this;
+}
+
+LWETask *LWEJobQueue::NextTask(LWEJobThread &Thread) {
+	LWETask *Task = Thread.m_Tasks.Pop();
+	if (Task) return Task;
+	Task = m_SharedTasks.Steal();
+	if (Task) return Task;
+	uint32_t Seed = Thread.m_StealSeed;
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+	Thread.m_StealSeed = Seed;
+	for (uint32_t i = 0; i < m_ThreadCount; i++) {
+		LWEJobThread &Victim = m_Threads[(Seed + i) % m_ThreadCount];
+		if (&Victim == &Thread) continue;
+		Task = Victim.m_Tasks.Steal();
+		if (Task) {
+			if (Thread.m_Events) {
+				uint64_t Current = LWTimer::GetCurrent();
+				RecordEvent(Thread, LWEJobEvent::Steal, Victim.m_ThreadIdx, Current, Current);
+			}
+			Thread.m_TasksStolen++;
+			return Task;
+		}
+	}
+	return nullptr;
+}
+
 LWEJobThread &LWEJobQueue::GetMainThread(void) {
 	return m_Threads[0];
 }
@@ -223,19 +630,30 @@ bool LWEJobQueue::isJoined(void) const {
 	return (m_Flag&Joined) != 0;
 }
 
-LWEJobQueue::LWEJobQueue(uint32_t ThreadCnt) : m_ThreadCount(0), m_JobCount(0), m_LockedFlag(0), m_ReserveJobCount(0), m_Flag(Paused) {
+LWEJobQueue::LWEJobQueue(LWAllocator &Allocator, uint32_t ThreadCnt) : m_Allocator(Allocator), m_ThreadCount(0), m_JobCount(0), m_LockedFlag(0), m_ReserveJobCount(0), m_Flag(Paused) {
 	for (uint32_t i = 0; i < MaxJobs; i++) m_JobState[i].store(JobNull);
 	if (!ThreadCnt) ThreadCnt = std::thread::hardware_concurrency()-1;
 	ThreadCnt = std::min<uint32_t>(ThreadCnt, MaxThreads-1);
 	m_ThreadCount = ThreadCnt + 1;
-	m_Threads[0].m_ThreadID = 0x1;
-	for (uint32_t i = 1; i < m_ThreadCount; i++) {
+	m_SharedTasks.SetAllocator(&Allocator);
+	for (uint32_t i = 0; i < m_ThreadCount; i++) {
 		m_Threads[i].m_ThreadID = (1 << i);
-		m_Threads[i].m_Thread = std::thread(RunThread, m_Threads+i, this);
+		m_Threads[i].m_ThreadIdx = i;
+		m_Threads[i].m_StealSeed = (i + 1) * 2654435761u;
+		m_Threads[i].m_Tasks.SetAllocator(&Allocator);
 	}
+	t_CurrentQueue = this;
+	t_CurrentThread = m_Threads;
+	for (uint32_t i = 1; i < m_ThreadCount; i++) m_Threads[i].m_Thread = std::thread(RunThread, m_Threads+i, this);
 }
 
 LWEJobQueue::~LWEJobQueue() {
 	m_Flag |= Finished;
 	WaitForAllJoined();
+	if (t_CurrentQueue == this) {
+		t_CurrentQueue = nullptr;
+		t_CurrentThread = nullptr;
+	}
+	for (auto &&Block : m_TaskBlocks) LWAllocator::Destroy(Block);
+	for (uint32_t i = 0; i < MaxThreads; i++) LWAllocator::Destroy(m_Threads[i].m_Events);
 }
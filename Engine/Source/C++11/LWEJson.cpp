@@ -1,14 +1,18 @@
 #include "LWEJson.h"
+#include "LWEJsonTape.h"
 #include <LWCore/LWText.h>
 #include <LWPlatform/LWPlatform.h>
 #include <LWCore/LWAllocator.h>
 #include <LWCore/LWQuaternion.h>
 #include <LWPlatform/LWFileStream.h>
 #include <LWCore/LWMatrix.h>
+#include <LWCore/LWByteBuffer.h>
 #include <cstring>
 #include <functional>
 #include <cstdarg>
 #include <algorithm>
+#include <cerrno>
+#include <cmath>
 
 LWEJObject &LWEJObject::SetValue(LWAllocator &Allocator, const char *Value) {
 	uint32_t Len = (uint32_t)strlen(Value) + 1;
@@ -582,6 +586,195 @@ bool LWEJson::Parse(LWEJson &JSon, const char *Buffer, LWEJObject *Parent) {
 	return Res != nullptr;
 }
 
+bool LWEJson::Parse(LWEJson &JSon, const LWEJsonTape &Tape, LWEJObject *Parent) {
+	char StaticDataBuffer[1024];
+	char *DataBuffer = StaticDataBuffer;
+	uint32_t DataBufferLen = sizeof(StaticDataBuffer);
+
+	//copies the node's text as it appears in the source, so names and values are unescaped the same as Parse.
+	auto CopyNodeText = [&StaticDataBuffer, &DataBuffer, &DataBufferLen, &JSon, &Tape](uint32_t Index)->const char* {
+		const LWEJNode *N = Tape.GetNode(Index);
+		if (N->m_Length + 1 > DataBufferLen) {
+			if (DataBuffer != StaticDataBuffer) LWAllocator::Destroy(DataBuffer);
+			DataBuffer = JSon.GetAllocator().AllocateArray<char>(N->m_Length + 1);
+			DataBufferLen = N->m_Length + 1;
+		}
+		std::copy(Tape.GetText(Index), Tape.GetText(Index) + N->m_Length, DataBuffer);
+		DataBuffer[N->m_Length] = '\0';
+		return DataBuffer;
+	};
+
+	std::function<bool(uint32_t, LWEJObject *)> ParseNode = [&ParseNode, &CopyNodeText, &JSon, &Tape](uint32_t Index, LWEJObject *Obj)->bool {
+		const LWEJNode *N = Tape.GetNode(Index);
+		uint32_t Type = N->GetType();
+		uint32_t ObjHash = Obj ? Obj->m_Hash : 0;
+		if (Obj) Obj->m_Type = Type;
+		else if (Type == LWEJObject::Object || Type == LWEJObject::Array) JSon.SetType(Type);
+		else return false;
+		if (Type == LWEJObject::Object) {
+			for (uint32_t C = Tape.GetFirstChild(Index); C != LWEJsonTape::InvalidNode && C < N->m_Next; C = Tape.GetNode(C + 1)->m_Next) {
+				LWEJObject *O = JSon.MakeElement(CopyNodeText(C), Obj);
+				if (!O) return false;
+				Obj = JSon.Find(ObjHash);
+				if (!ParseNode(C + 1, O)) return false;
+			}
+		} else if (Type == LWEJObject::Array) {
+			uint32_t i = 0;
+			for (uint32_t C = Tape.GetFirstChild(Index); C != LWEJsonTape::InvalidNode && C < N->m_Next; C = Tape.GetNode(C)->m_Next) {
+				LWEJObject *O = JSon.MakeElementf("%s[%d]", Obj, Obj ? Obj->m_Name : "", i++);
+				if (!O) return false;
+				Obj = JSon.Find(ObjHash);
+				if (!ParseNode(C, O)) return false;
+			}
+		} else Obj->SetValue(JSon.GetAllocator(), CopyNodeText(Index));
+		return true;
+	};
+	bool Res = Tape.GetNodeCount() && ParseNode(0, Parent);
+	if (DataBuffer != StaticDataBuffer) LWAllocator::Destroy(DataBuffer);
+	return Res;
+}
+
+//sets an object's value as is, cbor text is not escaped so must not pass through SetValue.
+static void SetCBORValue(LWEJObject &Obj, LWAllocator &Allocator, uint32_t Type, const char *Value, uint32_t Len) {
+	if (Len + 1 > Obj.m_ValueBufferLen) {
+		if (Obj.m_Value != Obj.m_ValueBuf) LWAllocator::Destroy(Obj.m_Value);
+		Obj.m_Value = Allocator.AllocateArray<char>(Len + 1);
+		Obj.m_ValueBufferLen = Len + 1;
+	}
+	std::copy(Value, Value + Len, Obj.m_Value);
+	Obj.m_Value[Len] = '\0';
+	Obj.m_Type = Type;
+}
+
+bool LWEJson::ParseCBOR(LWEJson &JSon, LWByteBuffer &Buffer, LWEJObject *Parent) {
+	char StaticDataBuffer[1024];
+	char StaticNameBuffer[1024];
+	char *DataBuffer = StaticDataBuffer;
+	char *NameBuffer = StaticNameBuffer;
+	uint32_t DataBufferLen = sizeof(StaticDataBuffer);
+	uint32_t NameBufferLen = sizeof(StaticNameBuffer);
+
+	auto Grow = [&JSon](char *&Buf, uint32_t &BufLen, char *StaticBuf, uint32_t Len) {
+		if (Len <= BufLen) return;
+		if (Buf != StaticBuf) LWAllocator::Destroy(Buf);
+		Buf = JSon.GetAllocator().AllocateArray<char>(Len);
+		BufLen = Len;
+	};
+
+	auto ReadHead = [&Buffer](uint8_t &Major, uint8_t &Info, uint64_t &Value)->bool {
+		if (Buffer.EndOfBuffer()) return false;
+		uint8_t Head = Buffer.Read<uint8_t>();
+		Major = Head >> 5;
+		Info = Head & 0x1F;
+		Value = Info;
+		//only strings, arrays, and maps may be indefinite length.
+		if (Info < 24 || (Info == 31 && Major >= 2 && Major <= 5)) return true;
+		if (Info > 27) return false;
+		int32_t Len = 1 << (Info - 24);
+		if (Buffer.GetPosition() + Len > Buffer.GetBufferSize()) return false;
+		Value = 0;
+		for (int32_t i = 0; i < Len; i++) Value = (Value << 8) | Buffer.Read<uint8_t>();
+		return true;
+	};
+
+	//reads Len bytes of text into the data buffer and null terminates it.
+	auto ReadText = [&Grow, &Buffer, &StaticDataBuffer, &DataBuffer, &DataBufferLen](uint64_t Len)->const char* {
+		if (Len > (uint64_t)(Buffer.GetBufferSize() - Buffer.GetPosition())) return nullptr;
+		Grow(DataBuffer, DataBufferLen, StaticDataBuffer, (uint32_t)Len + 1);
+		Buffer.Read<uint8_t>((uint8_t*)DataBuffer, (uint32_t)Len);
+		DataBuffer[Len] = '\0';
+		return DataBuffer;
+	};
+
+	auto isBreak = [&Buffer]()->bool {
+		return !Buffer.EndOfBuffer() && (uint8_t)Buffer.Read<uint8_t>(Buffer.GetPosition()) == 0xFF;
+	};
+
+	std::function<bool(LWEJObject *, uint32_t)> ParseItem = [&](LWEJObject *Obj, uint32_t Depth)->bool {
+		uint8_t Major, Info;
+		uint64_t Value;
+		char Buf[32];
+		if (Depth > CBORMaxDepth || !ReadHead(Major, Info, Value)) return false;
+		if (Major == 4 || Major == 5) {
+			uint32_t Type = Major == 4 ? LWEJObject::Array : LWEJObject::Object;
+			bool Indefinite = Info == 31;
+			if (Obj) Obj->m_Type = Type;
+			else JSon.SetType(Type);
+			for (uint64_t i = 0; Indefinite ? !isBreak() : i < Value; i++) {
+				LWEJObject *O = nullptr;
+				if (Type == LWEJObject::Array) O = JSon.MakeElementf("%s[%d]", Obj, Obj ? Obj->m_Name : "", (uint32_t)i);
+				else {
+					uint8_t KeyMajor, KeyInfo;
+					uint64_t KeyLen;
+					if (!ReadHead(KeyMajor, KeyInfo, KeyLen) || KeyMajor != 3 || KeyInfo == 31) return false;
+					const char *Key = ReadText(KeyLen);
+					if (!Key) return false;
+					//names are kept escaped, the same as they appear in json text.
+					uint32_t Len = EscapeString(Key, NameBuffer, NameBufferLen);
+					if (Len > NameBufferLen) {
+						Grow(NameBuffer, NameBufferLen, StaticNameBuffer, Len);
+						EscapeString(Key, NameBuffer, NameBufferLen);
+					}
+					O = JSon.MakeElement(NameBuffer, Obj);
+				}
+				if (!O || !ParseItem(O, Depth + 1)) return false;
+			}
+			if (Indefinite) {
+				if (Buffer.EndOfBuffer()) return false;
+				Buffer.OffsetPosition(1);
+			}
+			return true;
+		}
+		if (Major == 6) return ParseItem(Obj, Depth + 1);
+		if (!Obj) return false;
+		if (Major == 0) {
+			snprintf(Buf, sizeof(Buf), "%llu", (unsigned long long)Value);
+			SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Number, Buf, (uint32_t)strlen(Buf));
+		} else if (Major == 1) {
+			if (Value <= (uint64_t)INT64_MAX) snprintf(Buf, sizeof(Buf), "%lld", -1ll - (long long)Value);
+			else snprintf(Buf, sizeof(Buf), "%.17g", -1.0 - (double)Value);
+			SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Number, Buf, (uint32_t)strlen(Buf));
+		} else if (Major == 3) {
+			if (Info == 31) return false;
+			const char *Text = ReadText(Value);
+			if (!Text) return false;
+			SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::String, Text, (uint32_t)Value);
+		} else if (Major == 7) {
+			double D;
+			if (Info == 20) SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Boolean, "false", 5);
+			else if (Info == 21) SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Boolean, "true", 4);
+			else if (Info == 22 || Info == 23) SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Null, "null", 4);
+			else if (Info >= 25 && Info <= 27) {
+				if (Info == 25) {
+					uint32_t Exp = (uint32_t)(Value >> 10) & 0x1F;
+					uint32_t Mantissa = (uint32_t)Value & 0x3FF;
+					if (Exp == 0) D = ldexp((double)Mantissa, -24);
+					else if (Exp != 31) D = ldexp((double)(Mantissa + 1024), (int32_t)Exp - 25);
+					else D = Mantissa ? NAN : INFINITY;
+					if (Value & 0x8000) D = -D;
+				} else if (Info == 26) {
+					uint32_t Bits = (uint32_t)Value;
+					float F;
+					memcpy(&F, &Bits, sizeof(F));
+					D = F;
+				} else memcpy(&D, &Value, sizeof(D));
+				//json has no nan or infinity.
+				if (D != D || D - D != 0.0) SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Null, "null", 4);
+				else {
+					uint32_t Len = (uint32_t)snprintf(Buf, sizeof(Buf), "%.15g", D);
+					if (strtod(Buf, nullptr) != D) Len = (uint32_t)snprintf(Buf, sizeof(Buf), "%.17g", D);
+					SetCBORValue(*Obj, JSon.GetAllocator(), LWEJObject::Number, Buf, Len);
+				}
+			} else return false;
+		} else return false;
+		return true;
+	};
+	bool Res = ParseItem(Parent, 0);
+	if (DataBuffer != StaticDataBuffer) LWAllocator::Destroy(DataBuffer);
+	if (NameBuffer != StaticNameBuffer) LWAllocator::Destroy(NameBuffer);
+	return Res;
+}
+
 uint32_t LWEJson::Serialize(char *Buffer, uint32_t BufferLen, bool Format) {
 
 	std::function<uint32_t(char *, uint32_t , LWEJson &, LWEJObject &, uint32_t , bool, bool )> SerializeObjectFmt = [&SerializeObjectFmt](char *Buffer, uint32_t BufferLen, LWEJson &Js, LWEJObject &Obj, uint32_t Depth, bool Last, bool WriteName)->uint32_t {
@@ -672,6 +865,107 @@ uint32_t LWEJson::Serialize(char *Buffer, uint32_t BufferLen, bool Format) {
 	return o;
 }
 
+uint32_t LWEJson::SerializeCBOR(LWByteBuffer &Buffer) {
+	char StaticNameBuffer[1024];
+	char *NameBuffer = StaticNameBuffer;
+	uint32_t NameBufferLen = sizeof(StaticNameBuffer);
+
+	auto WriteHead = [&Buffer](uint8_t Major, uint64_t Value)->uint32_t {
+		uint8_t Head[9];
+		uint32_t Len = 1;
+		Major <<= 5;
+		if (Value < 24) Head[0] = Major | (uint8_t)Value;
+		else if (Value <= 0xFF) Head[0] = Major | 24, Len = 2;
+		else if (Value <= 0xFFFF) Head[0] = Major | 25, Len = 3;
+		else if (Value <= 0xFFFFFFFF) Head[0] = Major | 26, Len = 5;
+		else Head[0] = Major | 27, Len = 9;
+		for (uint32_t i = 1; i < Len; i++) Head[i] = (uint8_t)(Value >> ((Len - 1 - i) * 8));
+		return Buffer.Write<uint8_t>(Len, Head);
+	};
+
+	auto WriteText = [&WriteHead, &Buffer](const char *Text, uint32_t Len)->uint32_t {
+		return WriteHead(3, Len) + Buffer.Write<uint8_t>(Len, (const uint8_t*)Text);
+	};
+
+	//names are kept escaped, so are unescaped into a text key.
+	auto WriteName = [&WriteText, &StaticNameBuffer, &NameBuffer, &NameBufferLen, this](const char *Name)->uint32_t {
+		if (!strchr(Name, '\\')) return WriteText(Name, (uint32_t)strlen(Name));
+		uint32_t Len = UnEscapeString(Name, NameBuffer, NameBufferLen);
+		if (Len > NameBufferLen) {
+			if (NameBuffer != StaticNameBuffer) LWAllocator::Destroy(NameBuffer);
+			NameBuffer = m_Allocator.AllocateArray<char>(Len);
+			NameBufferLen = Len;
+			UnEscapeString(Name, NameBuffer, NameBufferLen);
+		}
+		return WriteText(NameBuffer, (uint32_t)strlen(NameBuffer));
+	};
+
+	//numbers without a fraction or exponent are written as integers, everything else as the smallest float which holds the value exactly.
+	auto WriteNumber = [&WriteHead, &Buffer](const char *Value)->uint32_t {
+		char *End = nullptr;
+		if (!strpbrk(Value, ".eE")) {
+			errno = 0;
+			if (*Value == '-') {
+				long long N = strtoll(Value, &End, 10);
+				if (End != Value && !*End && errno != ERANGE) return N < 0 ? WriteHead(1, (uint64_t)(-1ll - N)) : WriteHead(0, (uint64_t)N);
+			} else {
+				unsigned long long N = strtoull(Value, &End, 10);
+				if (End != Value && !*End && errno != ERANGE) return WriteHead(0, (uint64_t)N);
+			}
+		}
+		double D = strtod(Value, nullptr);
+		float F = (float)D;
+		uint8_t Bytes[9];
+		uint32_t Len = 9;
+		if ((double)F == D) {
+			uint32_t Bits;
+			memcpy(&Bits, &F, sizeof(Bits));
+			Bytes[0] = 0xFA;
+			Len = 5;
+			for (uint32_t i = 1; i < Len; i++) Bytes[i] = (uint8_t)(Bits >> ((Len - 1 - i) * 8));
+		} else {
+			uint64_t Bits;
+			memcpy(&Bits, &D, sizeof(Bits));
+			Bytes[0] = 0xFB;
+			for (uint32_t i = 1; i < Len; i++) Bytes[i] = (uint8_t)(Bits >> ((Len - 1 - i) * 8));
+		}
+		return Buffer.Write<uint8_t>(Len, Bytes);
+	};
+
+	std::function<uint32_t(LWEJObject &)> WriteObject = [&WriteObject, &WriteHead, &WriteText, &WriteName, &WriteNumber, &Buffer, this](LWEJObject &Obj)->uint32_t {
+		uint32_t o = 0;
+		if (Obj.m_Type == LWEJObject::Array || Obj.m_Type == LWEJObject::Object) {
+			bool isObject = Obj.m_Type == LWEJObject::Object;
+			uint32_t Cnt = 0;
+			for (uint32_t i = 0; i < Obj.m_Length; i++) Cnt += Find(Obj.m_Children[i].m_FullNameHash) ? 1 : 0;
+			o += WriteHead(isObject ? 5 : 4, Cnt);
+			for (uint32_t i = 0; i < Obj.m_Length; i++) {
+				LWEJObject *Jobj = Find(Obj.m_Children[i].m_FullNameHash);
+				if (!Jobj) continue;
+				if (isObject) o += WriteName(Jobj->m_Name);
+				o += WriteObject(*Jobj);
+			}
+		} else if (Obj.m_Type == LWEJObject::String) o += WriteText(Obj.m_Value, (uint32_t)strlen(Obj.m_Value));
+		else if (Obj.m_Type == LWEJObject::Number) o += WriteNumber(Obj.m_Value);
+		else if (Obj.m_Type == LWEJObject::Boolean) o += Buffer.Write<uint8_t>(*Obj.m_Value == 't' ? 0xF5 : 0xF4);
+		else o += Buffer.Write<uint8_t>(0xF6);
+		return o;
+	};
+
+	bool isObject = m_Type != LWEJObject::Array;
+	uint32_t Cnt = 0;
+	for (uint32_t i = 0; i < m_Length; i++) Cnt += Find(m_Elements[i]) ? 1 : 0;
+	uint32_t o = WriteHead(isObject ? 5 : 4, Cnt);
+	for (uint32_t i = 0; i < m_Length; i++) {
+		LWEJObject *J = Find(m_Elements[i]);
+		if (!J) continue;
+		if (isObject) o += WriteName(J->m_Name);
+		o += WriteObject(*J);
+	}
+	if (NameBuffer != StaticNameBuffer) LWAllocator::Destroy(NameBuffer);
+	return o;
+}
+
 LWEJObject *LWEJson::MakeElement(const char *Name, LWEJObject *Parent) {
 	const uint32_t MaxParents = 128;
 	char FullNameBuffer[1024];
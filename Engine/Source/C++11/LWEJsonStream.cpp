@@ -0,0 +1,483 @@
+#include "LWEJsonStream.h"
+#include "LWEJsonTape.h"
+#include "LWEJson.h"
+#include <LWCore/LWAllocator.h>
+#include <LWCore/LWByteStream.h>
+#include <LWPlatform/LWFileStream.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cinttypes>
+#include <iostream>
+#include <algorithm>
+
+uint32_t LWEJsonReader::Next(void) {
+	if (m_State == Done) return m_Token = EndOfDocument;
+	if (m_State == Failed) return m_Token = Error;
+	m_ValueLength = 0;
+	*m_Value = '\0';
+	while (true) {
+		int32_t c = Peek();
+		if (m_State == ExpectCommaOrEnd) {
+			if (!m_Depth) {
+				if (c != -1) return Fail("Unexpected data after document.");
+				m_State = Done;
+				return m_Token = EndOfDocument;
+			}
+			uint8_t Top = m_Stack[m_Depth - 1];
+			if (c == (Top == BeginObject ? '}' : ']')) {
+				m_Position++;
+				m_Depth--;
+				return m_Token = (Top == BeginObject ? EndObject : EndArray);
+			}
+			if (c != ',') return Fail("Expected ',' or closing bracket.");
+			m_Position++;
+			m_State = Top == BeginObject ? ExpectKey : ExpectValue;
+		} else if (m_State == ExpectKeyOrEnd || m_State == ExpectValueOrEnd) {
+			char End = m_State == ExpectKeyOrEnd ? '}' : ']';
+			if (c == End) {
+				m_Position++;
+				m_Depth--;
+				m_State = ExpectCommaOrEnd;
+				return m_Token = (End == '}' ? EndObject : EndArray);
+			}
+			m_State = m_State == ExpectKeyOrEnd ? ExpectKey : ExpectValue;
+		} else if (m_State == ExpectKey) {
+			if (c != '\"') return Fail("Expected member name.");
+			if (!ReadString()) return m_Token;
+			if (Peek() != ':') return Fail("Expected ':'.");
+			m_Position++;
+			m_State = ExpectValue;
+			return m_Token = Key;
+		} else {
+			if (c == '{' || c == '[') {
+				if (m_Depth >= MaxDepth) return Fail("Exceeded max depth.");
+				m_Position++;
+				m_Stack[m_Depth++] = c == '{' ? BeginObject : BeginArray;
+				m_State = c == '{' ? ExpectKeyOrEnd : ExpectValueOrEnd;
+				return m_Token = (c == '{' ? BeginObject : BeginArray);
+			}
+			if (c == '\"') {
+				if (!ReadString()) return m_Token;
+				m_State = ExpectCommaOrEnd;
+				return m_Token = String;
+			}
+			if (c == -1 || c == '}' || c == ']' || c == ',' || c == ':') return Fail("Expected value.");
+			uint32_t Token = ReadScalar();
+			if (Token == Error) return m_Token;
+			m_State = ExpectCommaOrEnd;
+			return m_Token = Token;
+		}
+	}
+	return m_Token;
+}
+
+bool LWEJsonReader::Skip(void) {
+	if (m_Token == Key) {
+		if (Next() == Error) return false;
+	}
+	if (m_Token != BeginObject && m_Token != BeginArray) return m_Token != Error;
+	uint32_t Depth = m_Depth - 1;
+	while (m_Depth != Depth) {
+		if (Next() == Error) return false;
+	}
+	return true;
+}
+
+bool LWEJsonReader::Fill(void) {
+	m_Position = m_Length = 0;
+	if (m_EndOfStream) return false;
+	m_Length = m_ReadFunc(m_Buffer, m_BufferSize);
+	if (!m_Length) m_EndOfStream = true;
+	return m_Length != 0;
+}
+
+int32_t LWEJsonReader::Peek(void) {
+	while (true) {
+		if (m_Position == m_Length && !Fill()) return -1;
+		char c = m_Buffer[m_Position];
+		if (c == '\n') m_Line++;
+		else if (c != ' ' && c != '\t' && c != '\r') return (uint8_t)c;
+		m_Position++;
+	}
+	return -1;
+}
+
+void LWEJsonReader::AppendValue(const char *Text, uint32_t Len) {
+	if (m_ValueLength + Len + 1 > m_ValueSize) {
+		uint32_t NewSize = std::max<uint32_t>(m_ValueSize * 2, m_ValueLength + Len + 1);
+		char *Value = m_Allocator.AllocateArray<char>(NewSize);
+		memcpy(Value, m_Value, m_ValueLength);
+		LWAllocator::Destroy(m_Value);
+		m_Value = Value;
+		m_ValueSize = NewSize;
+	}
+	memcpy(m_Value + m_ValueLength, Text, Len);
+	m_ValueLength += Len;
+	m_Value[m_ValueLength] = '\0';
+}
+
+bool LWEJsonReader::ReadString(void) {
+	m_Position++;
+	bool Escaped = false;
+	bool EscapeNext = false;
+	while (true) {
+		if (m_Position == m_Length && !Fill()) {
+			Fail("Unterminated string.");
+			return false;
+		}
+		uint32_t Start = m_Position;
+		for (; m_Position < m_Length; m_Position++) {
+			uint8_t c = (uint8_t)m_Buffer[m_Position];
+			if (c < 0x20) {
+				Fail("Control character in string.");
+				return false;
+			}
+			if (EscapeNext) EscapeNext = false;
+			else if (c == '\\') Escaped = EscapeNext = true;
+			else if (c == '\"') break;
+		}
+		AppendValue(m_Buffer + Start, m_Position - Start);
+		if (m_Position < m_Length) break;
+	}
+	m_Position++;
+	if (Escaped) m_ValueLength = LWEJsonTape::UnEscapeText(m_Value, m_ValueLength, m_Value, m_ValueLength + 1) - 1;
+	return true;
+}
+
+uint32_t LWEJsonReader::ReadScalar(void) {
+	while (true) {
+		uint32_t Start = m_Position;
+		for (; m_Position < m_Length; m_Position++) {
+			char c = m_Buffer[m_Position];
+			if (c == ',' || c == '}' || c == ']' || c == ':' || c == '\"' || c == ' ' || c == '\t' || c == '\n' || c == '\r') break;
+		}
+		AppendValue(m_Buffer + Start, m_Position - Start);
+		if (m_Position < m_Length || !Fill()) break;
+	}
+	if (!strcmp(m_Value, "true") || !strcmp(m_Value, "false")) return Boolean;
+	if (!strcmp(m_Value, "null")) return Null;
+	if (!LWEJsonTape::isNumber(m_Value, m_ValueLength)) return Fail("Invalid number or literal.");
+	return Number;
+}
+
+uint32_t LWEJsonReader::Fail(const char *Reason) {
+	std::cout << "JSON parse error line " << m_Line << ": " << Reason << std::endl;
+	m_State = Failed;
+	return m_Token = Error;
+}
+
+uint32_t LWEJsonReader::GetToken(void) const {
+	return m_Token;
+}
+
+const char *LWEJsonReader::GetValue(void) const {
+	return m_Value;
+}
+
+uint32_t LWEJsonReader::GetValueLength(void) const {
+	return m_ValueLength;
+}
+
+bool LWEJsonReader::Equals(const char *Str) const {
+	return !strcmp(m_Value, Str);
+}
+
+uint32_t LWEJsonReader::GetDepth(void) const {
+	return m_Depth;
+}
+
+uint32_t LWEJsonReader::GetLine(void) const {
+	return m_Line;
+}
+
+int32_t LWEJsonReader::AsInt(void) const {
+	return atoi(m_Value);
+}
+
+float LWEJsonReader::AsFloat(void) const {
+	return (float)atof(m_Value);
+}
+
+double LWEJsonReader::AsDouble(void) const {
+	return atof(m_Value);
+}
+
+bool LWEJsonReader::AsBoolean(void) const {
+	return *m_Value == 't';
+}
+
+LWEJsonReader::LWEJsonReader(std::function<uint32_t(char*, uint32_t)> ReadFunc, LWAllocator &Allocator, uint32_t BufferSize) : m_ReadFunc(ReadFunc), m_Allocator(Allocator), m_BufferSize(BufferSize), m_ValueSize(256) {
+	m_Buffer = Allocator.AllocateArray<char>(m_BufferSize);
+	m_Value = Allocator.AllocateArray<char>(m_ValueSize);
+	*m_Value = '\0';
+}
+
+LWEJsonReader::LWEJsonReader(LWFileStream &Stream, LWAllocator &Allocator, uint32_t BufferSize) : LWEJsonReader([&Stream](char *Buffer, uint32_t Len)->uint32_t { return Stream.Read(Buffer, Len); }, Allocator, BufferSize) {}
+
+LWEJsonReader::LWEJsonReader(LWByteStream &Stream, LWAllocator &Allocator, uint32_t BufferSize) : LWEJsonReader([&Stream](char *Buffer, uint32_t Len)->uint32_t {
+	if (!Stream.GetRemainingCache() && !Stream.CanReadBytes(1)) return 0;
+	uint32_t n = std::min<uint32_t>(Len, Stream.GetRemainingCache());
+	return (uint32_t)Stream.Read<int8_t>((int8_t*)Buffer, n);
+}, Allocator, BufferSize) {}
+
+LWEJsonReader::~LWEJsonReader() {
+	LWAllocator::Destroy(m_Buffer);
+	LWAllocator::Destroy(m_Value);
+}
+
+LWEJsonWriter &LWEJsonWriter::BeginObject(void) {
+	if (!BeginValue()) return *this;
+	if (m_Depth >= MaxDepth) {
+		m_Failed = true;
+		return *this;
+	}
+	m_Stack[m_Depth++] = InObject;
+	return Append("{", 1);
+}
+
+LWEJsonWriter &LWEJsonWriter::EndObject(void) {
+	return EndContainer(InObject, '}');
+}
+
+LWEJsonWriter &LWEJsonWriter::BeginArray(void) {
+	if (!BeginValue()) return *this;
+	if (m_Depth >= MaxDepth) {
+		m_Failed = true;
+		return *this;
+	}
+	m_Stack[m_Depth++] = 0;
+	return Append("[", 1);
+}
+
+LWEJsonWriter &LWEJsonWriter::EndArray(void) {
+	return EndContainer(0, ']');
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteKey(const char *Name) {
+	return WriteKey(Name, true);
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteString(const char *Value) {
+	return WriteString(Value, (uint32_t)strlen(Value));
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteString(const char *Value, uint32_t Len) {
+	if (!BeginValue()) return *this;
+	return AppendString(Value, Len);
+}
+LWEJsonWriter &LWEJsonWriter::WriteInt(int64_t Value) {
+	char Buffer[32];
+	if (!BeginValue()) return *this;
+	return Append(Buffer, (uint32_t)snprintf(Buffer, sizeof(Buffer), "%" PRId64, Value));
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteUInt(uint64_t Value) {
+	char Buffer[32];
+	if (!BeginValue()) return *this;
+	return Append(Buffer, (uint32_t)snprintf(Buffer, sizeof(Buffer), "%" PRIu64, Value));
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteFloat(double Value) {
+	char Buffer[32];
+	if (Value != Value || Value - Value != 0.0) return WriteNull(); //json has no nan or infinity.
+	if (!BeginValue()) return *this;
+	uint32_t Len = (uint32_t)snprintf(Buffer, sizeof(Buffer), "%.15g", Value);
+	if (strtod(Buffer, nullptr) != Value) Len = (uint32_t)snprintf(Buffer, sizeof(Buffer), "%.17g", Value);
+	return Append(Buffer, Len);
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteBoolean(bool Value) {
+	if (!BeginValue()) return *this;
+	return Value ? Append("true", 4) : Append("false", 5);
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteNull(void) {
+	if (!BeginValue()) return *this;
+	return Append("null", 4);
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteRaw(const char *Value) {
+	if (!BeginValue()) return *this;
+	return Append(Value, (uint32_t)strlen(Value));
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteElement(LWEJson &Json, LWEJObject &Obj) {
+	//LWEJson keeps names as they appeared in the source, so they are written without escaping like Serialize does.
+	if (m_Depth && (m_Stack[m_Depth - 1] & InObject) && !m_AfterKey) WriteKey(Obj.m_Name, false);
+	if (Obj.m_Type == LWEJObject::Object || Obj.m_Type == LWEJObject::Array) {
+		if (Obj.m_Type == LWEJObject::Object) BeginObject();
+		else BeginArray();
+		for (uint32_t i = 0; i < Obj.m_Length; i++) {
+			LWEJObject *C = Json.Find(Obj.m_Children[i].m_FullNameHash);
+			if (C) WriteElement(Json, *C);
+		}
+		return Obj.m_Type == LWEJObject::Object ? EndObject() : EndArray();
+	}
+	if (Obj.m_Type == LWEJObject::String) return WriteString(Obj.m_Value);
+	if (Obj.m_Type == LWEJObject::Boolean) return WriteBoolean(Obj.AsBoolean());
+	if (Obj.m_Type == LWEJObject::Null) return WriteNull();
+	return WriteRaw(Obj.m_Value);
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteDocument(LWEJson &Json) {
+	if (Json.GetType() == LWEJObject::Array) BeginArray();
+	else BeginObject();
+	for (uint32_t i = 0; i < Json.GetLength(); i++) {
+		LWEJObject *C = Json.GetElement(i);
+		if (C) WriteElement(Json, *C);
+	}
+	return Json.GetType() == LWEJObject::Array ? EndArray() : EndObject();
+}
+
+bool LWEJsonWriter::Flush(void) {
+	if (m_WriteFunc && m_Length && !m_Failed) {
+		if (!m_WriteFunc(m_Buffer, m_Length)) m_Failed = true;
+		m_Length = 0;
+	}
+	return !m_Failed;
+}
+
+const char *LWEJsonWriter::GetData(void) const {
+	return m_Buffer;
+}
+
+uint32_t LWEJsonWriter::GetLength(void) const {
+	return m_Length;
+}
+
+uint64_t LWEJsonWriter::GetBytesWritten(void) const {
+	return m_BytesWritten;
+}
+
+bool LWEJsonWriter::isFailed(void) const {
+	return m_Failed;
+}
+
+bool LWEJsonWriter::BeginValue(void) {
+	if (m_Failed) return false;
+	if (!m_Depth) {
+		if (m_RootWritten) m_Failed = true;
+		m_RootWritten = true;
+		return !m_Failed;
+	}
+	uint8_t &Top = m_Stack[m_Depth - 1];
+	if (Top&InObject) {
+		if (!m_AfterKey) m_Failed = true;
+		m_AfterKey = false;
+		return !m_Failed;
+	}
+	if (Top&HasElements) Append(",", 1);
+	Top |= HasElements;
+	Indent();
+	return true;
+}
+
+LWEJsonWriter &LWEJsonWriter::WriteKey(const char *Name, bool Escape) {
+	if (m_Failed) return *this;
+	if (!m_Depth || (m_Stack[m_Depth - 1] & InObject) == 0 || m_AfterKey) {
+		m_Failed = true;
+		return *this;
+	}
+	if (m_Stack[m_Depth - 1] & HasElements) Append(",", 1);
+	m_Stack[m_Depth - 1] |= HasElements;
+	Indent();
+	m_AfterKey = true;
+	uint32_t Len = (uint32_t)strlen(Name);
+	if (Escape) AppendString(Name, Len);
+	else Append("\"", 1).Append(Name, Len).Append("\"", 1);
+	return Append(m_Format ? ": " : ":", m_Format ? 2 : 1);
+}
+
+LWEJsonWriter &LWEJsonWriter::AppendString(const char *Value, uint32_t Len) {
+	const char Hex[] = "0123456789abcdef";
+	Append("\"", 1);
+	const char *S = Value;
+	const char *L = Value + Len;
+	for (const char *P = Value; P != L; P++) {
+		uint8_t c = (uint8_t)*P;
+		if (c >= 0x20 && c != '\"' && c != '\\') continue;
+		Append(S, (uint32_t)(P - S));
+		S = P + 1;
+		char Esc[6] = { '\\', (char)c, 0, 0, 0, 0 };
+		uint32_t EscLen = 2;
+		if (c == '\b') Esc[1] = 'b';
+		else if (c == '\f') Esc[1] = 'f';
+		else if (c == '\n') Esc[1] = 'n';
+		else if (c == '\r') Esc[1] = 'r';
+		else if (c == '\t') Esc[1] = 't';
+		else if (c < 0x20) {
+			Esc[1] = 'u';
+			Esc[2] = Esc[3] = '0';
+			Esc[4] = Hex[c >> 4];
+			Esc[5] = Hex[c & 0xF];
+			EscLen = 6;
+		}
+		Append(Esc, EscLen);
+	}
+	Append(S, (uint32_t)(L - S));
+	return Append("\"", 1);
+}
+
+LWEJsonWriter &LWEJsonWriter::EndContainer(uint8_t Type, char Token) {
+	if (m_Failed) return *this;
+	if (!m_Depth || (m_Stack[m_Depth - 1] & InObject) != Type || m_AfterKey) {
+		m_Failed = true;
+		return *this;
+	}
+	bool HadElements = (m_Stack[m_Depth - 1] & HasElements) != 0;
+	m_Depth--;
+	if (HadElements) Indent();
+	Append(&Token, 1);
+	if (!m_Depth && m_Format) Append("\n", 1);
+	return *this;
+}
+
+LWEJsonWriter &LWEJsonWriter::Append(const char *Text, uint32_t Len) {
+	m_BytesWritten += Len;
+	while (Len) {
+		if (m_Length == m_BufferSize) {
+			if (m_WriteFunc) Flush();
+			else {
+				uint32_t NewSize = m_BufferSize * 2;
+				char *Buffer = m_Allocator.AllocateArray<char>(NewSize);
+				memcpy(Buffer, m_Buffer, m_Length);
+				LWAllocator::Destroy(m_Buffer);
+				m_Buffer = Buffer;
+				m_BufferSize = NewSize;
+			}
+		}
+		uint32_t n = std::min<uint32_t>(Len, m_BufferSize - m_Length);
+		memcpy(m_Buffer + m_Length, Text, n);
+		m_Length += n;
+		Text += n;
+		Len -= n;
+	}
+	return *this;
+}
+
+LWEJsonWriter &LWEJsonWriter::Indent(void) {
+	if (!m_Format) return *this;
+	const char Spaces[] = "\n                                ";
+	uint32_t Count = m_Depth * 2;
+	Append(Spaces, 1);
+	while (Count) {
+		uint32_t n = std::min<uint32_t>(Count, sizeof(Spaces) - 2);
+		Append(Spaces + 1, n);
+		Count -= n;
+	}
+	return *this;
+}
+
+LWEJsonWriter::LWEJsonWriter(std::function<bool(const char*, uint32_t)> WriteFunc, LWAllocator &Allocator, bool Format, uint32_t BufferSize) : m_WriteFunc(WriteFunc), m_Allocator(Allocator), m_BufferSize(BufferSize), m_Format(Format) {
+	m_Buffer = Allocator.AllocateArray<char>(m_BufferSize);
+}
+
+LWEJsonWriter::LWEJsonWriter(LWFileStream &Stream, LWAllocator &Allocator, bool Format, uint32_t BufferSize) : LWEJsonWriter([&Stream](const char *Buffer, uint32_t Len)->bool { return Stream.Write(Buffer, Len) == Len; }, Allocator, Format, BufferSize) {}
+
+LWEJsonWriter::LWEJsonWriter(LWAllocator &Allocator, bool Format, uint32_t BufferSize) : LWEJsonWriter(nullptr, Allocator, Format, BufferSize) {}
+
+LWEJsonWriter::~LWEJsonWriter() {
+	Flush();
+	LWAllocator::Destroy(m_Buffer);
+}
\ No newline at end of file
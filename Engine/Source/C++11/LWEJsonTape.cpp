@@ -0,0 +1,519 @@
+#include "LWEJsonTape.h"
+#include "LWEJson.h"
+#include <LWCore/LWText.h>
+#include <LWCore/LWAllocator.h>
+#include <LWPlatform/LWFileStream.h>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+//The classifier is picked from what the compiler is targeting, targets without sse2(arm, wasm) use the scalar classifier.
+#if defined(__AVX2__) && !defined(LW_NOAVX2)
+#define LWEJSON_AVX2
+#include <immintrin.h>
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(LW_NOAVX)
+#define LWEJSON_SSE2
+#include <emmintrin.h>
+#endif
+
+//The masks of one block of source, bit n is set if byte n matches.
+struct LWEJsonBlockMasks {
+	uint64_t m_Quote;
+	uint64_t m_Backslash;
+	uint64_t m_Operator;
+	uint64_t m_Space;
+	uint64_t m_Control;
+};
+
+inline uint32_t LWEJsonTrailingZeros(uint64_t Mask) {
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward64(&Index, Mask);
+	return (uint32_t)Index;
+#else
+	return (uint32_t)__builtin_ctzll(Mask);
+#endif
+}
+
+//Sets every bit between an odd and even set bit, giving the bits which are inside a pair of quotes.
+inline uint64_t LWEJsonPrefixXor(uint64_t Mask) {
+	Mask ^= Mask << 1;
+	Mask ^= Mask << 2;
+	Mask ^= Mask << 4;
+	Mask ^= Mask << 8;
+	Mask ^= Mask << 16;
+	Mask ^= Mask << 32;
+	return Mask;
+}
+
+inline void LWEJsonClassify(const char *Block, LWEJsonBlockMasks &Masks) {
+#if defined(LWEJSON_AVX2)
+	uint64_t Quote = 0, Backslash = 0, Operator = 0, Space = 0, Control = 0;
+	for (uint32_t i = 0; i < LWEJsonTape::BlockSize; i += 32) {
+		__m256i V = _mm256_loadu_si256((const __m256i*)(Block + i));
+		__m256i Ops = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(V, _mm256_set1_epi8('}'))), _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(V, _mm256_set1_epi8(']'))));
+		Ops = _mm256_or_si256(Ops, _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(V, _mm256_set1_epi8(','))));
+		__m256i Spaces = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\t'))), _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\r'))));
+		__m256i Controls = _mm256_cmpeq_epi8(_mm256_max_epu8(V, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F));
+		Quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\"'))) << i;
+		Backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\\'))) << i;
+		Operator |= (uint64_t)(uint32_t)_mm256_movemask_epi8(Ops) << i;
+		Space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(Spaces) << i;
+		Control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(Controls) << i;
+	}
+	Masks = { Quote, Backslash, Operator, Space, Control };
+#elif defined(LWEJSON_SSE2)
+	uint64_t Quote = 0, Backslash = 0, Operator = 0, Space = 0, Control = 0;
+	for (uint32_t i = 0; i < LWEJsonTape::BlockSize; i += 16) {
+		__m128i V = _mm_loadu_si128((const __m128i*)(Block + i));
+		__m128i Ops = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('{')), _mm_cmpeq_epi8(V, _mm_set1_epi8('}'))), _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('[')), _mm_cmpeq_epi8(V, _mm_set1_epi8(']'))));
+		Ops = _mm_or_si128(Ops, _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8(':')), _mm_cmpeq_epi8(V, _mm_set1_epi8(','))));
+		__m128i Spaces = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(V, _mm_set1_epi8('\t'))), _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(V, _mm_set1_epi8('\r'))));
+		__m128i Controls = _mm_cmpeq_epi8(_mm_max_epu8(V, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+		Quote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(V, _mm_set1_epi8('\"'))) << i;
+		Backslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(V, _mm_set1_epi8('\\'))) << i;
+		Operator |= (uint64_t)(uint32_t)_mm_movemask_epi8(Ops) << i;
+		Space |= (uint64_t)(uint32_t)_mm_movemask_epi8(Spaces) << i;
+		Control |= (uint64_t)(uint32_t)_mm_movemask_epi8(Controls) << i;
+	}
+	Masks = { Quote, Backslash, Operator, Space, Control };
+#else
+	Masks = { 0, 0, 0, 0, 0 };
+	for (uint32_t i = 0; i < LWEJsonTape::BlockSize; i++) {
+		uint8_t c = (uint8_t)Block[i];
+		uint64_t Bit = 1ull << i;
+		if (c == '\"') Masks.m_Quote |= Bit;
+		else if (c == '\\') Masks.m_Backslash |= Bit;
+		else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') Masks.m_Operator |= Bit;
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') Masks.m_Space |= Bit;
+		if (c < 0x20) Masks.m_Control |= Bit;
+	}
+#endif
+}
+
+inline bool LWEJsonIsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+uint32_t LWEJNode::GetType(void) const {
+	return m_Type&TypeBits;
+}
+
+bool LWEJNode::isKey(void) const {
+	return (m_Type&Key) != 0;
+}
+
+uint32_t LWEJsonTape::IndexStructurals(const char *Buffer, uint32_t BufferLen, uint32_t *Indices) {
+	char Tail[BlockSize];
+	uint64_t PrevInString = 0; //all bits set if the previous block ended inside a string.
+	uint64_t PrevEscaped = 0; //1 if the first byte of the block is escaped by a backslash ending the previous block.
+	uint64_t PrevScalar = 0; //1 if the previous block ended in the middle of a literal or number.
+	uint32_t o = 0;
+	for (uint32_t Pos = 0; Pos < BufferLen; Pos += BlockSize) {
+		const char *Block = Buffer + Pos;
+		uint32_t Len = std::min<uint32_t>(BufferLen - Pos, BlockSize);
+		if (Len != BlockSize) {
+			memcpy(Tail, Block, Len);
+			memset(Tail + Len, ' ', BlockSize - Len);
+			Block = Tail;
+		}
+		LWEJsonBlockMasks Masks;
+		LWEJsonClassify(Block, Masks);
+
+		//backslashes are rare, so find the escaped bytes one backslash at a time.
+		uint64_t Escaped = PrevEscaped;
+		PrevEscaped = 0;
+		for (uint64_t Backslash = Masks.m_Backslash & ~Escaped; Backslash; Backslash &= Backslash - 1) {
+			uint32_t i = LWEJsonTrailingZeros(Backslash);
+			if (Escaped&(1ull << i)) continue;
+			if (i == BlockSize - 1) PrevEscaped = 1;
+			else Escaped |= 1ull << (i + 1);
+		}
+		uint64_t Quote = Masks.m_Quote&~Escaped;
+		uint64_t InString = LWEJsonPrefixXor(Quote) ^ PrevInString;
+		PrevInString = (uint64_t)((int64_t)InString >> 63);
+		if (Masks.m_Control&InString) return InvalidNode;
+
+		uint64_t Scalar = ~(Masks.m_Operator | Masks.m_Space | Quote | InString);
+		uint64_t ScalarStart = Scalar & ~((Scalar << 1) | PrevScalar);
+		PrevScalar = Scalar >> 63;
+		uint64_t Structural = (Masks.m_Operator&~InString) | Quote | ScalarStart;
+		if (Len != BlockSize) Structural &= (1ull << Len) - 1;
+		for (; Structural; Structural &= Structural - 1) Indices[o++] = Pos + LWEJsonTrailingZeros(Structural);
+	}
+	if (PrevInString) return InvalidNode;
+	return o;
+}
+
+uint32_t LWEJsonTape::UnEscapeText(const char *Text, uint32_t Len, char *Buffer, uint32_t BufferLen) {
+	const char *S = Text;
+	const char *SL = Text + Len;
+	char *B = Buffer;
+	char *L = Buffer + BufferLen;
+	uint32_t o = 0;
+	auto Write = [&B, L, &o](uint32_t c) {
+		char U[4];
+		uint32_t ULen = 1;
+		if (c < 0x80) U[0] = (char)c;
+		else if (c < 0x800) {
+			U[0] = (char)(0xC0 | (c >> 6));
+			U[1] = (char)(0x80 | (c & 0x3F));
+			ULen = 2;
+		} else if (c < 0x10000) {
+			U[0] = (char)(0xE0 | (c >> 12));
+			U[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+			U[2] = (char)(0x80 | (c & 0x3F));
+			ULen = 3;
+		} else {
+			U[0] = (char)(0xF0 | (c >> 18));
+			U[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+			U[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+			U[3] = (char)(0x80 | (c & 0x3F));
+			ULen = 4;
+		}
+		for (uint32_t i = 0; i < ULen; i++) {
+			if (B + 1 < L) *B++ = U[i];
+		}
+		o += ULen;
+	};
+	auto ReadHex = [](const char *P, const char *PL)->uint32_t {
+		uint32_t v = 0;
+		for (uint32_t i = 0; i < 4; i++, P++) {
+			if (P >= PL) return 0xFFFFFFFF;
+			char c = *P;
+			v <<= 4;
+			if (c >= '0' && c <= '9') v |= (uint32_t)(c - '0');
+			else if (c >= 'a' && c <= 'f') v |= (uint32_t)(c - 'a' + 10);
+			else if (c >= 'A' && c <= 'F') v |= (uint32_t)(c - 'A' + 10);
+			else return 0xFFFFFFFF;
+		}
+		return v;
+	};
+	for (; S < SL; S++) {
+		if (*S != '\\' || S + 1 == SL) {
+			if (B + 1 < L) *B++ = *S;
+			o++;
+			continue;
+		}
+		S++;
+		if (*S == 'b') Write('\b');
+		else if (*S == 'f') Write('\f');
+		else if (*S == 'n') Write('\n');
+		else if (*S == 'r') Write('\r');
+		else if (*S == 't') Write('\t');
+		else if (*S == 'u') {
+			uint32_t c = ReadHex(S + 1, SL);
+			if (c == 0xFFFFFFFF) {
+				Write('u');
+				continue;
+			}
+			S += 4;
+			if (c >= 0xD800 && c < 0xDC00 && S + 2 < SL && S[1] == '\\' && S[2] == 'u') {
+				uint32_t Low = ReadHex(S + 3, SL);
+				if (Low >= 0xDC00 && Low < 0xE000) {
+					c = 0x10000 + ((c - 0xD800) << 10) + (Low - 0xDC00);
+					S += 6;
+				}
+			}
+			Write(c);
+		} else {
+			if (B + 1 < L) *B++ = *S;
+			o++;
+		}
+	}
+	if (B != L) *B = '\0';
+	return o + 1;
+}
+
+bool LWEJsonTape::isNumber(const char *Text, uint32_t Len) {
+	const char *P = Text;
+	const char *L = Text + Len;
+	auto Digits = [&P, L]()->uint32_t {
+		const char *S = P;
+		while (P != L && *P >= '0' && *P <= '9') P++;
+		return (uint32_t)(P - S);
+	};
+	if (P != L && *P == '-') P++;
+	if (P == L) return false;
+	if (*P == '0') P++;
+	else if (!Digits()) return false;
+	if (P != L && *P == '.') {
+		P++;
+		if (!Digits()) return false;
+	}
+	if (P != L && (*P == 'e' || *P == 'E')) {
+		P++;
+		if (P != L && (*P == '+' || *P == '-')) P++;
+		if (!Digits()) return false;
+	}
+	return P == L;
+}
+
+bool LWEJsonTape::Parse(LWEJsonTape &Tape, const char *Buffer, uint32_t BufferLen) {
+	auto OutputError = [Buffer](uint32_t Offset, const char *Error)->bool {
+		uint32_t Line = 0;
+		for (const char *C = Buffer; C != Buffer + Offset; C++) {
+			if (*C == '\n') Line++;
+		}
+		std::cout << "JSON parse error line " << Line << ": " << Error << std::endl;
+		return false;
+	};
+
+	Tape.m_Source = Buffer;
+	Tape.m_SourceLen = BufferLen;
+	Tape.m_NodeCount = 0;
+	if (BufferLen + 1 > Tape.m_IndexPoolSize) {
+		LWAllocator::Destroy(Tape.m_Indices);
+		Tape.m_Indices = Tape.m_Allocator->AllocateArray<uint32_t>(BufferLen + 1);
+		Tape.m_IndexPoolSize = BufferLen + 1;
+	}
+	uint32_t *Indices = Tape.m_Indices;
+	uint32_t IndexCount = IndexStructurals(Buffer, BufferLen, Indices);
+	if (IndexCount == InvalidNode) return OutputError(BufferLen, "Unterminated string or control character in string.");
+	if (!IndexCount) return OutputError(BufferLen, "Empty document.");
+	Indices[IndexCount] = BufferLen;
+
+	//every node consumes at least one index.
+	if (IndexCount > Tape.m_NodePoolSize) {
+		LWAllocator::Destroy(Tape.m_Nodes);
+		Tape.m_Nodes = Tape.m_Allocator->AllocateArray<LWEJNode>(IndexCount);
+		Tape.m_NodePoolSize = IndexCount;
+	}
+	LWEJNode *Nodes = Tape.m_Nodes;
+	uint32_t Stack[MaxDepth];
+	uint32_t Depth = 0;
+	uint32_t NodeCount = 0;
+
+	auto PushString = [Buffer, Indices, IndexCount, Nodes, &NodeCount](uint32_t &i, uint32_t Flag)->bool {
+		if (i + 1 >= IndexCount || Buffer[Indices[i + 1]] != '\"') return false;
+		uint32_t Offset = Indices[i] + 1;
+		uint32_t Len = Indices[i + 1] - Offset;
+		if (memchr(Buffer + Offset, '\\', Len)) Flag |= LWEJNode::Escaped;
+		Nodes[NodeCount] = { LWEJObject::String | Flag, Offset, Len, NodeCount + 1 };
+		NodeCount++;
+		i += 2;
+		return true;
+	};
+
+	uint32_t i = 0;
+	while (true) {
+		//Parse a value.
+		if (i >= IndexCount) return OutputError(BufferLen, "Expected value.");
+		uint32_t Offset = Indices[i];
+		char c = Buffer[Offset];
+		if (Depth && Nodes[Stack[Depth - 1]].m_Type == LWEJObject::Array) Nodes[Stack[Depth - 1]].m_Length++;
+		bool Close = false;
+		bool NeedKey = false;
+		if (c == '{' || c == '[') {
+			if (Depth >= MaxDepth) return OutputError(Offset, "Exceeded max depth.");
+			Stack[Depth++] = NodeCount;
+			Nodes[NodeCount++] = { c == '{' ? (uint32_t)LWEJObject::Object : (uint32_t)LWEJObject::Array, Offset, 0, 0 };
+			i++;
+			char e = c == '{' ? '}' : ']';
+			if (i < IndexCount && Buffer[Indices[i]] == e) Close = true;
+			else if (c == '[') continue;
+			else NeedKey = true;
+		} else if (c == '\"') {
+			if (!PushString(i, 0)) return OutputError(Offset, "Invalid string.");
+		} else if (c == '}' || c == ']' || c == ',' || c == ':') {
+			return OutputError(Offset, "Expected value.");
+		} else {
+			uint32_t Len = Indices[i + 1] - Offset;
+			while (LWEJsonIsSpace(Buffer[Offset + Len - 1])) Len--;
+			uint32_t Type = LWEJObject::Number;
+			if (c == 't' || c == 'f') {
+				if (!(Len == 4 && !strncmp(Buffer + Offset, "true", 4)) && !(Len == 5 && !strncmp(Buffer + Offset, "false", 5))) return OutputError(Offset, "Invalid literal.");
+				Type = LWEJObject::Boolean;
+			} else if (c == 'n') {
+				if (Len != 4 || strncmp(Buffer + Offset, "null", 4)) return OutputError(Offset, "Invalid literal.");
+				Type = LWEJObject::Null;
+			} else if (!isNumber(Buffer + Offset, Len)) return OutputError(Offset, "Invalid number.");
+			Nodes[NodeCount] = { Type, Offset, Len, NodeCount + 1 };
+			NodeCount++;
+			i++;
+		}
+
+		//Close containers, then find the next key or value.
+		while (true) {
+			if (!Depth) {
+				if (i != IndexCount) return OutputError(Indices[i], "Unexpected data after document.");
+				Tape.m_NodeCount = NodeCount;
+				return true;
+			}
+			LWEJNode &Parent = Nodes[Stack[Depth - 1]];
+			if (Close) {
+				Parent.m_Next = NodeCount;
+				Depth--;
+				i++;
+				Close = false;
+				continue;
+			}
+			if (!NeedKey) {
+				if (i >= IndexCount) return OutputError(BufferLen, "Unterminated array or object.");
+				c = Buffer[Indices[i]];
+				if (c == (Parent.m_Type == LWEJObject::Array ? ']' : '}')) {
+					Close = true;
+					continue;
+				}
+				if (c != ',') return OutputError(Indices[i], "Expected ',' or closing bracket.");
+				i++;
+				if (Parent.m_Type == LWEJObject::Array) break;
+			}
+			NeedKey = false;
+			if (i >= IndexCount || Buffer[Indices[i]] != '\"' || !PushString(i, LWEJNode::Key)) return OutputError(i < IndexCount ? Indices[i] : BufferLen, "Expected member name.");
+			if (i >= IndexCount || Buffer[Indices[i]] != ':') return OutputError(i < IndexCount ? Indices[i] : BufferLen, "Expected ':'.");
+			i++;
+			Parent.m_Length++;
+			break;
+		}
+	}
+	return false;
+}
+
+bool LWEJsonTape::LoadFile(LWEJsonTape &Tape, const LWText &Path, LWAllocator &Allocator, LWFileStream *ExistingStream) {
+	LWFileStream Stream;
+	if (!LWFileStream::OpenStream(Stream, Path, LWFileStream::BinaryMode | LWFileStream::ReadMode, Allocator, ExistingStream)) return false;
+	uint32_t Len = Stream.Length();
+	char *B = Tape.m_Allocator->AllocateArray<char>(Len + 1);
+	Stream.Read(B, Len);
+	B[Len] = '\0';
+	LWAllocator::Destroy(Tape.m_OwnedSource);
+	Tape.m_OwnedSource = B;
+	return Parse(Tape, B, Len);
+}
+
+const LWEJNode *LWEJsonTape::GetNode(uint32_t Index) const {
+	if (Index >= m_NodeCount) return nullptr;
+	return m_Nodes + Index;
+}
+
+uint32_t LWEJsonTape::GetFirstChild(uint32_t Index) const {
+	if (Index >= m_NodeCount) return InvalidNode;
+	const LWEJNode &N = m_Nodes[Index];
+	uint32_t Type = N.GetType();
+	if ((Type != LWEJObject::Array && Type != LWEJObject::Object) || !N.m_Length) return InvalidNode;
+	return Index + 1;
+}
+
+uint32_t LWEJsonTape::GetChild(uint32_t Index, uint32_t i) const {
+	uint32_t C = GetFirstChild(Index);
+	if (C == InvalidNode || i >= m_Nodes[Index].m_Length) return InvalidNode;
+	bool isObject = m_Nodes[Index].GetType() == LWEJObject::Object;
+	if (isObject) C++;
+	for (; i; i--) C = m_Nodes[C].m_Next + (isObject ? 1 : 0);
+	return C;
+}
+
+uint32_t LWEJsonTape::FindChild(uint32_t Index, const char *Name) const {
+	if (Index >= m_NodeCount || m_Nodes[Index].GetType() != LWEJObject::Object) return InvalidNode;
+	uint32_t Len = (uint32_t)strlen(Name);
+	for (uint32_t C = Index + 1; C < m_Nodes[Index].m_Next; C = m_Nodes[C + 1].m_Next) {
+		if (Equals(C, Name, Len)) return C + 1;
+	}
+	return InvalidNode;
+}
+
+uint32_t LWEJsonTape::Find(const char *Path) const {
+	uint32_t Index = 0;
+	const char *P = Path;
+	while (*P && Index != InvalidNode) {
+		if (*P == '[') {
+			uint32_t i = (uint32_t)atoi(P + 1);
+			if (Index >= m_NodeCount || m_Nodes[Index].GetType() != LWEJObject::Array) return InvalidNode;
+			Index = GetChild(Index, i);
+			P = strchr(P, ']');
+			if (!P) return InvalidNode;
+			P++;
+			if (*P == '.') P++;
+			continue;
+		}
+		const char *E = P;
+		while (*E && *E != '.' && *E != '[') E++;
+		if (Index >= m_NodeCount || m_Nodes[Index].GetType() != LWEJObject::Object) return InvalidNode;
+		uint32_t Len = (uint32_t)(E - P);
+		uint32_t Next = InvalidNode;
+		for (uint32_t C = Index + 1; C < m_Nodes[Index].m_Next; C = m_Nodes[C + 1].m_Next) {
+			if (!Equals(C, P, Len)) continue;
+			Next = C + 1;
+			break;
+		}
+		Index = Next;
+		P = *E == '.' ? E + 1 : E;
+	}
+	return Index;
+}
+
+bool LWEJsonTape::Equals(uint32_t Index, const char *Str, uint32_t Len) const {
+	if (Index >= m_NodeCount) return false;
+	const LWEJNode &N = m_Nodes[Index];
+	if ((N.m_Type&LWEJNode::Escaped) == 0) return N.m_Length == Len && !memcmp(m_Source + N.m_Offset, Str, Len);
+	char Buffer[256];
+	if (N.m_Length >= sizeof(Buffer)) {
+		char *B = m_Allocator->AllocateArray<char>(N.m_Length + 1);
+		uint32_t BLen = GetString(Index, B, N.m_Length + 1) - 1;
+		bool Res = BLen == Len && !memcmp(B, Str, Len);
+		LWAllocator::Destroy(B);
+		return Res;
+	}
+	uint32_t BLen = GetString(Index, Buffer, sizeof(Buffer)) - 1;
+	return BLen == Len && !memcmp(Buffer, Str, Len);
+}
+
+uint32_t LWEJsonTape::GetString(uint32_t Index, char *Buffer, uint32_t BufferLen) const {
+	if (Index >= m_NodeCount) return 0;
+	const LWEJNode &N = m_Nodes[Index];
+	const char *S = m_Source + N.m_Offset;
+	if ((N.m_Type&LWEJNode::Escaped) == 0) {
+		uint32_t Len = std::min<uint32_t>(N.m_Length, BufferLen ? BufferLen - 1 : 0);
+		memcpy(Buffer, S, Len);
+		if (BufferLen) Buffer[Len] = '\0';
+		return N.m_Length + 1;
+	}
+	return UnEscapeText(S, N.m_Length, Buffer, BufferLen);
+}
+
+const char *LWEJsonTape::GetText(uint32_t Index) const {
+	if (Index >= m_NodeCount) return nullptr;
+	return m_Source + m_Nodes[Index].m_Offset;
+}
+
+int32_t LWEJsonTape::AsInt(uint32_t Index) const {
+	char Buffer[64];
+	GetString(Index, Buffer, sizeof(Buffer));
+	return atoi(Buffer);
+}
+
+float LWEJsonTape::AsFloat(uint32_t Index) const {
+	return (float)AsDouble(Index);
+}
+
+double LWEJsonTape::AsDouble(uint32_t Index) const {
+	char Buffer[64];
+	GetString(Index, Buffer, sizeof(Buffer));
+	return atof(Buffer);
+}
+
+bool LWEJsonTape::AsBoolean(uint32_t Index) const {
+	const char *T = GetText(Index);
+	return T && (*T == 't' || *T == 'T');
+}
+
+uint32_t LWEJsonTape::GetNodeCount(void) const {
+	return m_NodeCount;
+}
+
+const char *LWEJsonTape::GetSource(void) const {
+	return m_Source;
+}
+
+LWAllocator &LWEJsonTape::GetAllocator(void) const {
+	return *m_Allocator;
+}
+
+LWEJsonTape::LWEJsonTape(LWAllocator &Allocator) : m_Allocator(&Allocator) {}
+
+LWEJsonTape::~LWEJsonTape() {
+	LWAllocator::Destroy(m_Nodes);
+	LWAllocator::Destroy(m_Indices);
+	LWAllocator::Destroy(m_OwnedSource);
+}
\ No newline at end of file
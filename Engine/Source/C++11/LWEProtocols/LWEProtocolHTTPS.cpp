@@ -1,123 +1,138 @@
 #include "LWEProtocols/LWEProtocolHTTPS.h"
 #include <LWCore/LWText.h>
+#include <LWCore/LWTimer.h>
 #include <iostream>
 
 LWProtocol &LWEProtocolHttps::SocketChanged(LWSocket &Prev, LWSocket &New, LWProtocolManager *Manager) {
 	LWEProtocolTLS::SocketChanged(Prev, New, Manager);
-	New.SetProtocolData(m_hProtocolID, Prev.GetProtocolData(m_hProtocolID));
+	LWEHttpConnection *Conn = (LWEHttpConnection*)New.GetProtocolData(m_hProtocolID);
+	if (Conn) Conn->SetSocket(&New);
+	for (auto &&R : m_Waiting) {
+		if (R->m_Socket == &Prev) R->m_Socket = &New;
+	}
 	return *this;
 }
 
 LWProtocol &LWEProtocolHttps::SocketClosed(LWSocket &Socket, LWProtocolManager *Manager) {
 	LWEProtocolTLS::SocketClosed(Socket, Manager);
-	
+	//Requests waiting on the handshake of this socket have to find another connection.
+	for (auto Iter = m_Waiting.begin(); Iter != m_Waiting.end();) {
+		LWEHttpRequest *R = *Iter;
+		if (R->m_Socket != &Socket) {
+			++Iter;
+			continue;
+		}
+		if (R->m_Status == 0) {
+			R->m_Socket = nullptr;
+			++Iter;
+			continue;
+		}
+		m_Pool.Release(R);
+		Iter = m_Waiting.erase(Iter);
+	}
+	LWEHttpConnection *Conn = (LWEHttpConnection*)Socket.GetProtocolData(m_hProtocolID);
+	if (!Conn) return *this;
+	Socket.SetProtocolData(m_hProtocolID, nullptr);
+	Conn->FinishClosed(m_Pool);
+	m_Connections.Destroy(Conn, m_Pool, m_Waiting);
 	return *this;
 }
 
 LWProtocol &LWEProtocolHttps::ProcessTLSData(LWSocket &Socket, const char *Data, uint32_t DataLen) {
-	ProcessRead(Socket, Data, DataLen);
-	return *this;
-}
-
-bool LWEProtocolHttps::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len) {
-	LWEHttpRequest *Req = (LWEHttpRequest*)Socket.GetProtocolData(m_hProtocolID);
-	LWEHttpRequest IReq;
-	bool Insert = false;
-	if (!Req) {
-		Req = &IReq;
-		Req->m_Socket = &Socket;
-		Insert = true;
-	}
-	if (!Req->Deserialize(Buffer, Len)) {
-		std::cout << "Error deserializing response." << std::endl;
-		return false;
-	}
-	if (Insert) {
-		if (!GetNextFromPool(&Req)) {
-			std::cout << "Could not get a request to write to from pool." << std::endl;
-			return false;
+	//Decrypted records are not null terminated, so they are copied into a receive buffer that bodies can be sliced from.
+	if (!m_ReceiveBuffer || m_ReceiveBuffer->isShared() || m_ReceiveBuffer->m_Capacity < DataLen + 1) {
+		if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
+		m_ReceiveBuffer = LWEHttpBuffer::Make(std::max<uint32_t>(DataLen + 1, LWEProtocolHttp::ReceiveBufferSize), m_Pool.GetAllocator());
+		if (!m_ReceiveBuffer) {
+			std::cout << "Error allocating receive buffer." << std::endl;
+			return *this;
 		}
-		*Req = IReq;
-		Socket.SetProtocolData(m_hProtocolID, Req);
 	}
-	if (Req->m_Flag&LWEHttpRequest::ResponseReady) {
-		if (Req->m_Status == 0) {
-			if (!m_InRequests.Push(*Req, &Req)) {
-				std::cout << "Failed to insert into request." << std::endl;
-				return false;
-			}
-			Socket.SetProtocolData(m_hProtocolID, Req);
-		}
-		if (Req->m_Callback) Req->m_Callback(*Req, Req->m_Body);
-		if (Req->CloseConnection() && Req->m_Status != 0) {
-			Socket.MarkClosable();
-		}
+	char *Buffer = m_ReceiveBuffer->GetData();
+	memcpy(Buffer, Data, DataLen);
+	Buffer[DataLen] = '\0';
+	ProcessRead(Socket, Buffer, DataLen, m_ReceiveBuffer);
+	return *this;
+}
 
-	}
-	return true;
+bool LWEProtocolHttps::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source) {
+	return m_Connections.ReadRequests(Socket, m_hProtocolID, Buffer, Len, Source, m_Pool, [this](LWEHttpRequest *Request) { return m_InRequests.Push(Request); });
 }
 
 LWEProtocolHttps &LWEProtocolHttps::ProcessRequests(uint32_t ProtocolID, LWProtocolManager &Manager) {
 	char Buffer[1024 * 64];
-	LWEHttpRequest *Request;
-	while (m_OutRequests.Pop(&Request)) {
-		LWSocket Sock;
-		bool IsResponse = Request->m_Status != 0;
-		uint32_t Len = Request->Serialize(Buffer, sizeof(Buffer), IsResponse ? m_Agent : m_Server);
-		if (!Len) continue;
-		if (!Request->m_Socket) {
-			uint32_t Error = LWSocket::CreateSocket(Sock, LWText(Request->m_Host), Request->m_Port, (uint32_t)LWSocket::Tcp, LWEProtocolTLS::m_ProtocolID);
-			if (Error) {
-				std::cout << "Error connecting to: '" << Request->m_Host << ":" << Request->m_Port << "' " << Error << std::endl;
-				continue;
-			}
-			Request->m_Socket = Manager.PushSocket(Sock);
-			//std::cout << "Making socket: " << Request->m_Socket->GetSocketDescriptor() << std::endl;
-			Request->m_Socket->SetProtocolData(m_hProtocolID, Request);
-			if (!Request->m_Socket) {
-				std::cout << "Error inserting socket." << std::endl;
-				continue;
-			}
+	//Each buffer is encrypted and sent as it is written, a socket still in it's handshake takes nothing until it finishes.
+	auto TLSSend = [this](LWSocket &Socket, const LWSocketBuffer *Buffers, uint32_t BufferCount) {
+		for (uint32_t i = 0; i < BufferCount; i++) {
+			if (!Buffers[i].m_Length) continue;
+			uint32_t r = LWEProtocolTLS::Send(Socket, Buffers[i].m_Data, Buffers[i].m_Length);
+			if (r == -1 || (r == 0 && i)) return (uint32_t)LWEHttpConnectionPool::SendFailed;
+			if (r == 0) return (uint32_t)LWEHttpConnectionPool::SendPending;
 		}
-		uint32_t Res = LWEProtocolTLS::Send(*Request->m_Socket, Buffer, Len);
-		if (Res == -1) {
-			Request->m_Socket->MarkClosable();
-			continue;
-		} else if (Res == 0) {
-			LWEHttpRequest *NewRequest;
-			if (!m_OutRequests.Push(*Request, &NewRequest)) {
-				std::cout << "Failed to create new request." << std::endl;
-				continue;
-			}
-			//Allow a read operation to occur, so we'll break and come back later.
-			Request->m_Socket->SetProtocolData(m_hProtocolID, NewRequest);
-			return *this; //Connection is not ready, so we put it on the back of the list and wait until it is ready.
-		}
-		if (Request->CloseConnection()) Request->m_Socket->MarkClosable();
-	}
+		return (uint32_t)LWEHttpConnectionPool::SendOk;
+	};
+	m_Connections.CloseIdle(LWTimer::GetCurrent());
+	//Requests held back by the per host cap, a pending handshake, or retried after their connection closed go first, so they keep their order.
+	std::vector<LWEHttpRequest*> Waiting;
+	Waiting.swap(m_Waiting);
+	for (auto &&Request : Waiting) m_Connections.SendRequest(Request, m_Agent, m_Server, m_hProtocolID, LWEProtocolTLS::m_ProtocolID, Manager, m_Pool, m_Waiting, Buffer, sizeof(Buffer), TLSSend);
+	LWEHttpRequest *Request;
+	while (m_OutRequests.Pop(Request)) m_Connections.SendRequest(Request, m_Agent, m_Server, m_hProtocolID, LWEProtocolTLS::m_ProtocolID, Manager, m_Pool, m_Waiting, Buffer, sizeof(Buffer), TLSSend);
 	return *this;
 }
 
 bool LWEProtocolHttps::GetNextRequest(LWEHttpRequest &Request) {
-	return m_InRequests.Pop(Request);
+	LWEHttpRequest *Req = nullptr;
+	if (!m_InRequests.Pop(Req)) return false;
+	Request = *Req;
+	m_Pool.Release(Req);
+	return true;
+}
+
+bool LWEProtocolHttps::GetNextRequest(LWEHttpRequest **Request) {
+	return m_InRequests.Pop(*Request);
 }
 
 bool LWEProtocolHttps::GetNextFromPool(LWEHttpRequest **Request) {
-	LWEHttpRequest Req;
-	if (!m_Pool.Push(Req, Request)) return false;
-	return m_Pool.Pop(Req);
+	*Request = m_Pool.Acquire();
+	return *Request != nullptr;
+}
+
+LWEProtocolHttps &LWEProtocolHttps::ReleaseRequest(LWEHttpRequest *Request) {
+	m_Pool.Release(Request);
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEProtocolHttps::GetConnectionPool(void) {
+	return m_Connections;
 }
 
 bool LWEProtocolHttps::PushRequest(LWEHttpRequest &Request) {
-	LWEHttpRequest Req = Request;
-	return m_OutRequests.Push(Req);
+	LWEHttpRequest *Req = nullptr;
+	if (!GetNextFromPool(&Req)) return false;
+	*Req = Request;
+	return PushRequest(Req);
+}
+
+bool LWEProtocolHttps::PushRequest(LWEHttpRequest *Request) {
+	if (m_OutRequests.Push(Request)) return true;
+	m_Pool.Release(Request);
+	return false;
 }
 
 bool LWEProtocolHttps::PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t lStatus) {
-	LWEHttpRequest Request = InRequest;
-	Request.m_Status = lStatus;
-	Request.SetBody(Response);
-	return m_OutRequests.Push(Request);
+	return PushResponse(InRequest, Response, (uint32_t)strlen(Response), lStatus);
+}
+
+bool LWEProtocolHttps::PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t ResponseLen, uint32_t lStatus) {
+	LWEHttpRequest *Request = nullptr;
+	if (!GetNextFromPool(&Request)) return false;
+	*Request = InRequest;
+	Request->m_Allocator = &m_Pool.GetAllocator();
+	Request->m_Status = lStatus;
+	Request->m_Flag = (Request->m_Flag&~LWEHttpRequest::CONTENTENCODEBITS) | (ResponseLen >= LWEHttpRequest::MinCompressLength ? Request->GetAcceptedEncoding() : LWEHttpRequest::ContentEncodeIdentity);
+	Request->SetBody(Response, ResponseLen);
+	return PushRequest(Request);
 }
 
 LWEProtocolHttps &LWEProtocolHttps::SetAgentString(const char *Agent) {
@@ -132,7 +147,16 @@ LWEProtocolHttps &LWEProtocolHttps::SetServerString(const char *Server) {
 	return *this;
 }
 
-LWEProtocolHttps::LWEProtocolHttps(uint32_t HttpsProtocolID, uint32_t TLSProtocolID, LWProtocolManager *ProtoManager, LWAllocator &Allocator, const char *CertFile, const char *KeyFile) : LWEProtocolTLS(TLSProtocolID, Allocator, CertFile, KeyFile), m_hProtocolID(HttpsProtocolID), m_Manager(ProtoManager) {
+LWEProtocolHttps::LWEProtocolHttps(uint32_t HttpsProtocolID, uint32_t TLSProtocolID, LWProtocolManager *ProtoManager, LWAllocator &Allocator, const char *CertFile, const char *KeyFile) : LWEProtocolTLS(TLSProtocolID, Allocator, CertFile, KeyFile), m_Manager(ProtoManager), m_Pool(Allocator), m_Connections(Allocator), m_hProtocolID(HttpsProtocolID) {
 	m_Agent[0] = '\0';
 	m_Server[0] = '\0';
 }
+
+LWEProtocolHttps::~LWEProtocolHttps() {
+	LWEHttpRequest *Request = nullptr;
+	while (m_OutRequests.Pop(Request)) m_Pool.Release(Request);
+	while (m_InRequests.Pop(Request)) m_Pool.Release(Request);
+	for (auto &&R : m_Waiting) m_Pool.Release(R);
+	m_Connections.Clear(m_Pool);
+	if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
+}
@@ -2,6 +2,8 @@
 #include <LWNetwork/LWProtocolManager.h>
 #include <LWNetwork/LWSocket.h>
 #include <LWCore/LWText.h>
+#include <LWCore/LWTimer.h>
+#include <LWCore/LWAllocators/LWAllocator_Pool.h>
 #include <LWEJson.h>
 #include <cstring>
 #include <cstdarg>
@@ -9,6 +11,127 @@
 #include <iostream>
 #include <zlib.h>
 #include <functional>
+#include <string>
+#include <new>
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(LW_NOAVX)
+#define LWEHTTP_SSE2
+#include <emmintrin.h>
+#endif
+
+LWEHttpBuffer *LWEHttpBuffer::Make(uint32_t Capacity, LWAllocator &Allocator) {
+	char *Mem = Allocator.AllocateArray<char>(sizeof(LWEHttpBuffer) + Capacity);
+	if (!Mem) return nullptr;
+	LWEHttpBuffer *Buffer = new(Mem) LWEHttpBuffer();
+	Buffer->m_RefCount.store(1, std::memory_order_relaxed);
+	Buffer->m_Capacity = Capacity;
+	return Buffer;
+}
+
+LWEHttpBuffer *LWEHttpBuffer::AddRef(void) {
+	m_RefCount.fetch_add(1, std::memory_order_relaxed);
+	return this;
+}
+
+void LWEHttpBuffer::Release(void) {
+	if (m_RefCount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+	this->~LWEHttpBuffer();
+	LWAllocator::Destroy((char*)this);
+	return;
+}
+
+bool LWEHttpBuffer::isShared(void) const {
+	return m_RefCount.load(std::memory_order_acquire) > 1;
+}
+
+char *LWEHttpBuffer::GetData(void) {
+	return (char*)(this + 1);
+}
+
+bool LWEHttpBody::Set(const char *Data, uint32_t Len, LWAllocator &Allocator) {
+	LWEHttpBuffer *Buffer = LWEHttpBuffer::Make(Len + 1, Allocator);
+	if (!Buffer) return false;
+	memcpy(Buffer->GetData(), Data, Len);
+	Buffer->GetData()[Len] = '\0';
+	Slice(Buffer, 0, Len);
+	Buffer->Release();
+	return true;
+}
+
+LWEHttpBody &LWEHttpBody::Slice(LWEHttpBuffer *Buffer, uint32_t Offset, uint32_t Len) {
+	Buffer->AddRef();
+	Clear();
+	m_Buffer = Buffer;
+	m_Offset = Offset;
+	m_Length = Len;
+	return *this;
+}
+
+bool LWEHttpBody::Append(const char *Data, uint32_t Len, LWAllocator &Allocator, uint32_t MaxLength) {
+	uint64_t NewLength = (uint64_t)m_Length + Len;
+	if (NewLength > MaxLength) return false;
+	if (!m_Buffer || m_Buffer->isShared() || m_Offset + NewLength + 1 > m_Buffer->m_Capacity) {
+		uint64_t Capacity = (m_Buffer && !m_Buffer->isShared()) ? (uint64_t)m_Buffer->m_Capacity * 2 : 256;
+		Capacity = std::min<uint64_t>(std::max<uint64_t>(Capacity, NewLength + 1), (uint64_t)MaxLength + 1);
+		LWEHttpBuffer *Buffer = LWEHttpBuffer::Make((uint32_t)Capacity, Allocator);
+		if (!Buffer) return false;
+		memcpy(Buffer->GetData(), GetData(), m_Length);
+		uint32_t Length = m_Length;
+		Clear();
+		m_Buffer = Buffer;
+		m_Length = Length;
+	}
+	char *Dst = m_Buffer->GetData() + m_Offset;
+	memcpy(Dst + m_Length, Data, Len);
+	m_Length = (uint32_t)NewLength;
+	Dst[m_Length] = '\0';
+	return true;
+}
+
+LWEHttpBody &LWEHttpBody::Clear(void) {
+	if (m_Buffer) m_Buffer->Release();
+	m_Buffer = nullptr;
+	m_Offset = m_Length = 0;
+	return *this;
+}
+
+const char *LWEHttpBody::GetData(void) const {
+	if (!m_Buffer) return "";
+	return m_Buffer->GetData() + m_Offset;
+}
+
+uint32_t LWEHttpBody::GetLength(void) const {
+	return m_Length;
+}
+
+LWEHttpBody &LWEHttpBody::operator = (const LWEHttpBody &O) {
+	if (O.m_Buffer) Slice(O.m_Buffer, O.m_Offset, O.m_Length);
+	else Clear();
+	return *this;
+}
+
+LWEHttpBody &LWEHttpBody::operator = (LWEHttpBody &&O) {
+	if (this == &O) return *this;
+	Clear();
+	m_Buffer = O.m_Buffer;
+	m_Offset = O.m_Offset;
+	m_Length = O.m_Length;
+	O.m_Buffer = nullptr;
+	O.m_Offset = O.m_Length = 0;
+	return *this;
+}
+
+LWEHttpBody::LWEHttpBody(const LWEHttpBody &O) : m_Buffer(O.m_Buffer), m_Offset(O.m_Offset), m_Length(O.m_Length) {
+	if (m_Buffer) m_Buffer->AddRef();
+}
+
+LWEHttpBody::LWEHttpBody(LWEHttpBody &&O) : m_Buffer(O.m_Buffer), m_Offset(O.m_Offset), m_Length(O.m_Length) {
+	O.m_Buffer = nullptr;
+	O.m_Offset = O.m_Length = 0;
+}
+
+LWEHttpBody::~LWEHttpBody() {
+	Clear();
+}
 
 uint32_t LWEHttpRequest::Escape(const char *In, char *Buffer, uint32_t BufferLen) {
 	char ValidChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.-_~";
@@ -102,11 +225,54 @@ uint32_t LWEHttpRequest::MakeJSONQueryString(LWEJson &Json, char *Buffer, uint32
 }
 
 uint32_t LWEHttpRequest::Serialize(char *Buffer, uint32_t BufferLen, const char *UserAgent) {
+	uint32_t o = SerializeHeaders(Buffer, BufferLen, UserAgent);
+	auto Write = [&o, Buffer, BufferLen](const char *Data, uint32_t Len) {
+		if (o < BufferLen) memcpy(Buffer + o, Data, std::min<uint32_t>(Len, BufferLen - o));
+		o += Len;
+	};
+	if (m_Body.GetLength()) {
+		if (m_Flag&EncodeChunked) {
+			char Size[16];
+			Write(Size, (uint32_t)snprintf(Size, sizeof(Size), "%x\r\n", m_Body.GetLength()));
+		}
+		Write(m_Body.GetData(), m_Body.GetLength());
+		if (m_Flag&EncodeChunked) Write("\r\n", 2);
+	}
+	if (m_Flag&EncodeChunked) Write("0\r\n\r\n", 5);
+	if (o < BufferLen) Buffer[o] = '\0';
+	return o;
+}
+
+bool LWEHttpRequest::SerializeBody(LWEHttpZStream *Deflater, char *Buffer, uint32_t BufferLen, const std::function<bool(const char*, uint32_t)> &Send) {
+	uint32_t Len = m_Body.GetLength();
+	if (!CompressedBody()) {
+		if (!(m_Flag&EncodeChunked)) return !Len || Send(m_Body.GetData(), Len);
+		if (Len) {
+			uint32_t n = (uint32_t)snprintf(Buffer, BufferLen, "%x\r\n", Len);
+			if (!Send(Buffer, n) || !Send(m_Body.GetData(), Len) || !Send("\r\n", 2)) return false;
+		}
+		return Send("0\r\n\r\n", 5);
+	}
+	if (!Deflater || !Deflater->Begin((m_Flag&CONTENTENCODEBITS) == ContentEncodeGZip)) return false;
+	auto Frame = [Buffer, BufferLen, &Send](const char *Data, uint32_t DataLen) -> bool {
+		uint32_t o = (uint32_t)snprintf(Buffer, BufferLen, "%x\r\n", DataLen);
+		if (o + DataLen + 2 > BufferLen) return Send(Buffer, o) && Send(Data, DataLen) && Send("\r\n", 2);
+		memcpy(Buffer + o, Data, DataLen);
+		o += DataLen;
+		Buffer[o++] = '\r';
+		Buffer[o++] = '\n';
+		return Send(Buffer, o);
+	};
+	if (!Deflater->Write(m_Body.GetData(), Len, true, Frame)) return false;
+	return Send("0\r\n\r\n", 5);
+}
+
+uint32_t LWEHttpRequest::SerializeHeaders(char *Buffer, uint32_t BufferLen, const char *UserAgent) {
 	//std::cout << "Serializing!" << std::endl;
 	char Methods[][32] = { "GET", "POST" };
 	char Caches[][32] = { "no-cache" };
 	char Connections[][32] = { "close", "keep-alive",  "upgrade", "Keep-alive, upgrade" };
-	char Encodings[][32] = { "", "chunk" };
+	char Encodings[][32] = { "", "chunked" };
 	char ContentEncodings[][32] = { "identity", "gzip", "compress", "deflate", "br" };
 	char Upgrades[][32] = { "", "websocket" };
 	uint32_t o = 0;
@@ -138,7 +304,11 @@ uint32_t LWEHttpRequest::Serialize(char *Buffer, uint32_t BufferLen, const char
 		else o += snprintf(Buffer + o, BufferLen - o, "Accept: %s\r\n", m_ContentType);
 	}
 	if (*m_Authorization) o += snprintf(Buffer + o, BufferLen - o, "Authorization: %s\r\n", m_Authorization);
-	if (m_ContentLength) o += snprintf(Buffer + o, BufferLen - o, "Content-Length: %d\r\n", m_ContentLength);
+	if ((m_Flag&ACCEPTENCODEBITS) && !IsResponse) {
+		if ((m_Flag&ACCEPTENCODEBITS) == ACCEPTENCODEBITS) o += snprintf(Buffer + o, BufferLen - o, "Accept-Encoding: gzip, deflate\r\n");
+		else o += snprintf(Buffer + o, BufferLen - o, "Accept-Encoding: %s\r\n", (m_Flag&AcceptGZip) ? "gzip" : "deflate");
+	}
+	if (m_ContentLength && !(m_Flag&EncodeChunked)) o += snprintf(Buffer + o, BufferLen - o, "Content-Length: %d\r\n", m_ContentLength);
 	if (UserAgent && *UserAgent) {
 		if (IsResponse) o += snprintf(Buffer + o, BufferLen - o, "Server: %s\r\n", UserAgent);
 		else o += snprintf(Buffer + o, BufferLen - o, "User-Agent: %s\r\n", UserAgent);
@@ -146,7 +316,7 @@ uint32_t LWEHttpRequest::Serialize(char *Buffer, uint32_t BufferLen, const char
 	if (*m_SecWebSockKey) {
 		if (IsResponse) o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Accept: %s\r\n", m_SecWebSockKey);
 		else o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Key: %s\r\n", m_SecWebSockKey);
-		o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Extensions: \r\n");
+		if (*m_SecWebSockExt) o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Extensions: %s\r\n", m_SecWebSockExt);
 	}
 	if (*m_SecWebSockProto) o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Protocol: %s\r\n", m_SecWebSockProto);
 	if (m_WebSockVersion && !IsResponse) o += snprintf(Buffer + o, BufferLen - o, "Sec-WebSocket-Version: %d\r\n", m_WebSockVersion);
@@ -159,15 +329,6 @@ uint32_t LWEHttpRequest::Serialize(char *Buffer, uint32_t BufferLen, const char
 	}
 
 	o += snprintf(Buffer + o, BufferLen - o, "\r\n");
-	if (*m_Body) {
-		if (m_Flag&EncodeChunked) {
-			if (!m_ContentLength) m_ContentLength = (uint32_t)strlen(m_Body);
-			o += snprintf(Buffer + o, BufferLen - o, "%x\r\n%s\r\n", m_ContentLength, m_Body);
-		}
-		else {
-			o += snprintf(Buffer + o, BufferLen - o, "%s", m_Body);
-		}
-	}
 	return o;
 }
 
@@ -179,29 +340,156 @@ uint32_t LWEHttpRequest::GZipDecompress(const char *In, uint32_t InLen, char *Bu
 	Stream.total_in = 0;
 	Stream.zalloc = Z_NULL;
 	Stream.zfree = Z_NULL;
+	Stream.opaque = Z_NULL;
 	if (inflateInit2(&Stream, 31) != Z_OK) {
 		std::cout << "Failed to start inflate." << std::endl;
 		return 0;
 	}
-	uint32_t o = 0;
-	bool Finished = false;
-	while (!Finished) {
-		if (o >= BufferLen) {
-			return o;
+	Stream.next_out = (Bytef*)Buffer;
+	Stream.avail_out = BufferLen;
+	int32_t r = inflate(&Stream, Z_FINISH);
+	if (r == Z_BUF_ERROR) std::cout << "Compressed data was truncated or did not fit." << std::endl;
+	else if (r != Z_STREAM_END && Stream.msg) std::cout << "error: " << Stream.msg << std::endl;
+	inflateEnd(&Stream);
+	return r == Z_STREAM_END ? (uint32_t)Stream.total_out : 0;
+}
+
+bool LWEHttpRequest::GZipDecompress(const char *In, uint32_t InLen, LWEHttpBody &Body, LWAllocator &Allocator) {
+	char Buffer[1024 * 16];
+	z_stream Stream;
+	Stream.next_in = (Bytef*)In;
+	Stream.avail_in = InLen;
+	Stream.total_out = 0;
+	Stream.total_in = 0;
+	Stream.zalloc = Z_NULL;
+	Stream.zfree = Z_NULL;
+	Stream.opaque = Z_NULL;
+	Body.Clear();
+	if (!InLen) return true;
+	if (inflateInit2(&Stream, 47) != Z_OK) {
+		std::cout << "Failed to start inflate." << std::endl;
+		return false;
+	}
+	int32_t r = Z_OK;
+	while (r == Z_OK) {
+		Stream.next_out = (Bytef*)Buffer;
+		Stream.avail_out = sizeof(Buffer);
+		r = inflate(&Stream, Z_NO_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END) break;
+		if (!Body.Append(Buffer, sizeof(Buffer) - Stream.avail_out, Allocator, MaxBodyLength)) {
+			r = Z_MEM_ERROR;
+			break;
 		}
-		Stream.next_out = (Bytef*)Buffer + o;
-		Stream.avail_out = BufferLen - o;
-		int32_t r = inflate(&Stream, Z_SYNC_FLUSH);
-		if (r == Z_OK || r == Z_STREAM_END) o = (uint32_t)Stream.total_out;
-		if (r != Z_OK) {
-			if (Stream.msg) std::cout << "error: " << Stream.msg << std::endl;
-			Finished = true;
+	}
+	if (r == Z_BUF_ERROR) std::cout << "Compressed body was truncated." << std::endl;
+	else if (r != Z_STREAM_END && Stream.msg) std::cout << "error: " << Stream.msg << std::endl;
+	inflateEnd(&Stream);
+	return r == Z_STREAM_END;
+}
+
+bool LWEHttpZStream::Begin(bool GZip) {
+	//47 lets inflate accept both gzip and zlib wrappers.
+	return Start(m_Mode == Inflate ? 47 : (GZip ? 31 : 15));
+}
+
+bool LWEHttpZStream::BeginRaw(uint32_t WindowBits) {
+	return Start(-(int32_t)WindowBits);
+}
+
+bool LWEHttpZStream::Start(int32_t WindowBits) {
+	z_stream *Stream = (z_stream*)m_Stream;
+	m_Ended = false;
+	if (Stream && WindowBits == m_WindowBits) return (m_Mode == Inflate ? inflateReset(Stream) : deflateReset(Stream)) == Z_OK;
+	if (Stream) {
+		if (m_Mode == Inflate) inflateEnd(Stream);
+		else deflateEnd(Stream);
+	} else m_Stream = Stream = m_Allocator.Allocate<z_stream>();
+	if (!Stream) return false;
+	*Stream = z_stream();
+	m_WindowBits = WindowBits;
+	int32_t r = m_Mode == Inflate ? inflateInit2(Stream, WindowBits) : deflateInit2(Stream, CompressLevel, Z_DEFLATED, WindowBits, 8, Z_DEFAULT_STRATEGY);
+	if (r == Z_OK) return true;
+	std::cout << "Failed to start zlib stream." << std::endl;
+	LWAllocator::Destroy(Stream);
+	m_Stream = nullptr;
+	m_WindowBits = 0;
+	return false;
+}
+
+bool LWEHttpZStream::Write(const char *In, uint32_t Len, bool Finish, const std::function<bool(const char*, uint32_t)> &Out) {
+	char Buffer[OutputSize];
+	z_stream *Stream = (z_stream*)m_Stream;
+	if (!Stream) return false;
+	Stream->next_in = (Bytef*)In;
+	Stream->avail_in = Len;
+	if (m_Mode == Inflate) {
+		//Anything after the end of the stream is ignored.
+		while ((Stream->avail_in || !Stream->avail_out) && !m_Ended) {
+			Stream->next_out = (Bytef*)Buffer;
+			Stream->avail_out = sizeof(Buffer);
+			int32_t r = inflate(Stream, Z_NO_FLUSH);
+			//Out of input for now, whoever ends the body checks isEnded for truncation.
+			if (r == Z_BUF_ERROR) break;
+			if (r != Z_OK && r != Z_STREAM_END) {
+				if (Stream->msg) std::cout << "error: " << Stream->msg << std::endl;
+				return false;
+			}
+			m_Ended = r == Z_STREAM_END;
+			uint32_t n = sizeof(Buffer) - Stream->avail_out;
+			if (n && !Out(Buffer, n)) return false;
 		}
+		return true;
 	}
-	if (inflateEnd(&Stream) != Z_OK) {
-		std::cout << "Failed finish inflating." << std::endl;
+	int32_t Flush = Finish ? Z_FINISH : Z_NO_FLUSH;
+	for (;;) {
+		Stream->next_out = (Bytef*)Buffer;
+		Stream->avail_out = sizeof(Buffer);
+		int32_t r = deflate(Stream, Flush);
+		if (r == Z_STREAM_ERROR) return false;
+		uint32_t n = sizeof(Buffer) - Stream->avail_out;
+		if (n && !Out(Buffer, n)) return false;
+		if (r == Z_STREAM_END || (!Finish && !Stream->avail_in && Stream->avail_out)) break;
 	}
-	return o;
+	return true;
+}
+
+bool LWEHttpZStream::Flush(const std::function<bool(const char*, uint32_t)> &Out) {
+	char Buffer[OutputSize];
+	z_stream *Stream = (z_stream*)m_Stream;
+	if (!Stream || m_Mode != Deflate) return false;
+	Stream->next_in = nullptr;
+	Stream->avail_in = 0;
+	do {
+		Stream->next_out = (Bytef*)Buffer;
+		Stream->avail_out = sizeof(Buffer);
+		if (deflate(Stream, Z_SYNC_FLUSH) == Z_STREAM_ERROR) return false;
+		uint32_t n = sizeof(Buffer) - Stream->avail_out;
+		if (n && !Out(Buffer, n)) return false;
+	} while (!Stream->avail_out);
+	return true;
+}
+
+bool LWEHttpZStream::isEnded(void) const {
+	return m_Ended;
+}
+
+bool LWEHttpZStream::isEmpty(void) const {
+	return !m_Stream || !((z_stream*)m_Stream)->total_in;
+}
+
+LWEHttpZStream::LWEHttpZStream(uint32_t Mode, LWAllocator &Allocator) : m_Allocator(Allocator), m_Mode(Mode) {}
+
+LWEHttpZStream::~LWEHttpZStream() {
+	z_stream *Stream = (z_stream*)m_Stream;
+	if (!Stream) return;
+	if (m_Mode == Inflate) inflateEnd(Stream);
+	else deflateEnd(Stream);
+	LWAllocator::Destroy(Stream);
+}
+
+LWAllocator &LWEHttpRequest::GetDefaultAllocator(void) {
+	static LWAllocator_Pool Allocator;
+	return Allocator;
 }
 
 uint16_t LWEHttpRequest::ParseURI(const char *URI, char *HostBuffer, uint32_t HostBufferSize, uint32_t *HostBufferLen, char *PathBuffer, uint32_t PathBufferSize, uint32_t *PathBufferLen, char *ProtocolBuffer, uint32_t ProtocolBufferSize, uint32_t *ProtocolBufferLen) {
@@ -302,131 +590,323 @@ uint16_t LWEHttpRequest::ParseURI(const char *URI, char *HostBuffer, uint32_t Ho
 	return PortNbr;
 }
 
-bool LWEHttpRequest::Deserialize(const char *Buffer, uint32_t Len) {
-	char Methods[][32] = { "GET", "POST" };
-	char NameBuffer[1024];
-	char ResultBuffer[1024];
-	const uint32_t MethodCnt = 2;
+//Returns the offset of the first c in Buffer, or Len if there is none.
+inline uint32_t LWEHttpFindByte(const char *Buffer, uint32_t Len, char c) {
+#ifdef LWEHTTP_SSE2
+	uint32_t i = 0;
+	__m128i Target = _mm_set1_epi8(c);
+	for (; i + 16 <= Len; i += 16) {
+		uint32_t Mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(Buffer + i)), Target));
+		if (!Mask) continue;
+#ifdef _MSC_VER
+		unsigned long Index;
+		_BitScanForward(&Index, Mask);
+		return i + (uint32_t)Index;
+#else
+		return i + (uint32_t)__builtin_ctz(Mask);
+#endif
+	}
+	for (; i < Len; i++) {
+		if (Buffer[i] == c) return i;
+	}
+	return Len;
+#else
+	const char *Res = (const char*)memchr(Buffer, c, Len);
+	return Res ? (uint32_t)(Res - Buffer) : Len;
+#endif
+}
+
+//Trims leading and trailing spaces/tabs from the range.
+inline void LWEHttpTrim(const char *&Text, uint32_t &Len) {
+	while (Len && (*Text == ' ' || *Text == '\t')) {
+		Text++;
+		Len--;
+	}
+	while (Len && (Text[Len - 1] == ' ' || Text[Len - 1] == '\t')) Len--;
+}
+
+inline bool LWEHttpEquals(const char *Text, uint32_t Len, const char *Name, uint32_t NameLen) {
+	return Len == NameLen && !_strnicmp(Text, Name, NameLen);
+}
+
+inline void LWEHttpCopy(char *Dst, uint32_t DstLen, const char *Src, uint32_t SrcLen) {
+	SrcLen = std::min<uint32_t>(SrcLen, DstLen - 1);
+	memcpy(Dst, Src, SrcLen);
+	Dst[SrcLen] = '\0';
+}
+
+//Calls Func for each trimmed, non-empty token of a comma separated header value.
+template<class Func>
+inline void LWEHttpTokens(const char *Value, uint32_t Len, Func &&F) {
+	while (Len) {
+		uint32_t n = LWEHttpFindByte(Value, Len, ',');
+		const char *Token = Value;
+		uint32_t TokenLen = n;
+		LWEHttpTrim(Token, TokenLen);
+		if (TokenLen) F(Token, TokenLen);
+		if (n == Len) break;
+		Value += n + 1;
+		Len -= n + 1;
+	}
+}
 
+uint32_t LWEHttpRequest::Parse(const char *Buffer, uint32_t Len, LWEHttpBuffer *Source) {
 	uint32_t o = 0;
-	uint32_t k = 0;
-	uint32_t i = 0;
-	bool IsResponse = true;
-	if (m_Flag&HeadersRead) {
-		if ((m_Flag&ENCODEBITS) == EncodeChunked) {
-			if (!m_ChunkLength) {
-				sscanf(Buffer + o, "%1023s\r\n%n", NameBuffer, &k);
-				if (k == 0) return false;
-				sscanf(NameBuffer, "%x", &m_ChunkLength);
-				o += k;
-				if (!m_ChunkLength) {
-					m_Flag |= ResponseReady;
-					return true;
-				}
-				return Deserialize(Buffer + o, Len - o);
-			}
-			else {
-				uint32_t Remain = std::min<uint32_t>(sizeof(m_Body) - m_ContentLength, std::min<uint32_t>(Len, m_ChunkLength));
-				memcpy(m_Body + m_ContentLength, Buffer, Remain);
-				m_ContentLength += Remain;
-				m_ChunkLength -= Remain;
-				o += Remain;
-				if (!m_ChunkLength) o += 2;
-				if (m_ContentLength == sizeof(m_Body)) m_ContentLength--;
-				m_Body[m_ContentLength] = '\0';
-				return o != Len ? Deserialize(Buffer + o, Len - o) : true;
-			}
-		}
-		else {
-			uint32_t Remain = std::min<uint32_t>((sizeof(m_Body)) - m_ChunkLength, Len);
+	if (m_ParseState == ParseDone) m_ParseState = ParseStartLine;
+	while (o < Len && m_ParseState != ParseDone) {
+		if (m_ParseState == ParseBody || m_ParseState == ParseBodyRemaining) {
+			uint32_t Remain = Len - o;
 			uint32_t ContentEncodeBits = (m_Flag&CONTENTENCODEBITS);
-			memcpy(m_Body + m_ChunkLength, Buffer, Remain);
+			if (m_ParseState == ParseBody) Remain = std::min<uint32_t>(Remain, m_ContentLength - m_ChunkLength);
+			if (Source && !ContentEncodeBits && !m_BodyCallback && !m_ChunkLength && Remain == m_ContentLength && o + Remain == Len && Remain >= SliceBodyLength) m_Body.Slice(Source, (uint32_t)(Buffer + o - Source->GetData()), Remain);
+			else if (!ReceiveBody(Buffer + o, Remain)) return ParseError;
 			m_ChunkLength += Remain;
-			if (!ContentEncodeBits) {
-				if (m_ChunkLength == sizeof(m_Body)) m_ChunkLength--;
-				m_Body[m_ChunkLength] = '\0';
-			}
-			if (m_ChunkLength >= m_ContentLength || m_ChunkLength >= sizeof(m_Body) - 1) {
-				if (ContentEncodeBits == ContentEncodeGZip) {
-					m_ContentLength = GZipDecompress(m_Body, m_ContentLength, m_Body, sizeof(m_Body));
-					m_Body[m_ContentLength] = 0;
-				}
-				m_Flag |= ResponseReady;
+			o += Remain;
+			//A body without a length runs until the connection closes, where SocketClosed finishes it.
+			if (m_ParseState == ParseBody && m_ChunkLength >= m_ContentLength) {
+				if (!FinishMessage()) return ParseError;
 			}
+			continue;
+		} else if (m_ParseState == ParseChunkData) {
+			uint32_t Remain = std::min<uint32_t>(Len - o, m_ChunkLength);
+			if (!ReceiveBody(Buffer + o, Remain)) return ParseError;
+			m_ContentLength += Remain;
+			m_ChunkLength -= Remain;
+			o += Remain;
+			if (!m_ChunkLength) m_ParseState = ParseChunkEnd;
+			continue;
 		}
-		return true;
+		const char *Line = Buffer + o;
+		uint32_t n = LWEHttpFindByte(Line, Len - o, '\n');
+		if (m_LineLength + n > MaxLineLength) {
+			std::cout << "HTTP line exceeds " << MaxLineLength << " bytes." << std::endl;
+			return ParseError;
+		}
+		if (o + n == Len) {
+			//Line continues in the next receive.
+			memcpy(m_LineBuffer + m_LineLength, Line, n);
+			m_LineLength += n;
+			return Len;
+		}
+		o += n + 1;
+		if (m_LineLength) {
+			memcpy(m_LineBuffer + m_LineLength, Line, n);
+			Line = m_LineBuffer;
+			n += m_LineLength;
+			m_LineLength = 0;
+		}
+		if (n && Line[n - 1] == '\r') n--;
+		if (!ParseLine(Line, n)) return ParseError;
 	}
+	return o;
+}
 
-	sscanf(Buffer + o, "HTTP/1.1 %d %127[^\r]\n%n", &m_Status, m_Path, &k);
-	if (k == 0) {
-		sscanf(Buffer + o, "%255s %127s HTTP/1.1\r\n%n", NameBuffer, m_Path, &k);
-		if (k == 0) return false;
-		IsResponse = false;
-	}
-	o += k;
-	if (!IsResponse) {
-		for (i = 0; i < MethodCnt; i++) {
-			if (!strcmp(NameBuffer, Methods[i])) {
-				m_Flag |= i;
-				break;
-			}
+bool LWEHttpRequest::ParseLine(const char *Line, uint32_t Len) {
+	const char *Methods[] = { "GET", "POST" };
+	const uint32_t MethodCnt = 2;
+	if (m_ParseState == ParseHeaders) {
+		if (Len) return ParseHeader(Line, Len);
+		m_Flag |= HeadersRead;
+		m_Body.Clear();
+		m_ChunkLength = 0;
+		bool IsResponse = m_Status != 0;
+		uint32_t ContentEncodeBits = m_Flag&CONTENTENCODEBITS;
+		if (m_Inflater && (ContentEncodeBits == ContentEncodeGZip || ContentEncodeBits == ContentEncodeDeflate)) {
+			if (!m_Inflater->Begin(false)) return false;
+			m_Flag |= StreamDecode;
 		}
-		if (i == MethodCnt) {
-			std::cout << "Unknown method: '" << NameBuffer << "'" << std::endl;
-			return false;
+		if ((m_Flag&ENCODEBITS) == EncodeChunked) {
+			m_ContentLength = 0;
+			m_ParseState = ParseChunkSize;
+			return true;
+		}
+		if (m_ContentLength > MaxBodyLength) return false;
+		if (m_ContentLength) m_ParseState = ParseBody;
+		else if (IsResponse && !(m_Flag&ContentLengthRead) && m_Status >= 200 && m_Status != 204 && m_Status != 304) m_ParseState = ParseBodyRemaining;
+		else return FinishMessage();
+		return true;
+	} else if (m_ParseState == ParseChunkSize) {
+		uint32_t Size = 0;
+		uint32_t i = 0;
+		for (; i < Len; i++) {
+			char c = Line[i];
+			uint32_t v = 0;
+			if (c >= '0' && c <= '9') v = c - '0';
+			else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+			else break;
+			if (Size > 0x0FFFFFFF) return false;
+			Size = (Size << 4) | v;
+		}
+		if (!i || (i < Len && Line[i] != ';' && Line[i] != ' ' && Line[i] != '\t')) return false;
+		if (!Size) {
+			m_ParseState = ParseTrailers;
+			return true;
 		}
+		if ((uint64_t)m_ContentLength + Size > MaxBodyLength) return false;
+		m_ChunkLength = Size;
+		m_ParseState = ParseChunkData;
+		return true;
+	} else if (m_ParseState == ParseChunkEnd) {
+		if (Len) return false;
+		m_ParseState = ParseChunkSize;
+		return true;
+	} else if (m_ParseState == ParseTrailers) {
+		if (!Len) return FinishMessage();
+		return true;
 	}
-	*m_Host = *m_ContentType = *m_Authorization = *m_Path = *m_TransferEncoding = *m_Origin = *m_SecWebSockKey = *m_SecWebSockProto = '\0';
+	//Start line, blank lines between pipelined messages are skipped.
+	if (!Len) return true;
+	bool IsResponse = Len > 5 && !strncmp(Line, "HTTP/", 5);
+	m_Flag &= ~(HeadersRead | ResponseReady | ContentLengthRead | CONNECTIONBITS | ENCODEBITS | CONTENTENCODEBITS | UPGRADEBITS | ACCEPTENCODEBITS | StreamDecode);
 	m_Flag |= ConnectionKeepAlive;
-	while (Buffer[o] && o < Len) {
-		if (Buffer[o] == '\r' || Buffer[o] == '\n') {
-			if ((m_Flag&EncodeChunked) != 0) m_ContentLength = 0;
-			m_Flag |= HeadersRead;
-			m_Body[0] = '\0';
-			return Deserialize(Buffer + o + 2, Len - (o + 2));
+	m_ContentLength = m_ChunkLength = 0;
+	m_WebSockVersion = 0;
+	*m_ContentType = *m_TransferEncoding = *m_SecWebSockKey = *m_SecWebSockProto = *m_SecWebSockExt = '\0';
+	m_Body.Clear();
+	if (IsResponse) {
+		uint32_t n = LWEHttpFindByte(Line, Len, ' ');
+		if (n + 4 > Len) return false;
+		const char *Code = Line + n + 1;
+		if (Code[0] < '1' || Code[0] > '5' || Code[1] < '0' || Code[1] > '9' || Code[2] < '0' || Code[2] > '9') return false;
+		m_Status = (uint32_t)(Code[0] - '0') * 100 + (uint32_t)(Code[1] - '0') * 10 + (uint32_t)(Code[2] - '0');
+		m_ParseState = ParseHeaders;
+		return true;
+	}
+	*m_Host = *m_Authorization = *m_Path = *m_Origin = '\0';
+	m_Status = 0;
+	uint32_t n = LWEHttpFindByte(Line, Len, ' ');
+	uint32_t i = 0;
+	for (; i < MethodCnt; i++) {
+		if (LWEHttpEquals(Line, n, Methods[i], (uint32_t)strlen(Methods[i]))) break;
+	}
+	if (i == MethodCnt) {
+		std::cout << "Unknown method: '" << std::string(Line, n) << "'" << std::endl;
+		return false;
+	}
+	m_Flag = (m_Flag&~METHODBITS) | i;
+	if (n == Len) return false;
+	const char *Target = Line + n + 1;
+	uint32_t TargetLen = LWEHttpFindByte(Target, Len - n - 1, ' ');
+	if (!TargetLen || n + 1 + TargetLen == Len) return false;
+	LWEHttpCopy(m_Path, sizeof(m_Path), Target, TargetLen);
+	m_ParseState = ParseHeaders;
+	return true;
+}
+
+bool LWEHttpRequest::ParseHeader(const char *Line, uint32_t Len) {
+	uint32_t n = LWEHttpFindByte(Line, Len, ':');
+	if (n == Len) return false;
+	const char *Name = Line;
+	const char *Value = Line + n + 1;
+	uint32_t NameLen = n;
+	uint32_t ValueLen = Len - n - 1;
+	LWEHttpTrim(Name, NameLen);
+	LWEHttpTrim(Value, ValueLen);
+	auto Is = [Name, NameLen](const char *Header) -> bool { return LWEHttpEquals(Name, NameLen, Header, (uint32_t)strlen(Header)); };
+	auto IsValue = [](const char *Text, uint32_t TextLen, const char *Token) -> bool { return LWEHttpEquals(Text, TextLen, Token, (uint32_t)strlen(Token)); };
+	if (Is("Host")) LWEHttpCopy(m_Host, sizeof(m_Host), Value, ValueLen);
+	else if (Is("Content-Type")) LWEHttpCopy(m_ContentType, sizeof(m_ContentType), Value, ValueLen);
+	else if (Is("Accept")) {
+		if (!*m_ContentType) LWEHttpCopy(m_ContentType, sizeof(m_ContentType), Value, ValueLen);
+	} else if (Is("Authorization")) LWEHttpCopy(m_Authorization, sizeof(m_Authorization), Value, ValueLen);
+	else if (Is("Content-Length")) {
+		uint64_t Length = 0;
+		if (!ValueLen) return false;
+		for (uint32_t i = 0; i < ValueLen; i++) {
+			if (Value[i] < '0' || Value[i] > '9') return false;
+			Length = Length * 10 + (uint32_t)(Value[i] - '0');
+			if (Length > MaxBodyLength) return false;
 		}
-		k = 0;
-		sscanf(Buffer + o, "%1023[^:]: %1023[^\r]%n", NameBuffer, ResultBuffer, &k);
-		if (k == 0) return false;
-		o += k + 2;
-		if (!_stricmp(NameBuffer, "Host")) strncat(m_Host, ResultBuffer, sizeof(m_Host));
-		else if (!_stricmp(NameBuffer, "Content-Type")) strncat(m_ContentType, ResultBuffer, sizeof(m_ContentType));
-		else if (!_stricmp(NameBuffer, "Accept")) strncat(m_ContentType, ResultBuffer, sizeof(m_ContentType));
-		else if (!_stricmp(NameBuffer, "Authorization")) strncat(m_Authorization, ResultBuffer, sizeof(m_Authorization));
-		else if (!_stricmp(NameBuffer, "Content-Length")) m_ContentLength = atoi(ResultBuffer);
-		else if (!_stricmp(NameBuffer, "Accept-Encoding")) {}
-		else if (!_stricmp(NameBuffer, "Origin")) strncat(m_Origin, ResultBuffer, sizeof(m_Origin));
-		else if (!_stricmp(NameBuffer, "Sec-WebSocket-Key")) strncat(m_SecWebSockKey, ResultBuffer, sizeof(m_SecWebSockKey));
-		else if (!_stricmp(NameBuffer, "Sec-WebSocket-Accept")) strncat(m_SecWebSockKey, ResultBuffer, sizeof(m_SecWebSockKey));
-		else if (!_stricmp(NameBuffer, "Sec-WebSocket-Protocol")) strncat(m_SecWebSockProto, ResultBuffer, sizeof(m_SecWebSockProto));
-		else if (!_stricmp(NameBuffer, "Sec-WebSocket-Version")) m_WebSockVersion = atoi(ResultBuffer);
-		else if (!_stricmp(NameBuffer, "Cache-Control")) {
-			if (!_stricmp(ResultBuffer, "no-cache")) m_Flag |= NoCacheControl;
-		}else if (!_stricmp(NameBuffer, "Connection")) {
-			for (const char *C = ResultBuffer; C; C = LWText::FirstToken(C, ',')) {
-				C = LWText::NextWord(C == ResultBuffer ? C : (C + 1), true);
-				if (!_strnicmp(C, "close", 5)) m_Flag &= ~CONNECTIONBITS;
-				else if (!_strnicmp(C, "keep-alive", 10)) m_Flag |= ConnectionKeepAlive;
-				else if (!_strnicmp(C, "upgrade", 7)) m_Flag |= ConnectionUpgrade;
+		m_ContentLength = (uint32_t)Length;
+		m_Flag |= ContentLengthRead;
+	} else if (Is("Origin")) LWEHttpCopy(m_Origin, sizeof(m_Origin), Value, ValueLen);
+	else if (Is("Sec-WebSocket-Key") || Is("Sec-WebSocket-Accept")) LWEHttpCopy(m_SecWebSockKey, sizeof(m_SecWebSockKey), Value, ValueLen);
+	else if (Is("Sec-WebSocket-Protocol")) LWEHttpCopy(m_SecWebSockProto, sizeof(m_SecWebSockProto), Value, ValueLen);
+	else if (Is("Sec-WebSocket-Extensions")) LWEHttpCopy(m_SecWebSockExt, sizeof(m_SecWebSockExt), Value, ValueLen);
+	else if (Is("Sec-WebSocket-Version")) {
+		m_WebSockVersion = 0;
+		for (uint32_t i = 0; i < ValueLen && Value[i] >= '0' && Value[i] <= '9'; i++) m_WebSockVersion = m_WebSockVersion * 10 + (uint32_t)(Value[i] - '0');
+	}
+	else if (Is("Connection")) {
+		LWEHttpTokens(Value, ValueLen, [this, &IsValue](const char *Token, uint32_t TokenLen) {
+			if (IsValue(Token, TokenLen, "close")) m_Flag &= ~CONNECTIONBITS;
+			else if (IsValue(Token, TokenLen, "keep-alive")) m_Flag |= ConnectionKeepAlive;
+			else if (IsValue(Token, TokenLen, "upgrade")) m_Flag |= ConnectionUpgrade;
+		});
+	} else if (Is("Transfer-Encoding")) {
+		LWEHttpCopy(m_TransferEncoding, sizeof(m_TransferEncoding), Value, ValueLen);
+		//"chunk" is accepted for peers running older builds of this serializer.
+		LWEHttpTokens(Value, ValueLen, [this, &IsValue](const char *Token, uint32_t TokenLen) {
+			if (IsValue(Token, TokenLen, "chunked") || IsValue(Token, TokenLen, "chunk")) m_Flag |= EncodeChunked;
+		});
+	} else if (Is("Content-Encoding")) {
+		m_Flag &= ~CONTENTENCODEBITS;
+		if (IsValue(Value, ValueLen, "gzip") || IsValue(Value, ValueLen, "x-gzip")) m_Flag |= ContentEncodeGZip;
+		else if (IsValue(Value, ValueLen, "compress")) m_Flag |= ContentEncodeCompress;
+		else if (IsValue(Value, ValueLen, "deflate")) m_Flag |= ContentEncodeDeflate;
+		else if (IsValue(Value, ValueLen, "br")) m_Flag |= ContentEncodeBR;
+	} else if (Is("Accept-Encoding")) {
+		LWEHttpTokens(Value, ValueLen, [this, &IsValue](const char *Token, uint32_t TokenLen) {
+			uint32_t NameLen = LWEHttpFindByte(Token, TokenLen, ';');
+			uint32_t q = NameLen + LWEHttpFindByte(Token + NameLen, TokenLen - NameLen, '=');
+			if (q < TokenLen) {
+				//A quality of 0 means the coding is refused.
+				uint32_t i = q + 1;
+				while (i < TokenLen && (Token[i] == '0' || Token[i] == '.' || Token[i] == ' ')) i++;
+				if (i == TokenLen) return;
 			}
-		}else if (!_stricmp(NameBuffer, "Transfer-Encoding")) {
-			if (!_stricmp(ResultBuffer, "chunked")) m_Flag |= EncodeChunked;
-		} else if (!_stricmp(NameBuffer, "Content-Encoding")) {
-			if (!_stricmp(ResultBuffer, "identity")) m_Flag |= ContentEncodeIdentity;
-			else if (!_stricmp(ResultBuffer, "gzip")) m_Flag |= ContentEncodeGZip;
-			else if (!_stricmp(ResultBuffer, "compress")) m_Flag |= ContentEncodeCompress;
-			else if (!_stricmp(ResultBuffer, "deflate")) m_Flag |= ContentEncodeDeflate;
-			else if (!_stricmp(ResultBuffer, "br")) m_Flag |= ContentEncodeBR;
-		}else if(!_stricmp(NameBuffer, "Upgrade")){
-			if (!_stricmp(ResultBuffer, "websocket")) m_Flag |= UpgradeWebSock;
-		}else {
-			std::cout << "header: '" << NameBuffer << "' - '" << ResultBuffer << "'" << std::endl;
-		}
+			LWEHttpTrim(Token, NameLen);
+			if (IsValue(Token, NameLen, "gzip") || IsValue(Token, NameLen, "x-gzip")) m_Flag |= AcceptGZip;
+			else if (IsValue(Token, NameLen, "deflate")) m_Flag |= AcceptDeflate;
+			else if (IsValue(Token, NameLen, "*")) m_Flag |= ACCEPTENCODEBITS;
+		});
+	} else if (Is("Upgrade")) {
+		if (IsValue(Value, ValueLen, "websocket")) m_Flag |= UpgradeWebSock;
+	}
+	return true;
+}
 
+bool LWEHttpRequest::FinishMessage(void) {
+	uint32_t ContentEncodeBits = m_Flag&CONTENTENCODEBITS;
+	if (m_Flag&StreamDecode) {
+		//Write stops quietly when it runs out of input, so a body that ends before it's stream does was truncated.
+		if (!m_Inflater->isEnded() && !m_Inflater->isEmpty()) {
+			std::cout << "Compressed body was truncated." << std::endl;
+			return false;
+		}
+		m_ContentLength = m_Body.GetLength();
+	} else if (ContentEncodeBits == ContentEncodeGZip || ContentEncodeBits == ContentEncodeDeflate) {
+		//Without an inflater the body was collected compressed.
+		LWEHttpBody Compressed = std::move(m_Body);
+		if (!GZipDecompress(Compressed.GetData(), Compressed.GetLength(), m_Body, *m_Allocator)) return false;
+		m_ContentLength = m_Body.GetLength();
+		if (m_BodyCallback && m_Body.GetLength()) {
+			m_BodyCallback(*this, m_Body.GetData(), m_Body.GetLength());
+			m_Body.Clear();
+		}
 	}
+	m_Flag |= ResponseReady;
+	m_ParseState = ParseDone;
 	return true;
 }
 
+bool LWEHttpRequest::ReceiveBody(const char *Data, uint32_t Len) {
+	if (m_Flag&StreamDecode) return m_Inflater->Write(Data, Len, false, [this](const char *Out, uint32_t OutLen) { return DeliverBody(Out, OutLen); });
+	if (m_Flag&CONTENTENCODEBITS) return m_Body.Append(Data, Len, *m_Allocator, MaxBodyLength);
+	return DeliverBody(Data, Len);
+}
+
+bool LWEHttpRequest::DeliverBody(const char *Data, uint32_t Len) {
+	if (!m_BodyCallback) return m_Body.Append(Data, Len, *m_Allocator, MaxBodyLength);
+	m_BodyCallback(*this, Data, Len);
+	return true;
+}
+
+bool LWEHttpRequest::Deserialize(const char *Buffer, uint32_t Len, LWEHttpBuffer *Source) {
+	return Parse(Buffer, Len, Source) != ParseError;
+}
+
 LWEHttpRequest &LWEHttpRequest::SetURI(const char *URI) {
 	char ProtocolBuffer[256];
 	m_Port = ParseURI(URI, m_Host, sizeof(m_Host), nullptr, m_Path, sizeof(m_Path), nullptr, ProtocolBuffer, sizeof(ProtocolBuffer), nullptr);
@@ -517,6 +997,21 @@ LWEHttpRequest &LWEHttpRequest::SetWebSockProtof(const char *Fmt, ...) {
 	return SetWebSockProto(Buffer);
 }
 
+LWEHttpRequest &LWEHttpRequest::SetWebSockExt(const char *Extensions) {
+	*m_SecWebSockExt = '\0';
+	strncat(m_SecWebSockExt, Extensions, sizeof(m_SecWebSockExt));
+	return *this;
+}
+
+LWEHttpRequest &LWEHttpRequest::SetWebSockExtf(const char *Fmt, ...) {
+	char Buffer[256];
+	va_list lst;
+	va_start(lst, Fmt);
+	vsnprintf(Buffer, sizeof(Buffer), Fmt, lst);
+	va_end(lst);
+	return SetWebSockExt(Buffer);
+}
+
 LWEHttpRequest &LWEHttpRequest::SetAuthorization(const char *Auth) {
 	*m_Authorization = '\0';
 	strncat(m_Authorization, Auth, sizeof(m_Authorization));
@@ -548,9 +1043,12 @@ LWEHttpRequest &LWEHttpRequest::SetContentTypef(const char *Fmt, ...) {
 }
 
 LWEHttpRequest &LWEHttpRequest::SetBody(const char *Body) {
-	*m_Body = '\0';
-	strncat(m_Body, Body, sizeof(m_Body));
-	m_ContentLength = (uint32_t)strlen(m_Body);
+	return SetBody(Body, (uint32_t)strlen(Body));
+}
+
+LWEHttpRequest &LWEHttpRequest::SetBody(const char *Body, uint32_t Len) {
+	if (!m_Body.Set(Body, Len, *m_Allocator)) Len = 0;
+	m_ContentLength = Len;
 	return *this;
 }
 
@@ -558,10 +1056,19 @@ LWEHttpRequest &LWEHttpRequest::SetBodyf(const char *Fmt, ...) {
 	char Buffer[1024];
 	va_list lst;
 	va_start(lst, Fmt);
-	vsnprintf(Buffer, sizeof(Buffer), Fmt, lst);
+	int32_t Len = vsnprintf(Buffer, sizeof(Buffer), Fmt, lst);
 	va_end(lst);
-
-	return SetBody(Buffer);
+	if (Len < 0) return *this;
+	if ((uint32_t)Len < sizeof(Buffer)) return SetBody(Buffer, (uint32_t)Len);
+	LWEHttpBuffer *Body = LWEHttpBuffer::Make((uint32_t)Len + 1, *m_Allocator);
+	if (!Body) return *this;
+	va_start(lst, Fmt);
+	vsnprintf(Body->GetData(), (uint32_t)Len + 1, Fmt, lst);
+	va_end(lst);
+	m_Body.Slice(Body, 0, (uint32_t)Len);
+	Body->Release();
+	m_ContentLength = (uint32_t)Len;
+	return *this;
 }
 
 LWEHttpRequest &LWEHttpRequest::SetCallback(std::function<void(LWEHttpRequest &, const char *)> Callback) {
@@ -569,6 +1076,11 @@ LWEHttpRequest &LWEHttpRequest::SetCallback(std::function<void(LWEHttpRequest &,
 	return *this;
 }
 
+LWEHttpRequest &LWEHttpRequest::SetBodyCallback(std::function<void(LWEHttpRequest &, const char *, uint32_t)> Callback) {
+	m_BodyCallback = Callback;
+	return *this;
+}
+
 LWEHttpRequest &LWEHttpRequest::SetMethod(uint32_t Method) {
 	m_Flag = (m_Flag&~METHODBITS) | Method;
 	return *this;
@@ -604,6 +1116,17 @@ bool LWEHttpRequest::UpgradeConnection(void) {
 	return (m_Flag&ConnectionUpgrade) != 0;
 }
 
+bool LWEHttpRequest::CompressedBody(void) {
+	uint32_t ContentEncodeBits = m_Flag&CONTENTENCODEBITS;
+	return m_Body.GetLength() && (ContentEncodeBits == ContentEncodeGZip || ContentEncodeBits == ContentEncodeDeflate);
+}
+
+uint32_t LWEHttpRequest::GetAcceptedEncoding(void) {
+	if (m_Flag&AcceptGZip) return ContentEncodeGZip;
+	if (m_Flag&AcceptDeflate) return ContentEncodeDeflate;
+	return ContentEncodeIdentity;
+}
+
 uint32_t LWEHttpRequest::GetMethod(void) {
 	return m_Flag&METHODBITS;
 }
@@ -616,25 +1139,346 @@ uint32_t LWEHttpRequest::GetUpgradeType(void) {
 	return m_Flag&UPGRADEBITS;
 }
 
-LWEHttpRequest::LWEHttpRequest(const char *URI, uint32_t Flag) : m_Socket(nullptr), m_Flag(Flag), m_Status(0), m_Callback(nullptr), m_UserData(nullptr), m_ContentLength(0), m_ChunkLength(0), m_Port(80), m_WebSockVersion(0) {
+LWEHttpRequest::LWEHttpRequest(const char *URI, uint32_t Flag, LWAllocator *Allocator) : m_Socket(nullptr), m_Allocator(Allocator ? Allocator : &GetDefaultAllocator()), m_Inflater(nullptr), m_Flag(Flag), m_Status(0), m_Callback(nullptr), m_UserData(nullptr), m_ContentLength(0), m_ChunkLength(0), m_ParseState(ParseStartLine), m_LineLength(0), m_Port(80), m_WebSockVersion(0) {
 	m_Host[0] = '\0';
 	m_Path[0] = '\0';
 	m_Authorization[0] = '\0';
 	m_ContentType[0] = '\0';
-	m_Body[0] = '\0';
 	m_Origin[0] = '\0';
 	m_SecWebSockKey[0] = '\0';
 	m_SecWebSockProto[0] = '\0';
+	m_SecWebSockExt[0] = '\0';
 	SetURI(URI);
 }
 
-LWEHttpRequest::LWEHttpRequest() : m_Socket(nullptr), m_Flag(0), m_Status(0), m_Callback(nullptr), m_UserData(nullptr), m_ContentLength(0), m_ChunkLength(0), m_Port(80), m_WebSockVersion(0) {
-	m_Host[0] = m_Path[0] = m_Authorization[0] = m_ContentType[0] = m_Body[0] = m_Origin[0] = m_SecWebSockKey[0] = m_SecWebSockProto[0] = '\0';
+LWEHttpRequest::LWEHttpRequest(LWAllocator *Allocator) : m_Socket(nullptr), m_Allocator(Allocator ? Allocator : &GetDefaultAllocator()), m_Inflater(nullptr), m_Flag(0), m_Status(0), m_Callback(nullptr), m_UserData(nullptr), m_ContentLength(0), m_ChunkLength(0), m_ParseState(ParseStartLine), m_LineLength(0), m_Port(80), m_WebSockVersion(0) {
+	m_Host[0] = m_Path[0] = m_Authorization[0] = m_ContentType[0] = m_Origin[0] = m_SecWebSockKey[0] = m_SecWebSockProto[0] = m_SecWebSockExt[0] = '\0';
+}
+
+LWEHttpRequest *LWEHttpRequestPool::Acquire(void) {
+	LWEHttpRequest *Request = nullptr;
+	if (m_Free.Pop(Request)) return Request;
+	return m_Allocator.Allocate<LWEHttpRequest>(&m_Allocator);
+}
+
+void LWEHttpRequestPool::Release(LWEHttpRequest *Request) {
+	if (!Request) return;
+	*Request = LWEHttpRequest(&m_Allocator);
+	if (!m_Free.Push(Request)) LWAllocator::Destroy(Request);
+	return;
+}
+
+LWAllocator &LWEHttpRequestPool::GetAllocator(void) {
+	return m_Allocator;
+}
+
+LWEHttpRequestPool::LWEHttpRequestPool(LWAllocator &Allocator) : m_Allocator(Allocator) {}
+
+LWEHttpRequestPool::~LWEHttpRequestPool() {
+	LWEHttpRequest *Request = nullptr;
+	while (m_Free.Pop(Request)) LWAllocator::Destroy(Request);
+}
+
+bool LWEHttpConnection::PushInFlight(LWEHttpRequest *Request) {
+	if (m_InFlightCount >= MaxPipelined) return false;
+	m_InFlight[(m_InFlightHead + m_InFlightCount++) % MaxPipelined] = Request;
+	return true;
+}
+
+LWEHttpRequest *LWEHttpConnection::GetInFlight(void) {
+	return m_InFlightCount ? m_InFlight[m_InFlightHead] : nullptr;
+}
+
+LWEHttpRequest *LWEHttpConnection::PopInFlight(void) {
+	if (!m_InFlightCount) return nullptr;
+	LWEHttpRequest *Request = m_InFlight[m_InFlightHead];
+	m_InFlightHead = (m_InFlightHead + 1) % MaxPipelined;
+	m_InFlightCount--;
+	return Request;
+}
+
+LWEHttpConnection &LWEHttpConnection::SetSocket(LWSocket *Socket) {
+	m_Socket = Socket;
+	for (uint32_t i = 0; i < m_InFlightCount; i++) m_InFlight[(m_InFlightHead + i) % MaxPipelined]->m_Socket = Socket;
+	if (m_Request) m_Request->m_Socket = Socket;
+	return *this;
+}
+
+bool LWEHttpConnection::FinishClosed(LWEHttpRequestPool &Requests) {
+	LWEHttpRequest *Req = (m_Flag&Client) ? GetInFlight() : nullptr;
+	if (!Req || Req->m_ParseState != LWEHttpRequest::ParseBodyRemaining) return false;
+	//The response had no length or chunked framing, so the close marks the end of it's body.
+	PopInFlight();
+	if (Req->FinishMessage() && Req->m_Callback) Req->m_Callback(*Req, Req->m_Body.GetData());
+	Requests.Release(Req);
+	return true;
+}
+
+LWEHttpConnection::LWEHttpConnection(LWSocket *Socket, uint32_t Flag, LWAllocator &Allocator) : m_Inflater(LWEHttpZStream::Inflate, Allocator), m_Deflater(LWEHttpZStream::Deflate, Allocator), m_Socket(Socket), m_LastActive(LWTimer::GetCurrent()), m_Flag(Flag) {
+	m_Host[0] = '\0';
+}
+
+LWEHttpConnection *LWEHttpConnectionPool::Find(const LWEHttpRequest &Request, bool &Wait) {
+	bool KeepAlive = (Request.m_Flag&LWEHttpRequest::ConnectionKeepAlive) != 0;
+	bool Pipeline = KeepAlive && (Request.m_Flag&LWEHttpRequest::METHODBITS) == LWEHttpRequest::GET;
+	LWEHttpConnection *Best = nullptr;
+	uint32_t Count = 0;
+	Wait = false;
+	for (auto &&C : m_Connections) {
+		if (!(C->m_Flag&LWEHttpConnection::Client) || C->m_Port != Request.m_Port || strcmp(C->m_Host, Request.m_Host)) continue;
+		Count++;
+		if (!KeepAlive || (C->m_Flag&(LWEHttpConnection::Pooled | LWEHttpConnection::Closing)) != LWEHttpConnection::Pooled) continue;
+		if (!C->m_InFlightCount) return C;
+		if (!Pipeline || C->m_InFlightCount >= m_MaxPipelined) continue;
+		if (!Best || C->m_InFlightCount < Best->m_InFlightCount) Best = C;
+	}
+	if (Best || Count < m_MaxPerHost) return Best;
+	Wait = true;
+	return nullptr;
+}
+
+LWEHttpConnection *LWEHttpConnectionPool::Create(LWSocket *Socket, const LWEHttpRequest *Request) {
+	uint32_t Flag = 0;
+	if (Request) Flag = LWEHttpConnection::Client | ((Request->m_Flag&LWEHttpRequest::ConnectionKeepAlive) ? LWEHttpConnection::Pooled : 0);
+	LWEHttpConnection *Connection = m_Allocator.Allocate<LWEHttpConnection>(Socket, Flag, m_Allocator);
+	if (!Connection) return nullptr;
+	if (Request) {
+		strncat(Connection->m_Host, Request->m_Host, sizeof(Connection->m_Host) - 1);
+		Connection->m_Port = Request->m_Port;
+	}
+	m_Connections.push_back(Connection);
+	return Connection;
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::Destroy(LWEHttpConnection *Connection, LWEHttpRequestPool &Requests, std::vector<LWEHttpRequest*> &Retry) {
+	if (!Connection) return *this;
+	Requests.Release(Connection->m_Request);
+	for (LWEHttpRequest *Request = Connection->PopInFlight(); Request; Request = Connection->PopInFlight()) {
+		bool Untouched = Request->m_LineLength == 0 && (Request->m_ParseState == LWEHttpRequest::ParseStartLine || Request->m_ParseState == LWEHttpRequest::ParseDone);
+		bool Idempotent = (Request->m_Flag&LWEHttpRequest::METHODBITS) == LWEHttpRequest::GET;
+		if (!Untouched || !Idempotent || (Request->m_Flag&LWEHttpRequest::Retried)) {
+			Requests.Release(Request);
+			continue;
+		}
+		Request->m_Flag |= LWEHttpRequest::Retried;
+		Request->m_Socket = nullptr;
+		Retry.push_back(Request);
+	}
+	auto Iter = std::find(m_Connections.begin(), m_Connections.end(), Connection);
+	if (Iter != m_Connections.end()) {
+		*Iter = m_Connections.back();
+		m_Connections.pop_back();
+	}
+	LWAllocator::Destroy(Connection);
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::CloseIdle(uint64_t Current) {
+	for (auto &&C : m_Connections) {
+		if ((C->m_Flag&(LWEHttpConnection::Pooled | LWEHttpConnection::Closing)) != LWEHttpConnection::Pooled || C->m_InFlightCount) continue;
+		if (Current - C->m_LastActive < m_IdleTimeout) continue;
+		C->m_Flag |= LWEHttpConnection::Closing;
+		C->m_Socket->MarkClosable();
+	}
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::SetMaxPerHost(uint32_t MaxPerHost) {
+	m_MaxPerHost = std::max<uint32_t>(MaxPerHost, 1);
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::SetMaxPipelined(uint32_t MaxPipelined) {
+	m_MaxPipelined = std::min<uint32_t>(std::max<uint32_t>(MaxPipelined, 1), LWEHttpConnection::MaxPipelined);
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::SetIdleTimeout(uint32_t Milliseconds) {
+	m_IdleTimeout = LWTimer::ToHighResolution((uint64_t)Milliseconds);
+	return *this;
+}
+
+uint32_t LWEHttpConnectionPool::GetMaxPerHost(void) const {
+	return m_MaxPerHost;
+}
+
+uint32_t LWEHttpConnectionPool::GetMaxPipelined(void) const {
+	return m_MaxPipelined;
+}
+
+uint32_t LWEHttpConnectionPool::GetConnectionCount(void) const {
+	return (uint32_t)m_Connections.size();
+}
+
+LWEHttpConnectionPool &LWEHttpConnectionPool::Clear(LWEHttpRequestPool &Requests) {
+	for (auto &&C : m_Connections) {
+		Requests.Release(C->m_Request);
+		for (LWEHttpRequest *Request = C->PopInFlight(); Request; Request = C->PopInFlight()) Requests.Release(Request);
+		LWAllocator::Destroy(C);
+	}
+	m_Connections.clear();
+	return *this;
+}
+
+bool LWEHttpConnectionPool::ReadRequests(LWSocket &Socket, uint32_t ProtocolID, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source, LWEHttpRequestPool &Requests, const std::function<bool(LWEHttpRequest*)> &Received) {
+	LWEHttpConnection *Conn = (LWEHttpConnection*)Socket.GetProtocolData(ProtocolID);
+	if (!Conn) {
+		Conn = Create(&Socket, nullptr);
+		if (!Conn) {
+			std::cout << "Could not create connection." << std::endl;
+			return false;
+		}
+		Socket.SetProtocolData(ProtocolID, Conn);
+	}
+	bool IsClient = (Conn->m_Flag&LWEHttpConnection::Client) != 0;
+	Conn->m_LastActive = LWTimer::GetCurrent();
+	//Pipelined messages are parsed one after another from the same buffer, responses arrive in the order their requests were sent.
+	while (Len) {
+		LWEHttpRequest *Req = IsClient ? Conn->GetInFlight() : Conn->m_Request;
+		if (!Req) {
+			if (IsClient) {
+				std::cout << "Received response with no request in flight." << std::endl;
+				Socket.MarkClosable();
+				return false;
+			}
+			Req = Requests.Acquire();
+			if (!Req) {
+				std::cout << "Could not get a request to write to from pool." << std::endl;
+				return false;
+			}
+			Req->m_Socket = &Socket;
+			Conn->m_Request = Req;
+		}
+		Req->m_Inflater = &Conn->m_Inflater;
+		uint32_t r = Req->Parse(Buffer, Len, Source);
+		Req->m_Inflater = nullptr;
+		if (r == LWEHttpRequest::ParseError) {
+			std::cout << "Error deserializing response." << std::endl;
+			Req->m_Flag |= LWEHttpRequest::Retried;
+			Conn->m_Flag |= LWEHttpConnection::Closing;
+			Socket.MarkClosable();
+			return false;
+		}
+		Buffer += r;
+		Len -= r;
+		if (!(Req->m_Flag&LWEHttpRequest::ResponseReady)) break;
+		if (IsClient) Conn->PopInFlight();
+		else Conn->m_Request = nullptr;
+		if (Req->m_Callback) Req->m_Callback(*Req, Req->m_Body.GetData());
+		if (IsClient) {
+			if (Req->CloseConnection()) Conn->m_Flag |= LWEHttpConnection::Closing;
+			if ((Conn->m_Flag&LWEHttpConnection::Closing) && !Conn->m_InFlightCount) Socket.MarkClosable();
+			Requests.Release(Req);
+		} else if (!Received(Req)) {
+			std::cout << "Failed to insert into request." << std::endl;
+			Requests.Release(Req);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LWEHttpConnectionPool::SendRequest(LWEHttpRequest *Request, const char *Agent, const char *Server, uint32_t ProtocolID, uint32_t SocketProtocolID, LWProtocolManager &Manager, LWEHttpRequestPool &Requests, std::vector<LWEHttpRequest*> &Waiting, char *Buffer, uint32_t BufferLen, const std::function<uint32_t(LWSocket&, const LWSocketBuffer*, uint32_t)> &Send) {
+	bool IsResponse = Request->m_Status != 0;
+	const char *lAgent = IsResponse ? Agent : Server;
+	if (!IsResponse) Request->m_Flag |= LWEHttpRequest::AcceptGZip | LWEHttpRequest::AcceptDeflate;
+	bool Compressed = Request->CompressedBody();
+	if (Compressed) Request->m_Flag |= LWEHttpRequest::EncodeChunked;
+	uint32_t Len = Compressed ? Request->SerializeHeaders(Buffer, BufferLen, lAgent) : Request->Serialize(Buffer, BufferLen, lAgent);
+	if (!Len) {
+		Requests.Release(Request);
+		return false;
+	}
+	LWEHttpConnection *Conn = nullptr;
+	if (!Request->m_Socket) {
+		bool Wait = false;
+		Conn = Find(*Request, Wait);
+		if (Wait) {
+			Waiting.push_back(Request);
+			return true;
+		}
+		if (!Conn) {
+			LWSocket Sock;
+			uint32_t Error = LWSocket::CreateSocket(Sock, LWText(Request->m_Host), Request->m_Port, (uint32_t)LWSocket::Tcp, SocketProtocolID);
+			if (Error) {
+				std::cout << "Error connecting to: '" << Request->m_Host << ":" << Request->m_Port << "' " << Error << std::endl;
+				Requests.Release(Request);
+				return false;
+			}
+			LWSocket *S = Manager.PushSocket(Sock);
+			if (!S) {
+				std::cout << "Error inserting socket." << std::endl;
+				Requests.Release(Request);
+				return false;
+			}
+			Conn = Create(S, Request);
+			if (!Conn) {
+				std::cout << "Could not create connection." << std::endl;
+				S->MarkClosable();
+				Requests.Release(Request);
+				return false;
+			}
+			S->SetProtocolData(ProtocolID, Conn);
+		}
+		Request->m_Socket = Conn->m_Socket;
+	}
+	LWSocket &Socket = *Request->m_Socket;
+	if (!Conn) Conn = (LWEHttpConnection*)Socket.GetProtocolData(ProtocolID);
+	if (!Conn && (Conn = Create(&Socket, IsResponse ? nullptr : Request)) != nullptr) Socket.SetProtocolData(ProtocolID, Conn);
+	if (!Conn) {
+		std::cout << "Could not create connection." << std::endl;
+		Requests.Release(Request);
+		return false;
+	}
+	uint32_t Res = SendOk;
+	if (Len < BufferLen && !Compressed) {
+		LWSocketBuffer Message = { Buffer, Len };
+		Res = Send(Socket, &Message, 1);
+	} else if (!Compressed && !(Request->m_Flag&LWEHttpRequest::EncodeChunked)) {
+		//Large bodies go out in one gather write with the headers, straight from the body buffer.
+		LWSocketBuffer Buffers[2] = { { Buffer, Request->SerializeHeaders(Buffer, BufferLen, lAgent) }, { Request->m_Body.GetData(), Request->m_Body.GetLength() } };
+		Res = Send(Socket, Buffers, 2);
+	} else {
+		//Chunked bodies are framed straight from the body buffer, and compressed bodies are sent a block at a time, instead of being staged.
+		LWSocketBuffer Headers = { Buffer, Compressed ? Len : Request->SerializeHeaders(Buffer, BufferLen, lAgent) };
+		Res = Send(Socket, &Headers, 1);
+		if (Res == SendOk && !Request->SerializeBody(&Conn->m_Deflater, Buffer, BufferLen, [&Socket, &Send](const char *Data, uint32_t DataLen) { LWSocketBuffer Body = { Data, DataLen }; return Send(Socket, &Body, 1) == SendOk; })) Res = SendFailed;
+	}
+	if (Res == SendPending) {
+		//The socket can not take data yet(such as a tls handshake that has not finished), so the request waits for the next pass.
+		Waiting.push_back(Request);
+		return true;
+	}
+	if (Res == SendFailed) {
+		std::cout << "Error sending request." << std::endl;
+		Socket.MarkClosable();
+		Requests.Release(Request);
+		return false;
+	}
+	if (IsResponse) {
+		if (Request->CloseConnection()) Socket.MarkClosable();
+		Requests.Release(Request);
+		return true;
+	}
+	//Outgoing requests are owned by their connection until the response arrives.
+	if (!Conn->PushInFlight(Request)) {
+		std::cout << "Error tracking request." << std::endl;
+		Requests.Release(Request);
+		return false;
+	}
+	Conn->m_LastActive = LWTimer::GetCurrent();
+	if (!Request->KeepAliveConnection()) Conn->m_Flag |= LWEHttpConnection::Closing;
+	return true;
+}
+
+LWEHttpConnectionPool::LWEHttpConnectionPool(LWAllocator &Allocator) : m_Allocator(Allocator), m_IdleTimeout(LWTimer::ToHighResolution((uint64_t)DefaultIdleTimeout)) {}
+
+LWEHttpConnectionPool::~LWEHttpConnectionPool() {
+	for (auto &&C : m_Connections) LWAllocator::Destroy(C);
 }
 
 
 LWProtocol &LWEProtocolHttp::Read(LWSocket &Socket, LWProtocolManager *Manager) {
-	char Buffer[1024 * 64];
 	if(Socket.GetFlag()&LWSocket::Listen){
 		LWSocket Acc;
 		if (!Socket.Accept(Acc, Socket.GetProtocolID())) {
@@ -644,104 +1488,76 @@ LWProtocol &LWEProtocolHttp::Read(LWSocket &Socket, LWProtocolManager *Manager)
 		Manager->PushSocket(Acc);
 		return *this;
 	}
-	int32_t r = Socket.Receive(Buffer, sizeof(Buffer));
+	//Bodies may still reference the previous receive buffer, in which case a fresh one is made.
+	if (!m_ReceiveBuffer || m_ReceiveBuffer->isShared()) {
+		if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
+		m_ReceiveBuffer = LWEHttpBuffer::Make(ReceiveBufferSize + 1, m_Pool.GetAllocator());
+		if (!m_ReceiveBuffer) {
+			std::cout << "Error allocating receive buffer." << std::endl;
+			return *this;
+		}
+	}
+	char *Buffer = m_ReceiveBuffer->GetData();
+	int32_t r = Socket.Receive(Buffer, ReceiveBufferSize);
 	if (r <= 0) {
 		Socket.MarkClosable();
 		return *this;
 	}
 	Buffer[r] = '\0';
-	if (!ProcessRead(Socket, Buffer, r)) {
+	if (!ProcessRead(Socket, Buffer, r, m_ReceiveBuffer)) {
 		std::cout << "Error parsing HTTP buffer." << std::endl;
 	}
 	return *this;
 }
 
 LWProtocol &LWEProtocolHttp::SocketChanged(LWSocket &Prev, LWSocket &New, LWProtocolManager *Manager) {
-	LWEHttpRequest *Req = (LWEHttpRequest*)Prev.GetProtocolData(m_ProtocolID);
-	if (Req) Req->m_Socket = &New;
+	LWEHttpConnection *Conn = (LWEHttpConnection*)New.GetProtocolData(m_ProtocolID);
+	if (Conn) Conn->SetSocket(&New);
+	return *this;
+}
+
+LWProtocol &LWEProtocolHttp::SocketClosed(LWSocket &Socket, LWProtocolManager *Manager) {
+	LWEHttpConnection *Conn = (LWEHttpConnection*)Socket.GetProtocolData(m_ProtocolID);
+	if (!Conn) return *this;
+	Socket.SetProtocolData(m_ProtocolID, nullptr);
+	Conn->FinishClosed(m_Pool);
+	m_Connections.Destroy(Conn, m_Pool, m_Waiting);
 	return *this;
 }
 
 uint32_t LWEProtocolHttp::Send(LWSocket &Socket, const char *Buffer, uint32_t Len) {
-	for (uint32_t o = 0; o < Len;) {
-		int32_t r = Socket.Send(Buffer + o, Len - o);
-		if (r == -1) {
-			std::cout << "Error sending: " << Socket.GetSocketDescriptor() << " " << std::endl;
-			return 1;
-		}
-		o += (uint32_t)r;
+	if (!Socket.Queue(Buffer, Len)) {
+		std::cout << "Error sending: " << Socket.GetSocketDescriptor() << " " << std::endl;
+		return 1;
 	}
 	return 0;
 }
 
-bool LWEProtocolHttp::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len) {
-	LWEHttpRequest *Req = (LWEHttpRequest*)Socket.GetProtocolData(m_ProtocolID);
-	LWEHttpRequest IReq;
-	bool Insert = false;
-	if (!Req) {
-		Req = &IReq;
-		Req->m_Socket = &Socket;
-		Insert = true;
-	}
-	if (!Req->Deserialize(Buffer, Len)) {
-		std::cout << "Error deserializing response." << std::endl;
-		return false;
-	}
-	if (Insert) {
-		if (!GetNextFromPool(&Req)) {
-			std::cout << "Could not get a request to write to from pool." << std::endl;
-			return false;
-		}
-		*Req = IReq;
-		Socket.SetProtocolData(m_ProtocolID, Req);
-	}
-	if (Req->m_Flag&LWEHttpRequest::ResponseReady) {
-		if (Req->m_Status == 0) {
-			if (!m_InRequests.Push(*Req, &Req)) {
-				std::cout << "Failed to insert into request." << std::endl;
-				return false;
-			}
-			Socket.SetProtocolData(m_ProtocolID, Req);
-		}
-		if (Req->m_Callback) Req->m_Callback(*Req, Req->m_Body);
-		if (Req->CloseConnection() && Req->m_Status != 0) {
-			Socket.MarkClosable();
-		}
-
-	}
-	return true;
+bool LWEProtocolHttp::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t Len, LWEHttpBuffer *Source) {
+	return m_Connections.ReadRequests(Socket, m_ProtocolID, Buffer, Len, Source, m_Pool, [this](LWEHttpRequest *Request) { return m_InRequests.Push(Request); });
 }
 
 LWEProtocolHttp &LWEProtocolHttp::ProcessRequests(uint32_t ProtocolID, LWProtocolManager &Manager) {
 	char Buffer[1024 * 64];
+	//Sends are queued on the socket and go out when the socket is flushed below.
+	auto QueueSend = [this](LWSocket &Socket, const LWSocketBuffer *Buffers, uint32_t BufferCount) {
+		if (m_FlushList.empty() || m_FlushList.back() != &Socket) m_FlushList.push_back(&Socket);
+		return Socket.Queue(Buffers, BufferCount) ? (uint32_t)LWEHttpConnectionPool::SendOk : (uint32_t)LWEHttpConnectionPool::SendFailed;
+	};
+	m_Connections.CloseIdle(LWTimer::GetCurrent());
+	//Requests held back by the per host cap or retried after their connection closed go first, so they keep their order.
+	std::vector<LWEHttpRequest*> Waiting;
+	Waiting.swap(m_Waiting);
+	for (auto &&Request : Waiting) m_Connections.SendRequest(Request, m_Agent, m_Server, m_ProtocolID, ProtocolID, Manager, m_Pool, m_Waiting, Buffer, sizeof(Buffer), QueueSend);
 	LWEHttpRequest *Request;
-	while (m_OutRequests.Pop(&Request)) {
-		LWSocket Sock;
-		bool IsResponse = Request->m_Status != 0;
-		uint32_t Len = Request->Serialize(Buffer, sizeof(Buffer), IsResponse ? m_Agent : m_Server);
-		if (!Len) continue;
-		if (!Request->m_Socket) {
-			uint32_t Error = LWSocket::CreateSocket(Sock, LWText(Request->m_Host), Request->m_Port, (uint32_t)LWSocket::Tcp, ProtocolID);
-			if (Error) {
-				std::cout << "Error connecting to: '" << Request->m_Host << ":" << Request->m_Port << "' " << Error << std::endl;
-				continue;
-			}
-			Request->m_Socket = Manager.PushSocket(Sock);
-			//std::cout << "Making socket: " << Request->m_Socket->GetSocketDescriptor() << std::endl;
-			Request->m_Socket->SetProtocolData(m_ProtocolID, Request);
-			if (!Request->m_Socket) {
-				std::cout << "Error inserting socket." << std::endl;
-				continue;
-			}
-		}
-
-		uint32_t Res = Send(*Request->m_Socket, Buffer, Len);
-		if (Res == -1) {
-			std::cout << "Error sending request." << std::endl;
-			continue;
-		}
-		if (Request->CloseConnection()) Request->m_Socket->MarkClosable();
+	while (m_OutRequests.Pop(Request)) m_Connections.SendRequest(Request, m_Agent, m_Server, m_ProtocolID, ProtocolID, Manager, m_Pool, m_Waiting, Buffer, sizeof(Buffer), QueueSend);
+	//Everything queued this pass goes out together, one gather write per connection.
+	std::sort(m_FlushList.begin(), m_FlushList.end());
+	m_FlushList.erase(std::unique(m_FlushList.begin(), m_FlushList.end()), m_FlushList.end());
+	for (auto &&S : m_FlushList) {
+		if (!Manager.Flush(*S)) S->MarkClosable();
 	}
+	m_FlushList.clear();
 	return *this;
 }
 
@@ -756,25 +1572,57 @@ LWEProtocolHttp &LWEProtocolHttp::SetProtocolManager(LWProtocolManager *Manager)
 }
 
 bool LWEProtocolHttp::GetNextRequest(LWEHttpRequest &Request) {
-	return m_InRequests.Pop(Request);
+	LWEHttpRequest *Req = nullptr;
+	if (!m_InRequests.Pop(Req)) return false;
+	Request = *Req;
+	m_Pool.Release(Req);
+	return true;
+}
+
+bool LWEProtocolHttp::GetNextRequest(LWEHttpRequest **Request) {
+	return m_InRequests.Pop(*Request);
 }
 
 bool LWEProtocolHttp::GetNextFromPool(LWEHttpRequest **Request) {
-	LWEHttpRequest Req;
-	if (!m_Pool.Push(Req, Request)) return false;
-	return m_Pool.Pop(Req);
+	*Request = m_Pool.Acquire();
+	return *Request != nullptr;
+}
+
+LWEProtocolHttp &LWEProtocolHttp::ReleaseRequest(LWEHttpRequest *Request) {
+	m_Pool.Release(Request);
+	return *this;
+}
+
+LWEHttpConnectionPool &LWEProtocolHttp::GetConnectionPool(void) {
+	return m_Connections;
 }
 
 bool LWEProtocolHttp::PushRequest(LWEHttpRequest &Request) {
-	LWEHttpRequest Req = Request;
-	return m_OutRequests.Push(Req);
+	LWEHttpRequest *Req = nullptr;
+	if (!GetNextFromPool(&Req)) return false;
+	*Req = Request;
+	return PushRequest(Req);
+}
+
+bool LWEProtocolHttp::PushRequest(LWEHttpRequest *Request) {
+	if (m_OutRequests.Push(Request)) return true;
+	m_Pool.Release(Request);
+	return false;
 }
 
 bool LWEProtocolHttp::PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t lStatus) {
-	LWEHttpRequest Request = InRequest;
-	Request.m_Status = lStatus;
-	Request.SetBody(Response);
-	return m_OutRequests.Push(Request);
+	return PushResponse(InRequest, Response, (uint32_t)strlen(Response), lStatus);
+}
+
+bool LWEProtocolHttp::PushResponse(LWEHttpRequest &InRequest, const char *Response, uint32_t ResponseLen, uint32_t lStatus) {
+	LWEHttpRequest *Request = nullptr;
+	if (!GetNextFromPool(&Request)) return false;
+	*Request = InRequest;
+	Request->m_Allocator = &m_Pool.GetAllocator();
+	Request->m_Status = lStatus;
+	Request->m_Flag = (Request->m_Flag&~LWEHttpRequest::CONTENTENCODEBITS) | (ResponseLen >= LWEHttpRequest::MinCompressLength ? Request->GetAcceptedEncoding() : LWEHttpRequest::ContentEncodeIdentity);
+	Request->SetBody(Response, ResponseLen);
+	return PushRequest(Request);
 }
 
 LWEProtocolHttp &LWEProtocolHttp::SetAgentString(const char *Agent) {
@@ -789,12 +1637,26 @@ LWEProtocolHttp &LWEProtocolHttp::SetServerString(const char *Server) {
 	return *this;
 }
 
-LWEProtocolHttp::LWEProtocolHttp(uint32_t ProtocolID, LWProtocolManager *Manager) : LWProtocol(), m_ProtocolID(ProtocolID), m_Manager(m_Manager) {
+LWEProtocolHttp::LWEProtocolHttp(uint32_t ProtocolID, LWProtocolManager *Manager, LWAllocator &Allocator) : LWProtocol(), m_Manager(Manager), m_Pool(Allocator), m_Connections(Allocator), m_ProtocolID(ProtocolID) {
+	m_Agent[0] = '\0';
+	m_Server[0] = '\0';
+}
+
+LWEProtocolHttp::LWEProtocolHttp(uint32_t ProtocolID, LWProtocolManager *Manager) : LWProtocol(), m_Manager(Manager), m_Pool(LWEHttpRequest::GetDefaultAllocator()), m_Connections(LWEHttpRequest::GetDefaultAllocator()), m_ProtocolID(ProtocolID) {
 	m_Agent[0] = '\0';
 	m_Server[0] = '\0';
 }
 
-LWEProtocolHttp::LWEProtocolHttp() : LWProtocol(), m_ProtocolID(0), m_Manager(nullptr) {
+LWEProtocolHttp::LWEProtocolHttp() : LWProtocol(), m_Manager(nullptr), m_Pool(LWEHttpRequest::GetDefaultAllocator()), m_Connections(LWEHttpRequest::GetDefaultAllocator()), m_ProtocolID(0) {
 	m_Agent[0] = '\0';
 	m_Server[0] = '\0';
+}
+
+LWEProtocolHttp::~LWEProtocolHttp() {
+	LWEHttpRequest *Request = nullptr;
+	while (m_OutRequests.Pop(Request)) m_Pool.Release(Request);
+	while (m_InRequests.Pop(Request)) m_Pool.Release(Request);
+	for (auto &&R : m_Waiting) m_Pool.Release(R);
+	m_Connections.Clear(m_Pool);
+	if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
 }
\ No newline at end of file
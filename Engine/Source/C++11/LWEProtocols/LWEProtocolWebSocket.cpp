@@ -7,121 +7,186 @@
 #include <LWCore/LWText.h>
 #include <LWCore/LWByteBuffer.h>
 #include <iostream>
+#include <random>
+#include <cstring>
+#include <algorithm>
+//The masking kernels are picked from what the compiler is targeting, anything else falls back to 8 bytes at a time.
+#if defined(__AVX2__) && !defined(LW_NOAVX2)
+#define LWEWEBSOCKET_AVX2
+#include <immintrin.h>
+#endif
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(LW_NOAVX)
+#define LWEWEBSOCKET_SSE2
+#include <emmintrin.h>
+#endif
+
+
+//Generates the masking key for client frames, RFC 6455 requires it be unpredictable to intermediaries.
+inline uint32_t LWEWebSocketMaskKey(void) {
+	static thread_local std::mt19937 Generator(std::random_device{}());
+	return (uint32_t)Generator();
+}
+
+//Ensures Packet owns a writable buffer of at least Length bytes, keeping the received payload.
+inline bool LWEWebPacketReserve(LWEWebPacket &Packet, uint32_t Length, LWAllocator &Allocator) {
+	LWEHttpBuffer *Old = Packet.m_Buffer;
+	bool Owned = Old && !Old->isShared() && Packet.m_Data == Old->GetData();
+	if (Owned && Old->m_Capacity >= Length) return true;
+	uint32_t Capacity = Owned ? Old->m_Capacity : 0;
+	Capacity = std::max<uint32_t>(std::min<uint32_t>(Capacity * 2, LWEWebPacket::MaxDataLength + 1), Length);
+	LWEHttpBuffer *Buffer = LWEHttpBuffer::Make(Capacity, Allocator);
+	if (!Buffer) return false;
+	if (Packet.m_DataPos) std::copy(Packet.m_Data, Packet.m_Data + Packet.m_DataPos, Buffer->GetData());
+	if (Old) Old->Release();
+	Packet.m_Buffer = Buffer;
+	Packet.m_Data = Buffer->GetData();
+	return true;
+}
 
+void LWEWebPacket::ApplyMask(char *Data, uint32_t Len, uint32_t Mask, uint32_t Offset) {
+	uint8_t Key[4];
+	uint8_t Rotated[4];
+	std::memcpy(Key, &Mask, sizeof(Key));
+	for (uint32_t i = 0; i < 4; i++) Rotated[i] = Key[(Offset + i) & 3];
+	uint32_t Word;
+	std::memcpy(&Word, Rotated, sizeof(Word));
+	uint32_t i = 0;
+#ifdef LWEWEBSOCKET_AVX2
+	__m256i WideKey = _mm256_set1_epi32((int32_t)Word);
+	for (; i + 32 <= Len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(Data + i));
+		_mm256_storeu_si256((__m256i*)(Data + i), _mm256_xor_si256(v, WideKey));
+	}
+#endif
+#ifdef LWEWEBSOCKET_SSE2
+	__m128i QuadKey = _mm_set1_epi32((int32_t)Word);
+	for (; i + 16 <= Len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(Data + i));
+		_mm_storeu_si128((__m128i*)(Data + i), _mm_xor_si128(v, QuadKey));
+	}
+#endif
+	uint64_t LongKey = (uint64_t)Word | ((uint64_t)Word << 32);
+	for (; i + 8 <= Len; i += 8) {
+		uint64_t v;
+		std::memcpy(&v, Data + i, sizeof(v));
+		v ^= LongKey;
+		std::memcpy(Data + i, &v, sizeof(v));
+	}
+	for (; i < Len; i++) Data[i] ^= (char)Rotated[i & 3];
+	return;
+}
 
-uint32_t LWEWebPacket::Deserialize(const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator) {
-	LWByteBuffer Buf((const int8_t*)Buffer, BufferLen, LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
-	
-	auto ReadData = [this](LWByteBuffer &Buf) -> bool{
-		uint32_t opCode = GetOp();
-		uint32_t Len = m_DataLen;
-		if (opCode == CONTROL_TEXT) Len--;
-		uint32_t Remaining = Len - m_DataPos;
-		Remaining = std::min<uint32_t>(Remaining, Buf.GetBufferSize() - Buf.GetPosition());
-		m_DataPos += Buf.Read(m_Data + m_DataPos, Remaining);
-		if (m_DataPos != Len) return false;
-		if (opCode == CONTROL_TEXT) m_DataPos++;
-		if (m_Mask) {
-			
-			uint32_t RemainLen = (m_DataLen - m_FramePos);
-			uint32_t *uData = (uint32_t*)m_Data + (m_FramePos / 4);
-			uint32_t uBytes = RemainLen / 4;
-			if ((RemainLen%4) != 0) uBytes++;
-			if (uBytes) {
-				uint32_t FrameP = m_FramePos % 4;
-				if (FrameP == 0) uData[0] ^= m_Mask;
-				else if (FrameP == 1) uData[0] ^= ((m_Mask<<8) & 0xFFFFFF00);
-				else if (FrameP == 2) uData[0] ^= ((m_Mask<<16) & 0xFFFF0000);
-				else uData[0] ^= ((m_Mask<<24) & 0xFF000000);
-				for (uint32_t i = 1; i < uBytes; i++) uData[i] ^= m_Mask;
+uint32_t LWEWebPacket::Deserialize(const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator, LWEHttpBuffer *Source) {
+	uint32_t o = 0;
+	if (!m_FrameLen) {
+		const uint8_t *Header = (const uint8_t*)m_Header;
+		uint32_t HeaderSize = 2;
+		for (;;) {
+			if (m_HeaderLen >= 2) {
+				uint32_t LenCode = Header[1] & 0x7F;
+				HeaderSize = 2 + (LenCode == 126 ? 2 : (LenCode == 127 ? 8 : 0)) + ((Header[1] & 0x80) ? 4 : 0);
 			}
+			if (m_HeaderLen == HeaderSize) break;
+			if (o == BufferLen) return o;
+			uint32_t Len = std::min<uint32_t>(HeaderSize - m_HeaderLen, BufferLen - o);
+			std::copy(Buffer + o, Buffer + o + Len, m_Header + m_HeaderLen);
+			m_HeaderLen += Len;
+			o += Len;
+		}
+		m_HeaderLen = 0;
+		bool Fin = (Header[0] & 0x80) != 0;
+		uint32_t opCodes = Header[0] & 0xF;
+		uint64_t Len = Header[1] & 0x7F;
+		uint32_t p = 2;
+		if (Len == 126) {
+			Len = ((uint64_t)Header[2] << 8) | Header[3];
+			p = 4;
+		} else if (Len == 127) {
+			Len = 0;
+			for (; p < 10; p++) Len = (Len << 8) | Header[p];
+		}
+		m_Mask = 0;
+		if (Header[1] & 0x80) std::memcpy(&m_Mask, Header + p, sizeof(m_Mask));
+		if (opCodes == 1) m_ControlFlag |= CONTROL_TEXT;
+		else if (opCodes == 2) m_ControlFlag |= CONTROL_BINARY;
+		else if (opCodes == 8) m_ControlFlag |= CONTROL_CLOSED;
+		else if (opCodes == 9) m_ControlFlag |= CONTROL_PING;
+		else if (opCodes == 10) m_ControlFlag |= CONTROL_PONG;
+		else if (opCodes != 0) return -1;
+		//rsv1 marks a compressed message, and is only valid on the first frame of a data message.
+		if (Header[0] & 0x30) return -1;
+		if (Header[0] & 0x40) {
+			if (!opCodes || opCodes >= 8) return -1;
+			m_ControlFlag |= CONTROL_COMPRESSED;
 		}
+		//control frames can't be fragmented and carry at most 125 bytes.
+		if (opCodes >= 8 && (!Fin || Len > 125)) return -1;
+		if (Fin) m_ControlFlag |= CONTROL_FINISHED;
+		if (Len + m_DataPos > MaxDataLength) return -1;
+		bool Text = GetOp() == CONTROL_TEXT;
 		m_FramePos = m_DataPos;
-		if (opCode == CONTROL_TEXT) {
-			m_Data[Len] = '\0';
-			m_FramePos--;
+		m_FrameLen = (uint32_t)Len;
+		m_DataLen = m_DataPos + m_FrameLen;
+		uint32_t Remaining = BufferLen - o;
+		if (Source && Fin && !m_DataPos && m_FrameLen >= ZeroCopyLength && m_FrameLen <= Remaining && (!Text || m_FrameLen == Remaining)) {
+			//The whole message is in the receive buffer, unmask it in place and keep a reference rather then copying it out.
+			char *Payload = const_cast<char*>(Buffer) + o;
+			if (m_Mask) ApplyMask(Payload, m_FrameLen, m_Mask, 0);
+			if (m_Buffer) m_Buffer->Release();
+			m_Buffer = Source->AddRef();
+			m_Data = Payload;
+			m_DataPos = m_DataLen = m_FrameLen + (Text ? 1 : 0);
+			o += m_FrameLen;
+			m_FrameLen = 0;
+			return o;
 		}
-		return true;
-	};
-
-	if (m_DataPos != m_DataLen) {
-		ReadData(Buf);
-		return Buf.GetPosition();
+		if (!LWEWebPacketReserve(*this, m_DataLen + 1, Allocator)) return -1;
 	}
-	uint16_t Flag = Buf.Read<uint16_t>();
-	bool Fin = (Flag & 0x8000) != 0;
-	uint16_t opCodes = (Flag & 0xF00) >> 8;
-	bool Masked = (Flag & 0x80) != 0;
-	uint64_t Len = ((uint64_t)Flag) & 0x7F;
-	if (Len == 126) Len = (uint64_t)Buf.Read<uint16_t>();
-	else if (Len == 127) Len = Buf.Read<uint64_t>();
-	uint32_t Mask = Masked ? Buf.Read<uint32_t>() : 0;
-	//Order swap mask:
-	m_Mask = (Mask & 0xFF) << 24 | (Mask & 0xFF00) << 8 | (Mask & 0xFF0000) >> 8 | (Mask & 0xFF000000) >> 24;
-	if (opCodes == 1) m_ControlFlag |= CONTROL_TEXT;
-	else if (opCodes == 2) m_ControlFlag |= CONTROL_BINARY;
-	else if (opCodes == 8) m_ControlFlag |= CONTROL_CLOSED;
-	else if (opCodes == 9) m_ControlFlag |= CONTROL_PING;
-	else if (opCodes == 10) m_ControlFlag |= CONTROL_PONG;
-	else if(opCodes != 0) return -1;
-	if (Fin) m_ControlFlag |= CONTROL_FINISHED;
-	opCodes = GetOp();
-	if (m_DataLen) {
-		uint32_t l = m_DataLen;
-		l += (uint32_t)Len;
-		uint32_t DLen = l % 4;
-		DLen = l + (DLen == 0 ? 0 : 4 - DLen);
-		char *NewData = Allocator.AllocateArray<char>(DLen);
-		char *OldData = m_Data;
-		std::copy(OldData, OldData + m_DataLen, NewData);
-		m_Data = NewData;
-		m_DataLen = l;
-		if (opCodes == CONTROL_TEXT) m_DataPos--;
-		LWAllocator::Destroy(OldData);
-	} else {
-		LWAllocator::Destroy(m_Data);
-		m_DataLen = (uint32_t)Len;
-		if (opCodes == CONTROL_TEXT) m_DataLen++;
-		uint32_t DLen = m_DataLen % 4;
-		DLen = m_DataLen + (DLen == 0 ? 0 : 4 - DLen);
-		m_Data = Allocator.AllocateArray<char>(DLen);
+	uint32_t Len = std::min<uint32_t>(m_FrameLen, BufferLen - o);
+	char *Target = m_Data + m_DataPos;
+	std::copy(Buffer + o, Buffer + o + Len, Target);
+	if (m_Mask) ApplyMask(Target, Len, m_Mask, m_DataPos - m_FramePos);
+	m_DataPos += Len;
+	m_FrameLen -= Len;
+	o += Len;
+	if (m_FrameLen || GetOp() != CONTROL_TEXT) return o;
+	m_Data[m_DataPos] = '\0';
+	if (Finished()) {
+		m_DataPos++;
+		m_DataLen++;
 	}
-	ReadData(Buf);
-	return Buf.GetPosition();
+	return o;
 }
 
-uint32_t LWEWebPacket::Serialize(char *Buffer, uint32_t BufferLen, bool isClient) {
-	LWByteBuffer Buf((int8_t*)Buffer, BufferLen, LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
+uint32_t LWEWebPacket::SerializeHeader(char *Buffer, uint32_t BufferLen, bool isClient) {
+	if (BufferLen < MaxHeaderSize) return 0;
 	uint8_t ops[] = { 0, 1, 2, 8, 9, 10, 11 };
-	uint8_t Flag = ((m_ControlFlag&CONTROL_FINISHED)?0x80:0) | ops[(m_ControlFlag&~CONTROL_FINISHED)];
-	Buf.Write<uint8_t>(Flag);
-	uint8_t subFlag = isClient?0x80:0;
+	uint8_t *Header = (uint8_t*)Buffer;
+	uint32_t o = 0;
+	Header[o++] = ((m_ControlFlag&CONTROL_FINISHED) ? 0x80 : 0) | ((m_ControlFlag&CONTROL_COMPRESSED) ? 0x40 : 0) | ops[GetOp()];
+	uint8_t subFlag = isClient ? 0x80 : 0;
 	if (m_DataLen > 0xffff) {
-		subFlag |= 0x7F;
-		Buf.Write<uint8_t>(subFlag);
-		Buf.Write<uint64_t>(((uint64_t)m_DataLen)&0xFFFFFFFF);
+		Header[o++] = subFlag | 0x7F;
+		for (int32_t i = 7; i >= 0; i--) Header[o++] = (uint8_t)(((uint64_t)m_DataLen) >> (i * 8));
 	} else if (m_DataLen > 125) {
-		subFlag |= 0x7E;
-		Buf.Write<uint8_t>(subFlag);
-		Buf.Write<uint16_t>((uint16_t)m_DataLen);
-	} else {
-		subFlag |= (uint8_t)m_DataLen;
-		Buf.Write<uint8_t>(subFlag);
-	}
+		Header[o++] = subFlag | 0x7E;
+		Header[o++] = (uint8_t)(m_DataLen >> 8);
+		Header[o++] = (uint8_t)m_DataLen;
+	} else Header[o++] = subFlag | (uint8_t)m_DataLen;
 	if (isClient) {
-		uint32_t Mask = 0;
-
-		Buf.Write<uint32_t>(Mask);
-		
-		//Uncomment when doing proper maksing.
-		//uint32_t uMask = (Mask & 0xFF) << 24 | (Mask & 0xFF00) << 8 | (Mask & 0xFF0000) >> 8 | (Mask & 0xFF000000) >> 24;
-		//uint32_t *uData = (uint32_t*)m_Data;
-		//uint32_t uBytes = m_DataLen / 4 + (m_DataLen%4==0?0:1);
-		//for (uint32_t i = 0; i < uBytes; i++) uData[i] ^= uMask;
-		
+		m_Mask = LWEWebSocketMaskKey();
+		std::memcpy(Header + o, &m_Mask, sizeof(m_Mask));
+		o += sizeof(m_Mask);
+		if (m_Data) ApplyMask(m_Data, m_DataLen, m_Mask, 0);
 	}
-	Buf.Write<char>(m_DataLen, m_Data);
-	return Buf.GetPosition();
+	return o;
+}
+
+uint32_t LWEWebPacket::Serialize(char *Buffer, uint32_t BufferLen, bool isClient) {
+	uint32_t o = SerializeHeader(Buffer, BufferLen, isClient);
+	if (!o || BufferLen - o < m_DataLen) return 0;
+	if (m_DataLen) std::copy(m_Data, m_Data + m_DataLen, Buffer + o);
+	return o + m_DataLen;
 }
 
 uint32_t LWEWebPacket::GetOp(void) {
@@ -129,11 +194,14 @@ uint32_t LWEWebPacket::GetOp(void) {
 }
 
 void LWEWebPacket::WorkFinished(void) {
-	LWAllocator::Destroy(m_Data);
+	if (m_Buffer) m_Buffer->Release();
+	m_Buffer = nullptr;
 	m_Data = nullptr;
 	m_DataPos = 0;
 	m_DataLen = 0;
 	m_FramePos = 0;
+	m_FrameLen = 0;
+	m_HeaderLen = 0;
 	m_ControlFlag = 0;
 	return;
 }
@@ -143,58 +211,74 @@ bool LWEWebPacket::Finished(void) {
 }
 
 LWEWebPacket &LWEWebPacket::operator=(LWEWebPacket &&Other) {
-	LWAllocator::Destroy(m_Data);
+	if (&Other == this) return *this;
+	if (m_Buffer) m_Buffer->Release();
 	m_Data = Other.m_Data;
+	m_Buffer = Other.m_Buffer;
 	m_DataLen = Other.m_DataLen;
 	m_ControlFlag = Other.m_ControlFlag;
 	m_WebSocket = Other.m_WebSocket;
 	m_Mask = Other.m_Mask;
 	m_DataPos = Other.m_DataPos;
 	m_FramePos = Other.m_FramePos;
+	m_FrameLen = Other.m_FrameLen;
+	m_HeaderLen = Other.m_HeaderLen;
+	std::copy(Other.m_Header, Other.m_Header + MaxHeaderSize, m_Header);
 	Other.m_Data = nullptr;
+	Other.m_Buffer = nullptr;
 	Other.m_DataLen = 0;
 	Other.m_ControlFlag = 0;
 	Other.m_DataPos = 0;
 	Other.m_FramePos = 0;
+	Other.m_FrameLen = 0;
+	Other.m_HeaderLen = 0;
 	Other.m_Mask = 0;
 	Other.m_WebSocket = nullptr;
 	return *this;
 }
 
 LWEWebPacket &LWEWebPacket::operator = (const LWEWebPacket &Other) {
+	if (Other.m_Buffer) Other.m_Buffer->AddRef();
+	if (m_Buffer) m_Buffer->Release();
 	m_Data = Other.m_Data;
+	m_Buffer = Other.m_Buffer;
 	m_Mask = Other.m_Mask;
 	m_DataPos = Other.m_DataPos;
 	m_DataLen = Other.m_DataLen;
 	m_FramePos = Other.m_FramePos;
+	m_FrameLen = Other.m_FrameLen;
+	m_HeaderLen = Other.m_HeaderLen;
+	std::copy(Other.m_Header, Other.m_Header + MaxHeaderSize, m_Header);
 	m_ControlFlag = Other.m_ControlFlag;
 	m_WebSocket = Other.m_WebSocket;
 	return *this;
 }
 
-LWEWebPacket::LWEWebPacket() : m_Data(nullptr), m_DataPos(0), m_DataLen(0), m_FramePos(0), m_ControlFlag(0), m_WebSocket(nullptr) {}
+LWEWebPacket::LWEWebPacket() : m_Data(nullptr), m_Buffer(nullptr), m_DataLen(0), m_DataPos(0), m_FramePos(0), m_FrameLen(0), m_ControlFlag(0), m_Mask(0), m_HeaderLen(0), m_WebSocket(nullptr) {}
 
-LWEWebPacket::LWEWebPacket(LWEWebPacket &&Other) : m_Data(Other.m_Data), m_DataPos(Other.m_DataPos), m_FramePos(Other.m_FramePos), m_DataLen(Other.m_DataLen), m_Mask(Other.m_Mask), m_ControlFlag(Other.m_ControlFlag), m_WebSocket(Other.m_WebSocket) {
-	Other.m_Data = nullptr;
-	Other.m_DataPos = 0;
-	Other.m_DataLen = 0;
-	Other.m_FramePos = 0;
-	Other.m_Mask = 0;
-	Other.m_ControlFlag = 0;
-	Other.m_WebSocket = nullptr;
+LWEWebPacket::LWEWebPacket(LWEWebPacket &&Other) : m_Data(nullptr), m_Buffer(nullptr), m_DataLen(0), m_DataPos(0), m_FramePos(0), m_FrameLen(0), m_ControlFlag(0), m_Mask(0), m_HeaderLen(0), m_WebSocket(nullptr) {
+	*this = std::move(Other);
 }
 
-LWEWebPacket::LWEWebPacket(const char *Data, uint32_t DataLen, LWAllocator &Allocator, uint32_t ControlFlag, LWEWebSocket *WebSocket) : m_Data(nullptr), m_DataLen(DataLen), m_DataPos(0), m_FramePos(0), m_Mask(0), m_ControlFlag(ControlFlag), m_WebSocket(WebSocket) {
+LWEWebPacket::LWEWebPacket(const LWEWebPacket &Other) : m_Data(nullptr), m_Buffer(nullptr), m_DataLen(0), m_DataPos(0), m_FramePos(0), m_FrameLen(0), m_ControlFlag(0), m_Mask(0), m_HeaderLen(0), m_WebSocket(nullptr) {
+	*this = Other;
+}
+
+LWEWebPacket::LWEWebPacket(const char *Data, uint32_t DataLen, LWAllocator &Allocator, uint32_t ControlFlag, LWEWebSocket *WebSocket) : m_Data(nullptr), m_Buffer(nullptr), m_DataLen(DataLen), m_DataPos(0), m_FramePos(0), m_FrameLen(0), m_ControlFlag(ControlFlag), m_Mask(0), m_HeaderLen(0), m_WebSocket(WebSocket) {
 	if (Data) {
-		uint32_t DLen = DataLen % 4;
-		DLen = DataLen + (DLen == 0 ? 0 : (4 - DLen));
-		m_Data = Allocator.AllocateArray<char>(DLen);
+		m_Buffer = LWEHttpBuffer::Make(DataLen + 1, Allocator);
+		if (!m_Buffer) {
+			m_DataLen = 0;
+			return;
+		}
+		m_Data = m_Buffer->GetData();
 		std::copy(Data, Data + m_DataLen, m_Data);
+		m_Data[m_DataLen] = '\0';
 	}
 }
 
 LWEWebPacket::~LWEWebPacket() {
-	LWAllocator::Destroy(m_Data);
+	if (m_Buffer) m_Buffer->Release();
 }
 
 LWEWebSocket &LWEWebSocket::SetURI(const char *URI) {
@@ -303,17 +387,213 @@ bool LWEWebSocket::IsConnected(void) {
 	return lStatus == CONNECTED_CLIENT || lStatus == CONNECTED_SERVER;
 }
 
+/*! \cond */
+struct LWEWebSocketDeflateParams {
+	uint32_t m_Flag = 0;
+	uint32_t m_ServerWindowBits = 0;
+	uint32_t m_ClientWindowBits = 0;
+	bool m_Valid = false;
+};
+/*! \endcond */
+
+//Parses one extension of a Sec-WebSocket-Extensions list, Params is only valid if it is a well formed permessage-deflate entry.  returns the start of the next extension, or null at the end of the list.
+inline const char *LWEWebSocketParseDeflate(const char *Ext, LWEWebSocketDeflateParams &Params) {
+	auto SkipSpace = [](const char *C) -> const char* {
+		while (*C == ' ' || *C == '\t') C++;
+		return C;
+	};
+	auto Is = [](const char *Name, uint32_t NameLen, const char *Target) -> bool {
+		return NameLen == strlen(Target) && !strncmp(Name, Target, NameLen);
+	};
+	Params = LWEWebSocketDeflateParams();
+	bool Valid = true;
+	const char *C = Ext;
+	for (uint32_t i = 0;; i++) {
+		C = SkipSpace(C);
+		const char *Name = C;
+		while (*C && *C != ';' && *C != ',' && *C != '=' && *C != ' ' && *C != '\t') C++;
+		uint32_t NameLen = (uint32_t)(C - Name);
+		C = SkipSpace(C);
+		uint32_t Value = 0;
+		bool HasValue = *C == '=';
+		if (HasValue) {
+			C = SkipSpace(C + 1);
+			bool Quoted = *C == '"';
+			if (Quoted) C++;
+			const char *Digits = C;
+			for (; *C >= '0' && *C <= '9'; C++) Value = std::min<uint32_t>(Value * 10 + (uint32_t)(*C - '0'), 100);
+			if (Quoted && *C == '"') C++;
+			C = SkipSpace(C);
+			if (C == Digits) Valid = false;
+		}
+		if (!i) Valid = Valid && !HasValue && Is(Name, NameLen, "permessage-deflate");
+		else if (Is(Name, NameLen, "server_no_context_takeover") && !HasValue && !(Params.m_Flag&LWEWebSocket::ServerNoContextTakeover)) Params.m_Flag |= LWEWebSocket::ServerNoContextTakeover;
+		else if (Is(Name, NameLen, "client_no_context_takeover") && !HasValue && !(Params.m_Flag&LWEWebSocket::ClientNoContextTakeover)) Params.m_Flag |= LWEWebSocket::ClientNoContextTakeover;
+		else if (Is(Name, NameLen, "server_max_window_bits") && HasValue && !Params.m_ServerWindowBits && Value >= 8 && Value <= LWEWebSocket::MaxWindowBits) Params.m_ServerWindowBits = Value;
+		else if (Is(Name, NameLen, "client_max_window_bits") && !Params.m_ClientWindowBits && (!HasValue || (Value >= 8 && Value <= LWEWebSocket::MaxWindowBits))) Params.m_ClientWindowBits = HasValue ? Value : LWEWebSocket::MaxWindowBits;
+		else Valid = false;
+		while (*C && *C != ';' && *C != ',') {
+			Valid = false;
+			C++;
+		}
+		if (*C != ';') break;
+		C++;
+	}
+	Params.m_Valid = Valid;
+	return *C == ',' ? C + 1 : nullptr;
+}
+
+bool LWEWebSocket::isClient(void) {
+	uint32_t lStatus = GetConnectStatus();
+	return lStatus == CONNECTED_CLIENT || lStatus == CONNECTING_CLIENT;
+}
+
+bool LWEWebSocket::AcceptDeflateOffer(const char *Offers, uint32_t Flag, uint32_t WindowBits) {
+	m_Flag &= ~DEFLATEBITS;
+	if (!(Flag&PerMessageDeflate)) return false;
+	for (const char *C = Offers; C;) {
+		LWEWebSocketDeflateParams Params;
+		C = LWEWebSocketParseDeflate(C, Params);
+		if (!Params.m_Valid) continue;
+		//the server must not use a larger window then the client asked for.
+		uint32_t Bits = std::min<uint32_t>(WindowBits, Params.m_ServerWindowBits ? Params.m_ServerWindowBits : MaxWindowBits);
+		if (Bits < MinWindowBits) continue;
+		m_Flag |= PerMessageDeflate | ((Params.m_Flag | Flag)&(ServerNoContextTakeover | ClientNoContextTakeover));
+		m_DeflateWindowBits = Bits;
+		return true;
+	}
+	return false;
+}
+
+bool LWEWebSocket::AcceptDeflateResponse(const char *Response) {
+	bool Offered = (m_Flag&PerMessageDeflate) != 0;
+	m_Flag &= ~DEFLATEBITS;
+	if (!Response || !*Response) return true;
+	LWEWebSocketDeflateParams Params;
+	const char *Next = LWEWebSocketParseDeflate(Response, Params);
+	if (!Offered || !Params.m_Valid || Next) return false;
+	if (Params.m_ClientWindowBits) {
+		if (Params.m_ClientWindowBits < MinWindowBits) return false;
+		m_DeflateWindowBits = std::min<uint32_t>(m_DeflateWindowBits, Params.m_ClientWindowBits);
+	}
+	m_Flag |= PerMessageDeflate | Params.m_Flag;
+	return true;
+}
+
+uint32_t LWEWebSocket::WriteDeflateExtension(char *Buffer, uint32_t BufferLen) {
+	if (!(m_Flag&PerMessageDeflate) || !BufferLen) return 0;
+	uint32_t o = snprintf(Buffer, BufferLen, "permessage-deflate");
+	if (isClient()) {
+		if (m_DeflateWindowBits < MaxWindowBits) o += snprintf(Buffer + o, BufferLen - o, "; client_max_window_bits=%d", m_DeflateWindowBits);
+		else o += snprintf(Buffer + o, BufferLen - o, "; client_max_window_bits");
+	} else if (m_DeflateWindowBits < MaxWindowBits) o += snprintf(Buffer + o, BufferLen - o, "; server_max_window_bits=%d", m_DeflateWindowBits);
+	if (m_Flag&ServerNoContextTakeover) o += snprintf(Buffer + o, BufferLen - o, "; server_no_context_takeover");
+	if (m_Flag&ClientNoContextTakeover) o += snprintf(Buffer + o, BufferLen - o, "; client_no_context_takeover");
+	return std::min<uint32_t>(o, BufferLen - 1);
+}
+
+bool LWEWebSocket::Deflate(LWEWebPacket &Packet, LWAllocator &Allocator) {
+	if (!(m_Flag&PerMessageDeflate)) return false;
+	bool Reset = (m_Flag&(isClient() ? ClientNoContextTakeover : ServerNoContextTakeover)) != 0;
+	if (!m_Deflater) {
+		m_Deflater = Allocator.Allocate<LWEHttpZStream>(LWEHttpZStream::Deflate, Allocator);
+		Reset = true;
+	}
+	if (!m_Deflater || (Reset && !m_Deflater->BeginRaw(m_DeflateWindowBits))) return false;
+	LWEWebPacket Out;
+	auto Write = [&Out, &Allocator](const char *Data, uint32_t Len) -> bool {
+		if (!LWEWebPacketReserve(Out, Out.m_DataPos + Len, Allocator)) return false;
+		std::copy(Data, Data + Len, Out.m_Data + Out.m_DataPos);
+		Out.m_DataPos += Len;
+		return true;
+	};
+	if (!m_Deflater->Write(Packet.m_Data, Packet.m_DataLen, false, Write) || !m_Deflater->Flush(Write)) return false;
+	//the sync flush always ends with an empty stored block(00 00 ff ff) which is left for the receiver to append.
+	if (Out.m_DataPos < 4) return false;
+	if (Packet.m_Buffer) Packet.m_Buffer->Release();
+	Packet.m_Buffer = Out.m_Buffer;
+	Packet.m_Data = Out.m_Data;
+	Packet.m_DataLen = Out.m_DataPos - 4;
+	Packet.m_ControlFlag |= LWEWebPacket::CONTROL_COMPRESSED;
+	Out.m_Buffer = nullptr;
+	return true;
+}
+
+bool LWEWebSocket::Inflate(LWEWebPacket &Packet, LWAllocator &Allocator) {
+	const char Tail[] = { 0x00, 0x00, (char)0xFF, (char)0xFF };
+	if (!(m_Flag&PerMessageDeflate)) return false;
+	//a peer may end it's stream with a final block, in which case the next message starts a new one.
+	bool Reset = !m_Inflater || m_Inflater->isEnded();
+	if (!m_Inflater) m_Inflater = Allocator.Allocate<LWEHttpZStream>(LWEHttpZStream::Inflate, Allocator);
+	if (!m_Inflater || (Reset && !m_Inflater->BeginRaw(MaxWindowBits))) return false;
+	bool Text = Packet.GetOp() == LWEWebPacket::CONTROL_TEXT;
+	LWEWebPacket Out;
+	auto Write = [&Out, &Allocator](const char *Data, uint32_t Len) -> bool {
+		if ((uint64_t)Out.m_DataPos + Len > LWEWebPacket::MaxDataLength) return false;
+		if (!LWEWebPacketReserve(Out, Out.m_DataPos + Len + 1, Allocator)) return false;
+		std::copy(Data, Data + Len, Out.m_Data + Out.m_DataPos);
+		Out.m_DataPos += Len;
+		return true;
+	};
+	if (!m_Inflater->Write(Packet.m_Data, Packet.m_DataLen - (Text ? 1 : 0), false, Write)) return false;
+	if (!m_Inflater->Write(Tail, sizeof(Tail), false, Write)) return false;
+	if (!LWEWebPacketReserve(Out, Out.m_DataPos + 1, Allocator)) return false;
+	Out.m_Data[Out.m_DataPos] = '\0';
+	if (Packet.m_Buffer) Packet.m_Buffer->Release();
+	Packet.m_Buffer = Out.m_Buffer;
+	Packet.m_Data = Out.m_Data;
+	Packet.m_DataPos = Packet.m_DataLen = Out.m_DataPos + (Text ? 1 : 0);
+	Packet.m_ControlFlag &= ~LWEWebPacket::CONTROL_COMPRESSED;
+	Out.m_Buffer = nullptr;
+	return true;
+}
+
+bool LWEWebSocket::ReadFrames(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWAllocator &Allocator, LWEHttpBuffer *Source, const std::function<bool(LWEWebPacket &)> &Received) {
+	uint32_t o = 0;
+	while (o != BufferLen) {
+		//A frame with the control bit in it's opcode goes to m_ControlPacket, which may arrive between the fragments of m_ActivePacket.
+		bool isControl = m_ControlPacket.m_HeaderLen || m_ControlPacket.m_FrameLen || (!m_ActivePacket.m_HeaderLen && !m_ActivePacket.m_FrameLen && (Buffer[o] & 0x8));
+		LWEWebPacket &Packet = isControl ? m_ControlPacket : m_ActivePacket;
+		uint32_t Res = Packet.Deserialize(Buffer + o, BufferLen - o, Allocator, Source);
+		if (Res == -1) {
+			std::cout << "Error deserializing data." << std::endl;
+			return false;
+		}
+		o += Res;
+		if (!Packet.Finished()) continue;
+		if (Packet.m_DataLen != Packet.m_DataPos) continue;
+		if (Packet.GetOp() == LWEWebPacket::CONTROL_CLOSED) {
+			Packet.WorkFinished();
+			Socket.MarkClosable();
+			return true;
+		} else if (Packet.GetOp() == LWEWebPacket::CONTROL_PONG) {
+			Packet.WorkFinished();
+			continue;
+		}
+		if ((Packet.m_ControlFlag&LWEWebPacket::CONTROL_COMPRESSED) && !Inflate(Packet, Allocator)) {
+			std::cout << "Error inflating message." << std::endl;
+			Socket.MarkClosable();
+			return false;
+		}
+		Packet.m_WebSocket = this;
+		if (!Received(Packet)) return false;
+	}
+	return true;
+}
+
 LWEWebSocket::LWEWebSocket(const char *URI, const char *Origin) : m_Socket(nullptr), m_Flag(0), m_Port(80) {
 	*m_Host = *m_Path = *m_Origin = *m_SecKey = *m_SecProtocols = '\0';
 	if (URI) SetURI(URI);
 	if (Origin) SetOrigin(Origin);
 }
 
-LWEWebSocket::~LWEWebSocket() {}
+LWEWebSocket::~LWEWebSocket() {
+	LWAllocator::Destroy(m_Deflater);
+	LWAllocator::Destroy(m_Inflater);
+}
 
 LWProtocol &LWEProtocolWebSocket::Read(LWSocket &Socket, LWProtocolManager *Manager) {
 	char IPBuf[32];
-	char Buffer[64 * 1024]; //64 kb buffer!
 	if (Socket.GetFlag()&LWSocket::Listen){
 		LWSocket Accepted;
 		if (!Socket.Accept(Accepted)) {
@@ -325,16 +605,28 @@ LWProtocol &LWEProtocolWebSocket::Read(LWSocket &Socket, LWProtocolManager *Mana
 		if (!Res) std::cout << "Error inserting socket into protocol manager." << std::endl;
 		return *this;
 	}
-	uint32_t r = Socket.Receive(Buffer, sizeof(Buffer));
+	//packets may still reference the last receive buffer, in which case a fresh one is made.
+	if (m_ReceiveBuffer && m_ReceiveBuffer->isShared()) {
+		m_ReceiveBuffer->Release();
+		m_ReceiveBuffer = nullptr;
+	}
+	if (!m_ReceiveBuffer) m_ReceiveBuffer = LWEHttpBuffer::Make(ReceiveBufferSize + 1, m_Allocator);
+	if (!m_ReceiveBuffer) {
+		std::cout << "Error allocating receive buffer." << std::endl;
+		return *this;
+	}
+	char *Buffer = m_ReceiveBuffer->GetData();
+	uint32_t r = Socket.Receive(Buffer, ReceiveBufferSize);
 	if (r == 0xFFFFFFFF) {
 		Socket.MarkClosable();
 		return *this;
 	}
-	ProcessRead(Socket, Buffer, r);
+	Buffer[r] = '\0';
+	ProcessRead(Socket, Buffer, r, m_ReceiveBuffer);
 	return *this;
 }
 
-bool LWEProtocolWebSocket::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen) {
+bool LWEProtocolWebSocket::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWEHttpBuffer *Source) {
 	char Buf[256];
 	char BufB[256];
 	LWEWebSocket *WebSocket = (LWEWebSocket*)Socket.GetProtocolData(m_ProtocolID);
@@ -377,6 +669,7 @@ bool LWEProtocolWebSocket::ProcessRead(LWSocket &Socket, const char *Buffer, uin
 		WebSocket->SetPath(Request.m_Path);
 		WebSocket->SetOrigin(Request.m_Origin);
 		WebSocket->m_Flag |= LWEWebSocket::CONNECTING_SERVER;
+		WebSocket->AcceptDeflateOffer(Request.m_SecWebSockExt, m_DeflateFlag, m_DeflateWindowBits);
 		Socket.SetProtocolData(m_ProtocolID, WebSocket);
 		PushOutPacket(nullptr, 0, WebSocket, LWEWebPacket::CONTROL_CONNECT);
 		return true;
@@ -387,11 +680,13 @@ bool LWEProtocolWebSocket::ProcessRead(LWSocket &Socket, const char *Buffer, uin
 			uint32_t Error = 0;
 			Error = Request.Deserialize(Buffer, BufferLen) ? 0 : 1;
 			Error = Error ? Error : ((*Request.m_SecWebSockKey && Request.m_Status == LWEHttpRequest::SwitchingProtocols) ? 0 : 2);
+			Error = Error ? Error : (WebSocket->AcceptDeflateResponse(Request.m_SecWebSockExt) ? 0 : 3);
 			//we should probably also validate the key....
 			
 			if (Error) {
 				if (Error == 1) std::cout << "Error deserializing websocket request." << std::endl;
 				else if (Error == 2) std::cout << "Error headers did not include correct websocket data." << std::endl;
+				else if (Error == 3) std::cout << "Error server responded with unsupported extensions: '" << Request.m_SecWebSockExt << "'" << std::endl;
 				Socket.MarkClosable();
 				return false;
 			}
@@ -402,44 +697,33 @@ bool LWEProtocolWebSocket::ProcessRead(LWSocket &Socket, const char *Buffer, uin
 	char IPBuf[32];
 	LWSocket::MakeAddress(Socket.GetRemoteIP(), IPBuf, sizeof(IPBuf));
 	if (BufferLen > 100) {}
-	LWEWebPacket *OPack;
-	uint32_t Target;
-	uint32_t ReservePos;
-	uint32_t o = 0;
-	while (o != BufferLen) {
-		uint32_t Res = WebSocket->m_ActivePacket.Deserialize(Buffer + o, BufferLen - o, m_Allocator);
-		if (Res == -1) {
-			std::cout << "Error deserializing data." << std::endl;
-			return false;
-		}
-		o += Res;
-		if (!WebSocket->m_ActivePacket.Finished()) continue;
-		if (WebSocket->m_ActivePacket.m_DataLen != WebSocket->m_ActivePacket.m_DataPos) continue;
-		if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_CLOSED) {
-			WebSocket->m_ActivePacket.WorkFinished();
-			Socket.MarkClosable();
-			return true;
-		} else if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_PING) {
-			WebSocket->m_ActivePacket.WorkFinished();
+	return WebSocket->ReadFrames(Socket, Buffer, BufferLen, m_Allocator, Source, [this, WebSocket](LWEWebPacket &Packet) {
+		if (Packet.GetOp() == LWEWebPacket::CONTROL_PING) {
+			Packet.WorkFinished();
 			PushOutPacket(nullptr, 0, WebSocket, LWEWebPacket::CONTROL_PONG);
-			continue;
-		} else if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_PONG) {
-			WebSocket->m_ActivePacket.WorkFinished();
-			continue;
+			return true;
 		}
-		WebSocket->m_ActivePacket.m_WebSocket = WebSocket;
+		LWEWebPacket *OPack;
+		uint32_t Target;
+		uint32_t ReservePos;
 		if (!m_InPackets.PushStart(&OPack, Target, ReservePos)) return false;
-		*OPack = std::move(WebSocket->m_ActivePacket);
+		*OPack = std::move(Packet);
 		m_InPackets.PushFinished(Target, ReservePos);
-	}
-	return true;
+		return true;
+	});
 }
 
 LWProtocol &LWEProtocolWebSocket::SocketClosed(LWSocket &Socket, LWProtocolManager *Manager) {
 	LWEWebSocket *WebSock = (LWEWebSocket*)Socket.GetProtocolData(m_ProtocolID);
 	bool Del = true;
 	if(m_WebSocketClosedCallback) Del = m_WebSocketClosedCallback(Socket, WebSock, Manager);
-	if (WebSock) WebSock->m_Socket = nullptr;
+	if (WebSock) {
+		WebSock->m_Socket = nullptr;
+		if (!WebSock->m_PendingPackets.empty()) {
+			WebSock->m_PendingPackets.clear();
+			m_PendingSockets.erase(std::remove(m_PendingSockets.begin(), m_PendingSockets.end(), WebSock), m_PendingSockets.end());
+		}
+	}
 	if (Del) LWAllocator::Destroy(WebSock);
 	return *this;
 }
@@ -453,14 +737,33 @@ LWProtocol &LWEProtocolWebSocket::SocketChanged(LWSocket &Prev, LWSocket &New, L
 }
 
 bool LWEProtocolWebSocket::Send(LWSocket &Socket, const char *Buffer, uint32_t Len) {
-	for (uint32_t o = 0; o < Len;) {
-		int32_t r = Socket.Send(Buffer + o, Len - o);
-		if (r == -1) {
-			std::cout << "Error sending: " << Socket.GetSocketDescriptor() << " " << std::endl;
+	if (!Socket.Queue(Buffer, Len)) {
+		std::cout << "Error sending: " << Socket.GetSocketDescriptor() << " " << std::endl;
+		return false;
+	}
+	if (m_FlushList.empty() || m_FlushList.back() != &Socket) m_FlushList.push_back(&Socket);
+	return true;
+}
+
+bool LWEProtocolWebSocket::QueueFrame(LWEWebPacket &Packet, char *Buffer, uint32_t BufferLen) {
+	LWEWebSocket *Sock = Packet.m_WebSocket;
+	LWSocket *rSock = Sock->m_Socket;
+	uint32_t Op = Packet.GetOp();
+	if ((Sock->m_Flag&LWEWebSocket::PerMessageDeflate) && (Op == LWEWebPacket::CONTROL_TEXT || Op == LWEWebPacket::CONTROL_BINARY) && Packet.m_DataLen >= m_DeflateMinLength && !(Packet.m_ControlFlag&LWEWebPacket::CONTROL_COMPRESSED)) {
+		if (!Sock->Deflate(Packet, m_Allocator)) {
+			std::cout << "Error compressing message." << std::endl;
+			rSock->MarkClosable();
 			return false;
 		}
-		o += (uint32_t)r;
 	}
+	//the header and payload are queued as one gather write, the socket's queue copies small frames together and large payloads are sent straight from the packet.
+	LWSocketBuffer Buffers[2] = { { Buffer, Packet.SerializeHeader(Buffer, BufferLen, Sock->GetConnectStatus() == LWEWebSocket::CONNECTED_CLIENT) }, { Packet.m_Data, Packet.m_DataLen } };
+	if (!rSock->Queue(Buffers, 2)) {
+		std::cout << "Error sending: " << rSock->GetSocketDescriptor() << std::endl;
+		rSock->MarkClosable();
+		return false;
+	}
+	if (m_FlushList.empty() || m_FlushList.back() != rSock) m_FlushList.push_back(rSock);
 	return true;
 }
 
@@ -469,17 +772,32 @@ LWEProtocolWebSocket &LWEProtocolWebSocket::ProcessOutPackets(void) {
 	LWEWebPacket *Pack;
 	uint32_t Target;
 	uint32_t ReservePos;
+	//Frames held back on an earlier pass go out first, so each socket's frames keep the order they were pushed in.
+	for (uint32_t i = 0; i < m_PendingSockets.size();) {
+		LWEWebSocket *Sock = m_PendingSockets[i];
+		while (!Sock->m_PendingPackets.empty() && Sock->IsConnected() && Sock->m_Socket->isWritable() && !(Sock->m_Socket->GetFlag()&LWSocket::Closeable)) {
+			QueueFrame(Sock->m_PendingPackets.front(), Buffer, sizeof(Buffer));
+			Sock->m_PendingPackets.pop_front();
+		}
+		if (!Sock->m_PendingPackets.empty()) {
+			i++;
+			continue;
+		}
+		m_PendingSockets[i] = m_PendingSockets.back();
+		m_PendingSockets.pop_back();
+	}
 	while (m_OutPackets.PopStart(&Pack, Target, ReservePos)) {
 		LWEWebPacket RPack = std::move(*Pack);
 		m_OutPackets.PopFinshed(Target, ReservePos);
 		LWEWebSocket *Sock = RPack.m_WebSocket;
 		if (!Sock->IsConnected() && (RPack.m_ControlFlag&LWEWebPacket::CONTROL_CONNECT)) {
-			if (!Sock->m_Socket) return *this;
+			if (!Sock->m_Socket) continue;
 			LWEHttpRequest Request;
 			Request.SetWebSockKey(Sock->m_SecKey);
 			Request.SetWebSockProto(m_SubProtocol);
 			Request.m_Flag |= LWEHttpRequest::ConnectionUpgrade | LWEHttpRequest::UpgradeWebSock;
 			Request.m_Status = Sock->GetConnectStatus() == LWEWebSocket::CONNECTING_SERVER ? LWEHttpRequest::SwitchingProtocols : 0;
+			Sock->WriteDeflateExtension(Request.m_SecWebSockExt, sizeof(Request.m_SecWebSockExt));
 			if (Sock->GetConnectStatus() == LWEWebSocket::CONNECTING_CLIENT) {
 				Request.SetHost(Sock->m_Host).SetPath(Sock->m_Path).SetOrigin(Sock->m_Origin);
 				Request.m_WebSockVersion = LWEWEBSOCKET_SUPPVER;
@@ -487,24 +805,32 @@ LWEProtocolWebSocket &LWEProtocolWebSocket::ProcessOutPackets(void) {
 			uint32_t Len = Request.Serialize(Buffer, sizeof(Buffer), Sock->GetConnectStatus()==LWEWebSocket::CONNECTED_CLIENT?m_UserAgent:m_Server);
 			if (!Send(*Sock->m_Socket, Buffer, Len)) {
 				std::cout << "Error sending data." << std::endl;
-				return *this;
+				continue;
 			}
 		}
 		if (RPack.m_ControlFlag&LWEWebPacket::CONTROL_CONNECT) continue; //discard as this was just to complete the upgrade transaction.
-		if(!Sock->IsConnected()){
-			if (!m_OutPackets.PushStart(&Pack, Target, ReservePos)) {
-				std::cout << "Error re-inserting packet." << std::endl;
-				return *this;
+		LWSocket *rSock = Sock->m_Socket;
+		if (!rSock) continue;
+		//Hold the frame back while the connection is still upgrading, or while the peer is not keeping up, only this socket's later frames wait behind it.
+		if (!Sock->m_PendingPackets.empty() || !Sock->IsConnected() || !rSock->isWritable()) {
+			if (Sock->m_PendingPackets.size() >= LWEWebSocket::MaxPendingPackets) {
+				std::cout << "Error socket is not keeping up: " << rSock->GetSocketDescriptor() << std::endl;
+				rSock->MarkClosable();
+				continue;
 			}
-			*Pack = std::move(RPack);
-			m_OutPackets.PushFinished(Target, ReservePos);
-			return *this; //break and let some time pass before we try again.
+			if (Sock->m_PendingPackets.empty()) m_PendingSockets.push_back(Sock);
+			Sock->m_PendingPackets.push_back(std::move(RPack));
+			continue;
 		}
-		LWSocket *rSock = RPack.m_WebSocket->m_Socket;
-		if(!rSock) continue;
-		uint32_t Len = RPack.Serialize(Buffer, sizeof(Buffer), Sock->GetConnectStatus() == LWEWebSocket::CONNECTED_CLIENT);
-		Send(*rSock, Buffer, Len);
+		QueueFrame(RPack, Buffer, sizeof(Buffer));
+	}
+	//Every frame queued this pass goes out together, one gather write per socket.
+	std::sort(m_FlushList.begin(), m_FlushList.end());
+	m_FlushList.erase(std::unique(m_FlushList.begin(), m_FlushList.end()), m_FlushList.end());
+	for (auto &&S : m_FlushList) {
+		if (!m_Manager->Flush(*S)) S->MarkClosable();
 	}
+	m_FlushList.clear();
 	return *this;
 }
 
@@ -522,7 +848,8 @@ LWEWebSocket *LWEProtocolWebSocket::OpenSocket(const char *URI, uint32_t Protoco
 	}
 	LWSocket *S = m_Manager->PushSocket(Sock);
 	LWEWebSocket *WebSock = m_Allocator.Allocate<LWEWebSocket>(URI, Origin);
-	WebSock->m_Flag |= LWEWebSocket::CONNECTING_CLIENT;
+	WebSock->m_Flag |= LWEWebSocket::CONNECTING_CLIENT | m_DeflateFlag;
+	WebSock->m_DeflateWindowBits = m_DeflateWindowBits;
 	WebSock->GenerateKey(m_KeySeed++);
 	S->SetProtocolData(m_ProtocolID, WebSock);
 	WebSock->m_Socket = S;
@@ -569,6 +896,13 @@ LWEProtocolWebSocket &LWEProtocolWebSocket::SetSubProtocol(const char *SubProtoc
 	return *this;
 }
 
+LWEProtocolWebSocket &LWEProtocolWebSocket::SetPerMessageDeflate(uint32_t Flag, uint32_t MinLength, uint32_t WindowBits) {
+	m_DeflateFlag = (Flag&LWEWebSocket::PerMessageDeflate) ? (Flag&LWEWebSocket::DEFLATEBITS) : 0;
+	m_DeflateMinLength = MinLength;
+	m_DeflateWindowBits = std::min<uint32_t>(std::max<uint32_t>(WindowBits, LWEWebSocket::MinWindowBits), LWEWebSocket::MaxWindowBits);
+	return *this;
+}
+
 LWEProtocolWebSocket &LWEProtocolWebSocket::SetWebSocketClosedCallback(std::function<bool(LWSocket &, LWEWebSocket*, LWProtocolManager*)> WebSocketClosedCallback) {
 	m_WebSocketClosedCallback = WebSocketClosedCallback;
 	return *this;
@@ -583,4 +917,8 @@ LWEProtocolWebSocket::LWEProtocolWebSocket(uint32_t ProtocolID, LWAllocator &All
 	*m_Server = *m_UserAgent = *m_SubProtocol = '\0';
 	m_WebSocketClosedCallback = nullptr;
 	m_WebSocketChangedCallback = nullptr;
+}
+
+LWEProtocolWebSocket::~LWEProtocolWebSocket() {
+	if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
 }
\ No newline at end of file
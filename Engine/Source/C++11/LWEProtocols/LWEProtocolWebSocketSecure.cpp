@@ -7,9 +7,10 @@
 #include <LWCore/LWText.h>
 #include <LWCore/LWByteBuffer.h>
 #include <iostream>
+#include <algorithm>
 
 
-bool LWEProtocolWebSocketSecure::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen) {
+bool LWEProtocolWebSocketSecure::ProcessRead(LWSocket &Socket, const char *Buffer, uint32_t BufferLen, LWEHttpBuffer *Source) {
 	char Buf[256];
 	char BufB[256];
 	LWEWebSocket *WebSocket = (LWEWebSocket*)Socket.GetProtocolData(m_wProtocolID);
@@ -52,6 +53,7 @@ bool LWEProtocolWebSocketSecure::ProcessRead(LWSocket &Socket, const char *Buffe
 		WebSocket->SetPath(Request.m_Path);
 		WebSocket->SetOrigin(Request.m_Origin);
 		WebSocket->m_Flag |= LWEWebSocket::CONNECTING_SERVER;
+		WebSocket->AcceptDeflateOffer(Request.m_SecWebSockExt, m_DeflateFlag, m_DeflateWindowBits);
 		Socket.SetProtocolData(m_wProtocolID, WebSocket);
 		PushOutPacket(nullptr, 0, WebSocket, LWEWebPacket::CONTROL_CONNECT);
 		return true;
@@ -62,12 +64,14 @@ bool LWEProtocolWebSocketSecure::ProcessRead(LWSocket &Socket, const char *Buffe
 			uint32_t Error = 0;
 			Error = Request.Deserialize(Buffer, BufferLen) ? 0 : 1;
 			Error = Error ? Error : ((*Request.m_SecWebSockKey && Request.m_Status == LWEHttpRequest::SwitchingProtocols) ? 0 : 2);
+			Error = Error ? Error : (WebSocket->AcceptDeflateResponse(Request.m_SecWebSockExt) ? 0 : 3);
 			//we should probably also validate the key....
 
 			if (Error) {
 				std::cout << "Buffer:" << std::endl << Buffer << std::endl;
 				if (Error == 1) std::cout << "Error deserializing websocket request." << std::endl;
 				else if (Error == 2) std::cout << "Error headers did not include correct websocket data." << std::endl;
+				else if (Error == 3) std::cout << "Error server responded with unsupported extensions: '" << Request.m_SecWebSockExt << "'" << std::endl;
 				Socket.MarkClosable();
 				return false;
 			}
@@ -78,37 +82,20 @@ bool LWEProtocolWebSocketSecure::ProcessRead(LWSocket &Socket, const char *Buffe
 	char IPBuf[32];
 	LWSocket::MakeAddress(Socket.GetRemoteIP(), IPBuf, sizeof(IPBuf));
 	if (BufferLen > 100) {}
-	LWEWebPacket *OPack;
-	uint32_t Target;
-	uint32_t ReservePos;
-	uint32_t o = 0;
-	while (o != BufferLen) {
-		uint32_t Res = WebSocket->m_ActivePacket.Deserialize(Buffer + o, BufferLen - o, m_Allocator);
-		if (Res == -1) {
-			std::cout << "Error deserializing data." << std::endl;
-			return false;
-		}
-		o += Res;
-		if (!WebSocket->m_ActivePacket.Finished()) continue;
-		if (WebSocket->m_ActivePacket.m_DataLen != WebSocket->m_ActivePacket.m_DataPos) continue;
-		if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_CLOSED) {
-			WebSocket->m_ActivePacket.WorkFinished();
-			Socket.MarkClosable();
-			return true;
-		} else if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_PING) {
-			WebSocket->m_ActivePacket.WorkFinished();
+	return WebSocket->ReadFrames(Socket, Buffer, BufferLen, m_Allocator, Source, [this, WebSocket](LWEWebPacket &Packet) {
+		if (Packet.GetOp() == LWEWebPacket::CONTROL_PING) {
+			Packet.WorkFinished();
 			PushOutPacket(nullptr, 0, WebSocket, LWEWebPacket::CONTROL_PONG);
-			continue;
-		} else if (WebSocket->m_ActivePacket.GetOp() == LWEWebPacket::CONTROL_PONG) {
-			WebSocket->m_ActivePacket.WorkFinished();
-			continue;
+			return true;
 		}
-		WebSocket->m_ActivePacket.m_WebSocket = WebSocket;
+		LWEWebPacket *OPack;
+		uint32_t Target;
+		uint32_t ReservePos;
 		if (!m_InPackets.PushStart(&OPack, Target, ReservePos)) return false;
-		*OPack = std::move(WebSocket->m_ActivePacket);
+		*OPack = std::move(Packet);
 		m_InPackets.PushFinished(Target, ReservePos);
-	}
-	return true;
+		return true;
+	});
 }
 
 LWProtocol &LWEProtocolWebSocketSecure::SocketClosed(LWSocket &Socket, LWProtocolManager *Manager) {
@@ -116,7 +103,13 @@ LWProtocol &LWEProtocolWebSocketSecure::SocketClosed(LWSocket &Socket, LWProtoco
 	LWEWebSocket *WebSock = (LWEWebSocket*)Socket.GetProtocolData(m_wProtocolID);
 	bool Del = true;
 	if (m_WebSocketClosedCallback) Del = m_WebSocketClosedCallback(Socket, WebSock, Manager);
-	if (WebSock) WebSock->m_Socket = nullptr;
+	if (WebSock) {
+		WebSock->m_Socket = nullptr;
+		if (!WebSock->m_PendingPackets.empty()) {
+			WebSock->m_PendingPackets.clear();
+			m_PendingSockets.erase(std::remove(m_PendingSockets.begin(), m_PendingSockets.end(), WebSock), m_PendingSockets.end());
+		}
+	}
 	if (Del) LWAllocator::Destroy(WebSock);
 	return *this;
 }
@@ -131,15 +124,82 @@ LWProtocol &LWEProtocolWebSocketSecure::SocketChanged(LWSocket &Prev, LWSocket &
 }
 
 LWProtocol &LWEProtocolWebSocketSecure::ProcessTLSData(LWSocket &Socket, const char *Data, uint32_t DataLen) {
-	ProcessRead(Socket, Data, DataLen);
+	//Decrypted records are not null terminated, so they are copied into a receive buffer that payloads can be sliced from.
+	if (!m_ReceiveBuffer || m_ReceiveBuffer->isShared() || m_ReceiveBuffer->m_Capacity < DataLen + 1) {
+		if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
+		m_ReceiveBuffer = LWEHttpBuffer::Make(std::max<uint32_t>(DataLen + 1, LWEProtocolWebSocket::ReceiveBufferSize), m_Allocator);
+		if (!m_ReceiveBuffer) {
+			std::cout << "Error allocating receive buffer." << std::endl;
+			return *this;
+		}
+	}
+	char *Buffer = m_ReceiveBuffer->GetData();
+	memcpy(Buffer, Data, DataLen);
+	Buffer[DataLen] = '\0';
+	ProcessRead(Socket, Buffer, DataLen, m_ReceiveBuffer);
 	return *this;
 }
 
+bool LWEProtocolWebSocketSecure::SendFrame(LWEWebPacket &Packet, char *Buffer, uint32_t BufferLen) {
+	LWEWebSocket *Sock = Packet.m_WebSocket;
+	LWSocket *rSock = Sock->m_Socket;
+	if (!rSock) return true;
+	uint32_t Op = Packet.GetOp();
+	if ((Sock->m_Flag&LWEWebSocket::PerMessageDeflate) && (Op == LWEWebPacket::CONTROL_TEXT || Op == LWEWebPacket::CONTROL_BINARY) && Packet.m_DataLen >= m_DeflateMinLength && !(Packet.m_ControlFlag&LWEWebPacket::CONTROL_COMPRESSED)) {
+		if (!Sock->Deflate(Packet, m_Allocator)) {
+			std::cout << "Error compressing message." << std::endl;
+			rSock->MarkClosable();
+			return true;
+		}
+	}
+	//The header is serialized(and the payload masked) once into the packet, m_FramePos counts the header and payload bytes sent so an interrupted frame resumes where it stopped.
+	if (!Packet.m_HeaderLen) {
+		Packet.m_HeaderLen = Packet.SerializeHeader(Packet.m_Header, sizeof(Packet.m_Header), Sock->GetConnectStatus() == LWEWebSocket::CONNECTED_CLIENT);
+		Packet.m_FramePos = 0;
+	}
+	uint32_t FrameLen = Packet.m_HeaderLen + Packet.m_DataLen;
+	uint32_t Res = 0;
+	if (!Packet.m_FramePos && Packet.m_DataLen <= BufferLen - Packet.m_HeaderLen) {
+		//small payloads go out in the same record as the header.
+		std::copy(Packet.m_Header, Packet.m_Header + Packet.m_HeaderLen, Buffer);
+		if (Packet.m_DataLen) std::copy(Packet.m_Data, Packet.m_Data + Packet.m_DataLen, Buffer + Packet.m_HeaderLen);
+		Res = Send(*rSock, Buffer, FrameLen);
+		if (Res != -1) Packet.m_FramePos += Res;
+	} else {
+		//larger payloads are sent straight from the packet after the header.
+		if (Packet.m_FramePos < Packet.m_HeaderLen) {
+			Res = Send(*rSock, Packet.m_Header + Packet.m_FramePos, Packet.m_HeaderLen - Packet.m_FramePos);
+			if (Res != -1) Packet.m_FramePos += Res;
+		}
+		if (Res != -1 && Packet.m_FramePos >= Packet.m_HeaderLen && Packet.m_FramePos < FrameLen) {
+			Res = Send(*rSock, Packet.m_Data + (Packet.m_FramePos - Packet.m_HeaderLen), FrameLen - Packet.m_FramePos);
+			if (Res != -1) Packet.m_FramePos += Res;
+		}
+	}
+	if (Res == -1) {
+		std::cout << "Error sending data." << std::endl;
+		rSock->MarkClosable();
+		return true;
+	}
+	return Packet.m_FramePos == FrameLen;
+}
+
 LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::ProcessOutPackets(void) {
 	char Buffer[1024 * 64];
 	LWEWebPacket *Pack;
 	uint32_t Target;
 	uint32_t ReservePos;
+	//Frames interrupted on an earlier pass resume first.
+	for (uint32_t i = 0; i < m_PendingSockets.size();) {
+		LWEWebSocket *Sock = m_PendingSockets[i];
+		while (!Sock->m_PendingPackets.empty() && SendFrame(Sock->m_PendingPackets.front(), Buffer, sizeof(Buffer))) Sock->m_PendingPackets.pop_front();
+		if (!Sock->m_PendingPackets.empty()) {
+			i++;
+			continue;
+		}
+		m_PendingSockets[i] = m_PendingSockets.back();
+		m_PendingSockets.pop_back();
+	}
 	while (m_OutPackets.PopStart(&Pack, Target, ReservePos)) {
 		LWEWebPacket RPack = std::move(*Pack);
 		m_OutPackets.PopFinshed(Target, ReservePos);
@@ -151,6 +211,7 @@ LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::ProcessOutPackets(void)
 			Request.SetWebSockProto(m_SubProtocol);
 			Request.m_Flag |= LWEHttpRequest::ConnectionUpgrade | LWEHttpRequest::UpgradeWebSock;
 			Request.m_Status = Sock->GetConnectStatus() == LWEWebSocket::CONNECTING_SERVER ? LWEHttpRequest::SwitchingProtocols : 0;
+			Sock->WriteDeflateExtension(Request.m_SecWebSockExt, sizeof(Request.m_SecWebSockExt));
 			if (Sock->GetConnectStatus() == LWEWebSocket::CONNECTING_CLIENT) {
 				Request.SetHost(Sock->m_Host).SetPath(Sock->m_Path).SetOrigin(Sock->m_Origin);
 				Request.m_WebSockVersion = LWEWEBSOCKET_SUPPVER;
@@ -179,23 +240,20 @@ LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::ProcessOutPackets(void)
 			return *this; //break and let some time pass before we try again.
 		}
 		std::cout << "Sending data: " << RPack.GetOp() << " Len: " << RPack.m_DataLen << " Fin: " << RPack.m_ControlFlag << std::endl;
-		LWSocket *rSock = RPack.m_WebSocket->m_Socket;
-		if (!rSock) continue;
-		uint32_t Len = RPack.Serialize(Buffer, sizeof(Buffer), Sock->GetConnectStatus() == LWEWebSocket::CONNECTED_CLIENT);
-		std::cout << "Serialized: " << Len << std::endl;
-		uint32_t Res = Send(*rSock, Buffer, Len);
-		if (Res==-1){
-			std::cout << "Error sending data." << std::endl;
-			return *this;
-		}
-		if (!Res) {
-			if (!m_OutPackets.PushStart(&Pack, Target, ReservePos)) {
-				std::cout << "Error re-inserting packet." << std::endl;
-				return *this;
+		if (!Sock->m_Socket) continue;
+		//Frames behind one that could not be sent whole wait with it, so each socket's frames keep the order they were pushed in.
+		if (!Sock->m_PendingPackets.empty()) {
+			if (Sock->m_PendingPackets.size() >= LWEWebSocket::MaxPendingPackets) {
+				std::cout << "Error socket is not keeping up: " << Sock->m_Socket->GetSocketDescriptor() << std::endl;
+				Sock->m_Socket->MarkClosable();
+				continue;
 			}
-			*Pack = std::move(RPack);
-			m_OutPackets.PushFinished(Target, ReservePos);
+			Sock->m_PendingPackets.push_back(std::move(RPack));
+			continue;
 		}
+		if (SendFrame(RPack, Buffer, sizeof(Buffer))) continue;
+		m_PendingSockets.push_back(Sock);
+		Sock->m_PendingPackets.push_back(std::move(RPack));
 	}
 	return *this;
 }
@@ -214,7 +272,8 @@ LWEWebSocket *LWEProtocolWebSocketSecure::OpenSocket(const char *URI, uint32_t P
 	}
 	LWSocket *S = m_Manager->PushSocket(Sock);
 	LWEWebSocket *WebSock = m_Allocator.Allocate<LWEWebSocket>(URI, Origin);
-	WebSock->m_Flag |= LWEWebSocket::CONNECTING_CLIENT;
+	WebSock->m_Flag |= LWEWebSocket::CONNECTING_CLIENT | m_DeflateFlag;
+	WebSock->m_DeflateWindowBits = m_DeflateWindowBits;
 	WebSock->GenerateKey(m_KeySeed++);
 	S->SetProtocolData(m_wProtocolID, WebSock);
 	WebSock->m_Socket = S;
@@ -261,6 +320,13 @@ LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::SetSubProtocol(const cha
 	return *this;
 }
 
+LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::SetPerMessageDeflate(uint32_t Flag, uint32_t MinLength, uint32_t WindowBits) {
+	m_DeflateFlag = (Flag&LWEWebSocket::PerMessageDeflate) ? (Flag&LWEWebSocket::DEFLATEBITS) : 0;
+	m_DeflateMinLength = MinLength;
+	m_DeflateWindowBits = std::min<uint32_t>(std::max<uint32_t>(WindowBits, LWEWebSocket::MinWindowBits), LWEWebSocket::MaxWindowBits);
+	return *this;
+}
+
 LWEProtocolWebSocketSecure &LWEProtocolWebSocketSecure::SetWebSocketClosedCallback(std::function<bool(LWSocket &, LWEWebSocket*, LWProtocolManager*)> WebSocketClosedCallback) {
 	m_WebSocketClosedCallback = WebSocketClosedCallback;
 	return *this;
@@ -275,4 +341,8 @@ LWEProtocolWebSocketSecure::LWEProtocolWebSocketSecure(uint32_t ProtocolID, uint
 	*m_Server = *m_UserAgent = *m_SubProtocol = '\0';
 	m_WebSocketClosedCallback = nullptr;
 	m_WebSocketChangedCallback = nullptr;
+}
+
+LWEProtocolWebSocketSecure::~LWEProtocolWebSocketSecure() {
+	if (m_ReceiveBuffer) m_ReceiveBuffer->Release();
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 LWEUIComponent *LWEUIComponent::XMLParse(LWEXMLNode *Node, LWEXML *XML, LWEUIManager *Manager, LWEXMLNode *Style, const char *ActiveComponentName, LWEXMLNode *ActiveComponent, LWEXMLNode *ActiveComponentNode, std::map<uint32_t, LWEXMLNode *> &StyleMap, std::map<uint32_t, LWEXMLNode *> &ComponentMap) {
 	char NameBuffer[256];
 	char Buffer[256];
-	uint32_t NameHash = LWText::MakeHash(Node->m_Name);
+	uint32_t NameHash = Node->m_NameHash;
 	auto Iter = ComponentMap.find(NameHash);
 	if (Iter == ComponentMap.end()) {
 		std::cout << "Error unknown node: '" << Node->m_Name << "'" << std::endl;
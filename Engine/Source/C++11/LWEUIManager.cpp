@@ -771,10 +771,10 @@ bool LWEUIManager::XMLParser(LWEXMLNode *Node, void *UserData, LWEXML *X) {
 	auto ParseStyle = [](LWEXMLNode *Node, LWEUIManager *Man, std::map<uint32_t, LWEXMLNode*> &StyleMap) {
 		const uint32_t NameHash = LWText::MakeHash("Name");
 		const uint32_t StyleHash = LWText::MakeHash("Style");
-		LWXMLAttribute *NameAttr = Node->FindAttribute("Name");
+		LWXMLAttribute *NameAttr = Node->FindAttribute(NameHash);
 		if (!NameAttr) return;
 		StyleMap.emplace(LWText::MakeHash(NameAttr->m_Value), Node);	
-		LWXMLAttribute *StyleAttr = Node->FindAttribute("Style");
+		LWXMLAttribute *StyleAttr = Node->FindAttribute(StyleHash);
 		if (!StyleAttr) return;
 		auto Iter = StyleMap.find(LWText::MakeHash(StyleAttr->m_Value));
 
@@ -786,9 +786,8 @@ bool LWEUIManager::XMLParser(LWEXMLNode *Node, void *UserData, LWEXML *X) {
 		LWEXMLNode *N = Iter->second;
 		for (uint32_t i = 0; i < N->m_AttributeCount; i++) {
 			LWXMLAttribute &Attr = N->m_Attributes[i];
-			uint32_t AttrHash = LWText::MakeHash(Attr.m_Name);
-			if (AttrHash == NameHash || AttrHash == StyleHash) continue;
-			if (Node->FindAttribute(Attr.m_Name)) continue;
+			if (Attr.m_NameHash == NameHash || Attr.m_NameHash == StyleHash) continue;
+			if (Node->FindAttribute(Attr.m_NameHash)) continue;
 			Node->PushAttribute(Attr.m_Name, Attr.m_Value);
 		}
 		return;
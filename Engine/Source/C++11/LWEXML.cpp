@@ -5,12 +5,33 @@
 #include <iostream>
 #include <functional>
 #include <cstdarg>
+#include <algorithm>
 
 bool LWEXMLNode::PushAttribute(const char *Name, const char *Value) {
-	if (m_AttributeCount >= MaxAttributes) return false;
-	strncpy(m_Attributes[m_AttributeCount].m_Name, Name, sizeof(m_Attributes[m_AttributeCount].m_Name));
-	strncpy(m_Attributes[m_AttributeCount].m_Value, Value, sizeof(m_Attributes[m_AttributeCount].m_Value));
-	m_AttributeCount++;
+	return PushAttribute(Name, (uint32_t)strlen(Name), Value, (uint32_t)strlen(Value));
+}
+
+bool LWEXMLNode::PushAttribute(const char *Name, uint32_t NameLen, const char *Value, uint32_t ValueLen) {
+	if (!m_XML) return false;
+	if (m_AttributeCount >= m_AttributePoolSize) {
+		//the old list stays in the arena until the xml is destroyed.
+		uint32_t NewPoolSize = std::max<uint32_t>(m_AttributePoolSize * 2, AttributePoolSize);
+		LWXMLAttribute *NewAttributes = (LWXMLAttribute*)m_XML->AllocateArena(sizeof(LWXMLAttribute)*NewPoolSize);
+		if (!NewAttributes) return false;
+		std::copy(m_Attributes, m_Attributes + m_AttributeCount, NewAttributes);
+		m_Attributes = NewAttributes;
+		m_AttributePoolSize = NewPoolSize;
+	}
+	char *Text = m_XML->AllocateArena(NameLen + ValueLen + 2);
+	if (!Text) return false;
+	LWXMLAttribute &A = m_Attributes[m_AttributeCount++];
+	A.m_Name = Text;
+	A.m_Value = Text + NameLen + 1;
+	std::copy(Name, Name + NameLen, A.m_Name);
+	std::copy(Value, Value + ValueLen, A.m_Value);
+	A.m_Name[NameLen] = '\0';
+	A.m_Value[ValueLen] = '\0';
+	A.m_NameHash = LWText::MakeHash(A.m_Name);
 	return true;
 }
 
@@ -37,7 +58,8 @@ bool LWEXMLNode::RemoveAttribute(LWXMLAttribute *Attr) {
 }
 
 LWEXMLNode &LWEXMLNode::SetName(const char *Name) {
-	strncpy(m_Name, Name, sizeof(m_Name));
+	snprintf(m_Name, sizeof(m_Name), "%s", Name);
+	m_NameHash = LWText::MakeHash(m_Name);
 	return *this;
 }
 
@@ -56,10 +78,12 @@ LWEXMLNode &LWEXMLNode::SetTextf(const char *TextFmt, ...) {
 }
 
 LWXMLAttribute *LWEXMLNode::FindAttribute(const LWText &Name) {
-	uint32_t NameHash = Name.GetHash();
+	return FindAttribute(Name.GetHash());
+}
+
+LWXMLAttribute *LWEXMLNode::FindAttribute(uint32_t NameHash) {
 	for (uint32_t i = 0; i < m_AttributeCount; i++) {
-		LWXMLAttribute *A = m_Attributes + i;
-		if (NameHash == LWText::MakeHash(A->m_Name)) return A;
+		if (m_Attributes[i].m_NameHash == NameHash) return m_Attributes + i;
 	}
 	return nullptr;
 }
@@ -183,6 +207,7 @@ bool LWEXML::ParseBuffer(LWEXML &XML, LWAllocator &Allocator, const char *Buffer
 				return false;
 			} 
 			C = LWText::CopyToTokens(LWText::NextWord(C, true), ActiveNode->m_Name, sizeof(ActiveNode->m_Name), "> ");
+			ActiveNode->m_NameHash = LWText::MakeHash(ActiveNode->m_Name);
 			for (;; C++) {
 				C = LWText::NextWord(C, true);
 				if (*C == '/') {
@@ -191,22 +216,30 @@ bool LWEXML::ParseBuffer(LWEXML &XML, LWAllocator &Allocator, const char *Buffer
 					continue;
 				}
 				if (*C == '>') break;
-				LWXMLAttribute *Attr = &ActiveNode->m_Attributes[ActiveNode->m_AttributeCount];
-				Attr->m_Value[0] = '\0';
-				C = LWText::CopyToTokens(C, Attr->m_Name, (uint32_t)sizeof(Attr->m_Name), " =");
-				C = LWText::NextWord(C, true);
-				if (*C != '=') {
-					C--;
-					ActiveNode->m_AttributeCount++;
-					continue;
+				if (!*C) {
+					std::cout << "Line " << CalculateLine(Buffer, F) << ": Error unexpected end of file." << std::endl;
+					return false;
 				}
-				C = LWText::NextWord(C+1, true);
-				if (*C == '\"') C = LWText::CopyToTokens(C + 1, Attr->m_Value, (uint32_t)sizeof(Attr->m_Value), "\"");
-				else {
-					std::cout << "Line " << CalculateLine(Buffer, F) << ": Error invalid token found: '" << *C << "' line: " << std::endl;
+				const char *Name = C;
+				uint32_t NameLen = (uint32_t)strcspn(C, " \t\r\n=/>");
+				const char *Value = "";
+				uint32_t ValueLen = 0;
+				C = LWText::NextWord(C + NameLen, true);
+				if (*C == '=') {
+					C = LWText::NextWord(C + 1, true);
+					const char *E = *C == '\"' ? strchr(C + 1, '\"') : nullptr;
+					if (!E) {
+						std::cout << "Line " << CalculateLine(Buffer, F) << ": Error invalid token found: '" << *C << "' line: " << std::endl;
+						return false;
+					}
+					Value = C + 1;
+					ValueLen = (uint32_t)(uintptr_t)(E - Value);
+					C = E;
+				} else C--;
+				if (!ActiveNode->PushAttribute(Name, NameLen, Value, ValueLen)) {
+					std::cout << "Line " << CalculateLine(Buffer, F) << ": Error could not allocate attribute." << std::endl;
 					return false;
 				}
-				ActiveNode->m_AttributeCount++;
 			}
 			P = C+1;
 		}
@@ -290,24 +323,37 @@ LWEXMLNode *LWEXML::NextNode(LWEXMLNode *Current, LWEXMLNode *Top, bool SkipChil
 
 LWEXMLNode *LWEXML::NextNodeWithName(LWEXMLNode *Current, const LWText &Name, bool SkipChildren) {
 	for (LWEXMLNode *N = NextNode(Current, SkipChildren); N; N = NextNode(N, SkipChildren)) {
-		if (LWText::Compare((char*)Name.GetCharacters(), N->m_Name)) return N;
+		if (N->m_NameHash == Name.GetHash() && LWText::Compare((char*)Name.GetCharacters(), N->m_Name)) return N;
 	}
 	return nullptr;
 }
 
 LWEXML &LWEXML::PushParser(const LWText &XMLNodeName, std::function<bool(LWEXMLNode*, void*, LWEXML*)> Callback, void *UserData) {
 	if (m_ParserCount >= MaxParsers) return *this;
-	snprintf(m_Parsers[m_ParserCount].m_Name, sizeof(m_Parsers[m_ParserCount].m_Name), "%s", (char*)XMLNodeName.GetCharacters());
-	m_Parsers[m_ParserCount].m_Callback = Callback;
-	m_Parsers[m_ParserCount++].m_UserData = UserData;
+	LWEXMLParser &P = m_Parsers[m_ParserCount];
+	snprintf(P.m_Name, sizeof(P.m_Name), "%s", (char*)XMLNodeName.GetCharacters());
+	P.m_Callback = Callback;
+	P.m_UserData = UserData;
+	P.m_NameHash = LWText::MakeHash(P.m_Name);
+	P.m_Next = InvalidParser;
+	//parsers sharing a name are chained in the order they were pushed.
+	auto Res = m_ParserMap.emplace(P.m_NameHash, m_ParserCount);
+	if (!Res.second) {
+		uint32_t i = Res.first->second;
+		for (; m_Parsers[i].m_Next != InvalidParser; i = m_Parsers[i].m_Next) {}
+		m_Parsers[i].m_Next = m_ParserCount;
+	}
+	m_ParserCount++;
 	return *this;
 }
 
 LWEXML &LWEXML::Process(void) {
 	for (LWEXMLNode *C = NextNode(nullptr); C;) {
 		bool Processed = false;
-		for (uint32_t i = 0; i < m_ParserCount; i++) {
-			if (LWText::Compare(C->m_Name, m_Parsers[i].m_Name)) {
+		auto Iter = m_ParserMap.find(C->m_NameHash);
+		if (Iter != m_ParserMap.end()) {
+			for (uint32_t i = Iter->second; i != InvalidParser; i = m_Parsers[i].m_Next) {
+				if (!LWText::Compare(C->m_Name, m_Parsers[i].m_Name)) continue;
 				if (m_Parsers[i].m_Callback(C, m_Parsers[i].m_UserData, this)) Processed = true;
 			}
 		}
@@ -317,6 +363,7 @@ LWEXML &LWEXML::Process(void) {
 }
 
 LWEXMLNode *LWEXML::GetInsertedNodeAfter(LWEXMLNode *Parent, LWEXMLNode *Prev, LWAllocator &Allocator) {
+	m_Allocator = &Allocator;
 	uint32_t TargetPool = m_NodeCount / NodePoolSize;
 	uint32_t TargetIdx = m_NodeCount%NodePoolSize;
 	if (!TargetIdx) {
@@ -335,7 +382,11 @@ LWEXMLNode *LWEXML::GetInsertedNodeAfter(LWEXMLNode *Parent, LWEXMLNode *Prev, L
 	NextNode->m_LastChild = nullptr;
 	NextNode->m_Text[0] = '\0';
 	NextNode->m_Name[0] = '\0';
+	NextNode->m_NameHash = LWText::MakeHash(NextNode->m_Name);
+	NextNode->m_Attributes = nullptr;
 	NextNode->m_AttributeCount = 0;
+	NextNode->m_AttributePoolSize = 0;
+	NextNode->m_XML = this;
 	if (!Prev) {
 		if (!Parent) {
 			NextNode->m_Next = m_FirstNode;
@@ -360,6 +411,29 @@ LWEXMLNode *LWEXML::GetInsertedNodeAfter(LWEXMLNode *Parent, LWEXMLNode *Prev, L
 	return NextNode;
 }
 
+char *LWEXML::AllocateArena(uint32_t Length) {
+	if (!m_Allocator) return nullptr;
+	Length = (Length + sizeof(void*) - 1)&~(uint32_t)(sizeof(void*) - 1);
+	if (Length <= m_ArenaRemaining) {
+		char *Res = m_ArenaBlock;
+		m_ArenaBlock += Length;
+		m_ArenaRemaining -= Length;
+		return Res;
+	}
+	//anything larger than half a block gets it's own block so the current block isn't abandoned.
+	bool Dedicated = Length > ArenaBlockSize / 2;
+	char *Block = m_Allocator->AllocateArray<char>(Dedicated ? Length : ArenaBlockSize);
+	char **NewPool = m_Allocator->AllocateArray<char*>(m_ArenaCount + 1);
+	std::copy(m_ArenaPool, m_ArenaPool + m_ArenaCount, NewPool);
+	NewPool[m_ArenaCount++] = Block;
+	LWAllocator::Destroy(m_ArenaPool);
+	m_ArenaPool = NewPool;
+	if (Dedicated) return Block;
+	m_ArenaBlock = Block + Length;
+	m_ArenaRemaining = ArenaBlockSize - Length;
+	return Block;
+}
+
 LWEXMLNode *LWEXML::GetFirstNode(void) {
 	return m_FirstNode;
 }
@@ -368,10 +442,12 @@ LWEXMLNode *LWEXML::GetLastNode(void) {
 	return m_LastNode;
 }
 
-LWEXML::LWEXML() : m_NodePool(nullptr), m_NodeCount(0), m_ParserCount(0), m_FirstNode(nullptr), m_LastNode(nullptr) {}
+LWEXML::LWEXML() : m_NodePool(nullptr), m_ArenaPool(nullptr), m_ArenaBlock(nullptr), m_Allocator(nullptr), m_ArenaCount(0), m_ArenaRemaining(0), m_NodeCount(0), m_ParserCount(0), m_FirstNode(nullptr), m_LastNode(nullptr) {}
 
 LWEXML::~LWEXML() {
 	uint32_t PoolCount = (m_NodeCount+NodePoolSize-1) / NodePoolSize;
 	for (uint32_t i = 0; i < PoolCount; i++) LWAllocator::Destroy(m_NodePool[i]);
+	for (uint32_t i = 0; i < m_ArenaCount; i++) LWAllocator::Destroy(m_ArenaPool[i]);
 	LWAllocator::Destroy(m_NodePool);
+	LWAllocator::Destroy(m_ArenaPool);
 }
\ No newline at end of file
@@ -6,6 +6,8 @@ Src = $(LOCAL_PATH)/../../../../../Source/
 include $(CLEAR_VARS)
 LOCAL_MODULE    := libLWCore
 LOCAL_SRC_FILES := $(Src)C++11/LWCore/LWAllocator.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocatorStats.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWBitStream.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWByteBuffer.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWText.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWMath.cpp
@@ -16,6 +18,8 @@ LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_DefaultDebug.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_LocalCircular.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_ConcurrentCircular.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_LocalHeap.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_Pool.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWCore/LWAllocators/LWAllocator_FrameArena.cpp
 ifeq ($(TARGET_ARCH_ABI), armeabi-v7a armeabi-v7a-hard x86)
 LOCAL_ARM_NEON := true
 endif
@@ -9,6 +9,8 @@ LOCAL_SRC_FILES := $(Src)C++11/LWNetwork/LWPacket.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWPacketManager.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWProtocol.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWProtocolManager.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWShardedProtocolManager.cpp
+LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWSnapshot.cpp
 LOCAL_SRC_FILES += $(Src)C++11/LWNetwork/LWSocket.cpp
 LOCAL_SRC_FILES += $(Src)NDK/LWNetwork/LWProtocolManager_NDK.cpp
 LOCAL_SRC_FILES += $(Src)NDK/LWNetwork/LWSocket_NDK.cpp
@@ -12,8 +12,12 @@ public:
 
 		FormatFlag = 0x3, /*!< \brief Flag bitwise and against m_Flag to retrieve just the format information. */
 
+		NoPrefetch = 0x40, /*!< \brief flag to indicate that a compressed stream should not be decoded ahead by the shared prefetch worker, samples are only decoded when requested. */
 		Decompressed = 0x80, /*!< \brief flag to indicate that the data is to be decompressed. */
 
+		PrefetchSize = 131072, /*!< \brief the size in bytes of the decoded samples the prefetch worker keeps buffered ahead of each compressed stream's last requested sample. */
+		PrefetchChunkSize = 16384, /*!< \brief the max size in bytes the worker decodes at a time. */
+
 		LinearPCM=0, /*!< \brief each sample is a linear pcm. */
 		IEEEFloatPCM, /*!< \brief each sample is a floating point linear pcm. */
 	};
@@ -30,6 +34,7 @@ public:
 	static LWAudioStream *Create(char *Buffer, uint32_t BufferLen, uint32_t Flag, uint32_t FormatType, LWAllocator &Allocator);
 
 	/*!< \brief decodes the requested samples into the specified buffer, then returns a pointer to that buffer, however if the underlying data is already decompressed, the returned pointer is to the samples in that stream. 
+		 compressed streams keep their decode position, so requesting the samples that follow the last request never seeks the decoder, and unless NoPrefetch was set those samples are usually copied from the buffer filled by the prefetch worker, samples it has not buffered while it is mid decode are returned as silence rather then waiting on it.
 		 \param Buffer the buffer to receive the samples, should be at least SampleLen*SampleSize*Channels in size.
 		 \param SamplePos the position in the audio stream samples that are requested.
 		 \param SampleLen the number of samples requested.
@@ -4,6 +4,8 @@
 #include <new>
 #include <cstdint>
 
+class LWAllocatorStats;
+
 /*! \defgroup LWAllocator LWAllocator
 	\ingroup LWCore
 	\brief LWAllocator group of allocation schemes used by the framework.
@@ -18,6 +20,10 @@
 
 class LWAllocator{
 public:
+	enum {
+		MaxThreadSlots = 64 /*!< \brief the number of process wide thread slots available to allocators with per thread caches. */
+	};
+
 	/*! \brief Obtains the allocator used to allocate the memory. 
 		\return returns null if the allocator is invalid, otherwise returns the allocator object.
 	*/
@@ -48,7 +54,7 @@ public:
 	*/
 	template<class Type, typename... Args>
 	Type *Allocate(Args&&... Arg){
-		Type *Mem = (Type*)AllocateMemory(sizeof(Type));
+		Type *Mem = (Type*)AllocateTracked(sizeof(Type));
 		if (!Mem) return Mem;
 		return new(Mem) Type(std::forward<Args>(Arg)...);
 	}
@@ -59,7 +65,7 @@ public:
 	*/
 	template<class Type>
 	Type *AllocateArray(uint32_t Length){
-		Type *Mem = (Type*)AllocateMemory(sizeof(Type)*Length);
+		Type *Mem = (Type*)AllocateTracked(sizeof(Type)*Length);
 		if (!Mem) return Mem;
 		if (!std::is_trivial<Type>::value) {
 			for (uint32_t i = 0; i < Length; i++) new(Mem + i) Type();
@@ -76,9 +82,27 @@ public:
 
 	/*! \brief returns the number of bytes still in allocation.
 	*/
-	uint32_t GetAllocatedBytes(void);
+	virtual uint32_t GetAllocatedBytes(void);
+
+	/*! \brief attaches an LWAllocatorStats object which records every allocation and deallocation made through this allocator, pass null to stop recording.  the stats object must outlive the allocator or be detached first.
+		allocations made while stats are attached carry an extra 16 bytes of meta data so their deallocation can be recorded, memory allocated before attaching is not recorded when it is deallocated.
+	*/
+	LWAllocator &SetStats(LWAllocatorStats *Stats);
+
+	/*! \brief returns the attached stats object, or null if none is attached.
+	*/
+	LWAllocatorStats *GetStats(void);
 protected:
 	uint32_t m_AllocatedBytes = 0; /*!< \brief the total number of bytes still allocated, this value does include the meta data that is also allocated with LWAllocators. */
+	LWAllocatorStats *m_Stats = nullptr; /*!< \brief optional statistics recorder, null unless instrumentation was requested. */
+
+	/*! \brief calls AllocateMemory and records the result to m_Stats if attached.
+	*/
+	void *AllocateTracked(uint32_t Length);
+
+	/*! \brief returns the calling thread's process wide slot index used to index per thread caches, or MaxThreadSlots if every slot is taken.  a slot is claimed on first call and released when the thread exits.
+	*/
+	static uint32_t GetThreadSlot(void);
 
 	/*! \brief the allocate memory function which allocates not only the memory requested, but additional meta data for tracking allocations. 
 		\param Length the number of bytes to allocate.
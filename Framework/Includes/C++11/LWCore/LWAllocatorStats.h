@@ -0,0 +1,146 @@
+#ifndef LWALLOCATORSTATS_H
+#define LWALLOCATORSTATS_H
+#include <cstdint>
+#include <atomic>
+
+/*! \addtogroup LWAllocator
+	@{
+*/
+
+/*! \brief Opt-in allocation statistics for an LWAllocator, attach with LWAllocator::SetStats.  Records live and peak bytes, counts by power of two size bucket, allocation rate per frame, and per call-site tag counts and live bytes.
+	Tags are set per thread with ScopedTag, and must be string literals(or otherwise outlive the stats object) as only the pointer is stored.  All recording is lock free and may be done from any thread.
+	Sizes recorded are the requested sizes, and do not include allocator meta data.  Only memory allocated while the stats were attached is recorded when it is freed, so stats may be attached to an allocator that is already in use.
+*/
+class LWAllocatorStats {
+public:
+	enum {
+		BucketCount = 24, /*!< \brief the number of size buckets, bucket 0 is up to 16 bytes and each following bucket doubles the max size, the last bucket holds everything larger. */
+		MaxTags = 32, /*!< \brief the max number of unique tags tracked, further tags are folded into the last tag. */
+		NoTag = MaxTags /*!< \brief the index used by allocations made without a tag. */
+	};
+
+	/*! \brief sets the calling thread's allocation tag for it's lifetime, restoring the previous tag when destroyed. */
+	class ScopedTag {
+	public:
+		ScopedTag(const char *Tag);
+
+		~ScopedTag();
+	private:
+		const char *m_PrevTag;
+	};
+
+	/*! \brief sets the tag applied to allocations made by the calling thread, null clears it. */
+	static void SetTag(const char *Tag);
+
+	/*! \brief returns the tag applied to allocations made by the calling thread. */
+	static const char *GetTag(void);
+
+	/*! \brief returns the bucket index Size falls into. */
+	static uint32_t GetBucket(uint32_t Size);
+
+	/*! \brief returns the max size in bytes held by the bucket, the last bucket returns 0xFFFFFFFF. */
+	static uint32_t GetBucketMaxSize(uint32_t Bucket);
+
+	/*! \brief records a successful allocation of Size bytes under the tag index Tag(from FindTag, or NoTag). */
+	LWAllocatorStats &RecordAllocation(uint32_t Size, uint32_t Tag);
+
+	/*! \brief records a deallocation of Size bytes that was recorded by RecordAllocation under Tag. */
+	LWAllocatorStats &RecordDeallocation(uint32_t Size, uint32_t Tag);
+
+	/*! \brief records an allocation request that the allocator could not satisfy. */
+	LWAllocatorStats &RecordFailure(uint32_t Size);
+
+	/*! \brief closes the current frame, the frame counts become available through GetLastFrameAllocations/GetLastFrameBytes. */
+	LWAllocatorStats &NextFrame(void);
+
+	/*! \brief resets every counter except the live counts. */
+	LWAllocatorStats &Reset(void);
+
+	/*! \brief writes the statistics as a JSON object into Buffer.
+		\return the number of bytes needed to write the entire object, if this is larger than BufferLen the output was truncated.
+	*/
+	uint32_t SerializeJSON(char *Buffer, uint32_t BufferLen) const;
+
+	/*! \brief returns the name the stats were created with. */
+	const char *GetName(void) const;
+
+	/*! \brief returns the number of requested bytes still allocated. */
+	uint64_t GetLiveBytes(void) const;
+
+	/*! \brief returns the largest GetLiveBytes has been. */
+	uint64_t GetPeakBytes(void) const;
+
+	/*! \brief returns the number of allocations that have not been deallocated, any remaining when the allocator is finished with are leaks. */
+	uint64_t GetLiveCount(void) const;
+
+	/*! \brief returns the total number of allocations. */
+	uint64_t GetAllocationCount(void) const;
+
+	/*! \brief returns the total number of deallocations. */
+	uint64_t GetDeallocationCount(void) const;
+
+	/*! \brief returns the number of failed allocation requests. */
+	uint64_t GetFailedCount(void) const;
+
+	/*! \brief returns the number of allocations that fell into Bucket. */
+	uint64_t GetBucketAllocations(uint32_t Bucket) const;
+
+	/*! \brief returns the number of allocations made in the last completed frame. */
+	uint64_t GetLastFrameAllocations(void) const;
+
+	/*! \brief returns the number of bytes allocated in the last completed frame. */
+	uint64_t GetLastFrameBytes(void) const;
+
+	/*! \brief returns the most allocations made in a single frame. */
+	uint64_t GetPeakFrameAllocations(void) const;
+
+	/*! \brief returns the number of frames completed. */
+	uint64_t GetFrameCount(void) const;
+
+	/*! \brief returns the number of unique tags recorded. */
+	uint32_t GetTagCount(void) const;
+
+	/*! \brief returns the name of the tag at Index, or null for NoTag. */
+	const char *GetTagName(uint32_t Index) const;
+
+	/*! \brief returns the number of allocations made under the tag at Index(or NoTag). */
+	uint64_t GetTagAllocations(uint32_t Index) const;
+
+	/*! \brief returns the number of bytes allocated under the tag at Index(or NoTag). */
+	uint64_t GetTagBytes(uint32_t Index) const;
+
+	/*! \brief returns the number of requested bytes allocated under the tag at Index(or NoTag) that are still allocated. */
+	uint64_t GetTagLiveBytes(uint32_t Index) const;
+
+	/*! \brief returns the number of allocations made under the tag at Index(or NoTag) that have not been deallocated. */
+	uint64_t GetTagLiveCount(uint32_t Index) const;
+
+	/*! \brief finds or registers the tag, returning it's index.  null returns NoTag. */
+	uint32_t FindTag(const char *Tag);
+
+	/*! \brief constructs the stats object with a name used when serializing. */
+	LWAllocatorStats(const char *Name);
+private:
+	const char *m_Name;
+	std::atomic<uint64_t> m_LiveBytes;
+	std::atomic<uint64_t> m_LiveCount;
+	std::atomic<uint64_t> m_PeakBytes;
+	std::atomic<uint64_t> m_AllocationCount;
+	std::atomic<uint64_t> m_DeallocationCount;
+	std::atomic<uint64_t> m_FailedCount;
+	std::atomic<uint64_t> m_Buckets[BucketCount];
+	std::atomic<uint64_t> m_FrameAllocations;
+	std::atomic<uint64_t> m_FrameBytes;
+	std::atomic<uint64_t> m_LastFrameAllocations;
+	std::atomic<uint64_t> m_LastFrameBytes;
+	std::atomic<uint64_t> m_PeakFrameAllocations;
+	std::atomic<uint64_t> m_FrameCount;
+	std::atomic<const char*> m_TagNames[MaxTags];
+	std::atomic<uint64_t> m_TagAllocations[MaxTags + 1];
+	std::atomic<uint64_t> m_TagBytes[MaxTags + 1];
+	std::atomic<uint64_t> m_TagLiveBytes[MaxTags + 1];
+	std::atomic<uint64_t> m_TagLiveCount[MaxTags + 1];
+};
+/*! @} */
+
+#endif
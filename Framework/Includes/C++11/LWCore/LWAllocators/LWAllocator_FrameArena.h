@@ -0,0 +1,93 @@
+#ifndef LWALLOCATOR_FRAMEARENA_H
+#define LWALLOCATOR_FRAMEARENA_H
+#include "LWCore/LWAllocator.h"
+#include <cstdint>
+/*! \addtogroup LWAllocator
+@{
+*/
+
+/*! \brief A linear allocator for transient per frame data.  The buffer is split into FrameCount frames, allocations bump a pointer in the current frame and deallocating does nothing unless it was the most recent allocation.
+	Calling NextFrame moves to the next frame and resets it in O(1), so memory allocated in a frame stays valid for FrameCount-1 further calls to NextFrame.  Markers can be pushed and popped to release scratch memory within a frame early.
+	This allocator is not thread safe, and GetAllocatedBytes reports the bytes in use across all frames rather than the number of outstanding allocations.
+*/
+class LWAllocator_FrameArena : public LWAllocator {
+public:
+	enum {
+		Poison = 0x1, /*!< \brief flag to fill new allocations with AllocPoisonByte, and released memory with FreePoisonByte to make use after frame bugs visible. */
+
+		AllocPoisonByte = 0xCD, /*!< \brief the value new allocations are filled with when poisoning is enabled. */
+		FreePoisonByte = 0xDD, /*!< \brief the value released memory is filled with when poisoning is enabled. */
+		Alignment = 16 /*!< \brief the alignment of every allocation. */
+	};
+
+	/*! \brief restores the arena to the marker taken at construction when destroyed, releasing everything allocated within the scope. */
+	class Scope {
+	public:
+		Scope(LWAllocator_FrameArena &Arena);
+
+		~Scope();
+	private:
+		LWAllocator_FrameArena &m_Arena;
+		uint64_t m_Marker;
+	};
+
+	/*! \brief advances to the next frame and resets it, anything allocated FrameCount frames ago is now invalid. */
+	LWAllocator_FrameArena &NextFrame(void);
+
+	/*! \brief returns a marker to the current position of the current frame. */
+	uint64_t PushMarker(void) const;
+
+	/*! \brief releases everything allocated in the current frame since Marker was pushed.
+		\return false if the marker belongs to a previous frame or is past the current position.
+	*/
+	bool PopMarker(uint64_t Marker);
+
+	/*! \brief returns the number of times NextFrame has been called. */
+	uint32_t GetFrameID(void) const;
+
+	/*! \brief returns the index of the current frame. */
+	uint32_t GetFrameIndex(void) const;
+
+	/*! \brief returns the number of bytes used in the current frame. */
+	uint32_t GetFrameUsed(void) const;
+
+	/*! \brief returns the number of bytes available to each frame. */
+	uint32_t GetFrameSize(void) const;
+
+	/*! \brief returns the number of frames the arena is split into. */
+	uint32_t GetFrameCount(void) const;
+
+	/*! \brief returns the largest number of bytes used by any frame, useful for tuning FrameSize. */
+	uint32_t GetHighWaterMark(void) const;
+
+	/*! \brief allocates a buffer of FrameSize*FrameCount bytes.
+		\param FrameSize the number of bytes available to each frame, rounded up to Alignment.
+		\param FrameCount the number of frames allocations survive for, 2 means double buffered.
+		\param Flags optional flags such as Poison.
+	*/
+	LWAllocator_FrameArena(uint32_t FrameSize, uint32_t FrameCount = 2, uint32_t Flags = 0);
+
+	~LWAllocator_FrameArena();
+protected:
+	virtual void *AllocateMemory(uint32_t Length);
+
+	virtual void *DeallocateMemory(void *Memory);
+
+	virtual void *AllocateBytes(uint32_t Length);
+
+	virtual void *DeallocateBytes(void *Memory);
+
+	/*! \brief rewinds the current frame to Position, updating the allocated bytes and poisoning the released range. */
+	LWAllocator_FrameArena &Rewind(uint32_t Position);
+
+	uint8_t *m_Buffer; /*!< \brief the buffer used for all frames. */
+	uint32_t *m_FramePositions; /*!< \brief the bump position of each frame. */
+	uint32_t m_FrameSize; /*!< \brief the size of each frame. */
+	uint32_t m_FrameCount; /*!< \brief the number of frames. */
+	uint32_t m_FrameIndex = 0; /*!< \brief the current frame index. */
+	uint32_t m_FrameID = 0; /*!< \brief the number of frames that have been advanced. */
+	uint32_t m_HighWaterMark = 0; /*!< \brief the largest position any frame reached. */
+	uint32_t m_Flags; /*!< \brief the flags the arena was created with. */
+};
+/*! @} */
+#endif
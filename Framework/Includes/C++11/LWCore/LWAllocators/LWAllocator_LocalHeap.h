@@ -1,21 +1,56 @@
 #ifndef LWALLOCATOR_LOCALHEAP_H
 #define LWALLOCATOR_LOCALHEAP_H
 #include "LWCore/LWAllocator.h"
+#include <atomic>
 
 /*! \addtogroup LWAllocator
 @{
 */
 
 /*! \brief A local heap allocation buffer for allocating objects without going through the system allocation scheme.
+	Free blocks are kept in two level segregated fit(TLSF) lists, so allocating and deallocating are O(1) regardless of fragmentation, and adjacent free blocks are merged immediately.
+	The heap is safe to share between threads, the O(1) core is guarded by a short spinlock.  With the PerThreadCache flag each thread also keeps a few freed small blocks to itself which are reused without touching the lock.
 */
 class LWAllocator_LocalHeap : public LWAllocator{
 public:
+	enum {
+		PerThreadCache = 0x1, /*!< \brief flag to enable the per thread cache of small blocks. */
 
-	/*! \brief allocates a buffer of BufferSize */
-	LWAllocator_LocalHeap(uint32_t BufferSize);
+		AlignmentBits = 4, /*!< \brief log2 of the alignment, and size granularity of every block. */
+		Alignment = 1 << AlignmentBits, /*!< \brief alignment of every block. */
+		SecondLevelBits = 4, /*!< \brief log2 of the number of second level lists for each power of two. */
+		SecondLevelCount = 1 << SecondLevelBits, /*!< \brief the number of second level lists for each power of two. */
+		FirstLevelShift = SecondLevelBits + AlignmentBits, /*!< \brief sizes below 1<<FirstLevelShift are all stored in the first level 0. */
+		FirstLevelCount = 32 - FirstLevelShift + 1, /*!< \brief the number of first level lists. */
+		MinBlockSize = 32, /*!< \brief the smallest block, including the header, which has room for the free list links and size footer. */
+
+		CacheClassCount = 16, /*!< \brief block sizes up to CacheClassCount*Alignment are eligible for the per thread cache. */
+		CacheDepth = 4 /*!< \brief the max number of cached blocks per thread for each size. */
+	};
+
+	/*! \brief returns the number of bytes available for the largest allocation that could currently be made. */
+	uint32_t GetLargestFreeBlock(void);
+
+	virtual uint32_t GetAllocatedBytes(void);
+
+	/*! \brief returns every block cached by the calling thread to the heap. */
+	LWAllocator_LocalHeap &FlushThreadCache(void);
+
+	/*! \brief allocates a buffer of BufferSize
+		\param Flags optional flags such as PerThreadCache.
+	*/
+	LWAllocator_LocalHeap(uint32_t BufferSize, uint32_t Flags = 0);
 
 	~LWAllocator_LocalHeap();
 protected:
+	/*! \cond */
+	struct ThreadCache {
+		uint32_t m_Blocks[CacheClassCount][CacheDepth];
+		uint32_t m_Counts[CacheClassCount];
+		std::atomic<int64_t> m_CachedBytes;
+	};
+	/*! \endcond */
+
 	virtual void *AllocateMemory(uint32_t Length);
 
 	virtual void *DeallocateMemory(void *Memory);
@@ -24,10 +59,36 @@ protected:
 
 	virtual void *DeallocateBytes(void *Memory);
 
+	/*! \brief takes a block of at least BlockSize bytes from the free lists, splitting off any large enough remainder.  returns the block offset or NullBlock. */
+	uint32_t TakeBlock(uint32_t BlockSize);
+
+	/*! \brief returns the block at Offset to the free lists, merging it with free neighbors. */
+	void ReleaseBlock(uint32_t Offset);
+
+	/*! \brief links the free block into the list for it's size. */
+	void InsertFree(uint32_t Offset, uint32_t BlockSize);
+
+	/*! \brief unlinks the free block from the list for it's size. */
+	void RemoveFree(uint32_t Offset, uint32_t BlockSize);
+
+	/*! \brief returns every block in Cache to the free lists, the lock must be held. */
+	void ReleaseCache(ThreadCache *Cache);
+
+	/*! \brief returns the calling thread's cache, or null if caching is disabled or no thread slot was available. */
+	ThreadCache *GetThreadCache(void);
+
+	void Lock(void);
+
+	void Unlock(void);
+
 	uint8_t *m_Buffer; /*!< \brief the buffer used for allocations. */
-	void *m_NextAllocationUnit; /*!< \brief the next available allocation unit. */
 	uint32_t m_BufferSize; /*!< \brief the total buffer size. */
-
+	uint32_t m_Flags; /*!< \brief the flags the heap was created with. */
+	uint32_t m_FirstLevelMap = 0; /*!< \brief bit n is set if any second level list of first level n has a free block. */
+	uint32_t m_SecondLevelMap[FirstLevelCount]; /*!< \brief bit n is set if the second level list n has a free block. */
+	uint32_t m_FreeLists[FirstLevelCount][SecondLevelCount]; /*!< \brief the offset of the first free block in each list. */
+	std::atomic_flag m_Lock = ATOMIC_FLAG_INIT; /*!< \brief guards the free lists and block headers. */
+	std::atomic<ThreadCache*> m_Caches[MaxThreadSlots]; /*!< \brief the per thread caches, indexed by GetThreadSlot. */
 };
 /*! @} */
-#endif
\ No newline at end of file
+#endif
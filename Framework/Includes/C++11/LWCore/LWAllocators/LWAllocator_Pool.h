@@ -0,0 +1,90 @@
+#ifndef LWALLOCATOR_POOL_H
+#define LWALLOCATOR_POOL_H
+#include "LWCore/LWAllocator.h"
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+/*! \addtogroup LWAllocator
+@{
+*/
+
+/*! \brief A thread-caching size class allocator for many small short lived objects.  Requests(including the 16 byte allocation header) are rounded up to one of SizeClassCount size classes, which are carved out of large slabs.
+	Each thread owns a cache of free blocks for every size class, so allocating and freeing is lock free until a cache runs dry or overflows, at which point a batch of blocks is exchanged with the central depot for that size class.
+	Requests larger than MaxClassSize go straight to malloc.  Slabs are only returned to the system when the allocator is destroyed.
+*/
+class LWAllocator_Pool : public LWAllocator {
+public:
+	enum {
+		MinClassSize = 16, /*!< \brief the smallest block size, sizes up to SmallClassSize are spaced by MinClassSize. */
+		SmallClassSize = 256, /*!< \brief past this size each power of two is split into 4 size classes. */
+		MaxClassSize = 32768, /*!< \brief the largest size class, anything larger is handed to malloc. */
+		SmallClassCount = SmallClassSize / MinClassSize, /*!< \brief the number of evenly spaced small size classes. */
+		SizeClassCount = SmallClassCount + 7 * 4, /*!< \brief the total number of size classes. */
+		SlabSize = 64 * 1024, /*!< \brief the minimum number of bytes requested from the system when a depot runs dry. */
+		MaxThreadCaches = MaxThreadSlots, /*!< \brief the max number of threads that get their own cache, further threads go through the depot directly. */
+		MaxBatchCount = 64 /*!< \brief the max number of blocks moved between a thread cache and the depot at once. */
+	};
+
+	/*! \brief returns the size class for an allocation of Size bytes(including the header), or SizeClassCount if it is larger than MaxClassSize. */
+	static uint32_t GetSizeClass(uint32_t Size);
+
+	/*! \brief returns the block size of the specified size class. */
+	static uint32_t GetClassSize(uint32_t SizeClass);
+
+	/*! \brief returns the number of blocks moved between a thread cache and the depot for the size class. */
+	static uint32_t GetBatchCount(uint32_t SizeClass);
+
+	/*! \brief returns the number of bytes still in allocation, summed over every thread cache. */
+	virtual uint32_t GetAllocatedBytes(void);
+
+	/*! \brief returns every cached block owned by the calling thread back to the central depots, call this before a thread that did many allocations exits. */
+	LWAllocator_Pool &FlushThreadCache(void);
+
+	LWAllocator_Pool();
+
+	/*! \brief destroys the allocator, all slabs are released so any outstanding allocations become invalid. */
+	~LWAllocator_Pool();
+protected:
+	/*! \cond */
+	struct Block {
+		Block *m_Next;
+	};
+
+	struct alignas(64) Depot {
+		std::mutex m_Lock;
+		Block *m_FreeList = nullptr;
+		uint32_t m_FreeCount = 0;
+	};
+
+	struct ThreadCache {
+		Block *m_FreeLists[SizeClassCount];
+		uint32_t m_FreeCounts[SizeClassCount];
+		std::atomic<int64_t> m_AllocatedBytes;
+	};
+	/*! \endcond */
+
+	virtual void *AllocateMemory(uint32_t Length);
+
+	virtual void *DeallocateMemory(void *Memory);
+
+	virtual void *AllocateBytes(uint32_t Length);
+
+	virtual void *DeallocateBytes(void *Memory);
+
+	/*! \brief returns the calling thread's cache, creating it on first use, or null if the thread could not be given a cache slot. */
+	ThreadCache *GetThreadCache(void);
+
+	/*! \brief pops up to Count blocks from the size class depot into List, carving a new slab if the depot is empty.  returns the number of blocks taken. */
+	uint32_t FetchBlocks(uint32_t SizeClass, Block *&List, uint32_t Count);
+
+	/*! \brief pushes Count blocks from List(linked through m_Next) into the size class depot. */
+	LWAllocator_Pool &ReleaseBlocks(uint32_t SizeClass, Block *List, Block *Tail, uint32_t Count);
+
+	Depot m_Depots[SizeClassCount]; /*!< \brief the central depot for each size class. */
+	std::atomic<ThreadCache*> m_Caches[MaxThreadCaches]; /*!< \brief the per thread caches, indexed by a process wide thread slot. */
+	std::mutex m_SlabLock; /*!< \brief guards the slab list. */
+	void *m_Slabs = nullptr; /*!< \brief linked list of every slab allocated, released on destruction. */
+	std::atomic<int64_t> m_SharedAllocatedBytes; /*!< \brief bytes allocated by threads without a cache and by large allocations. */
+};
+/*! @} */
+#endif
@@ -0,0 +1,121 @@
+#ifndef LWBITSTREAM_H
+#define LWBITSTREAM_H
+#include "LWCore/LWTypes.h"
+#include <cstdint>
+
+/*! \brief writes values packed to the bit into an LWByteBuffer, values are packed least significant bit first and written a byte at a time so the output does not depend on the buffer's byte order.
+	Flush must be called once all values are written to write the final partial byte.
+*/
+class LWBitWriter {
+public:
+	/*! \brief returns the number of bits needed to write every value from 0 to Range. */
+	static uint32_t GetBitsRequired(uint32_t Range);
+
+	/*! \brief returns the number of bits a value quantized to Resolution between Min and Max is written with. */
+	static uint32_t GetQuantizedBits(float Min, float Max, float Resolution);
+
+	/*! \brief clamps Value between Min and Max and returns the nearest step of Resolution from Min. */
+	static uint32_t Quantize(float Value, float Min, float Max, float Resolution);
+
+	/*! \brief returns the value of a quantized step. */
+	static float Dequantize(uint32_t Value, float Min, float Max, float Resolution);
+
+	/*! \brief maps signed values to unsigned so small magnitudes of either sign stay small(0, -1, 1, -2 -> 0, 1, 2, 3). */
+	static uint64_t ZigZag(int64_t Value);
+
+	/*! \brief reverses ZigZag. */
+	static int64_t UnZigZag(uint64_t Value);
+
+	/*! \brief returns the number of bits WriteVarInt uses for Value. */
+	static uint32_t GetVarIntBits(uint64_t Value);
+
+	/*! \brief writes the lower Bits(up to 32) bits of Value. */
+	LWBitWriter &WriteBits(uint32_t Value, uint32_t Bits);
+
+	/*! \brief writes a single bit. */
+	LWBitWriter &WriteBool(bool Value);
+
+	/*! \brief writes Value clamped between Min and Max with only the bits required for that range. */
+	LWBitWriter &WriteBounded(int32_t Value, int32_t Min, int32_t Max);
+
+	/*! \brief writes Value 7 bits at a time followed by a continuation bit, so small values take 8 bits. */
+	LWBitWriter &WriteVarInt(uint64_t Value);
+
+	/*! \brief writes a zigzagged signed variable length integer. */
+	LWBitWriter &WriteSignedVarInt(int64_t Value);
+
+	/*! \brief writes all 32 bits of a float. */
+	LWBitWriter &WriteFloat(float Value);
+
+	/*! \brief writes Value quantized to Resolution between Min and Max. */
+	LWBitWriter &WriteQuantized(float Value, float Min, float Max, float Resolution);
+
+	/*! \brief writes any remaining bits padded with 0 to a full byte.
+		\return the total number of bytes written to the buffer.
+	*/
+	uint32_t Flush(void);
+
+	/*! \brief returns the number of bits written so far. */
+	uint32_t GetBitsWritten(void) const;
+
+	/*! \brief returns true if the buffer ran out of space, any bytes past the end were dropped. */
+	bool isOverflowed(void) const;
+
+	/*! \brief constructs a bit writer which writes from the current position of Buffer. */
+	LWBitWriter(LWByteBuffer &Buffer);
+private:
+	/*! \brief writes every whole byte in the scratch to the buffer. */
+	void WriteScratch(void);
+
+	LWByteBuffer *m_Buffer;
+	uint64_t m_Scratch = 0;
+	uint32_t m_ScratchBits = 0;
+	uint32_t m_BitsWritten = 0;
+	uint32_t m_BytesWritten = 0;
+	bool m_Overflowed = false;
+};
+
+/*! \brief reads values written with LWBitWriter from an LWByteBuffer, the same range and resolution the values were written with must be used to read them back. */
+class LWBitReader {
+public:
+	/*! \brief reads Bits(up to 32) bits. */
+	uint32_t ReadBits(uint32_t Bits);
+
+	/*! \brief reads a single bit. */
+	bool ReadBool(void);
+
+	/*! \brief reads a value written with WriteBounded. */
+	int32_t ReadBounded(int32_t Min, int32_t Max);
+
+	/*! \brief reads a value written with WriteVarInt. */
+	uint64_t ReadVarInt(void);
+
+	/*! \brief reads a value written with WriteSignedVarInt. */
+	int64_t ReadSignedVarInt(void);
+
+	/*! \brief reads a float written with WriteFloat. */
+	float ReadFloat(void);
+
+	/*! \brief reads a value written with WriteQuantized. */
+	float ReadQuantized(float Min, float Max, float Resolution);
+
+	/*! \brief discards the remaining bits of the current byte, leaving the buffer positioned after the data of a flushed LWBitWriter. */
+	LWBitReader &AlignToByte(void);
+
+	/*! \brief returns the number of bits read so far. */
+	uint32_t GetBitsRead(void) const;
+
+	/*! \brief returns true if a read went past the end of the buffer, the missing bits are read as 0. */
+	bool isOverflowed(void) const;
+
+	/*! \brief constructs a bit reader which reads from the current position of Buffer. */
+	LWBitReader(LWByteBuffer &Buffer);
+private:
+	LWByteBuffer *m_Buffer;
+	uint64_t m_Scratch = 0;
+	uint32_t m_ScratchBits = 0;
+	uint32_t m_BitsRead = 0;
+	bool m_Overflowed = false;
+};
+
+#endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef LWCONCURRENTFIFO_H
 #define LWCONCURRENTFIFO_H
 #include <atomic>
+#include <mutex>
+#include <algorithm>
 #include <LWCore/LWAllocator.h>
 #include <cstdio>
 /*! \addtogroup LWCore
@@ -281,6 +283,362 @@ private:
 	std::atomic<uint32_t> m_WritePos;
 	std::atomic<uint32_t> m_ReadPos;
 };
+
+/*! \brief a bounded concurrent First-in First-Out queue that supports any thread pushing and any thread popping, each slot carries it's own sequence number so pushers and poppers only contend on the slot they claim, a thread that is descheduled mid operation does not stall any other thread. MaxElementCount must be a power of 2.
+*/
+template<class Type, uint32_t MaxElementCount>
+class LWConcurrentBoundedFIFO : public LWFIFO<Type> {
+public:
+	static_assert((MaxElementCount&(MaxElementCount - 1)) == 0, "MaxElementCount must be a power of 2.");
+
+	/*! \brief removes an item from the list.  note: Peeking is not thread-safe, as it does not gurantee another thread hasn't already read and removed the object before Result is written to. */
+	virtual bool Pop(Type &Result, bool Peek = false) {
+		uint32_t Pos = m_ReadPos.load(std::memory_order_relaxed);
+		Cell *C = nullptr;
+		for (;;) {
+			C = &m_Cells[Pos&Mask];
+			int32_t Dif = (int32_t)(C->m_Sequence.load(std::memory_order_acquire) - (Pos + 1));
+			if (Dif < 0) return false;
+			if (!Dif) {
+				if (Peek) {
+					Result = C->m_Data;
+					return true;
+				}
+				if (m_ReadPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+			} else Pos = m_ReadPos.load(std::memory_order_relaxed);
+		}
+		Result = std::move(C->m_Data);
+		C->m_Sequence.store(Pos + MaxElementCount, std::memory_order_release);
+		return true;
+	}
+
+	/*! \brief pushes an item onto the list, returns false if the list is full. */
+	virtual bool Push(const Type &Item) {
+		uint32_t Pos = m_WritePos.load(std::memory_order_relaxed);
+		Cell *C = nullptr;
+		for (;;) {
+			C = &m_Cells[Pos&Mask];
+			int32_t Dif = (int32_t)(C->m_Sequence.load(std::memory_order_acquire) - Pos);
+			if (Dif < 0) return false;
+			if (!Dif) {
+				if (m_WritePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+			} else Pos = m_WritePos.load(std::memory_order_relaxed);
+		}
+		C->m_Data = Item;
+		C->m_Sequence.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*! \brief pops up to Count items into Results with a single reservation, returns the number of items popped. */
+	uint32_t PopBatch(Type *Results, uint32_t Count) {
+		uint32_t Pos = m_ReadPos.load(std::memory_order_relaxed);
+		uint32_t n = 0;
+		for (;;) {
+			//Find how many consecutive slots are ready to be read, as slots complete independently only a ready prefix can be claimed.
+			for (n = 0; n < Count; n++) {
+				if (m_Cells[(Pos + n)&Mask].m_Sequence.load(std::memory_order_acquire) != Pos + n + 1) break;
+			}
+			if (!n) {
+				uint32_t Cur = m_ReadPos.load(std::memory_order_relaxed);
+				if (Cur == Pos) return 0;
+				Pos = Cur;
+				continue;
+			}
+			if (m_ReadPos.compare_exchange_weak(Pos, Pos + n, std::memory_order_relaxed)) break;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			Cell &C = m_Cells[(Pos + i)&Mask];
+			Results[i] = std::move(C.m_Data);
+			C.m_Sequence.store(Pos + i + MaxElementCount, std::memory_order_release);
+		}
+		return n;
+	}
+
+	/*! \brief pushes up to Count items from Items with a single reservation, returns the number of items pushed which may be less then Count if the list fills. */
+	uint32_t PushBatch(const Type *Items, uint32_t Count) {
+		uint32_t Pos = m_WritePos.load(std::memory_order_relaxed);
+		uint32_t n = 0;
+		for (;;) {
+			for (n = 0; n < Count; n++) {
+				if (m_Cells[(Pos + n)&Mask].m_Sequence.load(std::memory_order_acquire) != Pos + n) break;
+			}
+			if (!n) {
+				uint32_t Cur = m_WritePos.load(std::memory_order_relaxed);
+				if (Cur == Pos) return 0;
+				Pos = Cur;
+				continue;
+			}
+			if (m_WritePos.compare_exchange_weak(Pos, Pos + n, std::memory_order_relaxed)) break;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			Cell &C = m_Cells[(Pos + i)&Mask];
+			C.m_Data = Items[i];
+			C.m_Sequence.store(Pos + i + 1, std::memory_order_release);
+		}
+		return n;
+	}
+
+	/*! \brief returns the number of elements in the queue, this is only an approximation while other threads are operating on the queue. */
+	virtual uint32_t Length(void) {
+		return m_WritePos.load(std::memory_order_relaxed) - m_ReadPos.load(std::memory_order_relaxed);
+	}
+
+	/*! \brief constructor for the FIFO object, this object is available for use the moment that this object is returned. */
+	LWConcurrentBoundedFIFO() {
+		for (uint32_t i = 0; i < MaxElementCount; i++) m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+		m_WritePos.store(0, std::memory_order_relaxed);
+		m_ReadPos.store(0, std::memory_order_relaxed);
+	}
+
+	/*! \brief destroys the FIFO object, be sure all other threads have given up access to this object before you destroy the Concurrent list. */
+	~LWConcurrentBoundedFIFO() {}
+private:
+	static const uint32_t Mask = MaxElementCount - 1;
+
+	struct Cell {
+		std::atomic<uint32_t> m_Sequence;
+		Type m_Data;
+	};
+
+	Cell m_Cells[MaxElementCount];
+	alignas(64) std::atomic<uint32_t> m_WritePos;
+	alignas(64) std::atomic<uint32_t> m_ReadPos;
+	alignas(64) uint8_t m_Pad; /*!< \brief keeps the read position from sharing a cache line with whatever follows the queue. */
+};
+
+/*! \brief an unbounded concurrent First-in First-Out queue that supports any thread pushing and any thread popping, elements are stored in a chain of SegmentSize segments using the same per-slot sequence scheme as LWConcurrentBoundedFIFO.
+	segments are only linked, retired and recycled on a lock that is taken once every SegmentSize operations, drained segments are kept and reused so memory is bounded by the peak length of the queue.  SegmentSize must be a power of 2.
+*/
+template<class Type, uint32_t SegmentSize>
+class LWConcurrentUnboundedFIFO : public LWFIFO<Type> {
+public:
+	static_assert((SegmentSize&(SegmentSize - 1)) == 0, "SegmentSize must be a power of 2.");
+
+	/*! \brief removes an item from the list.  note: Peeking is not thread-safe, as it does not gurantee another thread hasn't already read and removed the object before Result is written to. */
+	virtual bool Pop(Type &Result, bool Peek = false) {
+		uint64_t Pos = m_ReadPos.load(std::memory_order_relaxed);
+		Segment *Seg = nullptr;
+		Cell *C = nullptr;
+		for (;;) {
+			Seg = m_Head.load(std::memory_order_acquire);
+			uint64_t SegIdx = Pos / SegmentSize;
+			uint64_t Idx = Seg->m_Index.load(std::memory_order_acquire);
+			if (Idx < SegIdx) {
+				if (!AdvanceHead(Seg, SegIdx)) return false;
+				continue;
+			} else if (Idx > SegIdx) {
+				Pos = m_ReadPos.load(std::memory_order_relaxed);
+				continue;
+			}
+			C = &Seg->m_Cells[Pos&Mask];
+			int64_t Dif = (int64_t)(C->m_Sequence.load(std::memory_order_acquire) - (Pos + 1));
+			if (Dif < 0) return false;
+			if (!Dif) {
+				if (Peek) {
+					Result = C->m_Data;
+					return true;
+				}
+				if (m_ReadPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+			} else Pos = m_ReadPos.load(std::memory_order_relaxed);
+		}
+		Result = std::move(C->m_Data);
+		Seg->m_Consumed.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	/*! \brief pushes an item onto the list, only fails if a new segment could not be allocated. */
+	virtual bool Push(const Type &Item) {
+		uint64_t Pos = m_WritePos.load(std::memory_order_relaxed);
+		Cell *C = nullptr;
+		for (;;) {
+			Segment *Seg = m_Tail.load(std::memory_order_acquire);
+			uint64_t SegIdx = Pos / SegmentSize;
+			uint64_t Idx = Seg->m_Index.load(std::memory_order_acquire);
+			if (Idx < SegIdx) {
+				if (!AdvanceTail(Seg, SegIdx)) return false;
+				continue;
+			} else if (Idx > SegIdx) {
+				Pos = m_WritePos.load(std::memory_order_relaxed);
+				continue;
+			}
+			C = &Seg->m_Cells[Pos&Mask];
+			if (C->m_Sequence.load(std::memory_order_acquire) == Pos) {
+				if (m_WritePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+			} else Pos = m_WritePos.load(std::memory_order_relaxed);
+		}
+		C->m_Data = Item;
+		C->m_Sequence.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*! \brief pops up to Count items into Results, each reservation is limited to the remainder of the current segment. returns the number of items popped. */
+	uint32_t PopBatch(Type *Results, uint32_t Count) {
+		uint32_t Total = 0;
+		while (Total < Count) {
+			uint64_t Pos = m_ReadPos.load(std::memory_order_relaxed);
+			Segment *Seg = m_Head.load(std::memory_order_acquire);
+			uint64_t SegIdx = Pos / SegmentSize;
+			uint64_t Idx = Seg->m_Index.load(std::memory_order_acquire);
+			if (Idx < SegIdx) {
+				if (!AdvanceHead(Seg, SegIdx)) break;
+				continue;
+			} else if (Idx > SegIdx) continue;
+			uint32_t Max = std::min<uint32_t>(Count - Total, SegmentSize - (uint32_t)(Pos&Mask));
+			uint32_t n = 0;
+			for (; n < Max; n++) {
+				if (Seg->m_Cells[(Pos + n)&Mask].m_Sequence.load(std::memory_order_acquire) != Pos + n + 1) break;
+			}
+			if (!n) {
+				if (m_ReadPos.load(std::memory_order_relaxed) == Pos) break;
+				continue;
+			}
+			if (!m_ReadPos.compare_exchange_weak(Pos, Pos + n, std::memory_order_relaxed)) continue;
+			for (uint32_t i = 0; i < n; i++) Results[Total + i] = std::move(Seg->m_Cells[(Pos + i)&Mask].m_Data);
+			Seg->m_Consumed.fetch_add(n, std::memory_order_release);
+			Total += n;
+		}
+		return Total;
+	}
+
+	/*! \brief pushes Count items from Items, each reservation is limited to the remainder of the current segment. returns the number of items pushed, which is only less then Count if a segment could not be allocated. */
+	uint32_t PushBatch(const Type *Items, uint32_t Count) {
+		uint32_t Total = 0;
+		while (Total < Count) {
+			uint64_t Pos = m_WritePos.load(std::memory_order_relaxed);
+			Segment *Seg = m_Tail.load(std::memory_order_acquire);
+			uint64_t SegIdx = Pos / SegmentSize;
+			uint64_t Idx = Seg->m_Index.load(std::memory_order_acquire);
+			if (Idx < SegIdx) {
+				if (!AdvanceTail(Seg, SegIdx)) break;
+				continue;
+			} else if (Idx > SegIdx) continue;
+			uint32_t Max = std::min<uint32_t>(Count - Total, SegmentSize - (uint32_t)(Pos&Mask));
+			uint32_t n = 0;
+			for (; n < Max; n++) {
+				if (Seg->m_Cells[(Pos + n)&Mask].m_Sequence.load(std::memory_order_acquire) != Pos + n) break;
+			}
+			if (!n || !m_WritePos.compare_exchange_weak(Pos, Pos + n, std::memory_order_relaxed)) continue;
+			for (uint32_t i = 0; i < n; i++) {
+				Cell &C = Seg->m_Cells[(Pos + i)&Mask];
+				C.m_Data = Items[Total + i];
+				C.m_Sequence.store(Pos + i + 1, std::memory_order_release);
+			}
+			Total += n;
+		}
+		return Total;
+	}
+
+	/*! \brief returns the number of elements in the queue, this is only an approximation while other threads are operating on the queue. */
+	virtual uint32_t Length(void) {
+		return (uint32_t)(m_WritePos.load(std::memory_order_relaxed) - m_ReadPos.load(std::memory_order_relaxed));
+	}
+
+	/*! \brief constructs the FIFO with the first segment allocated from Allocator, Allocator is only used while the internal segment lock is held. */
+	LWConcurrentUnboundedFIFO(LWAllocator &Allocator) : m_Allocator(Allocator) {
+		Segment *Seg = MakeSegment(0);
+		m_Head.store(Seg, std::memory_order_relaxed);
+		m_Tail.store(Seg, std::memory_order_relaxed);
+		m_WritePos.store(0, std::memory_order_relaxed);
+		m_ReadPos.store(0, std::memory_order_relaxed);
+	}
+
+	/*! \brief destroys the FIFO object, be sure all other threads have given up access to this object before you destroy the Concurrent list. */
+	~LWConcurrentUnboundedFIFO() {
+		Segment *Lists[] = { m_Head.load(), m_Retired, m_FreeSegments };
+		for (uint32_t i = 0; i < 3; i++) {
+			for (Segment *S = Lists[i]; S;) {
+				Segment *N = S->m_Next.load();
+				LWAllocator::Destroy(S);
+				S = N;
+			}
+		}
+	}
+private:
+	static const uint64_t Mask = SegmentSize - 1;
+
+	struct Cell {
+		std::atomic<uint64_t> m_Sequence;
+		Type m_Data;
+	};
+
+	struct Segment {
+		Cell m_Cells[SegmentSize];
+		std::atomic<uint64_t> m_Index;
+		std::atomic<uint32_t> m_Consumed; /*!< \brief number of cells which have finished being read, the segment can only be recycled once every cell is consumed. */
+		std::atomic<Segment*> m_Next;
+	};
+
+	/*! \brief takes a segment from the free list or allocator and prepares it to hold positions [Index*SegmentSize, (Index+1)*SegmentSize), must be called with m_SegmentLock held. */
+	Segment *MakeSegment(uint64_t Index) {
+		//Recycle any retired segments which have now been fully read.
+		while (m_Retired && m_Retired->m_Consumed.load(std::memory_order_acquire) == SegmentSize) {
+			Segment *S = m_Retired;
+			m_Retired = S->m_Next.load(std::memory_order_relaxed);
+			if (!m_Retired) m_RetiredTail = nullptr;
+			S->m_Next.store(m_FreeSegments, std::memory_order_relaxed);
+			m_FreeSegments = S;
+		}
+		Segment *S = m_FreeSegments;
+		if (S) m_FreeSegments = S->m_Next.load(std::memory_order_relaxed);
+		else {
+			S = m_Allocator.Allocate<Segment>();
+			if (!S) return nullptr;
+		}
+		//Any thread still holding a stale pointer to this segment will see a mismatched index or sequence and reload.
+		S->m_Index.store(Index, std::memory_order_release);
+		for (uint64_t i = 0; i < SegmentSize; i++) S->m_Cells[i].m_Sequence.store(Index*SegmentSize + i, std::memory_order_release);
+		S->m_Consumed.store(0, std::memory_order_relaxed);
+		S->m_Next.store(nullptr, std::memory_order_relaxed);
+		return S;
+	}
+
+	/*! \brief moves the tail forward until it reaches SegIdx, linking new segments as needed. */
+	bool AdvanceTail(Segment *Seg, uint64_t SegIdx) {
+		std::lock_guard<std::mutex> Lock(m_SegmentLock);
+		Segment *Tail = m_Tail.load(std::memory_order_relaxed);
+		if (Tail != Seg) return true;
+		while (Tail->m_Index.load(std::memory_order_relaxed) < SegIdx) {
+			Segment *Next = Tail->m_Next.load(std::memory_order_relaxed);
+			if (!Next) {
+				Next = MakeSegment(Tail->m_Index.load(std::memory_order_relaxed) + 1);
+				if (!Next) return false;
+				Tail->m_Next.store(Next, std::memory_order_release);
+			}
+			Tail = Next;
+		}
+		m_Tail.store(Tail, std::memory_order_release);
+		return true;
+	}
+
+	/*! \brief moves the head forward to SegIdx and retires the drained segments, returns false if the next segment has not been linked yet(the queue is empty). */
+	bool AdvanceHead(Segment *Seg, uint64_t SegIdx) {
+		std::lock_guard<std::mutex> Lock(m_SegmentLock);
+		Segment *Head = m_Head.load(std::memory_order_relaxed);
+		if (Head != Seg) return true;
+		while (Head->m_Index.load(std::memory_order_relaxed) < SegIdx) {
+			Segment *Next = Head->m_Next.load(std::memory_order_acquire);
+			if (!Next) break;
+			Head->m_Next.store(nullptr, std::memory_order_relaxed);
+			if (m_RetiredTail) m_RetiredTail->m_Next.store(Head, std::memory_order_relaxed);
+			else m_Retired = Head;
+			m_RetiredTail = Head;
+			Head = Next;
+		}
+		if (Head == Seg) return false;
+		m_Head.store(Head, std::memory_order_release);
+		return true;
+	}
+
+	alignas(64) std::atomic<uint64_t> m_WritePos;
+	alignas(64) std::atomic<Segment*> m_Tail;
+	alignas(64) std::atomic<uint64_t> m_ReadPos;
+	alignas(64) std::atomic<Segment*> m_Head;
+	alignas(64) std::mutex m_SegmentLock;
+	Segment *m_Retired = nullptr;
+	Segment *m_RetiredTail = nullptr;
+	Segment *m_FreeSegments = nullptr;
+	LWAllocator &m_Allocator;
+};
 /*! @} */
 #endif
 
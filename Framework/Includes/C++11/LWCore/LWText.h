@@ -184,6 +184,9 @@ public:
 	/*!< \overload uint32_t Copy(const char *, uint32_t, char*, uint32_t); */
 	static uint32_t Copy(const char *Pos, uint32_t n, char *Buffer, uint32_t BufferLen);
 
+	/*!< \brief printf formats into Buffer at Position and advances Position by the formatted length.  once Buffer is full nothing more is written but Position keeps advancing, so it finishes at the length needed for the whole output.  returns Position. */
+	static uint32_t Appendf(char *Buffer, uint32_t BufferLen, uint32_t &Position, const char *Fmt, ...);
+
 	/*! \brief returns the next character of the UTF-8 string. 
 		\note returns null if at the end of the string.
 	*/
@@ -19,6 +19,10 @@ class LWByteBuffer;
 
 class LWByteStream;
 
+class LWBitWriter;
+
+class LWBitReader;
+
 class LWFileStream;
 
 class LWText;
@@ -65,12 +69,24 @@ class LWAllocator_ConcurrentCircular;
 
 class LWAllocator_LocalHeap;
 
+class LWAllocatorStats;
+
+class LWAllocator_Pool;
+
+class LWAllocator_FrameArena;
+
 template<class Type>
 class LWFIFO;
 
 template<class Type, uint32_t MaxElements>
 class LWConcurrentFIFO;
 
+template<class Type, uint32_t MaxElementCount>
+class LWConcurrentBoundedFIFO;
+
+template<class Type, uint32_t SegmentSize>
+class LWConcurrentUnboundedFIFO;
+
 /*!< \brief defined double version of the quaternion class. */
 typedef LWQuaternion<double> LWQuaterniond;
 /*!< \brief defined float version of the quaternion class. */
@@ -17,7 +17,9 @@ public:
 
 		LWPacketID = 0x10000,
 
-		Ack = 0x80000000, /*!< \brief flag to indicate the packet expects an Ack response. */
+		Ack = 0x80000000, /*!< \brief flag to indicate the packet is reliable, it is resent until acked and delivered once. */
+		Sequenced = 0x40000000, /*!< \brief flag to indicate an unreliable packet is dropped if it arrives after a newer datagram from the same client. */
+		Ordered = 0x20000000, /*!< \brief flag for reliable packets to be delivered in the order they were pushed. */
 	};
 
 	/*!< \brief deserializes a basic packet object, is also useful for chaining deserialization. 
@@ -75,7 +77,7 @@ public:
 	/*!< \brief returns the packets id. */
 	uint32_t GetPacketID(void) const;
 
-	/*!< \brief returns the packets Ack id, when supporting reliable ack. */   
+	/*!< \brief returns the packets Ack id, this is the reliable message id within the packet's channel, and is only serialized for packets flagged Ack. */   
 	uint32_t GetPacketAckID(void) const;
 
 	/*!< \brief returns the minimum time for when to send the packet. */
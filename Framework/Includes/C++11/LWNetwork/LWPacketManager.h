@@ -4,6 +4,8 @@
 #include "LWNetwork/LWTypes.h"
 #include <functional>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 /*!< \brief this is the stored header for a packet, it contains the necessary information for buffering the packets content.*/
 struct LWPacketHeader{
@@ -13,36 +15,96 @@ struct LWPacketHeader{
 	void *m_Source;
 };
 
-/*!< \brief this is the raw packet header, the layout of all packets is preceded with this information, and it is imperative that at minimum this amount of data is sent. */
+/*!< \brief this is the raw packet header, the layout of all packets is preceded with this information, and it is imperative that at minimum this amount of data is sent.  the sequence and acks are per client and piggyback acknowledgement of received datagrams on every datagram sent back. */
 struct LWPacketRawHeader{
 	uint32_t m_Header;
 	uint32_t m_TotalSize;
+	uint16_t m_Sequence; /*!< \brief the sequence number of this datagram. */
+	uint16_t m_Ack; /*!< \brief the most recent sequence received from the other side. */
+	uint32_t m_AckBits; /*!< \brief bit n is set if sequence m_Ack-n was received, 0 if nothing has been received yet. */
 };
 
-/*!< \brief packet manager, which manages in and out packets and manages split packets as well, as well as providing selective resending of packets marked for requiring an Ack, this provides a reliable udp implementation if needed. */
+/*!< \brief a reliable message that has been sent and is waiting for it's ack. */
+struct LWPacketReliable{
+	LWPacket *m_Packet = nullptr;
+	uint64_t m_ResendTime = 0;
+	uint32_t m_ResendCount = 0;
+};
+
+/*!< \brief the sequence and time a datagram was sent at, and the reliable message it carried if any. */
+struct LWPacketSent{
+	uint64_t m_SendTime = 0;
+	uint32_t m_Sequence = 0xFFFFFFFF;
+	uint32_t m_MessageID = 0xFFFFFFFF;
+};
+
+/*!< \brief the reliable channel state the packet manager keeps for each client. */
+struct LWPacketChannel{
+	enum{
+		Window = 256, /*!< \brief the max number of reliable messages in flight, and the number of datagrams remembered for acks, must be a power of 2. */
+		InitialCongestionWindow = 4, /*!< \brief the number of reliable messages allowed in flight before any have been acked. */
+		MinCongestionWindow = 2 /*!< \brief the congestion window never shrinks below this many messages. */
+	};
+	LWPacketSent m_Sent[Window]; /*!< \brief the datagrams sent, indexed by sequence%Window. */
+	LWPacketReliable m_Unacked[Window]; /*!< \brief the reliable messages in flight, indexed by message id%Window. */
+	LWPacket *m_Ordered[Window]; /*!< \brief ordered messages received ahead of a missing message, indexed by message id%Window. */
+	uint32_t m_Received[Window]; /*!< \brief the message id|0x10000 of every reliable message received, indexed by message id%Window. */
+	void *m_Client;
+	uint64_t m_SmoothedRTT = 0;
+	uint64_t m_RTTVariance = 0;
+	uint64_t m_LastSendTime = 0;
+	uint64_t m_LastLossTime = 0;
+	float m_CongestionWindow = (float)InitialCongestionWindow;
+	float m_SlowStartThreshold = (float)Window;
+	uint32_t m_AckBits = 0;
+	uint32_t m_InFlight = 0;
+	uint16_t m_LocalSequence = 0;
+	uint16_t m_RemoteSequence = 0;
+	uint16_t m_LastSequenced = 0;
+	uint16_t m_NextMessageID = 0;
+	uint16_t m_OldestUnacked = 0;
+	uint16_t m_NextReceiveID = 0;
+	bool m_HasRemote = false;
+	bool m_HasSequenced = false;
+	bool m_HasRTT = false;
+	bool m_AckPending = false;
+
+	/*!< \brief returns true if another reliable message fits in the congestion and sequence windows. */
+	bool CanSend(void) const;
+
+	LWPacketChannel(void *Client);
+};
+
+/*!< \brief packet manager, which manages in and out packets and manages split packets as well, as well as providing a reliable udp channel layer per client.
+	 every datagram made by SerializePacket carries a sequence number along with acks for the last 32 datagrams received from that client.  packets flagged LWPacket::Ack are resent until a datagram carrying them is acked, with the resend timeout adapting to the measured round trip time and a per client congestion window limiting how many are in flight.
+	 reliable packets are delivered once, and LWPacket::Ordered packets in the order they were pushed.  LWPacket::Sequenced packets are unreliable but any arriving after a newer datagram are dropped.
+*/
 class LWPacketManager{
 public:
 	enum{
 		MaxOutPackets = 1024, /*!< \brief the maximum number of packets which can be queied at any time. */
 		Header = 0x4C57504B, /*!< \brief special header to indicate start of a packet: LWPK */
 
-		ResendFrequency = 3 /*!< \brief the resend frequency for sending packets from a client. */
+		ResendFrequency = 3, /*!< \brief the resend frequency in seconds for unreliable packets that could not be sent, and the upper bound of the reliable resend timeout. */
+		InitialResendMS = 1000, /*!< \brief the reliable resend timeout in milliseconds until a round trip has been measured. */
+		MinResendMS = 50, /*!< \brief the lower bound of the reliable resend timeout in milliseconds. */
+		AckDelayMS = 30 /*!< \brief if nothing has been sent to a client this many milliseconds after receiving a reliable packet from it, an ack only packet is sent. */
 	};
-	
-	/*!< \brief Serializes a single packet object into buffer. */
+
+	/*!< \brief Serializes a single packet object into buffer, stamping it with the next sequence and the acks for the packet's client.  every datagram sent to a client must be made with this method for acks and round trip times to work. */
 	uint32_t SerializePacket(LWPacket *Packet, char *Buffer, uint32_t BufferLen);
 
-	/*!< \brief attempts to deserialize a buffer into a series of packets if possible.
+	/*!< \brief attempts to deserialize a buffer into a series of packets if possible, and applies the acks it carries to the client's channel.
 		 \param Buffer the buffer containing the raw packet data.
 		 \param BUfferLen the length of the buffer, this method will deserialize as many packets as it can find, or stop if it reaches something it cannot deserialize.
 		 \param Client the client associated with the packet.
 		 \param Source the source of the received data.
-		 \param PacketAllocator the allocator used to create the packets.
+		 \param Sequence optional pointer to receive the datagram's sequence number.
 		 \return pointer to an allocated packet that the caller now owns, or null if failure.
 	*/
-	LWPacket *DeserializePacket(const char *Buffer, uint32_t BufferLen, void *Client, void *Source);
+	LWPacket *DeserializePacket(const char *Buffer, uint32_t BufferLen, void *Client, void *Source, uint16_t *Sequence = nullptr);
 
-	/*!< \brief processes raw packet data and either forms it into a packet, or stores it if the entire packet has not been received yet. 
+	/*!< \brief processes raw packet data and either forms it into a packet, or stores it if the entire packet has not been received yet.
 		 \
 	*/
 	bool ProcessRawData(void *Client, void *Source, const char *Buffer, uint32_t BufferLen);
@@ -50,24 +112,30 @@ public:
 	/*!< \brief sets the packets user data. */
 	LWPacketManager &SetUserData(void *UserData);
 
-	/*!< \brief processes outgoing packets, and potential ack responses. 
-		 \param lCurrentTime the current time, most commonly used by LWTimer::GetCurrent
+	/*!< \brief processes outgoing packets, resends reliable packets which have timed out, and sends acks that could not be piggybacked.
+		 \param lCurrentTime the current time, most commonly used by LWTimer::GetCurrent, this time is also used to measure round trips until the next Update.
 		 \param ClockResolutuion the resolution the clock uses for 1 second, most commonly captured via LWTimer::GetResolution.
 	*/
 	LWPacketManager &Update(uint64_t lCurrentTime, uint64_t ClockResolution);
 
-	/*!< \brief purges all out going and temporary packets marked by client most commonly due to client disconnect. */
+	/*!< \brief purges all out going and temporary packets marked by client, along with it's channel, most commonly due to client disconnect. */
 	LWPacketManager &PurgeClient(void *Client);
 
 	/*!< \brief registers a deserialization function with type identifier. */
 	LWPacketManager &RegisterDeserialization(uint32_t TypeID, std::function<LWPacket*(LWByteBuffer*, uint32_t, LWPacket*, LWAllocator &, LWPacketManager*)> Func);
 
-	/*!< \brief adds an outgoing packet to the packet list, and takes ownership of that packet. 
+	/*!< \brief adds an outgoing packet to the packet list, and takes ownership of that packet.  reliable packets wait in the list while their client's send window is full.
 		 \return rather packet was succesfully added to the queue.
 		 \note this function is not multi-threaded friendly, do not push packets and call update from seperate threads!
 	*/
 	bool PushOutPacket(LWPacket *Packet);
 
+	/*!< \brief returns the channel for the client, or null if nothing has been sent to or received from it. */
+	const LWPacketChannel *GetChannel(void *Client) const;
+
+	/*!< \brief returns the smoothed round trip time to the client in clock ticks, or 0 if it has not been measured. */
+	uint64_t GetRoundTripTime(void *Client) const;
+
 	/*!< \brief returns the packets user data. */
 	void *GetUserData(void) const;
 
@@ -79,22 +147,43 @@ public:
 		 \param BufferAllocator the allocator used to allocate the packet buffer.
 		 \param PacketAllocator the allocator used when deserializing packets.
 		 \param ReceivePacketFunc the function callback used when a packet has been deserialized, must return true if the packet is being owned by the applicaiton, or false if the packet is to be destroyed by the packet manager.
-		 \param SendPacketFunc the function callback used when a packet is ready to be sent(only called inside the update method). must return true is the packet was sent, and can be safely destroyed(or stored until an ack is received), or false if the packet could not be sent.
-		 \note LWPacket::PacketAck type is automatically registered as a deserialization type.
+		 \param SendPacketFunc the function callback used when a packet is ready to be sent(only called inside the update method), the packet should be serialized with SerializePacket. must return true is the packet was sent, and can be safely destroyed(or stored until an ack is received), or false if the packet could not be sent.
+		 \note LWPacket::PacketAck type is automatically registered as a deserialization type, and is used for ack only datagrams.
 	*/
 	LWPacketManager(uint32_t PacketBufferSize, LWAllocator &BufferAllocator, LWAllocator &PacketAllocator, std::function<bool(LWPacket *Pack, LWPacketManager *Man)> ReceivePacketFunc, std::function<bool(LWPacket *Pack, LWPacketManager *Man)> SendPacketFunc);
 
 	/*!< \brief destructs a packet manager object. */
 	~LWPacketManager();
 private:
+	/*!< \brief returns the channel for the client, creating it if needed. */
+	LWPacketChannel &FindChannel(void *Client);
+
+	/*!< \brief returns the current reliable resend timeout for the channel in clock ticks. */
+	uint64_t GetResendTimeout(const LWPacketChannel &Channel) const;
+
+	/*!< \brief records that the datagram Sequence was acked, releasing the reliable message it carried, and taking a round trip sample if Measure is set. */
+	void AckSequence(LWPacketChannel &Channel, uint16_t Sequence, bool Measure);
+
+	/*!< \brief filters a received packet through it's client's channel, handing it to the receive callback if it should be delivered. */
+	void ReceivePacket(LWPacket *Pack, void *Client, uint16_t Sequence);
+
+	/*!< \brief hands a packet to the receive callback, destroying it if the callback does not take ownership. */
+	void DeliverPacket(LWPacket *Pack);
+
+	/*!< \brief destroys a chain of packets. */
+	static void DestroyPacket(LWPacket *Pack);
+
 	LWPacket *m_OutPackets[MaxOutPackets];
 	char *m_PacketBuffer;
 	void *m_UserData = nullptr;
 	std::function<bool(LWPacket *Pack, LWPacketManager *Man)> m_ReceivePacketFunction;
 	std::function<bool(LWPacket *Pack, LWPacketManager *Man)> m_SendPacketFunction;
 	std::map<uint32_t, std::function<LWPacket*(LWByteBuffer*, uint32_t, LWPacket*, LWAllocator&, LWPacketManager*)>> m_DeserializeFunctions;
+	std::unordered_map<void*, LWPacketChannel*> m_Channels;
+	std::vector<LWPacketChannel*> m_ChannelList;
 	LWAllocator *m_PacketAllocator;
-	uint32_t m_NextAckID = 0;
+	uint64_t m_CurrentTime = 0;
+	uint64_t m_ClockResolution = 0;
 	uint32_t m_OutPacketCount = 0;
 	uint32_t m_PacketBufferLength;
 	uint32_t m_PacketBufferPosition = 0;
@@ -4,14 +4,35 @@
 #include "LWNetwork/LWTypes.h"
 #include "LWNetwork/LWSocket.h"
 #include "LWPlatform/LWPlatform.h"
+#include <unordered_map>
+#include <vector>
+#include <mutex>
 
 
 /*!< \brief protocol manager, supports managements of sockets, and the associated protocols they are associated with. also contains the functions to initiate and terminate the network status for the application. */
 class LWProtocolManager{
 public:
 	enum{
-		MaxSockets = 4096, /*!< \brief defines the total max sockets a protocol manager can support at one time. */
-		MaxProtocols = 128 /*!< \brief defines the total max unique protocol's the protocol manager can support at one time, this number is also the max protcol id's allowed, each protocol must be given a unique id. */
+		SocketBlockSize = 4096, /*!< \brief sockets are stored in blocks of this size, blocks are added as needed so socket pointers remain stable as the manager grows. */
+		MaxSocketBlocks = 256, /*!< \brief the max number of socket blocks. */
+		MaxSockets = SocketBlockSize*MaxSocketBlocks, /*!< \brief defines the total max sockets a protocol manager can support at one time. */
+		MaxProtocols = 128, /*!< \brief defines the total max unique protocol's the protocol manager can support at one time, this number is also the max protcol id's allowed, each protocol must be given a unique id. */
+		MaxReadyEvents = 1024, /*!< \brief the max number of ready sockets retrieved from the event queue per Poll, any others are retrieved on the next Poll. */
+		CloseSweepInterval = 64, /*!< \brief with an event queue only sockets that were read are checked for closing, every CloseSweepInterval polls all sockets are checked for sockets marked closable outside of a Read. */
+
+		PollBackend = 0x0, /*!< \brief flag to use poll() over every socket, supported on all platforms. */
+		EventQueueBackend = 0x1, /*!< \brief flag to use the platform's event queue(epoll on linux and android) so Poll only visits sockets with pending events, falls back to PollBackend if the platform has no event queue. */
+		EdgeTriggered = 0x2, /*!< \brief flag to register sockets edge triggered with the event queue, only use this if every protocol's Read drains it's socket as a socket will not be reported again until new data arrives. */
+
+		EventAdd = 0, /*!< \brief event queue operation to add a socket. */
+		EventModify, /*!< \brief event queue operation to change a socket's index. */
+		EventRemove, /*!< \brief event queue operation to remove a socket. */
+
+		EventReadable = 0x40000000, /*!< \brief set on an index returned by EventQueueWait when the socket has data to read or was closed. */
+		EventWritable = 0x80000000, /*!< \brief set on an index returned by EventQueueWait when a socket registered as Writable has room in it's send buffer. */
+		EventIndexBits = 0x3FFFFFFF, /*!< \brief mask for the socket index of an entry returned by EventQueueWait. */
+
+		InvalidEventQueue = 0xFFFFFFFF /*!< \brief returned by CreateEventQueue on platforms without an event queue. */
 	};
 	/*!< \brief initiates the network stack for the application.
 		 \return true if the network could be successfully initiated, false on failure.
@@ -23,6 +44,20 @@ public:
 
 	static bool PollSet(pollfd *SocketSet, uint32_t SetCnt, uint32_t Timeout);
 
+	/*!< \brief creates the platform's event queue, returns InvalidEventQueue if the platform does not have one. */
+	static uint32_t CreateEventQueue(void);
+
+	/*!< \brief destroys an event queue made with CreateEventQueue. */
+	static void DestroyEventQueue(uint32_t EventQueue);
+
+	/*!< \brief adds, modifys, or removes(Op is EventAdd, EventModify, or EventRemove) the socket descriptor from the event queue, Index is reported back by EventQueueWait when the socket has an event.  if Writable is true the socket is also reported when it can be written to. */
+	static bool EventQueueSet(uint32_t EventQueue, uint32_t SocketDescriptor, uint32_t Index, uint32_t Op, bool EdgeTriggered, bool Writable = false);
+
+	/*!< \brief waits upto Timeout milliseconds for sockets to have events, writing the index of each into ReadyList or'd with EventReadable and/or EventWritable.
+		 \return the number of ready sockets, or 0xFFFFFFFF on error.
+	*/
+	static uint32_t EventQueueWait(uint32_t EventQueue, uint32_t *ReadyList, uint32_t ReadyListSize, uint32_t Timeout);
+
 	/*!< \brief returns a list of host ip's avaiable to be connected to.
 		 \param IPBuffer the buffer to receive the ip's.
 		 \param BufferSize the size of buffer(in uint32_t size, not byte size! i.e: the number of ip's we can write to.
@@ -36,12 +71,20 @@ public:
 	/*!< \brief sets the user data for the protocol manager. */
 	LWProtocolManager &SetUserData(void *UserData);
 
-	/*!< \brief polls all active sockets for any data to be read, and calls the relevant protocols. 
+	/*!< \brief polls all active sockets for any data to be read, and calls the relevant protocols. with an event queue only sockets with pending events are visited.
 		 \param Timeout the timeout time is in milliseconds, with 0 being instant, and 0xFFFFFFFF for infinite.
 		 \return true if polling was successful, false if failure.
 	*/
 	bool Poll(uint32_t Timeout);
 
+	/*!< \brief sends what the socket's output queue can without blocking, if anything is left the socket is watched for room on the next Poll which keeps flushing it until the queue is empty.  may be called from any thread.
+		 \return false if the socket had an error.
+	*/
+	bool Flush(LWSocket &Socket);
+
+	/*!< \brief returns true if the manager is using the platform's event queue instead of poll(). */
+	bool isEventQueue(void) const;
+
 	/*!< \brief pushes a socket into the protocol manager, this function now takes ownership of the socket internally via a move operation(as such operations on the original socket well be invalid), however the memory passed to this function is still owned by the application, and must be cleaned up by the application(if allocated on heap).
 		 \return the socket object upon successfully being added, nullptr if the number of sockets is already exhausted.
 	*/
@@ -56,22 +99,51 @@ public:
 	/*!< \brief returns the active socket at the specified index. */
 	LWSocket *GetSocket(uint32_t Index);
 
+	/*!< \brief returns the active socket with the specified socket descriptor, or null if no active socket has that descriptor. */
+	LWSocket *FindSocket(uint32_t SocketDescriptor);
+
 	/*!< \brief returns the total number of active sockets. */
 	uint32_t GetActiveSocketCount(void) const;
 
 	/*!< \brief returns the user data for the protocol. */
 	void *GetUserData(void) const;
 
-	/*!< \brief constructs a protocol manager object. */
-	LWProtocolManager();
+	/*!< \brief constructs a protocol manager object.
+		 \param Flags the backend to use, PollBackend or EventQueueBackend(optionally with EdgeTriggered).
+	*/
+	LWProtocolManager(uint32_t Flags = PollBackend);
 
 	~LWProtocolManager();
 private:
-	LWSocket m_Sockets[MaxSockets];
-	pollfd m_SocketSet[MaxSockets];
+	/*!< \brief closes the socket at Index and moves the last socket into it's place. */
+	void RemoveSocket(uint32_t Index);
+
+	/*!< \brief starts or stops watching the socket at Index for room to write. */
+	void WatchWritable(uint32_t Index, bool Writable);
+
+	/*!< \brief flushes the socket at Index after it became writable, and stops watching it once it's queue is empty. */
+	void FlushWritable(uint32_t Index);
+
+	/*!< \brief starts watching every socket handed to Flush since the last Poll that still has queued data. */
+	void WatchPendingWrites(void);
+
+	/*!< \brief returns true if the socket at Index is marked closable and has nothing left to send. */
+	bool isRemovable(uint32_t Index);
+
+	LWSocket *m_SocketBlocks[MaxSocketBlocks];
+	pollfd *m_SocketSet = nullptr;
 	LWProtocol *m_Protocols[MaxProtocols];
+	std::unordered_map<uint32_t, uint32_t> m_SocketIndices;
+	std::vector<uint32_t> m_PendingWrites;
+	std::vector<uint32_t> m_WatchList;
+	std::mutex m_WriteLock;
+	uint32_t m_ReadyList[MaxReadyEvents];
 	void *m_UserData = nullptr;
 	uint32_t m_ActiveSocketCount = 0;
+	uint32_t m_SocketBlockCount = 0;
+	uint32_t m_EventQueue = InvalidEventQueue;
+	uint32_t m_PollCount = 0;
+	uint32_t m_Flags;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef LWSHARDEDPROTOCOLMANAGER_H
+#define LWSHARDEDPROTOCOLMANAGER_H
+#include "LWCore/LWTypes.h"
+#include "LWCore/LWConcurrent/LWFIFO.h"
+#include "LWNetwork/LWTypes.h"
+#include "LWNetwork/LWSocket.h"
+#include "LWNetwork/LWProtocol.h"
+#include "LWNetwork/LWProtocolManager.h"
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <type_traits>
+
+/*!< \brief runs several protocol managers(shards) each on their own thread, every socket belongs to exactly one shard and all of it's protocol callbacks are made on that shard's thread.
+	 listeners created with CreateListener are bound once per shard with SO_REUSEPORT so the os balances new connections, on platforms without SO_REUSEPORT a single listener on shard 0 accepts connections and hands them to the shards round robin.
+	 protocols which keep per manager state(such as LWEProtocolHttp and LWEProtocolWebSocket) should be created once per shard with GetShard, protocols registered to every shard must be thread safe.
+	 work for a socket owned by another shard is passed with Post or Send, which queue it to run on the owning shard's thread.
+*/
+class LWShardedProtocolManager {
+public:
+	enum {
+		MaxShards = 64, /*!< \brief the max number of shards. */
+		InternalProtocolID = LWProtocolManager::MaxProtocols - 1, /*!< \brief protocol id reserved for the shard wake sockets and round robin listeners, applications must not register a protocol with this id. */
+		TaskSegmentSize = 256, /*!< \brief segment size of each shard's task queue. */
+		PollTimeout = 100, /*!< \brief the max time in milliseconds a shard waits in Poll before checking if it should stop. */
+		TaskBatchSize = 32 /*!< \brief the number of tasks popped from a shard's queue at once. */
+	};
+
+	/*!< \brief a unit of work to be run on a shard's thread, receives that shard's protocol manager. */
+	typedef std::function<void(LWProtocolManager &)> Task;
+
+	/*!< \brief the queue of tasks waiting to run on a shard. */
+	typedef LWConcurrentUnboundedFIFO<Task, TaskSegmentSize> TaskQueue;
+
+	/*!< \brief creates a listening socket on Port for ProtocolID, once per shard when SO_REUSEPORT is available, otherwise a single socket on shard 0 which hands off accepted connections round robin.
+		 \param Port the port to listen on, if 0 the port chosen by the os for the first shard is used for every shard.
+		 \param Flag additional LWSocket flags, Listen is always added.
+		 \return 0 on success, or an LWSocket error code.
+	*/
+	uint32_t CreateListener(uint16_t Port, uint32_t Flag, uint32_t ProtocolID);
+
+	/*!< \brief registers a protocol with a single shard, call before Start. */
+	LWShardedProtocolManager &RegisterProtocol(uint32_t Shard, LWProtocol *Protocol, uint32_t ProtocolID);
+
+	/*!< \brief registers a protocol with every shard, the protocol must be safe to call from every shard's thread at once. call before Start. */
+	LWShardedProtocolManager &RegisterProtocol(LWProtocol *Protocol, uint32_t ProtocolID);
+
+	/*!< \brief moves Socket to the next shard in round robin order, the socket is pushed on that shard's thread. */
+	bool PushSocket(LWSocket &Socket);
+
+	/*!< \brief moves Socket to the specified shard, the socket is pushed on that shard's thread. */
+	bool PushSocket(uint32_t Shard, LWSocket &Socket);
+
+	/*!< \brief queues T to run on the specified shard's thread, this can be called from any thread.
+		 \return false if the task could not be queued.
+	*/
+	bool Post(uint32_t Shard, const Task &T);
+
+	/*!< \brief copys Buffer and has the shard that owns the socket with SocketDescriptor append it to the socket's output queue and flush it, so writes from other threads are never interleaved with the owning shard's own writes.  the data is dropped if the socket has been closed by the time the shard runs the send. */
+	bool Send(uint32_t Shard, uint32_t SocketDescriptor, const char *Buffer, uint32_t Len);
+
+	/*!< \brief starts every shard's polling thread. */
+	bool Start(void);
+
+	/*!< \brief stops and joins every shard's thread, any tasks still queued are run on the calling thread. */
+	LWShardedProtocolManager &Stop(void);
+
+	/*!< \brief returns the protocol manager for the specified shard, it should only be used directly before Start or from that shard's thread. */
+	LWProtocolManager &GetShard(uint32_t Shard);
+
+	/*!< \brief returns the shard index which owns Manager, or 0xFFFFFFFF if Manager is not one of this object's shards. */
+	uint32_t GetShardIndex(const LWProtocolManager *Manager) const;
+
+	/*!< \brief returns the number of shards. */
+	uint32_t GetShardCount(void) const;
+
+	/*!< \brief returns true if the shard threads are running. */
+	bool isRunning(void) const;
+
+	/*!< \brief constructs the sharded manager.
+		 \param ShardCount the number of shards(and threads), clamped to 1-MaxShards.
+		 \param Allocator the allocator used for the shards, task queues, handed off sockets, and queued sends, it is used from every shard's thread so must be thread safe(such as LWAllocator_Pool).
+		 \param ManagerFlags the flags passed to each shard's LWProtocolManager.
+	*/
+	LWShardedProtocolManager(uint32_t ShardCount, LWAllocator &Allocator, uint32_t ManagerFlags = LWProtocolManager::EventQueueBackend);
+
+	/*!< \brief stops the shards and closes every socket. */
+	~LWShardedProtocolManager();
+private:
+	/*!< \cond */
+	class InternalProtocol : public LWProtocol {
+	public:
+		virtual LWProtocol &Read(LWSocket &Socket, LWProtocolManager *Manager);
+
+		InternalProtocol(LWShardedProtocolManager *Owner);
+	private:
+		LWShardedProtocolManager *m_Owner;
+	};
+
+	struct Shard {
+		LWProtocolManager *m_Manager = nullptr;
+		TaskQueue *m_Tasks = nullptr;
+		typename std::aligned_storage<sizeof(TaskQueue), alignof(TaskQueue)>::type m_TaskStorage; /*!< \brief storage m_Tasks is constructed in, kept inline as the queue is over aligned. */
+		LWSocket m_WakeSender;
+		std::thread m_Thread;
+		std::atomic<bool> m_WakePending;
+		uint16_t m_WakePort = 0;
+	};
+	/*!< \endcond */
+
+	/*!< \brief runs every task queued for the shard. */
+	void RunTasks(uint32_t ShardIdx);
+
+	/*!< \brief wakes the shard's thread from Poll if it has not already been woken. */
+	void Wake(uint32_t ShardIdx);
+
+	Shard m_Shards[MaxShards];
+	InternalProtocol m_InternalProtocol;
+	LWAllocator &m_Allocator;
+	std::atomic<uint32_t> m_NextShard;
+	std::atomic<bool> m_Running;
+	uint32_t m_ShardCount;
+};
+
+#endif
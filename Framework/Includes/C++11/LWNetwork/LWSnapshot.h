@@ -0,0 +1,200 @@
+#ifndef LWSNAPSHOT_H
+#define LWSNAPSHOT_H
+#include "LWCore/LWTypes.h"
+#include "LWNetwork/LWTypes.h"
+#include <unordered_map>
+#include <vector>
+
+/*!< \brief describes how a single field of every entity in a snapshot is stored and written. */
+struct LWSnapshotField {
+	uint32_t m_Type;
+	uint32_t m_Bits; /*!< \brief the number of bits a full value of the field is written with. */
+	int32_t m_Min = 0;
+	int32_t m_Max = 0;
+	float m_fMin = 0.0f;
+	float m_fMax = 0.0f;
+	float m_Resolution = 0.0f;
+};
+
+/*!< \brief the list of fields every entity of a snapshot has, the server and client must build identical schemas. */
+class LWSnapshotSchema {
+public:
+	enum {
+		Bits = 0, /*!< \brief an unsigned value written with a fixed number of bits. */
+		Bounded, /*!< \brief a signed value clamped to a range, and written with the bits that range requires. */
+		Quantized, /*!< \brief a float quantized to a resolution within a range, and stored as the quantized step. */
+		VarInt, /*!< \brief a signed value written as a variable length integer, changes are written as the difference from the baseline. */
+		Float, /*!< \brief a float written with all 32 bits. */
+
+		MaxFields = 64 /*!< \brief the max number of fields an entity can have. */
+	};
+
+	/*!< \brief adds a field written with BitCount bits, returns false if the schema is full. */
+	bool AddBits(uint32_t BitCount);
+
+	/*!< \brief adds a signed field clamped between Min and Max. */
+	bool AddBounded(int32_t Min, int32_t Max);
+
+	/*!< \brief adds a float field quantized to Resolution between Min and Max. */
+	bool AddQuantized(float Min, float Max, float Resolution);
+
+	/*!< \brief adds a signed variable length integer field. */
+	bool AddVarInt(void);
+
+	/*!< \brief adds a full precision float field. */
+	bool AddFloat(void);
+
+	/*!< \brief writes the full stored value of a field. */
+	void WriteValue(LWBitWriter &Writer, uint32_t Field, uint32_t Value) const;
+
+	/*!< \brief reads the full stored value of a field. */
+	uint32_t ReadValue(LWBitReader &Reader, uint32_t Field) const;
+
+	/*!< \brief writes a changed value of a field, either as the difference from Baseline or the full value, whichever is fewer bits. */
+	void WriteDelta(LWBitWriter &Writer, uint32_t Field, uint32_t Value, uint32_t Baseline) const;
+
+	/*!< \brief reads a value written with WriteDelta. */
+	uint32_t ReadDelta(LWBitReader &Reader, uint32_t Field, uint32_t Baseline) const;
+
+	/*!< \brief converts an integer to the stored value of a field. */
+	uint32_t MakeValue(uint32_t Field, int32_t Value) const;
+
+	/*!< \brief converts a float to the stored value of a field, quantizing it for Quantized fields. */
+	uint32_t MakeValue(uint32_t Field, float Value) const;
+
+	/*!< \brief returns a field. */
+	const LWSnapshotField &GetField(uint32_t Field) const;
+
+	/*!< \brief returns the number of fields. */
+	uint32_t GetFieldCount(void) const;
+private:
+	LWSnapshotField m_Fields[MaxFields];
+	uint32_t m_FieldCount = 0;
+};
+
+/*!< \brief the state of every replicated entity at a single tick, each entity is an id and an array of stored values, one for each field of the schema.  entities are kept sorted by id. */
+class LWSnapshot {
+public:
+	/*!< \brief sets the id of the snapshot, snapshot ids are expected to increase with each tick(most commonly the tick itself). */
+	LWSnapshot &SetID(uint32_t ID);
+
+	/*!< \brief sets the stored value of an entity's field, adding the entity if it is not in the snapshot. */
+	LWSnapshot &SetValue(uint32_t EntityID, uint32_t Field, uint32_t Value);
+
+	/*!< \brief sets an integer field of an entity. */
+	LWSnapshot &SetInt(uint32_t EntityID, uint32_t Field, int32_t Value);
+
+	/*!< \brief sets a float field of an entity, Quantized fields are quantized to their resolution. */
+	LWSnapshot &SetFloat(uint32_t EntityID, uint32_t Field, float Value);
+
+	/*!< \brief adds an entity if it is not in the snapshot, new entities have every value set to 0.
+		 \return the stored values of the entity.
+	*/
+	uint32_t *AddEntity(uint32_t EntityID);
+
+	/*!< \brief removes an entity from the snapshot. */
+	LWSnapshot &RemoveEntity(uint32_t EntityID);
+
+	/*!< \brief removes every entity. */
+	LWSnapshot &Clear(void);
+
+	/*!< \brief returns the stored values of an entity, or null if it is not in the snapshot. */
+	const uint32_t *FindEntity(uint32_t EntityID) const;
+
+	/*!< \brief returns the stored value of an entity's field, or 0 if the entity is not in the snapshot. */
+	uint32_t GetValue(uint32_t EntityID, uint32_t Field) const;
+
+	/*!< \brief returns an integer field of an entity. */
+	int32_t GetInt(uint32_t EntityID, uint32_t Field) const;
+
+	/*!< \brief returns a float field of an entity, dequantizing Quantized fields. */
+	float GetFloat(uint32_t EntityID, uint32_t Field) const;
+
+	/*!< \brief returns the id of the entity at index. */
+	uint32_t GetEntityID(uint32_t Index) const;
+
+	/*!< \brief returns the stored values of the entity at index. */
+	const uint32_t *GetEntityValues(uint32_t Index) const;
+
+	/*!< \brief returns the number of entities. */
+	uint32_t GetEntityCount(void) const;
+
+	/*!< \brief returns the snapshot id. */
+	uint32_t GetID(void) const;
+
+	/*!< \brief returns the schema of the snapshot. */
+	const LWSnapshotSchema &GetSchema(void) const;
+
+	/*!< \brief constructs an empty snapshot, the schema must outlive the snapshot. */
+	LWSnapshot(const LWSnapshotSchema &Schema, uint32_t ID = 0);
+private:
+	/*!< \brief returns the index of the first entity with an id not less than EntityID. */
+	uint32_t LowerBound(uint32_t EntityID) const;
+
+	const LWSnapshotSchema *m_Schema;
+	std::vector<uint32_t> m_EntityIDs;
+	std::vector<uint32_t> m_Values;
+	uint32_t m_ID;
+};
+
+/*!< \brief server side delta encoder, keeps the last HistorySize snapshots and encodes new snapshots for each client against the last snapshot that client acknowledged.
+	 only entities and fields that changed since the baseline are written, and clients without a baseline(or whose baseline has fallen out of the history) receive the full snapshot.
+	 the encoded data is meant to be sent unreliably inside an LWPacket's Serialize with an LWBitWriter over the packet's buffer, the client then echoes the decoded snapshot id back, which the server passes to Acknowledge.
+*/
+class LWSnapshotEncoder {
+public:
+	enum {
+		HistorySize = 32, /*!< \brief the number of snapshots kept as possible baselines, must be the same as the decoder's. */
+		NoBaseline = 0xFFFFFFFF /*!< \brief the baseline id of clients that have not acknowledged a snapshot. */
+	};
+
+	/*!< \brief writes Snapshot as a delta against Baseline, or in full if Baseline is null. */
+	static void EncodeDelta(const LWSnapshot *Baseline, const LWSnapshot &Snapshot, LWBitWriter &Writer);
+
+	/*!< \brief stores a copy of the snapshot for the current tick, snapshot ids must increase with each push. */
+	LWSnapshotEncoder &PushSnapshot(const LWSnapshot &Snapshot);
+
+	/*!< \brief records that the client received the snapshot, making it the baseline for the client if it is newer than it's current baseline. */
+	LWSnapshotEncoder &Acknowledge(void *Client, uint32_t SnapshotID);
+
+	/*!< \brief encodes the most recently pushed snapshot for the client.
+		 \return false if no snapshot has been pushed.
+	*/
+	bool Encode(void *Client, LWBitWriter &Writer) const;
+
+	/*!< \brief forgets the client's baseline, most commonly due to client disconnect. */
+	LWSnapshotEncoder &PurgeClient(void *Client);
+
+	/*!< \brief returns the snapshot with the id if it is still in the history, or null. */
+	const LWSnapshot *FindSnapshot(uint32_t SnapshotID) const;
+
+	/*!< \brief returns the id of the client's baseline, or NoBaseline. */
+	uint32_t GetBaseline(void *Client) const;
+
+	/*!< \brief constructs a snapshot encoder, the schema must outlive the encoder. */
+	LWSnapshotEncoder(const LWSnapshotSchema &Schema);
+private:
+	std::vector<LWSnapshot> m_History;
+	std::unordered_map<void*, uint32_t> m_Baselines;
+	uint32_t m_Latest = NoBaseline;
+};
+
+/*!< \brief client side delta decoder, keeps the last HistorySize decoded snapshots so deltas against any of them can be applied. */
+class LWSnapshotDecoder {
+public:
+	/*!< \brief decodes a snapshot written with LWSnapshotEncoder into Result, and stores it as a future baseline.  Result's id should then be acknowledged back to the server.
+		 \return false if the snapshot's baseline is no longer known, the data was malformed, or the snapshot is older than one already decoded.
+	*/
+	bool Decode(LWBitReader &Reader, LWSnapshot &Result);
+
+	/*!< \brief returns the decoded snapshot with the id if it is still in the history, or null. */
+	const LWSnapshot *FindSnapshot(uint32_t SnapshotID) const;
+
+	/*!< \brief constructs a snapshot decoder, the schema must outlive the decoder. */
+	LWSnapshotDecoder(const LWSnapshotSchema &Schema);
+private:
+	std::vector<LWSnapshot> m_History;
+	uint32_t m_Latest = LWSnapshotEncoder::NoBaseline;
+};
+
+#endif
\ No newline at end of file
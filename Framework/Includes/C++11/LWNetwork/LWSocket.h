@@ -2,6 +2,7 @@
 #define LWSOCKET_H
 #include "LWCore/LWTypes.h"
 #include "LWNetwork/LWTypes.h"
+#include <atomic>
 
 struct LWSRVRecord {
 	char m_Address[64];
@@ -10,6 +11,22 @@ struct LWSRVRecord {
 	uint32_t m_Weight;
 };
 
+/*!< \brief a single buffer of a gather write, a list of these is sent as one contiguous stream. */
+struct LWSocketBuffer {
+	const char *m_Data;
+	uint32_t m_Length;
+};
+
+/*!< \brief a single datagram for LWSocket::SendBatch, made up of BufferCount buffers sent to the remote address. */
+struct LWSocketDatagram {
+	const LWSocketBuffer *m_Buffers;
+	uint32_t m_BufferCount;
+	uint32_t m_RemoteIP;
+	uint16_t m_RemotePort;
+};
+
+struct LWSocketQueue;
+
 /*!< \brief default socket object, it encompasses the tcp/ip and udp/ip stacks with a single interface.  providing simple mechanisms to send and receive data between two devices. */
 class LWSocket{
 public:
@@ -24,6 +41,7 @@ public:
 		Broadcast = 0x10, /*!< \brief flag to indicate the socket should support broadcasting if possible. */
 		TcpNoDelay = 0x20, /*!< \brief flag to indicate the socket should not delay tcp packets when waiting for more data. */
 		ReuseAddr = 0x40, /*!< \brief flag to indicate the socket is allowed to reuse a port which is already under use. */
+		ReusePort = 0x80, /*!< \brief flag to indicate multiple sockets may bind the same port with the os balancing incoming connections between them(SO_REUSEPORT), creation fails with ErrCtrlFlags on platforms without support. */
 
 		BroadcastIP = 0xFFFFFFFF, /*!< \brief ip address to broadcast to the entire local network. */
 		LocalIP = 0x7F000001, /*!< \brief ip address for loopback address on local device. */
@@ -40,6 +58,12 @@ public:
 		MaxBacklog = 20, /*!< \brief Max backlog for a listening socket before it begins dropping connections. */
 	
 		MaxProtocols=8, /*!< \brief max number of protocol data storage pointers. */
+
+		MaxGatherBuffers = 64, /*!< \brief max number of buffers passed to the os in a single gather write, buffers past this are left for the next call. */
+		MaxBatchDatagrams = 64, /*!< \brief max number of datagrams passed to the os in a single SendBatch call. */
+		QueueBlockSize = 16*1024, /*!< \brief the output queue copys small writes into blocks of this size, writes at least this large are first attempted directly when the queue is empty. */
+		QueueHighWater = 256*1024, /*!< \brief once this many bytes are queued isWritable returns false so protocols can hold back further frames. */
+		MaxQueueSize = 64*1024*1024, /*!< \brief Queue fails rather than grow the output queue past this many bytes. */
 	
 		DNS_A=1,
 		DNS_NS,
@@ -204,6 +228,41 @@ public:
 	*/
 	uint32_t Send(char *Buffer, uint32_t BufferLen, uint32_t RemoteIP, uint16_t RemotePort) const;
 
+	/*!< \brief gather writes the buffers as a single stream with one system call(sendmsg/WSASend), may not send all data in one step.
+		 \param Block if false the call returns immediately when the os send buffer is full instead of waiting for room(ignored on windows).
+		 \return the amount of data sent, 0 if nothing could be sent without blocking, or 0xFFFFFFFF on error.
+	*/
+	uint32_t Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, bool Block = true) const;
+
+	/*!< \brief gather writes the buffers as a single datagram to the specified remote device.
+		 \return the amount of data sent, or 0xFFFFFFFF on error.
+	*/
+	uint32_t Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, uint32_t RemoteIP, uint16_t RemotePort) const;
+
+	/*!< \brief sends a list of datagrams, on linux and android they are handed to the os together with sendmmsg.
+		 \return the number of datagrams sent, or 0xFFFFFFFF if the first could not be sent.
+	*/
+	uint32_t SendBatch(const LWSocketDatagram *Datagrams, uint32_t DatagramCount) const;
+
+	/*!< \brief appends the buffers to the socket's output queue to be sent by Flush, writes of QueueBlockSize or more are sent directly if nothing is already queued with only the remainder being copied.  the queue may be filled from any thread, once the socket is closed or moved from further writes through it fail.
+		 \return false if the socket had an error, was closed, or the queue would grow past MaxQueueSize.
+	*/
+	bool Queue(const LWSocketBuffer *Buffers, uint32_t BufferCount);
+
+	/*!< \brief appends Buffer to the socket's output queue. */
+	bool Queue(const char *Buffer, uint32_t BufferLen);
+
+	/*!< \brief sends as much of the output queue as the os will take without blocking, coalescing up to MaxGatherBuffers queued blocks per system call.
+		 \return the number of bytes still queued, or 0xFFFFFFFF if the socket had an error in which case the queue is discarded.
+	*/
+	uint32_t Flush(void);
+
+	/*!< \brief returns the number of bytes waiting in the output queue. */
+	uint32_t GetQueuedBytes(void) const;
+
+	/*!< \brief returns true while the output queue is below QueueHighWater, protocols should hold back new frames while this is false. */
+	bool isWritable(void) const;
+
 	/*!< \brief move operator. */
 	LWSocket &operator = (LWSocket &&Other);
 
@@ -252,6 +311,11 @@ public:
 	/*!< \brief destroys the socket object, and closing the connection if a tcp socket. */
 	~LWSocket();
 private:
+	/*!< \brief returns a referenced pointer to the output queue(creating it if Create is true), or null if there is none or the socket was closed or moved from. */
+	LWSocketQueue *AcquireQueue(bool Create);
+
+	/*!< \brief closes the output queue and drops anything left in it, waiting for any Queue or Flush still using it on another thread.  called when the socket is closed or destroyed. */
+	void ReleaseQueue(void);
 
 	void *m_UserData = nullptr;
 	void *m_ProtocolData[MaxProtocols];
@@ -262,7 +326,7 @@ private:
 	uint32_t m_Flag = 0;
 	uint16_t m_RemotePort = 0;
 	uint16_t m_LocalPort = 0;
-
+	std::atomic<LWSocketQueue*> m_OutQueue;
 };
 
 
@@ -11,4 +11,14 @@ class LWPacketManager;
 
 class LWProtocolManager;
 
+class LWShardedProtocolManager;
+
+class LWSnapshot;
+
+class LWSnapshotSchema;
+
+class LWSnapshotEncoder;
+
+class LWSnapshotDecoder;
+
 #endif
\ No newline at end of file
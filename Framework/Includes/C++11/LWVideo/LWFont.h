@@ -87,6 +87,13 @@ public:
 	*/
 	static LWFont *LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_t emSize, uint32_t RangeCount, const uint32_t *FirstChar, const uint32_t *NbrChars, LWAllocator &Allocator);
 
+	/*!< \brief rasterizes a TTF from the filestream with multiple glyph ranges without using the video driver, so it can be called from a worker thread.  the glyphs are packed into Atlas, and the returned font has no texture until one is created from Atlas and passed to SetTexture(0, ...).
+		 \param Driver the video driver the font will later destroy it's texture with, it is only stored.
+		 \param Atlas receives the RGBA8 glyph atlas.
+		 \return the font if it could be created, otherwise null if not loadable.
+	*/
+	static LWFont *LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_t emSize, uint32_t RangeCount, const uint32_t *FirstChar, const uint32_t *NbrChars, LWImage &Atlas, LWAllocator &Allocator);
+
 	/*! \brief returns the default vertex shader for rendering font, embedded into the code. */
 	static const char *GetVertexShaderSource(void);
 
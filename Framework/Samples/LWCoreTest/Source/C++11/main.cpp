@@ -1,6 +1,7 @@
 #include <LWCore/LWTypes.h>
 #include <LWCore/LWByteBuffer.h>
 #include <LWCore/LWByteStream.h>
+#include <LWCore/LWBitStream.h>
 #include <LWCore/LWMath.h>
 #include <LWCore/LWVector.h>
 #include <LWCore/LWSVector.h>
@@ -10,12 +11,17 @@
 #include <LWCore/LWSQuaternion.h>
 #include <LWCore/LWText.h>
 #include <LWCore/LWTimer.h>
+#include <LWCore/LWAllocatorStats.h>
 #include <LWCore/LWAllocators/LWAllocator_Default.h>
 #include <LWCore/LWAllocators/LWAllocator_LocalCircular.h>
 #include <LWCore/LWAllocators/LWAllocator_LocalHeap.h>
+#include <LWCore/LWAllocators/LWAllocator_Pool.h>
+#include <LWCore/LWAllocators/LWAllocator_FrameArena.h>
 #include <LWCore/LWConcurrent/LWFIFO.h>
 #include <LWCore/LWCrypto.h>
 #include <thread>
+#include <atomic>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <functional>
@@ -173,14 +179,142 @@ bool PerformAllocatorTest(const char *AllocatorName, LWAllocator &Allocator){
 	return true;
 }
 
+bool PerformThreadedAllocatorTest(const char *AllocatorName, LWAllocator &Allocator, uint32_t ThreadCount){
+	std::cout << "Beginning threaded allocation testing for: " << AllocatorName << " with " << ThreadCount << " threads." << std::endl;
+	const uint32_t AllocationCount = 20000;
+	const uint32_t QueueSize = 256;
+	LWConcurrentBoundedFIFO<int32_t*, QueueSize> Handoff;
+	std::atomic<bool> Failed(false);
+	std::vector<std::thread> Threads;
+	auto Start = std::chrono::steady_clock::now();
+	//Each thread allocates, verifies, and frees half of it's own allocations, the other half is handed to another thread to be freed so memory migrates between thread caches.
+	for (uint32_t t = 0; t < ThreadCount; t++) {
+		Threads.emplace_back([&Allocator, &Handoff, &Failed, t]() {
+			int32_t *Mem = nullptr;
+			for (uint32_t i = 0; i < AllocationCount; i++) {
+				uint32_t Len = (i*7 + t) % 600 + 1;
+				int32_t *A = Allocator.AllocateArray<int32_t>(Len);
+				if (!A) {
+					Failed = true;
+					return;
+				}
+				for (uint32_t d = 0; d < Len; d++) A[d] = (int32_t)Len;
+				if (LWAllocator::GetAllocationSize(A) != Len * sizeof(int32_t) || LWAllocator::GetAllocator(A) != &Allocator) Failed = true;
+				if ((i & 1) == 0 && Handoff.Push(A)) A = nullptr;
+				if (A) LWAllocator::Destroy(A);
+				if (Handoff.Pop(Mem)) {
+					uint32_t MemLen = LWAllocator::GetAllocationSize(Mem) / sizeof(int32_t);
+					for (uint32_t d = 0; d < MemLen; d++) if (Mem[d] != (int32_t)MemLen) Failed = true;
+					LWAllocator::Destroy(Mem);
+				}
+			}
+		});
+	}
+	for (auto &&T : Threads) T.join();
+	int32_t *Mem = nullptr;
+	while (Handoff.Pop(Mem)) LWAllocator::Destroy(Mem);
+	if (Failed) return false;
+	std::cout << "Checking allocated Bytes: " << Allocator.GetAllocatedBytes() << std::endl;
+	if (Allocator.GetAllocatedBytes() != 0) return false;
+	auto Elapsed = std::chrono::steady_clock::now() - Start;
+	std::cout << "Finished threaded allocation tests, time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(Elapsed).count() << "ms" << std::endl;
+	return true;
+}
+
+bool PerformFrameArenaTest(void){
+	std::cout << "Beginning allocation testing for: LWAllocator_FrameArena" << std::endl;
+	LWAllocator_FrameArena Arena(1024 * 64, 2, LWAllocator_FrameArena::Poison);
+	int32_t *FrameA = Arena.AllocateArray<int32_t>(100);
+	for (int32_t i = 0; i < 100; i++) FrameA[i] = i;
+	if (LWAllocator::GetAllocator(FrameA) != &Arena || LWAllocator::GetAllocationSize(FrameA) != sizeof(int32_t) * 100) return false;
+	if (((uintptr_t)FrameA) % LWAllocator_FrameArena::Alignment) return false;
+	uint32_t Used = Arena.GetFrameUsed();
+	{
+		LWAllocator_FrameArena::Scope Scratch(Arena);
+		uint8_t *Temp = Arena.AllocateArray<uint8_t>(1000);
+		if (!Temp || Temp[0] != LWAllocator_FrameArena::AllocPoisonByte) return false;
+		if (Arena.GetFrameUsed() <= Used) return false;
+	}
+	std::cout << "Checking scope release: " << Arena.GetFrameUsed() << std::endl;
+	if (Arena.GetFrameUsed() != Used) return false;
+	uint8_t *Top = Arena.AllocateArray<uint8_t>(32);
+	LWAllocator::Destroy(Top);
+	if (Arena.GetFrameUsed() != Used) return false;
+	if (Arena.AllocateArray<uint8_t>(1024 * 64)) return false; //Exceeds frame size.
+
+	Arena.NextFrame();
+	int32_t *FrameB = Arena.AllocateArray<int32_t>(100);
+	for (int32_t i = 0; i < 100; i++) if (FrameA[i] != i) return false; //Previous frame should still be intact when double buffered.
+	uint64_t StaleMarker = Arena.PushMarker();
+	Arena.NextFrame();
+	if (Arena.PopMarker(StaleMarker)) return false;
+	if (((uint8_t*)FrameA)[0] != LWAllocator_FrameArena::FreePoisonByte) return false;
+	Arena.NextFrame();
+	std::cout << "Checking allocated Bytes: " << Arena.GetAllocatedBytes() << " High water mark: " << Arena.GetHighWaterMark() << std::endl;
+	if (Arena.GetAllocatedBytes() != 0 || FrameB == FrameA) return false;
+
+	const uint32_t Iterations = 1000000;
+	LWAllocator_FrameArena BenchArena(Iterations * 32 + 1024, 1);
+	LWAllocator_Default Default;
+	auto Start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < Iterations; i++) LWAllocator::Destroy(Default.AllocateArray<uint8_t>(16));
+	auto DefaultElapsed = std::chrono::steady_clock::now() - Start;
+	Start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < Iterations; i++) BenchArena.AllocateArray<uint8_t>(16);
+	BenchArena.NextFrame();
+	auto ArenaElapsed = std::chrono::steady_clock::now() - Start;
+	std::cout << Iterations << " allocations, Default: " << std::chrono::duration_cast<std::chrono::milliseconds>(DefaultElapsed).count() << "ms FrameArena: " << std::chrono::duration_cast<std::chrono::milliseconds>(ArenaElapsed).count() << "ms" << std::endl;
+	return true;
+}
+
+bool PerformAllocatorStatsTest(void){
+	std::cout << "Beginning LWAllocatorStats test." << std::endl;
+	LWAllocator_Default Default;
+	LWAllocatorStats Stats("Default");
+	char Buffer[4096];
+	uint8_t *Before = Default.AllocateArray<uint8_t>(64);
+	Default.SetStats(&Stats);
+	int32_t *Untagged = Default.AllocateArray<int32_t>(4);
+	{
+		LWAllocatorStats::ScopedTag Tag("UI");
+		for (uint32_t i = 0; i < 10; i++) LWAllocator::Destroy(Default.AllocateArray<uint8_t>(100));
+		LWAllocatorStats::ScopedTag InnerTag("Network");
+		LWAllocator::Destroy(Default.AllocateArray<uint8_t>(5000));
+	}
+	Stats.NextFrame();
+	if (Stats.GetAllocationCount() != 12 || Stats.GetLiveCount() != 1 || Stats.GetLiveBytes() != 16 || Stats.GetPeakBytes() != 5016) return false;
+	if (Stats.GetLastFrameAllocations() != 12 || Stats.GetBucketAllocations(LWAllocatorStats::GetBucket(100)) != 10) return false;
+	if (Stats.GetTagCount() != 2 || Stats.GetTagAllocations(0) != 10 || Stats.GetTagBytes(1) != 5000 || Stats.GetTagAllocations(LWAllocatorStats::NoTag) != 1) return false;
+	if (Stats.GetTagLiveCount(0) != 0 || Stats.GetTagLiveCount(LWAllocatorStats::NoTag) != 1 || Stats.GetTagLiveBytes(LWAllocatorStats::NoTag) != 16) return false;
+	LWAllocator::Destroy(Before);
+	LWAllocator::Destroy(Untagged);
+	if (Stats.GetLiveCount() != 0 || Stats.GetLiveBytes() != 0 || Stats.GetDeallocationCount() != 12 || Stats.GetTagLiveBytes(LWAllocatorStats::NoTag) != 0) return false;
+	uint32_t Len = Stats.SerializeJSON(Buffer, sizeof(Buffer));
+	if (Len >= sizeof(Buffer) || Stats.SerializeJSON(nullptr, 0) != Len) return false;
+	std::cout << Buffer << std::endl;
+	Default.SetStats(nullptr);
+	return true;
+}
+
 bool PerformLWAllocatorTest(void){
 	std::cout << "Performing LWAllocator test: " << std::endl;
 	LWAllocator_Default Default;
 	LWAllocator_LocalCircular Circular(1024*1024*64);
 	LWAllocator_LocalHeap Heap(1024 * 1024 * 64);
+	LWAllocator_LocalHeap CachedHeap(1024 * 1024 * 64, LWAllocator_LocalHeap::PerThreadCache);
+	LWAllocator_Pool Pool;
+	uint32_t HeapFree = Heap.GetLargestFreeBlock();
 	if (!PerformAllocatorTest("LWAllocator_LocalCircular", Circular)) return false;
 	if (!PerformAllocatorTest("LWAllocator_LocalHeap", Heap)) return false;
+	std::cout << "Checking LWAllocator_LocalHeap coalescing: " << Heap.GetLargestFreeBlock() << std::endl;
+	if (Heap.GetLargestFreeBlock() != HeapFree) return false;
+	if (!PerformThreadedAllocatorTest("LWAllocator_LocalHeap", Heap, 8)) return false;
+	if (!PerformThreadedAllocatorTest("LWAllocator_LocalHeap(PerThreadCache)", CachedHeap, 8)) return false;
 	if (!PerformAllocatorTest("LWAllocator_Default", Default)) return false;
+	if (!PerformAllocatorTest("LWAllocator_Pool", Pool)) return false;
+	if (!PerformThreadedAllocatorTest("LWAllocator_Pool", Pool, 8)) return false;
+	if (!PerformFrameArenaTest()) return false;
+	if (!PerformAllocatorStatsTest()) return false;
 	return true;
 }
 
@@ -785,6 +919,33 @@ bool PerformLWByteStreamTest(void) {
 	return true;
 }
 
+bool PerformLWBitStreamTest(void) {
+	int8_t Buffer[64];
+	std::cout << "Beginning LWBitStream test." << std::endl;
+	LWByteBuffer WriteBuf(Buffer, sizeof(Buffer), LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
+	LWBitWriter Writer(WriteBuf);
+	Writer.WriteBits(5, 3).WriteBool(true).WriteBounded(-3, -10, 10).WriteVarInt(300).WriteSignedVarInt(-70000);
+	Writer.WriteFloat(3.25f).WriteQuantized(1.25f, 0.0f, 10.0f, 0.125f).WriteBits(0xFFFFFFFF, 32);
+	uint32_t Len = Writer.Flush();
+	if (!PerformTest("LWBitWriter<BitsWritten>", std::bind(&LWBitWriter::GetBitsWritten, &Writer), 120u)) return false;
+	if (!PerformTest("LWBitWriter<Flush>", [Len]()->uint32_t { return Len; }, 15u)) return false;
+	LWByteBuffer ReadBuf((const int8_t*)Buffer, Len, LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
+	LWBitReader Reader(ReadBuf);
+	if (!PerformTest("LWBitReader<ReadBits>", std::bind(&LWBitReader::ReadBits, &Reader, 3), 5u)) return false;
+	if (!PerformTest("LWBitReader<ReadBool>", std::bind(&LWBitReader::ReadBool, &Reader), true)) return false;
+	if (!PerformTest("LWBitReader<ReadBounded>", std::bind(&LWBitReader::ReadBounded, &Reader, -10, 10), -3)) return false;
+	if (!PerformTest("LWBitReader<ReadVarInt>", std::bind(&LWBitReader::ReadVarInt, &Reader), (uint64_t)300)) return false;
+	if (!PerformTest("LWBitReader<ReadSignedVarInt>", std::bind(&LWBitReader::ReadSignedVarInt, &Reader), (int64_t)-70000)) return false;
+	if (!PerformTest("LWBitReader<ReadFloat>", std::bind(&LWBitReader::ReadFloat, &Reader), 3.25f)) return false;
+	if (!PerformTest("LWBitReader<ReadQuantized>", std::bind(&LWBitReader::ReadQuantized, &Reader, 0.0f, 10.0f, 0.125f), 1.25f)) return false;
+	if (!PerformTest("LWBitReader<ReadBits>", std::bind(&LWBitReader::ReadBits, &Reader, 32), 0xFFFFFFFFu, true)) return false;
+	if (!PerformTest("LWBitReader<isOverflowed>", std::bind(&LWBitReader::isOverflowed, &Reader), false)) return false;
+	Reader.ReadBits(8);
+	if (!PerformTest("LWBitReader<isOverflowed>", std::bind(&LWBitReader::isOverflowed, &Reader), true)) return false;
+	std::cout << "LWBitStream test was successful." << std::endl;
+	return true;
+}
+
 bool PerformLWByteBufferTest(void){ 
 	int8_t Buffer[4096];
 	int64_t Values[4] = { 0x1122334455667788, 0x2233445566778899, 0x33445566778899AA, 0x445566778899AABB };
@@ -1688,6 +1849,37 @@ bool PerformLWTimerTest(void){
 	return true;
 }
 
+template<class FIFOType>
+bool PerformMPMCFIFOTest(FIFOType &Fifo, uint32_t Producers, uint32_t Consumers, int ItemsPerProducer) {
+	std::atomic<int64_t> Sum(0);
+	std::atomic<int> Popped(0);
+	std::vector<std::thread> Threads;
+	int Total = ItemsPerProducer*(int)Producers;
+	for (uint32_t i = 0; i < Producers; i++) {
+		Threads.emplace_back([&Fifo, ItemsPerProducer]() {
+			for (int n = 0; n < ItemsPerProducer; n++) {
+				while (!Fifo.Push(n)) std::this_thread::yield();
+			}
+		});
+	}
+	for (uint32_t i = 0; i < Consumers; i++) {
+		Threads.emplace_back([&Fifo, &Sum, &Popped, Total]() {
+			int Value = 0;
+			while (Popped.load() < Total) {
+				if (!Fifo.Pop(Value)) {
+					std::this_thread::yield();
+					continue;
+				}
+				Sum.fetch_add(Value);
+				Popped.fetch_add(1);
+			}
+		});
+	}
+	for (auto &&T : Threads) T.join();
+	int64_t Expected = (int64_t)ItemsPerProducer*(ItemsPerProducer - 1) / 2 * Producers;
+	return Sum.load() == Expected;
+}
+
 bool PerformLWConcurrentTest(void){
 	std::cout << "Beginning Concurrency algorithmn tests." << std::endl;
 	
@@ -1706,6 +1898,24 @@ bool PerformLWConcurrentTest(void){
 	ReadThread.join();
 	if (Count != 4950) return false;
 	std::cout << "Finished FIFO Test!" << std::endl;
+
+	std::cout << "Beginning MPMC FIFO Tests!" << std::endl;
+	LWAllocator_Default DefAlloc;
+	LWConcurrentBoundedFIFO<int, 32> BoundedFifo;
+	LWConcurrentUnboundedFIFO<int, 16> UnboundedFifo(DefAlloc);
+	if (!PerformMPMCFIFOTest(BoundedFifo, 4, 4, 1000)) return false;
+	std::cout << "Finished bounded FIFO Test!" << std::endl;
+	if (!PerformMPMCFIFOTest(UnboundedFifo, 4, 4, 1000)) return false;
+	if (UnboundedFifo.Length() != 0) return false;
+	std::cout << "Finished unbounded FIFO Test!" << std::endl;
+	int Batch[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	int BatchResult[8];
+	if (BoundedFifo.PushBatch(Batch, 8) != 8 || BoundedFifo.PopBatch(BatchResult, 8) != 8) return false;
+	if (UnboundedFifo.PushBatch(Batch, 8) != 8 || UnboundedFifo.PopBatch(BatchResult, 8) != 8) return false;
+	for (uint32_t i = 0; i < 8; i++) {
+		if (BatchResult[i] != Batch[i]) return false;
+	}
+	std::cout << "Finished batch FIFO Test!" << std::endl;
 	std::cout << "Finished Concurrent test." << std::endl;
 	return true;
 }
@@ -1988,11 +2198,66 @@ bool PerformSIMDComparisonTest(uint32_t Count) {
 	return true;
 };
 
+template<class FIFOType>
+uint64_t BenchmarkFIFO(FIFOType &Fifo, uint32_t Producers, uint32_t Consumers, uint32_t ItemCount) {
+	std::atomic<uint32_t> Popped(0);
+	std::vector<std::thread> Threads;
+	uint64_t Start = LWTimer::GetCurrent();
+	uint32_t PerProducer = ItemCount / Producers;
+	uint32_t Total = PerProducer*Producers;
+	for (uint32_t i = 0; i < Producers; i++) {
+		Threads.emplace_back([&Fifo, PerProducer]() {
+			for (uint32_t n = 0; n < PerProducer; n++) {
+				while (!Fifo.Push((int)n)) std::this_thread::yield();
+			}
+		});
+	}
+	for (uint32_t i = 0; i < Consumers; i++) {
+		Threads.emplace_back([&Fifo, &Popped, Total]() {
+			int Value = 0;
+			while (Popped.load() < Total) {
+				if (Fifo.Pop(Value)) Popped.fetch_add(1);
+				else std::this_thread::yield();
+			}
+		});
+	}
+	for (auto &&T : Threads) T.join();
+	return LWTimer::ToMilliSecond(LWTimer::GetCurrent() - Start);
+}
+
+bool PerformLWConcurrentBenchmark(uint32_t ItemCount) {
+	const uint32_t ColumnSize = 16;
+	const uint32_t LineSize = ColumnSize * 5 + 6;
+	const char Border = '|';
+	const char Line = '-';
+	const uint32_t ThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+	LWAllocator_Default DefAlloc;
+	std::cout << "Beginning FIFO benchmark with " << ItemCount << " items." << std::endl;
+	std::cout << std::setfill(Line) << std::setw(LineSize) << "" << std::setfill(' ') << std::endl;
+	std::cout << Border << FormatCenteredf(ColumnSize, "Threads") << Border << FormatCenteredf(ColumnSize, "OneAny") << Border << FormatCenteredf(ColumnSize, "Concurrent") << Border << FormatCenteredf(ColumnSize, "Bounded") << Border << FormatCenteredf(ColumnSize, "Unbounded") << Border << std::endl;
+	std::cout << std::setfill(Line) << std::setw(LineSize) << "" << std::setfill(' ') << std::endl;
+	for (auto &&Cnt : ThreadCounts) {
+		LWFIFOOneAny<int, 1024> OneAnyFifo;
+		LWConcurrentFIFO<int, 1024> ConcurrentFifo;
+		LWConcurrentBoundedFIFO<int, 1024> BoundedFifo;
+		LWConcurrentUnboundedFIFO<int, 1024> UnboundedFifo(DefAlloc);
+		std::cout << Border << FormatCenteredf(ColumnSize, "%dx%d", Cnt, Cnt) << Border;
+		if (Cnt == 1) std::cout << FormatCenteredf(ColumnSize, "%dms", (uint32_t)BenchmarkFIFO(OneAnyFifo, 1, 1, ItemCount)) << Border << std::flush; //LWFIFOOneAny only supports a single producer.
+		else std::cout << FormatCenteredf(ColumnSize, "N/A") << Border;
+		std::cout << FormatCenteredf(ColumnSize, "%dms", (uint32_t)BenchmarkFIFO(ConcurrentFifo, Cnt, Cnt, ItemCount)) << Border << std::flush;
+		std::cout << FormatCenteredf(ColumnSize, "%dms", (uint32_t)BenchmarkFIFO(BoundedFifo, Cnt, Cnt, ItemCount)) << Border << std::flush;
+		std::cout << FormatCenteredf(ColumnSize, "%dms", (uint32_t)BenchmarkFIFO(UnboundedFifo, Cnt, Cnt, ItemCount)) << Border << std::endl;
+		std::cout << std::setfill(Line) << std::setw(LineSize) << "" << std::setfill(' ') << std::endl;
+	}
+	return true;
+}
+
 int main(int, char **){
 	std::cout << "Testing LWFramework core features." << std::endl;
 	if (!PerformLWAllocatorTest()) std::cout << "Error with LWAllocator test." << std::endl;
 	else if (!PerformLWByteBufferTest()) std::cout << "Error with LWByteBuffer Test." << std::endl;
 	else if (!PerformLWByteStreamTest()) std::cout << "Error with LWByteStream test." << std::endl;
+	else if (!PerformLWBitStreamTest()) std::cout << "Error with LWBitStream test." << std::endl;
 	else if (!PerformLWVectorTest()) std::cout << "Error with LWVector test." << std::endl;
 	else if (!PerformLWSVectorTest()) std::cout << "Error with LWSVector test." << std::endl;
 	else if (!PerformLWMatrixTest()) std::cout << "Error with LWMatrix Test." << std::endl;
@@ -2004,6 +2269,7 @@ int main(int, char **){
 	else if (!PerformLWTimerTest()) std::cout << "Error with LWTimer Test." << std::endl;
 	else if (!PerformLWCryptoTest()) std::cout << "Error with LWCrypto test." << std::endl;
 	else if (!PerformSIMDComparisonTest(50000000)) std::cout << "Error with SIMD comparison test." << std::endl;
+	else if (!PerformLWConcurrentBenchmark(1000000)) std::cout << "Error with LWConcurrent benchmark." << std::endl;
 	else std::cout << "LWFramework core successful test." << std::endl;
 	return 0;
 }
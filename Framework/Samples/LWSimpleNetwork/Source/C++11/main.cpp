@@ -8,7 +8,13 @@
 #include "LWNetwork/LWSocket.h"
 #include "LWNetwork/LWPacket.h"
 #include "LWNetwork/LWPacketManager.h"
+#include "LWNetwork/LWSnapshot.h"
+#include "LWCore/LWByteBuffer.h"
+#include "LWCore/LWBitStream.h"
 #include <iostream>
+#include <map>
+#include <set>
+#include <vector>
 
 class LWTelnetProtocol : public LWProtocol{
 public:
@@ -219,43 +225,253 @@ bool TestLWPacketManager(LWAllocator &Allocator) {
 		return false;
 	};
 
+	//loops every datagram back to the manager in two fragments, so the manager acks it's own reliable packet.
 	auto Send = [](LWPacket *Pack, LWPacketManager *Man) -> bool {
 		char Buf[1024];
-		char BufB[1024];
 		std::cout << "Sending packet: " << Pack->GetType() << " ID: " << Pack->GetPacketID() << std::endl;
-		if (Pack->GetFlag()&LWPacket::Ack) {
-			LWPacket AckPack(Pack->GetPacketAckID(), nullptr, LWPacket::PacketAck, 0);
-			uint32_t Len = Man->SerializePacket(&AckPack, Buf, sizeof(Buf));
-			uint32_t LenB = Man->SerializePacket(Pack, BufB, sizeof(BufB));
-			if (!Man->ProcessRawData(nullptr, nullptr, Buf, 8)) std::cout << "Failed to add A" << std::endl;
-			if (!Man->ProcessRawData((void*)0x1, nullptr, BufB, 8)) std::cout << "Failed to add B" << std::endl;
-			if (!Man->ProcessRawData(nullptr, nullptr, Buf + 8, Len - 8)) std::cout << "Failed to add C" << std::endl;
-			if (!Man->ProcessRawData((void*)0x1, nullptr, BufB + 8, LenB - 8)) std::cout << "Failed to add D" << std::endl;
-		}
+		uint32_t Len = Man->SerializePacket(Pack, Buf, sizeof(Buf));
+		if (!Man->ProcessRawData(nullptr, nullptr, Buf, 8)) std::cout << "Failed to add A" << std::endl;
+		if (!Man->ProcessRawData(nullptr, nullptr, Buf + 8, Len - 8)) std::cout << "Failed to add B" << std::endl;
 		return true;
 	};
 
 	std::cout << "Beginning LWPacketManager tests!" << std::endl;
 	LWPacketManager Manager(1024, Allocator, Allocator, Receive, Send);
 	Manager.RegisterDeserialization(1, LWPacket::Deserialize);
-	LWPacket *Pack = Allocator.Allocate<LWPacket>(10, nullptr, 1, LWPacket::Ack);
-	uint32_t Len = Manager.SerializePacket(Pack, Buffer, sizeof(Buffer));
+	LWPacket Probe(9, (void*)0x1, 1, 0);
+	uint32_t Len = Manager.SerializePacket(&Probe, Buffer, sizeof(Buffer));
 	std::cout << "Serialized packet, len: " << Len << std::endl;
-	if (!Manager.ProcessRawData(nullptr, nullptr, Buffer, Len)) {
+	if (!Manager.ProcessRawData((void*)0x1, nullptr, Buffer, Len)) {
 		std::cout << "Error processing raw data packet!" << std::endl;
 	}
+	LWPacket *Pack = Allocator.Allocate<LWPacket>(10, nullptr, 1, LWPacket::Ack|LWPacket::Ordered);
 	Manager.PushOutPacket(Pack);
+	std::cout << "Waiting for any ack packets, only 1 send packet and 1 ack packet should appear after this line:" << std::endl;
 	uint64_t Start = LWTimer::GetCurrent();
 	uint64_t Freq = LWTimer::GetResolution()*ProtoManagerTime;
-	bool Out = false;
-	while (LWTimer::GetCurrent() < Start + Freq) {
-		Manager.Update(LWTimer::GetCurrent(), LWTimer::GetResolution());
-		if (!Out) {
-			std::cout << "Waiting for any ack packets, only 1 send packet should appear after this line:" << std::endl;
-			Out = true;
+	while (LWTimer::GetCurrent() < Start + Freq) Manager.Update(LWTimer::GetCurrent(), LWTimer::GetResolution());
+	std::cout << "Finished LWPacketManager tests!" << std::endl;
+	return true;
+}
+
+bool TestSnapshotDelta(void) {
+	enum { Team = 0, Health, PosX, Score, Angle };
+	int8_t Buffer[4096];
+	void *Client = (void*)0x1;
+	std::cout << "Beginning LWSnapshot delta tests!" << std::endl;
+	LWSnapshotSchema Schema;
+	Schema.AddBits(4);
+	Schema.AddBounded(-100, 100);
+	Schema.AddQuantized(-50.0f, 50.0f, 0.01f);
+	Schema.AddVarInt();
+	Schema.AddFloat();
+	LWSnapshotEncoder Encoder(Schema);
+	LWSnapshotDecoder Decoder(Schema);
+	LWSnapshot Received(Schema);
+
+	auto isEqual = [](const LWSnapshot &A, const LWSnapshot &B)->bool {
+		uint32_t FieldCount = A.GetSchema().GetFieldCount();
+		if (A.GetID() != B.GetID() || A.GetEntityCount() != B.GetEntityCount()) return false;
+		for (uint32_t i = 0; i < A.GetEntityCount(); i++) {
+			if (A.GetEntityID(i) != B.GetEntityID(i)) return false;
+			if (memcmp(A.GetEntityValues(i), B.GetEntityValues(i), sizeof(uint32_t)*FieldCount)) return false;
 		}
+		return true;
+	};
+	//encodes the latest snapshot for the client, returning the bytes written.
+	auto Encode = [&Encoder, &Buffer, Client]()->uint32_t {
+		LWByteBuffer WriteBuf(Buffer, sizeof(Buffer), LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
+		LWBitWriter Writer(WriteBuf);
+		Encoder.Encode(Client, Writer);
+		return Writer.isOverflowed() ? 0 : Writer.Flush();
+	};
+	auto Decode = [&Buffer](LWSnapshotDecoder &Dec, uint32_t Len, LWSnapshot &Result)->bool {
+		LWByteBuffer ReadBuf((const int8_t*)Buffer, Len, LWByteBuffer::BufferNotOwned | LWByteBuffer::Network);
+		LWBitReader Reader(ReadBuf);
+		return Dec.Decode(Reader, Result);
+	};
+
+	LWSnapshot Snapshot(Schema, 1);
+	for (uint32_t i = 0; i < 64; i++) {
+		uint32_t ID = 1 + i * 3;
+		Snapshot.SetInt(ID, Team, (int32_t)(i % 4)).SetInt(ID, Health, 100 - (int32_t)i).SetFloat(ID, PosX, -40.0f + (float)i).SetInt(ID, Score, (int32_t)i * 1000 - 20000).SetFloat(ID, Angle, (float)i * 0.1f);
 	}
-	std::cout << "Finished LWPacketManager tests!" << std::endl;
+	Encoder.PushSnapshot(Snapshot);
+	uint32_t FullLen = Encode();
+	if (!FullLen || !Decode(Decoder, FullLen, Received) || !isEqual(Received, Snapshot)) {
+		std::cout << "Full snapshot did not round trip." << std::endl;
+		return false;
+	}
+	Encoder.Acknowledge(Client, Received.GetID());
+	if (Encoder.GetBaseline(Client) != 1) return false;
+
+	//a few changed fields, a removed entity and a new entity, against the acknowledged baseline.
+	Snapshot.SetID(2).SetInt(4, Health, -50).SetFloat(7, PosX, 12.34f).SetInt(10, Score, 123456).RemoveEntity(13).SetInt(500, Team, 3);
+	Encoder.PushSnapshot(Snapshot);
+	uint32_t DeltaLen = Encode();
+	std::cout << "Full snapshot: " << FullLen << " Delta: " << DeltaLen << std::endl;
+	if (!DeltaLen || DeltaLen * 8 > FullLen || !Decode(Decoder, DeltaLen, Received) || !isEqual(Received, Snapshot)) {
+		std::cout << "Delta snapshot did not round trip." << std::endl;
+		return false;
+	}
+	if (Received.GetInt(4, Health) != -50 || Received.GetInt(4, Score) != -19000 || fabs(Received.GetFloat(7, PosX) - 12.34f) > 0.01f || Received.FindEntity(13) || Received.GetInt(500, Team) != 3) return false;
+	Encoder.Acknowledge(Client, Received.GetID());
+
+	//nothing changed, so only the header and end markers are written.
+	Encoder.PushSnapshot(Snapshot.SetID(3));
+	uint32_t SameLen = Encode();
+	if (!SameLen || SameLen > 4 || !Decode(Decoder, SameLen, Received) || !isEqual(Received, Snapshot)) {
+		std::cout << "Unchanged snapshot did not round trip: " << SameLen << std::endl;
+		return false;
+	}
+	Encoder.Acknowledge(Client, Received.GetID());
+
+	//snapshot 4 is lost, so 5 is still encoded against 3.
+	Encoder.PushSnapshot(Snapshot.SetID(4).SetInt(1, Health, 1));
+	uint32_t LostLen = Encode();
+	int8_t Lost[sizeof(Buffer)];
+	memcpy(Lost, Buffer, LostLen);
+	Encoder.PushSnapshot(Snapshot.SetID(5).SetInt(1, Team, 2));
+	uint32_t NextLen = Encode();
+	if (!Decode(Decoder, NextLen, Received) || !isEqual(Received, Snapshot) || Received.GetInt(1, Health) != 1) {
+		std::cout << "Snapshot after a lost delta did not round trip." << std::endl;
+		return false;
+	}
+	//the lost snapshot arriving late is older then the one decoded, and a decoder without the baseline can't apply a delta.
+	LWSnapshotDecoder Fresh(Schema);
+	memcpy(Buffer, Lost, LostLen);
+	if (Decode(Decoder, LostLen, Received) || Decode(Fresh, LostLen, Received)) {
+		std::cout << "Decoded a snapshot that should be rejected." << std::endl;
+		return false;
+	}
+	std::cout << "Finished LWSnapshot delta tests!" << std::endl;
+	return true;
+}
+
+bool TestReliableUDP(LWAllocator &Allocator) {
+	const uint64_t Resolution = 1000000;
+	const uint64_t StepTime = Resolution / 200; //5ms
+	const uint32_t OrderedCount = 200;
+	const uint32_t UnorderedCount = 100;
+	const uint32_t ReplyCount = 50;
+	const uint32_t SequencedSteps = 400;
+	const uint32_t SequencedID = 2000;
+	struct Datagram {
+		LWPacketManager *m_To;
+		void *m_From;
+		bool m_Sequenced;
+		uint32_t m_Len;
+		char m_Data[256];
+	};
+	void *ServerID = (void*)0x1;
+	void *ClientID = (void*)0x2;
+	uint32_t Seed = 1;
+	uint64_t Now = 0;
+	uint32_t Sent = 0, Dropped = 0, Resent = 0, SequencedArrived = 0, UnorderedDelivered = 0;
+	std::multimap<uint64_t, Datagram> Link;
+	std::vector<uint32_t> Ordered, Replies, Sequenced;
+	uint32_t Unordered[UnorderedCount] = {};
+	std::set<std::pair<void*, uint32_t>> SentMessages;
+	LWPacketManager *Server = nullptr;
+	LWPacketManager *Client = nullptr;
+
+	auto Random = [&Seed]()->uint32_t {
+		Seed = Seed * 1664525u + 1013904223u;
+		return Seed >> 16;
+	};
+	//the loopback link drops a fifth of the datagrams, and delays the rest by 20-50ms so they often arrive out of order.
+	auto Send = [&](LWPacket *Pack, LWPacketManager *Man)->bool {
+		Datagram D;
+		D.m_To = Man == Server ? Client : Server;
+		D.m_From = Man == Server ? ServerID : ClientID;
+		D.m_Sequenced = (Pack->GetFlag()&LWPacket::Sequenced) != 0;
+		D.m_Len = Man->SerializePacket(Pack, D.m_Data, sizeof(D.m_Data));
+		if ((Pack->GetFlag()&LWPacket::Ack) && !SentMessages.emplace(Man, Pack->GetPacketAckID()).second) Resent++;
+		Sent++;
+		if (Random() % 100 < 20) Dropped++;
+		else Link.emplace(Now + Resolution / 50 + Random() % (Resolution * 30 / 1000), D);
+		return true;
+	};
+	auto ServerReceive = [&](LWPacket *Pack, LWPacketManager *)->bool {
+		Replies.push_back(Pack->GetPacketID());
+		return false;
+	};
+	auto ClientReceive = [&](LWPacket *Pack, LWPacketManager *)->bool {
+		uint32_t ID = Pack->GetPacketID();
+		if (Pack->GetFlag()&LWPacket::Sequenced) Sequenced.push_back(ID);
+		else if (Pack->GetFlag()&LWPacket::Ordered) Ordered.push_back(ID);
+		else if (ID >= OrderedCount && ID < OrderedCount + UnorderedCount) {
+			Unordered[ID - OrderedCount]++;
+			UnorderedDelivered++;
+		}
+		return false;
+	};
+	auto isDrained = [](LWPacketManager &Man, void *ID)->bool {
+		const LWPacketChannel *C = Man.GetChannel(ID);
+		return C && !C->m_InFlight && C->m_OldestUnacked == C->m_NextMessageID;
+	};
+
+	std::cout << "Beginning reliable UDP loopback test!" << std::endl;
+	uint32_t BaseBytes = Allocator.GetAllocatedBytes();
+	{
+		LWPacketManager ServerMan(1024, Allocator, Allocator, ServerReceive, Send);
+		LWPacketManager ClientMan(1024, Allocator, Allocator, ClientReceive, Send);
+		Server = &ServerMan;
+		Client = &ClientMan;
+		for (uint32_t i = 0; i < OrderedCount; i++) ServerMan.PushOutPacket(Allocator.Allocate<LWPacket>(i, ClientID, 1, LWPacket::Ack | LWPacket::Ordered));
+		for (uint32_t i = 0; i < UnorderedCount; i++) ServerMan.PushOutPacket(Allocator.Allocate<LWPacket>(OrderedCount + i, ClientID, 1, LWPacket::Ack));
+		for (uint32_t i = 0; i < ReplyCount; i++) ClientMan.PushOutPacket(Allocator.Allocate<LWPacket>(i, ServerID, 1, LWPacket::Ack | LWPacket::Ordered));
+		bool Done = false;
+		for (uint32_t Step = 0; Step < 20000 && !Done; Step++) {
+			Now += StepTime;
+			if (Step < SequencedSteps) ServerMan.PushOutPacket(Allocator.Allocate<LWPacket>(SequencedID + Step, ClientID, 1, LWPacket::Sequenced));
+			ServerMan.Update(Now, Resolution);
+			ClientMan.Update(Now, Resolution);
+			while (!Link.empty() && Link.begin()->first <= Now) {
+				Datagram D = Link.begin()->second;
+				Link.erase(Link.begin());
+				if (D.m_Sequenced) SequencedArrived++;
+				D.m_To->ProcessRawData(D.m_From, nullptr, D.m_Data, D.m_Len);
+			}
+			Done = Step >= SequencedSteps && isDrained(ServerMan, ClientID) && isDrained(ClientMan, ServerID) && Ordered.size() == OrderedCount && UnorderedDelivered >= UnorderedCount && Replies.size() == ReplyCount;
+		}
+		uint64_t RTT = ServerMan.GetRoundTripTime(ClientID);
+		std::cout << "Sent: " << Sent << " Dropped: " << Dropped << " Resent: " << Resent << " RTT: " << RTT * 1000 / Resolution << "ms Sequenced: " << Sequenced.size() << "/" << SequencedArrived << std::endl;
+		if (!Done) {
+			std::cout << "Reliable packets were not all delivered and acked: " << Ordered.size() << " " << Replies.size() << std::endl;
+			return false;
+		}
+		if (!Resent || RTT < Resolution * 40 / 1000 || RTT > Resolution / 2) {
+			std::cout << "Lost packets were not resent, or the round trip was not measured." << std::endl;
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < OrderedCount; i++) {
+		if (Ordered[i] != i) {
+			std::cout << "Ordered packet " << Ordered[i] << " delivered at " << i << std::endl;
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < ReplyCount; i++) {
+		if (Replies[i] != i) return false;
+	}
+	for (uint32_t i = 0; i < UnorderedCount; i++) {
+		if (Unordered[i] != 1) {
+			std::cout << "Reliable packet " << OrderedCount + i << " delivered " << Unordered[i] << " times." << std::endl;
+			return false;
+		}
+	}
+	//sequenced packets are dropped rather then resent, and any arriving after a newer one are discarded.
+	for (uint32_t i = 1; i < Sequenced.size(); i++) {
+		if (Sequenced[i] <= Sequenced[i - 1]) return false;
+	}
+	if (Sequenced.empty() || Sequenced.size() >= SequencedArrived) {
+		std::cout << "Late sequenced packets were not discarded." << std::endl;
+		return false;
+	}
+	std::cout << "Checking allocated bytes: " << Allocator.GetAllocatedBytes() << " Expected: " << BaseBytes << std::endl;
+	if (Allocator.GetAllocatedBytes() != BaseBytes) return false;
+	std::cout << "Finished reliable UDP loopback test!" << std::endl;
 	return true;
 }
 
@@ -271,6 +487,8 @@ int LWMain(int, char **){
 	if (!TestHTML()) std::cout << "Failed html test." << std::endl;
 	if (!TestTelnet()) std::cout << "Failed telnet test." << std::endl;
 	if (!TestLWPacketManager(Allocator)) std::cout << "Failed LWPacketManager test." << std::endl;
+	if (!TestSnapshotDelta()) std::cout << "Failed LWSnapshot delta test." << std::endl;
+	if (!TestReliableUDP(Allocator)) std::cout << "Failed reliable UDP loopback test." << std::endl;
 	LWProtocolManager::TerminateNetwork();
 	std::cout << "Finished Network test!" << std::endl;
 	return 0;
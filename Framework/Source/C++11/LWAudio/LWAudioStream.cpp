@@ -7,12 +7,178 @@
 #include "vorbis/codec.h"
 #include "vorbis/vorbisfile.h"
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
 
 struct VorbisContext {
 	OggVorbis_File m_File;
 	char *m_Buffer;
 	uint32_t m_BufferLen;
 	uint32_t m_Position;
+	uint32_t m_FrameSize = 0;
+	uint32_t m_TotalSamples = 0;
+	uint32_t m_Cursor = 0; //the next sample ov_read will return, guarded by m_DecodeLock.
+	uint32_t m_PrefetchEnd = 0; //the worker does not decode past this sample, lowered if decoding fails.
+	uint32_t m_RingFrames = 0;
+	uint32_t m_RingStart = 0; //the sample of the first frame in the ring, the ring is guarded by m_RingLock.
+	uint32_t m_RingHead = 0;
+	uint32_t m_RingCount = 0;
+	uint32_t m_Generation = 0; //incremented whenever the ring is reset, so the worker drops a chunk decoded for the old position.
+	bool m_Prefetching = false;
+	std::mutex m_DecodeLock; //always taken before m_RingLock when both are held.
+	std::mutex m_RingLock;
+	char m_Ring[LWAudioStream::PrefetchSize];
+	char m_Chunk[LWAudioStream::PrefetchChunkSize];
+};
+
+//Decodes SampleLen samples at SamplePos, only seeking if SamplePos is not where the last read stopped.  m_DecodeLock must be held.
+bool VorbisRead(VorbisContext *Context, char *Buffer, uint32_t SamplePos, uint32_t SampleLen) {
+	if (Context->m_Cursor != SamplePos) {
+		if (ov_pcm_seek(&Context->m_File, (ogg_int64_t)SamplePos) != 0) {
+			Context->m_Cursor = 0xFFFFFFFF;
+			return false;
+		}
+		Context->m_Cursor = SamplePos;
+	}
+	uint32_t Len = SampleLen * Context->m_FrameSize;
+	uint32_t o = 0;
+	int32_t cs = 0;
+	while (o != Len) {
+		int32_t Ret = (int32_t)ov_read(&Context->m_File, Buffer + o, Len - o, 0, 2, 1, &cs);
+		if (Ret <= 0) {
+			std::cout << "Failed: " << Ret << " | " << o << std::endl;
+			Context->m_Cursor = 0xFFFFFFFF;
+			return false;
+		}
+		o += (uint32_t)Ret;
+	}
+	Context->m_Cursor += SampleLen;
+	return true;
+}
+
+//Copies the buffered samples starting at SamplePos, and drops every frame before the last one copied.  returns the number of samples copied, m_RingLock must be held.
+uint32_t VorbisRingCopy(VorbisContext *Context, char *Buffer, uint32_t SamplePos, uint32_t SampleLen) {
+	if (SamplePos < Context->m_RingStart || SamplePos >= Context->m_RingStart + Context->m_RingCount) return 0;
+	uint32_t FrameSize = Context->m_FrameSize;
+	uint32_t Len = std::min<uint32_t>(SampleLen, Context->m_RingStart + Context->m_RingCount - SamplePos);
+	uint32_t Idx = (Context->m_RingHead + (SamplePos - Context->m_RingStart)) % Context->m_RingFrames;
+	uint32_t First = std::min<uint32_t>(Len, Context->m_RingFrames - Idx);
+	memcpy(Buffer, Context->m_Ring + Idx * FrameSize, First * FrameSize);
+	memcpy(Buffer + First * FrameSize, Context->m_Ring, (Len - First) * FrameSize);
+	uint32_t Consumed = SamplePos + Len - Context->m_RingStart;
+	Context->m_RingHead = (Context->m_RingHead + Consumed) % Context->m_RingFrames;
+	Context->m_RingStart += Consumed;
+	Context->m_RingCount -= Consumed;
+	return Len;
+}
+
+//Decodes the next chunk after the ring's samples, returns false if the ring is full or the stream can't be decoded any further.
+bool VorbisPrefetchChunk(VorbisContext *Context) {
+	uint32_t FrameSize = Context->m_FrameSize;
+	uint32_t ChunkFrames = LWAudioStream::PrefetchChunkSize / FrameSize;
+	std::unique_lock<std::mutex> RingLock(Context->m_RingLock);
+	if (Context->m_RingCount >= Context->m_RingFrames || Context->m_RingStart + Context->m_RingCount >= Context->m_PrefetchEnd) return false;
+	uint32_t Generation = Context->m_Generation;
+	uint32_t Target = Context->m_RingStart + Context->m_RingCount;
+	uint32_t Len = std::min<uint32_t>(std::min<uint32_t>(ChunkFrames, Context->m_RingFrames - Context->m_RingCount), Context->m_PrefetchEnd - Target);
+	RingLock.unlock();
+
+	std::lock_guard<std::mutex> DecodeLock(Context->m_DecodeLock);
+	bool Decoded = VorbisRead(Context, Context->m_Chunk, Target, Len);
+	RingLock.lock();
+	if (!Decoded) Context->m_PrefetchEnd = Target;
+	else if (Generation == Context->m_Generation && Context->m_RingStart + Context->m_RingCount == Target) {
+		uint32_t Idx = (Context->m_RingHead + Context->m_RingCount) % Context->m_RingFrames;
+		uint32_t First = std::min<uint32_t>(Len, Context->m_RingFrames - Idx);
+		memcpy(Context->m_Ring + Idx * FrameSize, Context->m_Chunk, First * FrameSize);
+		memcpy(Context->m_Ring, Context->m_Chunk + First * FrameSize, (Len - First) * FrameSize);
+		Context->m_RingCount += Len;
+	}
+	return true;
+}
+
+//One worker keeps the rings of every prefetching stream filled, it is started with the first stream and stopped with the last.
+struct VorbisPrefetcher {
+	std::vector<VorbisContext*> m_Contexts;
+	VorbisContext *m_Current = nullptr; //the context the worker is decoding, which can't be destroyed until it's released.
+	bool m_Wake = false;
+	bool m_Stop = false;
+	std::mutex m_StartLock; //serializes adding and removing contexts, so the worker is never started while the last one is stopping.
+	std::mutex m_Lock;
+	std::condition_variable m_Signal;
+	std::condition_variable m_Released;
+	std::thread m_Worker;
+
+	static VorbisPrefetcher &Get(void) {
+		static VorbisPrefetcher Prefetcher;
+		return Prefetcher;
+	}
+
+	void Run(void) {
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		while (true) {
+			m_Signal.wait(Lock, [this]() { return m_Wake || m_Stop; });
+			if (m_Stop) break;
+			m_Wake = false;
+			//decode one chunk per stream each pass, so a stream far behind doesn't starve the others.
+			bool Decoded = false;
+			for (uint32_t i = 0; i < (uint32_t)m_Contexts.size() && !m_Stop; i++) {
+				VorbisContext *Context = m_Current = m_Contexts[i];
+				Lock.unlock();
+				Decoded |= VorbisPrefetchChunk(Context);
+				Lock.lock();
+				m_Current = nullptr;
+				m_Released.notify_all();
+			}
+			if (Decoded) m_Wake = true;
+		}
+	}
+
+	void Wake(void) {
+		{
+			std::lock_guard<std::mutex> Lock(m_Lock);
+			m_Wake = true;
+		}
+		m_Signal.notify_one();
+	}
+
+	void Add(VorbisContext *Context) {
+		std::lock_guard<std::mutex> StartLock(m_StartLock);
+		{
+			std::lock_guard<std::mutex> Lock(m_Lock);
+			m_Contexts.push_back(Context);
+			m_Wake = true;
+		}
+		if (!m_Worker.joinable()) m_Worker = std::thread(&VorbisPrefetcher::Run, this);
+		else m_Signal.notify_one();
+	}
+
+	void Remove(VorbisContext *Context) {
+		std::lock_guard<std::mutex> StartLock(m_StartLock);
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_Contexts.erase(std::find(m_Contexts.begin(), m_Contexts.end(), Context));
+		m_Released.wait(Lock, [this, Context]() { return m_Current != Context; });
+		if (!m_Contexts.empty()) return;
+		m_Stop = true;
+		Lock.unlock();
+		m_Signal.notify_one();
+		m_Worker.join();
+		Lock.lock();
+		m_Stop = m_Wake = false;
+	}
+
+	~VorbisPrefetcher() {
+		if (!m_Worker.joinable()) return;
+		{
+			std::lock_guard<std::mutex> Lock(m_Lock);
+			m_Stop = true;
+		}
+		m_Signal.notify_one();
+		m_Worker.join();
+	}
 };
 
 LWAudioStream *LWAudioStream::Create(const LWText &Filepath, uint32_t Flag, LWAllocator &Allocator) {
@@ -116,6 +282,9 @@ LWAudioStream *LWAudioStream::Create(char *Buffer, uint32_t BufferLen, uint32_t
 		}
 		vorbis_info *vi = ov_info(&Context->m_File, -1);
 		uint32_t TotalSamples = (uint32_t)ov_pcm_total(&Context->m_File, -1);
+		Context->m_FrameSize = 2 * sizeof(uint16_t);
+		Context->m_TotalSamples = Context->m_PrefetchEnd = TotalSamples;
+		Context->m_RingFrames = PrefetchSize / Context->m_FrameSize;
 		LWAudioStream *Stream = nullptr;
 		if (Flag&Decompressed) {
 			uint32_t TotalBufferSize = TotalSamples * 2*2;//channels*(sizeof(uint16_t)/8))
@@ -140,6 +309,12 @@ LWAudioStream *LWAudioStream::Create(char *Buffer, uint32_t BufferLen, uint32_t
 			LWAllocator::Destroy(Buffer);
 			Stream = Allocator.Allocate<LWAudioStream>(nullptr, RawBuffer, TotalSamples, (uint32_t)sizeof(uint16_t), 44100, LinearPCM, 2, FormatRaw);
 		} else {
+			if ((Flag&NoPrefetch) == 0) {
+				//the first chunk is decoded here, so playback doesn't start while the worker still holds the decoder.
+				VorbisPrefetchChunk(Context);
+				Context->m_Prefetching = true;
+				VorbisPrefetcher::Get().Add(Context);
+			}
 			Stream = Allocator.Allocate<LWAudioStream>(Context, Buffer, TotalSamples, (uint32_t)sizeof(uint16_t), 44100, LinearPCM, 2, FormatVorbis);
 		}
 		return Stream;
@@ -163,17 +338,38 @@ char *LWAudioStream::DecodeSamples(char *Buffer, uint32_t SamplePos, uint32_t Sa
 
 	auto ProcessVorbisFormat = [this](char *Buffer, uint32_t SamplePos, uint32_t SampleLen, uint32_t FrameSize, bool ForceCopy)->char* {
 		VorbisContext *Context = (VorbisContext*)m_Context;
-		ov_pcm_seek(&Context->m_File, (ogg_int64_t)(SamplePos));
+		bool Prefetching = Context->m_Prefetching;
 		uint32_t o = 0;
-		int32_t cs = 0;
-		while (o != (SampleLen*FrameSize)) {
-			int32_t Ret = (int32_t)ov_read(&Context->m_File, Buffer + o, (SampleLen*FrameSize) - o, 0, 2, 1, &cs);
-			if (Ret <= 0) {
-				std::cout << "Failed: " << Ret << " | " << o << std::endl;
-				return Buffer;
+		if (Prefetching) {
+			std::lock_guard<std::mutex> RingLock(Context->m_RingLock);
+			o = VorbisRingCopy(Context, Buffer, SamplePos, SampleLen);
+		}
+		if (o != SampleLen) {
+			//the worker has not caught up, or the position jumped, so decode the rest here and restart the worker after it.
+			//the mixer can't wait out the worker's chunk, so while the worker holds the decoder the missing samples are silent.
+			std::unique_lock<std::mutex> DecodeLock(Context->m_DecodeLock, std::defer_lock);
+			if (Prefetching) DecodeLock.try_lock();
+			else DecodeLock.lock();
+			if (!DecodeLock.owns_lock()) memset(Buffer + o * FrameSize, 0, (SampleLen - o) * FrameSize);
+			else {
+				if (Prefetching) {
+					std::lock_guard<std::mutex> RingLock(Context->m_RingLock);
+					o += VorbisRingCopy(Context, Buffer + o * FrameSize, SamplePos + o, SampleLen - o);
+				}
+				if (o != SampleLen) {
+					if (!VorbisRead(Context, Buffer + o * FrameSize, SamplePos + o, SampleLen - o)) memset(Buffer + o * FrameSize, 0, (SampleLen - o) * FrameSize);
+					if (Prefetching) {
+						std::lock_guard<std::mutex> RingLock(Context->m_RingLock);
+						Context->m_RingStart = SamplePos + SampleLen;
+						Context->m_RingHead = Context->m_RingCount = 0;
+						//a failed decode only stops prefetching until the position moves.
+						Context->m_PrefetchEnd = Context->m_TotalSamples;
+						Context->m_Generation++;
+					}
+				}
 			}
-			o += (uint32_t)Ret;
 		}
+		if (Prefetching) VorbisPrefetcher::Get().Wake();
 		return Buffer;
 	};
 
@@ -268,6 +464,8 @@ LWAudioStream::~LWAudioStream() {
 
 	auto CloseVorbis = [this]() {
 		VorbisContext *Context = (VorbisContext*)m_Context;
+		if (!Context) return;
+		if (Context->m_Prefetching) VorbisPrefetcher::Get().Remove(Context);
 		ov_clear(&Context->m_File);
 		LWAllocator::Destroy(Context);
 	};
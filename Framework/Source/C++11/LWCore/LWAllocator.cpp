@@ -1,4 +1,6 @@
 #include "LWCore/LWAllocator.h"
+#include "LWCore/LWAllocatorStats.h"
+#include <atomic>
 
 /*! \cond */
 struct alignas(16) LWAllocatorEnvironment{
@@ -6,15 +8,45 @@ struct alignas(16) LWAllocatorEnvironment{
 	uint32_t m_Size;
 	alignas(8) LWAllocator *m_Allocator;
 };
+
+//Allocations recorded to stats carry a second environment after the allocator's own, marked by this bit in it's allocator pointer and with the stats tag index in it's pad.
+const uintptr_t LWAllocatorTracked = 1;
+
+inline LWAllocatorEnvironment *LWAllocatorGetEnvironment(void *Memory) {
+	return (LWAllocatorEnvironment*)(((int8_t*)Memory) - sizeof(LWAllocatorEnvironment));
+}
+
+std::atomic<uint64_t> LWAllocatorThreadSlots(0);
+
+//The slot is released when the thread exits so it's caches can be picked up by the next thread.
+struct LWAllocatorThreadSlot {
+	uint32_t m_Index = LWAllocator::MaxThreadSlots;
+
+	LWAllocatorThreadSlot() {
+		uint64_t Slots = LWAllocatorThreadSlots.load();
+		uint32_t Index = 0;
+		do {
+			for (Index = 0; Index < LWAllocator::MaxThreadSlots && (Slots&(1ull << Index)); Index++) {}
+			if (Index >= LWAllocator::MaxThreadSlots) return;
+		} while (!LWAllocatorThreadSlots.compare_exchange_weak(Slots, Slots | (1ull << Index)));
+		m_Index = Index;
+	}
+
+	~LWAllocatorThreadSlot() {
+		if (m_Index < LWAllocator::MaxThreadSlots) LWAllocatorThreadSlots.fetch_and(~(1ull << m_Index));
+	}
+};
+
+thread_local LWAllocatorThreadSlot LWAllocatorSlot;
 /*! \endcond */
 
 LWAllocator *LWAllocator::GetAllocator(void *Memory){
-	LWAllocatorEnvironment *Enviroment = (LWAllocatorEnvironment *)(((int8_t*)Memory) - sizeof(LWAllocatorEnvironment));
-	return Enviroment->m_Allocator;
+	LWAllocatorEnvironment *Enviroment = LWAllocatorGetEnvironment(Memory);
+	return (LWAllocator*)((uintptr_t)Enviroment->m_Allocator&~LWAllocatorTracked);
 }
 
 uint32_t LWAllocator::GetAllocationSize(void *Memory){
-	LWAllocatorEnvironment *Enviroment = (LWAllocatorEnvironment *)(((int8_t*)Memory) - sizeof(LWAllocatorEnvironment));
+	LWAllocatorEnvironment *Enviroment = LWAllocatorGetEnvironment(Memory);
 	return Enviroment->m_Size;
 }
 
@@ -23,7 +55,39 @@ uint32_t LWAllocator::GetAllocatedBytes(void){
 }
 
 void *LWAllocator::Deallocate(void *Memory){
-	return DeallocateMemory(Memory);
+	LWAllocatorEnvironment *Env = LWAllocatorGetEnvironment(Memory);
+	//Memory allocated before stats were attached has no stats environment and is not recorded.
+	if (!((uintptr_t)Env->m_Allocator&LWAllocatorTracked)) return DeallocateMemory(Memory);
+	if (m_Stats) m_Stats->RecordDeallocation(Env->m_Size, Env->m_Pad);
+	return DeallocateMemory(Env) ? Memory : nullptr;
+}
+
+uint32_t LWAllocator::GetThreadSlot(void){
+	return LWAllocatorSlot.m_Index;
+}
+
+LWAllocator &LWAllocator::SetStats(LWAllocatorStats *Stats){
+	m_Stats = Stats;
+	return *this;
+}
+
+LWAllocatorStats *LWAllocator::GetStats(void){
+	return m_Stats;
+}
+
+void *LWAllocator::AllocateTracked(uint32_t Length){
+	if (!m_Stats) return AllocateMemory(Length);
+	void *Memory = Length + sizeof(LWAllocatorEnvironment) > Length ? AllocateMemory(Length + sizeof(LWAllocatorEnvironment)) : nullptr;
+	if (!Memory) {
+		m_Stats->RecordFailure(Length);
+		return nullptr;
+	}
+	LWAllocatorEnvironment *Env = (LWAllocatorEnvironment*)Memory;
+	Env->m_Pad = m_Stats->FindTag(LWAllocatorStats::GetTag());
+	Env->m_Size = Length;
+	Env->m_Allocator = (LWAllocator*)((uintptr_t)this | LWAllocatorTracked);
+	m_Stats->RecordAllocation(Length, Env->m_Pad);
+	return Env + 1;
 }
 
 void *LWAllocator::AllocateMemory(uint32_t Length){
@@ -0,0 +1,227 @@
+#include "LWCore/LWAllocatorStats.h"
+#include "LWCore/LWText.h"
+#include <cstring>
+
+/*! \cond */
+thread_local const char *LWAllocatorStatsTag = nullptr;
+/*! \endcond */
+
+LWAllocatorStats::ScopedTag::ScopedTag(const char *Tag) : m_PrevTag(LWAllocatorStatsTag) {
+	LWAllocatorStatsTag = Tag;
+}
+
+LWAllocatorStats::ScopedTag::~ScopedTag() {
+	LWAllocatorStatsTag = m_PrevTag;
+}
+
+void LWAllocatorStats::SetTag(const char *Tag) {
+	LWAllocatorStatsTag = Tag;
+}
+
+const char *LWAllocatorStats::GetTag(void) {
+	return LWAllocatorStatsTag;
+}
+
+uint32_t LWAllocatorStats::GetBucket(uint32_t Size) {
+	uint32_t Bucket = 0;
+	for (uint32_t Max = 16; Size > Max && Bucket < BucketCount - 1; Max <<= 1) Bucket++;
+	return Bucket;
+}
+
+uint32_t LWAllocatorStats::GetBucketMaxSize(uint32_t Bucket) {
+	if (Bucket >= BucketCount - 1) return 0xFFFFFFFF;
+	return 16u << Bucket;
+}
+
+LWAllocatorStats &LWAllocatorStats::RecordAllocation(uint32_t Size, uint32_t Tag) {
+	uint64_t Live = m_LiveBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+	m_LiveCount.fetch_add(1, std::memory_order_relaxed);
+	uint64_t Peak = m_PeakBytes.load(std::memory_order_relaxed);
+	while (Live > Peak && !m_PeakBytes.compare_exchange_weak(Peak, Live, std::memory_order_relaxed)) {}
+	m_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	m_Buckets[GetBucket(Size)].fetch_add(1, std::memory_order_relaxed);
+	m_FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+	m_FrameBytes.fetch_add(Size, std::memory_order_relaxed);
+	m_TagAllocations[Tag].fetch_add(1, std::memory_order_relaxed);
+	m_TagBytes[Tag].fetch_add(Size, std::memory_order_relaxed);
+	m_TagLiveBytes[Tag].fetch_add(Size, std::memory_order_relaxed);
+	m_TagLiveCount[Tag].fetch_add(1, std::memory_order_relaxed);
+	return *this;
+}
+
+LWAllocatorStats &LWAllocatorStats::RecordDeallocation(uint32_t Size, uint32_t Tag) {
+	m_LiveBytes.fetch_sub(Size, std::memory_order_relaxed);
+	m_LiveCount.fetch_sub(1, std::memory_order_relaxed);
+	m_DeallocationCount.fetch_add(1, std::memory_order_relaxed);
+	m_TagLiveBytes[Tag].fetch_sub(Size, std::memory_order_relaxed);
+	m_TagLiveCount[Tag].fetch_sub(1, std::memory_order_relaxed);
+	return *this;
+}
+
+LWAllocatorStats &LWAllocatorStats::RecordFailure(uint32_t) {
+	m_FailedCount.fetch_add(1, std::memory_order_relaxed);
+	return *this;
+}
+
+LWAllocatorStats &LWAllocatorStats::NextFrame(void) {
+	uint64_t Allocations = m_FrameAllocations.exchange(0, std::memory_order_relaxed);
+	m_LastFrameAllocations.store(Allocations, std::memory_order_relaxed);
+	m_LastFrameBytes.store(m_FrameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+	if (Allocations > m_PeakFrameAllocations.load(std::memory_order_relaxed)) m_PeakFrameAllocations.store(Allocations, std::memory_order_relaxed);
+	m_FrameCount.fetch_add(1, std::memory_order_relaxed);
+	return *this;
+}
+
+LWAllocatorStats &LWAllocatorStats::Reset(void) {
+	m_PeakBytes.store(m_LiveBytes.load());
+	m_AllocationCount.store(0);
+	m_DeallocationCount.store(0);
+	m_FailedCount.store(0);
+	for (uint32_t i = 0; i < BucketCount; i++) m_Buckets[i].store(0);
+	m_FrameAllocations.store(0);
+	m_FrameBytes.store(0);
+	m_LastFrameAllocations.store(0);
+	m_LastFrameBytes.store(0);
+	m_PeakFrameAllocations.store(0);
+	m_FrameCount.store(0);
+	for (uint32_t i = 0; i <= MaxTags; i++) {
+		m_TagAllocations[i].store(0);
+		m_TagBytes[i].store(0);
+	}
+	return *this;
+}
+
+uint32_t LWAllocatorStats::SerializeJSON(char *Buffer, uint32_t BufferLen) const {
+	uint32_t o = 0;
+	auto WriteString = [&o, Buffer, BufferLen](const char *Str) {
+		LWText::Appendf(Buffer, BufferLen, o, "\"");
+		for (; *Str; Str++) {
+			if (*Str == '"' || *Str == '\\') LWText::Appendf(Buffer, BufferLen, o, "\\%c", *Str);
+			else if ((uint8_t)*Str < 0x20) LWText::Appendf(Buffer, BufferLen, o, "\\u%04x", (uint32_t)(uint8_t)*Str);
+			else LWText::Appendf(Buffer, BufferLen, o, "%c", *Str);
+		}
+		LWText::Appendf(Buffer, BufferLen, o, "\"");
+	};
+	LWText::Appendf(Buffer, BufferLen, o, "{\"Name\":");
+	WriteString(m_Name ? m_Name : "");
+	LWText::Appendf(Buffer, BufferLen, o, ",\"LiveBytes\":%llu,\"PeakBytes\":%llu,\"LiveAllocations\":%llu", (unsigned long long)GetLiveBytes(), (unsigned long long)GetPeakBytes(), (unsigned long long)GetLiveCount());
+	LWText::Appendf(Buffer, BufferLen, o, ",\"Allocations\":%llu,\"Deallocations\":%llu,\"Failed\":%llu", (unsigned long long)GetAllocationCount(), (unsigned long long)GetDeallocationCount(), (unsigned long long)GetFailedCount());
+	LWText::Appendf(Buffer, BufferLen, o, ",\"Frames\":%llu,\"LastFrameAllocations\":%llu,\"LastFrameBytes\":%llu,\"PeakFrameAllocations\":%llu", (unsigned long long)GetFrameCount(), (unsigned long long)GetLastFrameAllocations(), (unsigned long long)GetLastFrameBytes(), (unsigned long long)GetPeakFrameAllocations());
+	LWText::Appendf(Buffer, BufferLen, o, ",\"Buckets\":[");
+	for (uint32_t i = 0; i < BucketCount; i++) LWText::Appendf(Buffer, BufferLen, o, "%s{\"MaxSize\":%u,\"Allocations\":%llu}", i ? "," : "", GetBucketMaxSize(i), (unsigned long long)GetBucketAllocations(i));
+	LWText::Appendf(Buffer, BufferLen, o, "],\"Tags\":[");
+	bool First = true;
+	uint32_t TagCount = GetTagCount();
+	for (uint32_t i = 0; i <= MaxTags; i++) {
+		if (i < MaxTags && i >= TagCount) i = NoTag;
+		uint64_t Allocations = GetTagAllocations(i);
+		uint64_t LiveCount = GetTagLiveCount(i);
+		if (!Allocations && !LiveCount) continue;
+		LWText::Appendf(Buffer, BufferLen, o, "%s{\"Name\":", First ? "" : ",");
+		WriteString(i == NoTag ? "Untagged" : GetTagName(i));
+		LWText::Appendf(Buffer, BufferLen, o, ",\"Allocations\":%llu,\"Bytes\":%llu,\"LiveBytes\":%llu,\"LiveAllocations\":%llu}", (unsigned long long)Allocations, (unsigned long long)GetTagBytes(i), (unsigned long long)GetTagLiveBytes(i), (unsigned long long)LiveCount);
+		First = false;
+	}
+	LWText::Appendf(Buffer, BufferLen, o, "]}");
+	return o;
+}
+
+const char *LWAllocatorStats::GetName(void) const {
+	return m_Name;
+}
+
+uint64_t LWAllocatorStats::GetLiveBytes(void) const {
+	return m_LiveBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetPeakBytes(void) const {
+	return m_PeakBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetLiveCount(void) const {
+	return m_LiveCount.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetAllocationCount(void) const {
+	return m_AllocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetDeallocationCount(void) const {
+	return m_DeallocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetFailedCount(void) const {
+	return m_FailedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetBucketAllocations(uint32_t Bucket) const {
+	return m_Buckets[Bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetLastFrameAllocations(void) const {
+	return m_LastFrameAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetLastFrameBytes(void) const {
+	return m_LastFrameBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetPeakFrameAllocations(void) const {
+	return m_PeakFrameAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetFrameCount(void) const {
+	return m_FrameCount.load(std::memory_order_relaxed);
+}
+
+uint32_t LWAllocatorStats::GetTagCount(void) const {
+	uint32_t i = 0;
+	for (; i < MaxTags && m_TagNames[i].load(std::memory_order_acquire); i++) {}
+	return i;
+}
+
+const char *LWAllocatorStats::GetTagName(uint32_t Index) const {
+	if (Index >= MaxTags) return nullptr;
+	return m_TagNames[Index].load(std::memory_order_acquire);
+}
+
+uint64_t LWAllocatorStats::GetTagAllocations(uint32_t Index) const {
+	return m_TagAllocations[Index].load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetTagBytes(uint32_t Index) const {
+	return m_TagBytes[Index].load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetTagLiveBytes(uint32_t Index) const {
+	return m_TagLiveBytes[Index].load(std::memory_order_relaxed);
+}
+
+uint64_t LWAllocatorStats::GetTagLiveCount(uint32_t Index) const {
+	return m_TagLiveCount[Index].load(std::memory_order_relaxed);
+}
+
+uint32_t LWAllocatorStats::FindTag(const char *Tag) {
+	if (!Tag) return NoTag;
+	for (uint32_t i = 0; i < MaxTags; i++) {
+		const char *Name = m_TagNames[i].load(std::memory_order_acquire);
+		if (!Name) {
+			if (m_TagNames[i].compare_exchange_strong(Name, Tag)) return i;
+		}
+		//Name is reloaded by a failed exchange, so a racing registration of the same tag is still matched.
+		if (Name == Tag || !strcmp(Name, Tag)) return i;
+	}
+	return MaxTags - 1;
+}
+
+LWAllocatorStats::LWAllocatorStats(const char *Name) : m_Name(Name) {
+	m_LiveBytes.store(0);
+	m_LiveCount.store(0);
+	m_PeakBytes.store(0);
+	for (uint32_t i = 0; i < MaxTags; i++) m_TagNames[i].store(nullptr);
+	for (uint32_t i = 0; i <= MaxTags; i++) {
+		m_TagLiveBytes[i].store(0);
+		m_TagLiveCount[i].store(0);
+	}
+	Reset();
+}
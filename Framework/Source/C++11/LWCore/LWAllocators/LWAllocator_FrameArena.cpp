@@ -0,0 +1,112 @@
+#include "LWCore/LWAllocators/LWAllocator_FrameArena.h"
+#include <cstring>
+
+/*! \cond */
+struct alignas(16) LWAllocator_FrameArenaEnvironment {
+	uint32_t m_Pad;
+	uint32_t m_Size;
+	alignas(8) LWAllocator *m_Allocator;
+};
+/*! \endcond */
+
+LWAllocator_FrameArena::Scope::Scope(LWAllocator_FrameArena &Arena) : m_Arena(Arena), m_Marker(Arena.PushMarker()) {}
+
+LWAllocator_FrameArena::Scope::~Scope() {
+	m_Arena.PopMarker(m_Marker);
+}
+
+LWAllocator_FrameArena &LWAllocator_FrameArena::NextFrame(void) {
+	m_FrameIndex = (m_FrameIndex + 1) % m_FrameCount;
+	m_FrameID++;
+	return Rewind(0);
+}
+
+uint64_t LWAllocator_FrameArena::PushMarker(void) const {
+	return ((uint64_t)m_FrameID << 32) | m_FramePositions[m_FrameIndex];
+}
+
+bool LWAllocator_FrameArena::PopMarker(uint64_t Marker) {
+	uint32_t Position = (uint32_t)Marker;
+	if ((uint32_t)(Marker >> 32) != m_FrameID || Position > m_FramePositions[m_FrameIndex]) return false;
+	Rewind(Position);
+	return true;
+}
+
+uint32_t LWAllocator_FrameArena::GetFrameID(void) const {
+	return m_FrameID;
+}
+
+uint32_t LWAllocator_FrameArena::GetFrameIndex(void) const {
+	return m_FrameIndex;
+}
+
+uint32_t LWAllocator_FrameArena::GetFrameUsed(void) const {
+	return m_FramePositions[m_FrameIndex];
+}
+
+uint32_t LWAllocator_FrameArena::GetFrameSize(void) const {
+	return m_FrameSize;
+}
+
+uint32_t LWAllocator_FrameArena::GetFrameCount(void) const {
+	return m_FrameCount;
+}
+
+uint32_t LWAllocator_FrameArena::GetHighWaterMark(void) const {
+	return m_HighWaterMark;
+}
+
+void *LWAllocator_FrameArena::AllocateMemory(uint32_t Length) {
+	uint32_t &Position = m_FramePositions[m_FrameIndex];
+	uint32_t Total = (Length + sizeof(LWAllocator_FrameArenaEnvironment) + Alignment - 1)&~(Alignment - 1);
+	if (Total < Length || Total > m_FrameSize - Position) return nullptr;
+	uint8_t *Memory = m_Buffer + m_FrameIndex*m_FrameSize + Position;
+	Position += Total;
+	if (Position > m_HighWaterMark) m_HighWaterMark = Position;
+	m_AllocatedBytes += Total;
+	LWAllocator_FrameArenaEnvironment *Env = (LWAllocator_FrameArenaEnvironment*)Memory;
+	Env->m_Pad = 0;
+	Env->m_Size = Length;
+	Env->m_Allocator = this;
+	Memory += sizeof(LWAllocator_FrameArenaEnvironment);
+	if (m_Flags&Poison) memset(Memory, AllocPoisonByte, Total - sizeof(LWAllocator_FrameArenaEnvironment));
+	return Memory;
+}
+
+void *LWAllocator_FrameArena::DeallocateMemory(void *Memory) {
+	LWAllocator_FrameArenaEnvironment *Env = (LWAllocator_FrameArenaEnvironment*)(((int8_t*)Memory) - sizeof(LWAllocator_FrameArenaEnvironment));
+	uint32_t Total = (Env->m_Size + sizeof(LWAllocator_FrameArenaEnvironment) + Alignment - 1)&~(Alignment - 1);
+	uint8_t *FrameStart = m_Buffer + m_FrameIndex*m_FrameSize;
+	uint32_t Position = m_FramePositions[m_FrameIndex];
+	//Only the most recent allocation of the current frame can be given back, everything else is released when the frame is reset.
+	if ((uint8_t*)Env + Total == FrameStart + Position) Rewind(Position - Total);
+	return nullptr;
+}
+
+void *LWAllocator_FrameArena::AllocateBytes(uint32_t) {
+	return nullptr;
+}
+
+void *LWAllocator_FrameArena::DeallocateBytes(void *) {
+	return nullptr;
+}
+
+LWAllocator_FrameArena &LWAllocator_FrameArena::Rewind(uint32_t Position) {
+	uint32_t &FramePosition = m_FramePositions[m_FrameIndex];
+	if (m_Flags&Poison) memset(m_Buffer + m_FrameIndex*m_FrameSize + Position, FreePoisonByte, FramePosition - Position);
+	m_AllocatedBytes -= (FramePosition - Position);
+	FramePosition = Position;
+	return *this;
+}
+
+LWAllocator_FrameArena::LWAllocator_FrameArena(uint32_t FrameSize, uint32_t FrameCount, uint32_t Flags) : LWAllocator(), m_FrameSize((FrameSize + Alignment - 1)&~(Alignment - 1)), m_FrameCount(FrameCount ? FrameCount : 1), m_Flags(Flags) {
+	m_Buffer = new uint8_t[(size_t)m_FrameSize*m_FrameCount];
+	m_FramePositions = new uint32_t[m_FrameCount];
+	for (uint32_t i = 0; i < m_FrameCount; i++) m_FramePositions[i] = 0;
+	if (m_Flags&Poison) memset(m_Buffer, FreePoisonByte, (size_t)m_FrameSize*m_FrameCount);
+}
+
+LWAllocator_FrameArena::~LWAllocator_FrameArena() {
+	delete[] m_Buffer;
+	delete[] m_FramePositions;
+}
@@ -1,54 +1,144 @@
 #include "LWCore/LWAllocators/LWAllocator_LocalHeap.h"
-
-#include <iostream>
+#include <thread>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 /*! \cond */
-
-struct LWAllocator_LocalHeapEnvironment{
-	LWAllocator_LocalHeapEnvironment *m_Next;
-	LWAllocator_LocalHeapEnvironment *m_Prev;
+//m_BlockSize takes the place of the pad in the standard allocation header, the low bits are free for flags since every block size is a multiple of Alignment.  Free blocks store their list links as buffer offsets after the header, and their size in the last 4 bytes so the next block can find them.
+struct alignas(16) LWAllocator_LocalHeapEnvironment{
+	uint32_t m_BlockSize;
 	uint32_t m_Size;
-	LWAllocator *m_Allocator;
+	alignas(8) LWAllocator *m_Allocator;
 };
+
+struct LWAllocator_LocalHeapFreeLinks {
+	uint32_t m_Next;
+	uint32_t m_Prev;
+};
+
+const uint32_t LWAllocator_LocalHeapFree = 0x1;
+const uint32_t LWAllocator_LocalHeapPrevFree = 0x2;
+const uint32_t LWAllocator_LocalHeapSizeMask = ~0xFu;
+const uint32_t LWAllocator_LocalHeapNull = 0xFFFFFFFF;
+
+inline uint32_t LWAllocator_LocalHeapHighBit(uint32_t Value) {
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanReverse(&Index, Value);
+	return (uint32_t)Index;
+#else
+	return 31 - (uint32_t)__builtin_clz(Value);
+#endif
+}
+
+inline uint32_t LWAllocator_LocalHeapLowBit(uint32_t Value) {
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, Value);
+	return (uint32_t)Index;
+#else
+	return (uint32_t)__builtin_ctz(Value);
+#endif
+}
+
+//Allocated bytes are counted from the requested size rather than the real block size, as a used block's size word can't be read without the lock.
+inline uint32_t LWAllocator_LocalHeapBlockSize(uint32_t Length) {
+	return std::max<uint32_t>((Length + sizeof(LWAllocator_LocalHeapEnvironment) + LWAllocator_LocalHeap::Alignment - 1)&LWAllocator_LocalHeapSizeMask, LWAllocator_LocalHeap::MinBlockSize);
+}
+
+inline void LWAllocator_LocalHeapMapping(uint32_t Size, uint32_t &FirstLevel, uint32_t &SecondLevel) {
+	if (Size < (1u << LWAllocator_LocalHeap::FirstLevelShift)) {
+		FirstLevel = 0;
+		SecondLevel = Size >> LWAllocator_LocalHeap::AlignmentBits;
+		return;
+	}
+	uint32_t Bit = LWAllocator_LocalHeapHighBit(Size);
+	SecondLevel = (Size >> (Bit - LWAllocator_LocalHeap::SecondLevelBits)) ^ LWAllocator_LocalHeap::SecondLevelCount;
+	FirstLevel = Bit - LWAllocator_LocalHeap::FirstLevelShift + 1;
+}
 /*! \endcond */
 
+uint32_t LWAllocator_LocalHeap::GetLargestFreeBlock(void) {
+	Lock();
+	uint32_t Largest = 0;
+	if (m_FirstLevelMap) {
+		uint32_t FirstLevel = LWAllocator_LocalHeapHighBit(m_FirstLevelMap);
+		uint32_t SecondLevel = LWAllocator_LocalHeapHighBit(m_SecondLevelMap[FirstLevel]);
+		for (uint32_t Offset = m_FreeLists[FirstLevel][SecondLevel]; Offset != LWAllocator_LocalHeapNull;) {
+			LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset);
+			Largest = std::max<uint32_t>(Largest, (Env->m_BlockSize&LWAllocator_LocalHeapSizeMask) - sizeof(LWAllocator_LocalHeapEnvironment));
+			Offset = ((LWAllocator_LocalHeapFreeLinks*)(Env + 1))->m_Next;
+		}
+	}
+	Unlock();
+	return Largest;
+}
+
+uint32_t LWAllocator_LocalHeap::GetAllocatedBytes(void) {
+	int64_t Total = m_AllocatedBytes;
+	for (uint32_t i = 0; i < MaxThreadSlots; i++) {
+		ThreadCache *Cache = m_Caches[i].load(std::memory_order_acquire);
+		if (Cache) Total -= Cache->m_CachedBytes.load(std::memory_order_relaxed);
+	}
+	return (uint32_t)Total;
+}
+
+LWAllocator_LocalHeap &LWAllocator_LocalHeap::FlushThreadCache(void) {
+	ThreadCache *Cache = GetThreadCache();
+	if (!Cache) return *this;
+	Lock();
+	ReleaseCache(Cache);
+	Unlock();
+	return *this;
+}
+
 void *LWAllocator_LocalHeap::AllocateMemory(uint32_t Length){
-	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)m_NextAllocationUnit;
-	while (Env && Env->m_Size < Length) Env = Env->m_Next;
-	if (!Env) return nullptr; //could not find suitable location for placing memory.
-	if (Env->m_Size > Length + sizeof(LWAllocator_LocalHeapEnvironment)){
-		LWAllocator_LocalHeapEnvironment *NewHeap = (LWAllocator_LocalHeapEnvironment*)(((int8_t*)Env) + sizeof(LWAllocator_LocalHeapEnvironment)+Length);
-		NewHeap->m_Prev = Env;
-		NewHeap->m_Next = Env->m_Next;
-		Env->m_Next = NewHeap;
-		NewHeap->m_Size = Env->m_Size - Length - sizeof(LWAllocator_LocalHeapEnvironment);
-		NewHeap->m_Allocator = this;
-	}else Length = Env->m_Size;
-	if (Env == (LWAllocator_LocalHeapEnvironment*)m_NextAllocationUnit) m_NextAllocationUnit = Env->m_Next;
-	Env->m_Size = 0;
-	m_AllocatedBytes += Length;
-	return ((int8_t*)Env) + sizeof(LWAllocator_LocalHeapEnvironment);
+	uint32_t BlockSize = LWAllocator_LocalHeapBlockSize(Length);
+	if (BlockSize < Length) return nullptr;
+	uint32_t Offset = LWAllocator_LocalHeapNull;
+	ThreadCache *Cache = GetThreadCache();
+	uint32_t CacheClass = (BlockSize >> AlignmentBits) - 1;
+	if (Cache && CacheClass < CacheClassCount && Cache->m_Counts[CacheClass]) {
+		Offset = Cache->m_Blocks[CacheClass][--Cache->m_Counts[CacheClass]];
+		Cache->m_CachedBytes.store(Cache->m_CachedBytes.load(std::memory_order_relaxed) - BlockSize, std::memory_order_relaxed);
+	} else {
+		Lock();
+		Offset = TakeBlock(BlockSize);
+		if (Offset == LWAllocator_LocalHeapNull && Cache) {
+			//Out of space, give back anything this thread is holding onto and try again.
+			ReleaseCache(Cache);
+			Offset = TakeBlock(BlockSize);
+		}
+		if (Offset != LWAllocator_LocalHeapNull) m_AllocatedBytes += BlockSize;
+		Unlock();
+		if (Offset == LWAllocator_LocalHeapNull) return nullptr; //could not find suitable location for placing memory.
+	}
+	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset);
+	Env->m_Size = Length;
+	Env->m_Allocator = this;
+	return Env + 1;
 }
 
 void *LWAllocator_LocalHeap::DeallocateMemory(void *Memory){
 	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment *)((int8_t*)Memory - sizeof(LWAllocator_LocalHeapEnvironment));
-	LWAllocator_LocalHeapEnvironment *Left = Env->m_Prev && Env->m_Prev->m_Size != 0 ? Env->m_Prev : Env;
-	LWAllocator_LocalHeapEnvironment *Right = Env->m_Next && Env->m_Next->m_Size!=0 ? Env->m_Next->m_Next : Env->m_Next;
-	
-	//Updated allocated bytes!
-	uintptr_t MemSize = 0;
-	if (!Env->m_Next) MemSize = ((uintptr_t)(m_Buffer + m_BufferSize) - (uintptr_t)Env) - sizeof(LWAllocator_LocalHeapEnvironment);
-	else MemSize = (uintptr_t)((int8_t*)Env->m_Next - (int8_t*)Env) - sizeof(LWAllocator_LocalHeapEnvironment);
-	m_AllocatedBytes -= (uint32_t)MemSize;
-
-	Left->m_Next = Right;
-	if (Right){
-		Right->m_Prev = Left;
-		Left->m_Size = (uint32_t)((uintptr_t)((int8_t*)Right - (int8_t*)Left) - sizeof(LWAllocator_LocalHeapEnvironment));
-	}else Left->m_Size = (uint32_t)((uintptr_t)((m_Buffer + m_BufferSize) - (uint8_t*)Left) - sizeof(LWAllocator_LocalHeapEnvironment));
-
-
-	if ((int8_t*)Left < m_NextAllocationUnit) m_NextAllocationUnit = Left;
+	uint32_t Offset = (uint32_t)((uint8_t*)Env - m_Buffer);
+	uint32_t BlockSize = LWAllocator_LocalHeapBlockSize(Env->m_Size);
+	ThreadCache *Cache = GetThreadCache();
+	if (Cache) {
+		//m_BlockSize shares it's word with flags that neighbors change under the lock, so the cached size class is derived from the requested size instead, the block may be slightly larger than it's class.
+		uint32_t CacheClass = (BlockSize >> AlignmentBits) - 1;
+		if (CacheClass < CacheClassCount && Cache->m_Counts[CacheClass] < CacheDepth) {
+			Cache->m_Blocks[CacheClass][Cache->m_Counts[CacheClass]++] = Offset;
+			Cache->m_CachedBytes.store(Cache->m_CachedBytes.load(std::memory_order_relaxed) + BlockSize, std::memory_order_relaxed);
+			return nullptr;
+		}
+	}
+	Lock();
+	m_AllocatedBytes -= BlockSize;
+	ReleaseBlock(Offset);
+	Unlock();
 	return nullptr;
 }
 
@@ -60,15 +150,148 @@ void *LWAllocator_LocalHeap::DeallocateBytes(void *){
 	return nullptr;
 }
 
-LWAllocator_LocalHeap::LWAllocator_LocalHeap(uint32_t BufferSize) : LWAllocator(), m_Buffer(new uint8_t[BufferSize]), m_BufferSize(BufferSize){
-	m_NextAllocationUnit = (LWAllocator_LocalHeapEnvironment*)m_Buffer;
-	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)m_NextAllocationUnit;
-	Env->m_Next = nullptr;
-	Env->m_Prev = nullptr;
-	Env->m_Size = m_BufferSize - sizeof(LWAllocator_LocalHeapEnvironment);
-	Env->m_Allocator = this;
+uint32_t LWAllocator_LocalHeap::TakeBlock(uint32_t BlockSize) {
+	uint32_t FirstLevel = 0;
+	uint32_t SecondLevel = 0;
+	//Round the request up to the next list boundary so any block in the found list is large enough.
+	uint32_t SearchSize = BlockSize;
+	if (SearchSize >= (1u << FirstLevelShift)) {
+		uint32_t Round = (1u << (LWAllocator_LocalHeapHighBit(SearchSize) - SecondLevelBits)) - 1;
+		if (SearchSize + Round < SearchSize) return LWAllocator_LocalHeapNull;
+		SearchSize += Round;
+	}
+	LWAllocator_LocalHeapMapping(SearchSize, FirstLevel, SecondLevel);
+	if (FirstLevel >= FirstLevelCount) return LWAllocator_LocalHeapNull;
+	uint32_t SecondMap = m_SecondLevelMap[FirstLevel] & (~0u << SecondLevel);
+	if (!SecondMap) {
+		uint32_t FirstMap = FirstLevel + 1 < 32 ? m_FirstLevelMap & (~0u << (FirstLevel + 1)) : 0;
+		if (!FirstMap) return LWAllocator_LocalHeapNull;
+		FirstLevel = LWAllocator_LocalHeapLowBit(FirstMap);
+		SecondMap = m_SecondLevelMap[FirstLevel];
+	}
+	SecondLevel = LWAllocator_LocalHeapLowBit(SecondMap);
+	uint32_t Offset = m_FreeLists[FirstLevel][SecondLevel];
+	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset);
+	uint32_t FreeSize = Env->m_BlockSize&LWAllocator_LocalHeapSizeMask;
+	RemoveFree(Offset, FreeSize);
+	if (FreeSize - BlockSize >= MinBlockSize) {
+		uint32_t Remain = FreeSize - BlockSize;
+		LWAllocator_LocalHeapEnvironment *RemainEnv = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset + BlockSize);
+		RemainEnv->m_BlockSize = Remain | LWAllocator_LocalHeapFree;
+		*(uint32_t*)(m_Buffer + Offset + FreeSize - sizeof(uint32_t)) = Remain;
+		InsertFree(Offset + BlockSize, Remain);
+	} else {
+		BlockSize = FreeSize;
+		((LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset + FreeSize))->m_BlockSize &= ~LWAllocator_LocalHeapPrevFree;
+	}
+	Env->m_BlockSize = BlockSize | (Env->m_BlockSize&LWAllocator_LocalHeapPrevFree);
+	return Offset;
+}
+
+void LWAllocator_LocalHeap::ReleaseBlock(uint32_t Offset) {
+	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset);
+	uint32_t BlockSize = Env->m_BlockSize&LWAllocator_LocalHeapSizeMask;
+	LWAllocator_LocalHeapEnvironment *Next = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset + BlockSize);
+	if (Next->m_BlockSize&LWAllocator_LocalHeapFree) {
+		uint32_t NextSize = Next->m_BlockSize&LWAllocator_LocalHeapSizeMask;
+		RemoveFree(Offset + BlockSize, NextSize);
+		BlockSize += NextSize;
+	}
+	if (Env->m_BlockSize&LWAllocator_LocalHeapPrevFree) {
+		uint32_t PrevSize = *(uint32_t*)(m_Buffer + Offset - sizeof(uint32_t));
+		Offset -= PrevSize;
+		RemoveFree(Offset, PrevSize);
+		BlockSize += PrevSize;
+		Env = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset);
+	}
+	Env->m_BlockSize = BlockSize | LWAllocator_LocalHeapFree;
+	*(uint32_t*)(m_Buffer + Offset + BlockSize - sizeof(uint32_t)) = BlockSize;
+	((LWAllocator_LocalHeapEnvironment*)(m_Buffer + Offset + BlockSize))->m_BlockSize |= LWAllocator_LocalHeapPrevFree;
+	InsertFree(Offset, BlockSize);
+}
+
+void LWAllocator_LocalHeap::InsertFree(uint32_t Offset, uint32_t BlockSize) {
+	uint32_t FirstLevel = 0;
+	uint32_t SecondLevel = 0;
+	LWAllocator_LocalHeapMapping(BlockSize, FirstLevel, SecondLevel);
+	uint32_t Head = m_FreeLists[FirstLevel][SecondLevel];
+	LWAllocator_LocalHeapFreeLinks *Links = (LWAllocator_LocalHeapFreeLinks*)(m_Buffer + Offset + sizeof(LWAllocator_LocalHeapEnvironment));
+	Links->m_Next = Head;
+	Links->m_Prev = LWAllocator_LocalHeapNull;
+	if (Head != LWAllocator_LocalHeapNull) ((LWAllocator_LocalHeapFreeLinks*)(m_Buffer + Head + sizeof(LWAllocator_LocalHeapEnvironment)))->m_Prev = Offset;
+	m_FreeLists[FirstLevel][SecondLevel] = Offset;
+	m_FirstLevelMap |= 1u << FirstLevel;
+	m_SecondLevelMap[FirstLevel] |= 1u << SecondLevel;
+}
+
+void LWAllocator_LocalHeap::RemoveFree(uint32_t Offset, uint32_t BlockSize) {
+	uint32_t FirstLevel = 0;
+	uint32_t SecondLevel = 0;
+	LWAllocator_LocalHeapMapping(BlockSize, FirstLevel, SecondLevel);
+	LWAllocator_LocalHeapFreeLinks *Links = (LWAllocator_LocalHeapFreeLinks*)(m_Buffer + Offset + sizeof(LWAllocator_LocalHeapEnvironment));
+	if (Links->m_Next != LWAllocator_LocalHeapNull) ((LWAllocator_LocalHeapFreeLinks*)(m_Buffer + Links->m_Next + sizeof(LWAllocator_LocalHeapEnvironment)))->m_Prev = Links->m_Prev;
+	if (Links->m_Prev != LWAllocator_LocalHeapNull) ((LWAllocator_LocalHeapFreeLinks*)(m_Buffer + Links->m_Prev + sizeof(LWAllocator_LocalHeapEnvironment)))->m_Next = Links->m_Next;
+	else {
+		m_FreeLists[FirstLevel][SecondLevel] = Links->m_Next;
+		if (Links->m_Next == LWAllocator_LocalHeapNull) {
+			m_SecondLevelMap[FirstLevel] &= ~(1u << SecondLevel);
+			if (!m_SecondLevelMap[FirstLevel]) m_FirstLevelMap &= ~(1u << FirstLevel);
+		}
+	}
+}
+
+void LWAllocator_LocalHeap::ReleaseCache(ThreadCache *Cache) {
+	for (uint32_t i = 0; i < CacheClassCount; i++) {
+		for (uint32_t n = 0; n < Cache->m_Counts[i]; n++) {
+			m_AllocatedBytes -= LWAllocator_LocalHeapBlockSize(((LWAllocator_LocalHeapEnvironment*)(m_Buffer + Cache->m_Blocks[i][n]))->m_Size);
+			ReleaseBlock(Cache->m_Blocks[i][n]);
+		}
+		Cache->m_Counts[i] = 0;
+	}
+	Cache->m_CachedBytes.store(0, std::memory_order_relaxed);
+}
+
+LWAllocator_LocalHeap::ThreadCache *LWAllocator_LocalHeap::GetThreadCache(void) {
+	if (!(m_Flags&PerThreadCache)) return nullptr;
+	uint32_t Index = GetThreadSlot();
+	if (Index >= MaxThreadSlots) return nullptr;
+	ThreadCache *Cache = m_Caches[Index].load(std::memory_order_acquire);
+	if (Cache) return Cache;
+	Cache = new ThreadCache();
+	std::fill(Cache->m_Counts, Cache->m_Counts + CacheClassCount, 0);
+	Cache->m_CachedBytes.store(0);
+	m_Caches[Index].store(Cache, std::memory_order_release);
+	return Cache;
+}
+
+void LWAllocator_LocalHeap::Lock(void) {
+	while (m_Lock.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+}
+
+void LWAllocator_LocalHeap::Unlock(void) {
+	m_Lock.clear(std::memory_order_release);
+}
+
+LWAllocator_LocalHeap::LWAllocator_LocalHeap(uint32_t BufferSize, uint32_t Flags) : LWAllocator(), m_Buffer(new uint8_t[BufferSize]), m_BufferSize(BufferSize&LWAllocator_LocalHeapSizeMask), m_Flags(Flags){
+	for (uint32_t i = 0; i < FirstLevelCount; i++) {
+		m_SecondLevelMap[i] = 0;
+		for (uint32_t n = 0; n < SecondLevelCount; n++) m_FreeLists[i][n] = LWAllocator_LocalHeapNull;
+	}
+	for (uint32_t i = 0; i < MaxThreadSlots; i++) m_Caches[i].store(nullptr);
+	//The last Alignment bytes hold a permanently used sentinel header so the final block always has a next block to check.
+	if (m_BufferSize < MinBlockSize + sizeof(LWAllocator_LocalHeapEnvironment)) return;
+	uint32_t BlockSize = m_BufferSize - sizeof(LWAllocator_LocalHeapEnvironment);
+	LWAllocator_LocalHeapEnvironment *Sentinel = (LWAllocator_LocalHeapEnvironment*)(m_Buffer + BlockSize);
+	Sentinel->m_BlockSize = LWAllocator_LocalHeapPrevFree;
+	Sentinel->m_Size = 0;
+	Sentinel->m_Allocator = this;
+	LWAllocator_LocalHeapEnvironment *Env = (LWAllocator_LocalHeapEnvironment*)m_Buffer;
+	Env->m_BlockSize = BlockSize | LWAllocator_LocalHeapFree;
+	*(uint32_t*)(m_Buffer + BlockSize - sizeof(uint32_t)) = BlockSize;
+	InsertFree(0, BlockSize);
 }
 
 LWAllocator_LocalHeap::~LWAllocator_LocalHeap(){
+	for (uint32_t i = 0; i < MaxThreadSlots; i++) delete m_Caches[i].load();
 	delete[] m_Buffer;
-}
\ No newline at end of file
+}
@@ -0,0 +1,196 @@
+#include "LWCore/LWAllocators/LWAllocator_Pool.h"
+#include <cstdlib>
+#include <algorithm>
+
+/*! \cond */
+struct alignas(16) LWAllocator_PoolEnvironment {
+	uint32_t m_SizeClass;
+	uint32_t m_Size;
+	alignas(8) LWAllocator *m_Allocator;
+};
+/*! \endcond */
+
+uint32_t LWAllocator_Pool::GetSizeClass(uint32_t Size) {
+	if (Size <= SmallClassSize) return Size ? (Size - 1) / MinClassSize : 0;
+	if (Size > MaxClassSize) return SizeClassCount;
+	uint32_t Bit = 8;
+	while ((1u << (Bit + 1)) < Size) Bit++;
+	return SmallClassCount + (Bit - 8) * 4 + ((Size - 1 - (1u << Bit)) >> (Bit - 2));
+}
+
+uint32_t LWAllocator_Pool::GetClassSize(uint32_t SizeClass) {
+	if (SizeClass < SmallClassCount) return (SizeClass + 1)*MinClassSize;
+	uint32_t Bit = 8 + (SizeClass - SmallClassCount) / 4;
+	uint32_t Step = (SizeClass - SmallClassCount) % 4;
+	return (1u << Bit) + (Step + 1)*(1u << (Bit - 2));
+}
+
+uint32_t LWAllocator_Pool::GetBatchCount(uint32_t SizeClass) {
+	return std::min<uint32_t>(std::max<uint32_t>((SlabSize / 4) / GetClassSize(SizeClass), 2), MaxBatchCount);
+}
+
+uint32_t LWAllocator_Pool::GetAllocatedBytes(void) {
+	int64_t Total = m_SharedAllocatedBytes.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < MaxThreadCaches; i++) {
+		ThreadCache *Cache = m_Caches[i].load(std::memory_order_acquire);
+		if (Cache) Total += Cache->m_AllocatedBytes.load(std::memory_order_relaxed);
+	}
+	return (uint32_t)Total;
+}
+
+LWAllocator_Pool &LWAllocator_Pool::FlushThreadCache(void) {
+	ThreadCache *Cache = GetThreadCache();
+	if (!Cache) return *this;
+	for (uint32_t i = 0; i < SizeClassCount; i++) {
+		Block *Head = Cache->m_FreeLists[i];
+		if (!Head) continue;
+		Block *Tail = Head;
+		while (Tail->m_Next) Tail = Tail->m_Next;
+		ReleaseBlocks(i, Head, Tail, Cache->m_FreeCounts[i]);
+		Cache->m_FreeLists[i] = nullptr;
+		Cache->m_FreeCounts[i] = 0;
+	}
+	return *this;
+}
+
+void *LWAllocator_Pool::AllocateMemory(uint32_t Length) {
+	uint32_t Total = Length + sizeof(LWAllocator_PoolEnvironment);
+	uint32_t SizeClass = GetSizeClass(Total);
+	LWAllocator_PoolEnvironment *Env = nullptr;
+	if (SizeClass == SizeClassCount) {
+		Env = (LWAllocator_PoolEnvironment*)malloc(Total);
+		if (!Env) return nullptr;
+		m_SharedAllocatedBytes.fetch_add(Total, std::memory_order_relaxed);
+	} else {
+		ThreadCache *Cache = GetThreadCache();
+		Block *B = nullptr;
+		if (Cache) {
+			if (!Cache->m_FreeLists[SizeClass]) Cache->m_FreeCounts[SizeClass] = FetchBlocks(SizeClass, Cache->m_FreeLists[SizeClass], GetBatchCount(SizeClass));
+			B = Cache->m_FreeLists[SizeClass];
+			if (!B) return nullptr;
+			Cache->m_FreeLists[SizeClass] = B->m_Next;
+			Cache->m_FreeCounts[SizeClass]--;
+			Cache->m_AllocatedBytes.store(Cache->m_AllocatedBytes.load(std::memory_order_relaxed) + Total, std::memory_order_relaxed);
+		} else {
+			if (!FetchBlocks(SizeClass, B, 1)) return nullptr;
+			m_SharedAllocatedBytes.fetch_add(Total, std::memory_order_relaxed);
+		}
+		Env = (LWAllocator_PoolEnvironment*)B;
+	}
+	Env->m_SizeClass = SizeClass;
+	Env->m_Size = Length;
+	Env->m_Allocator = this;
+	return ((int8_t*)Env) + sizeof(LWAllocator_PoolEnvironment);
+}
+
+void *LWAllocator_Pool::DeallocateMemory(void *Memory) {
+	LWAllocator_PoolEnvironment *Env = (LWAllocator_PoolEnvironment*)(((int8_t*)Memory) - sizeof(LWAllocator_PoolEnvironment));
+	uint32_t SizeClass = Env->m_SizeClass;
+	uint32_t Total = Env->m_Size + sizeof(LWAllocator_PoolEnvironment);
+	if (SizeClass == SizeClassCount) {
+		m_SharedAllocatedBytes.fetch_sub(Total, std::memory_order_relaxed);
+		free(Env);
+		return nullptr;
+	}
+	Block *B = (Block*)Env;
+	ThreadCache *Cache = GetThreadCache();
+	if (!Cache) {
+		m_SharedAllocatedBytes.fetch_sub(Total, std::memory_order_relaxed);
+		B->m_Next = nullptr;
+		ReleaseBlocks(SizeClass, B, B, 1);
+		return nullptr;
+	}
+	Cache->m_AllocatedBytes.store(Cache->m_AllocatedBytes.load(std::memory_order_relaxed) - Total, std::memory_order_relaxed);
+	B->m_Next = Cache->m_FreeLists[SizeClass];
+	Cache->m_FreeLists[SizeClass] = B;
+	uint32_t BatchCount = GetBatchCount(SizeClass);
+	if (++Cache->m_FreeCounts[SizeClass] <= BatchCount * 2) return nullptr;
+	//Cache has overflowed, hand a batch back to the depot so other threads can use them.
+	Block *Tail = B;
+	for (uint32_t i = 1; i < BatchCount; i++) Tail = Tail->m_Next;
+	Cache->m_FreeLists[SizeClass] = Tail->m_Next;
+	Cache->m_FreeCounts[SizeClass] -= BatchCount;
+	Tail->m_Next = nullptr;
+	ReleaseBlocks(SizeClass, B, Tail, BatchCount);
+	return nullptr;
+}
+
+void *LWAllocator_Pool::AllocateBytes(uint32_t) {
+	return nullptr;
+}
+
+void *LWAllocator_Pool::DeallocateBytes(void *) {
+	return nullptr;
+}
+
+LWAllocator_Pool::ThreadCache *LWAllocator_Pool::GetThreadCache(void) {
+	uint32_t Index = GetThreadSlot();
+	if (Index >= MaxThreadCaches) return nullptr;
+	ThreadCache *Cache = m_Caches[Index].load(std::memory_order_acquire);
+	if (Cache) return Cache;
+	Cache = new ThreadCache();
+	std::fill(Cache->m_FreeLists, Cache->m_FreeLists + SizeClassCount, nullptr);
+	std::fill(Cache->m_FreeCounts, Cache->m_FreeCounts + SizeClassCount, 0);
+	Cache->m_AllocatedBytes.store(0);
+	m_Caches[Index].store(Cache, std::memory_order_release);
+	return Cache;
+}
+
+uint32_t LWAllocator_Pool::FetchBlocks(uint32_t SizeClass, Block *&List, uint32_t Count) {
+	Depot &D = m_Depots[SizeClass];
+	std::lock_guard<std::mutex> Lock(D.m_Lock);
+	if (!D.m_FreeList) {
+		uint32_t ClassSize = GetClassSize(SizeClass);
+		uint32_t Size = std::max<uint32_t>(SlabSize, ClassSize*GetBatchCount(SizeClass));
+		uint32_t BlockCount = Size / ClassSize;
+		//The slab is prefixed with 16 bytes to link it into m_Slabs while keeping blocks 16 byte aligned.
+		int8_t *Slab = (int8_t*)malloc(Size + 16);
+		if (!Slab) return 0;
+		{
+			std::lock_guard<std::mutex> SlabLock(m_SlabLock);
+			*(void**)Slab = m_Slabs;
+			m_Slabs = Slab;
+		}
+		Block *Prev = nullptr;
+		for (uint32_t i = BlockCount; i > 0; i--) {
+			Block *B = (Block*)(Slab + 16 + (i - 1)*ClassSize);
+			B->m_Next = Prev;
+			Prev = B;
+		}
+		D.m_FreeList = Prev;
+		D.m_FreeCount = BlockCount;
+	}
+	Block *Head = D.m_FreeList;
+	Block *Tail = Head;
+	uint32_t n = 1;
+	for (; n < Count && Tail->m_Next; n++) Tail = Tail->m_Next;
+	D.m_FreeList = Tail->m_Next;
+	D.m_FreeCount -= n;
+	Tail->m_Next = nullptr;
+	List = Head;
+	return n;
+}
+
+LWAllocator_Pool &LWAllocator_Pool::ReleaseBlocks(uint32_t SizeClass, Block *List, Block *Tail, uint32_t Count) {
+	Depot &D = m_Depots[SizeClass];
+	std::lock_guard<std::mutex> Lock(D.m_Lock);
+	Tail->m_Next = D.m_FreeList;
+	D.m_FreeList = List;
+	D.m_FreeCount += Count;
+	return *this;
+}
+
+LWAllocator_Pool::LWAllocator_Pool() : LWAllocator() {
+	for (uint32_t i = 0; i < MaxThreadCaches; i++) m_Caches[i].store(nullptr);
+	m_SharedAllocatedBytes.store(0);
+}
+
+LWAllocator_Pool::~LWAllocator_Pool() {
+	for (uint32_t i = 0; i < MaxThreadCaches; i++) delete m_Caches[i].load();
+	void *Slab = m_Slabs;
+	while (Slab) {
+		void *Next = *(void**)Slab;
+		free(Slab);
+		Slab = Next;
+	}
+}
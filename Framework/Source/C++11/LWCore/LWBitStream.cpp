@@ -0,0 +1,172 @@
+#include "LWCore/LWBitStream.h"
+#include "LWCore/LWByteBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint32_t LWBitWriter::GetBitsRequired(uint32_t Range) {
+	uint32_t Bits = 0;
+	for (; Range; Range >>= 1) Bits++;
+	return Bits;
+}
+
+uint32_t LWBitWriter::GetQuantizedBits(float Min, float Max, float Resolution) {
+	return GetBitsRequired(Quantize(Max, Min, Max, Resolution));
+}
+
+uint32_t LWBitWriter::Quantize(float Value, float Min, float Max, float Resolution) {
+	uint32_t Steps = (uint32_t)ceilf((Max - Min) / Resolution);
+	Value = std::min<float>(std::max<float>(Value, Min), Max);
+	return std::min<uint32_t>((uint32_t)floorf((Value - Min) / Resolution + 0.5f), Steps);
+}
+
+float LWBitWriter::Dequantize(uint32_t Value, float Min, float Max, float Resolution) {
+	return std::min<float>(Min + (float)Value*Resolution, Max);
+}
+
+uint64_t LWBitWriter::ZigZag(int64_t Value) {
+	return ((uint64_t)Value << 1) ^ (uint64_t)(Value >> 63);
+}
+
+int64_t LWBitWriter::UnZigZag(uint64_t Value) {
+	return (int64_t)(Value >> 1) ^ -(int64_t)(Value & 1);
+}
+
+uint32_t LWBitWriter::GetVarIntBits(uint64_t Value) {
+	uint32_t Bits = 8;
+	for (Value >>= 7; Value; Value >>= 7) Bits += 8;
+	return Bits;
+}
+
+LWBitWriter &LWBitWriter::WriteBits(uint32_t Value, uint32_t Bits) {
+	if (!Bits) return *this;
+	uint64_t Mask = (1ull << Bits) - 1;
+	m_Scratch |= ((uint64_t)Value & Mask) << m_ScratchBits;
+	m_ScratchBits += Bits;
+	m_BitsWritten += Bits;
+	WriteScratch();
+	return *this;
+}
+
+LWBitWriter &LWBitWriter::WriteBool(bool Value) {
+	return WriteBits(Value ? 1 : 0, 1);
+}
+
+LWBitWriter &LWBitWriter::WriteBounded(int32_t Value, int32_t Min, int32_t Max) {
+	Value = std::min<int32_t>(std::max<int32_t>(Value, Min), Max);
+	return WriteBits((uint32_t)((int64_t)Value - Min), GetBitsRequired((uint32_t)((int64_t)Max - Min)));
+}
+
+LWBitWriter &LWBitWriter::WriteVarInt(uint64_t Value) {
+	for (; Value >= 0x80; Value >>= 7) WriteBits((uint32_t)(Value & 0x7F) | 0x80, 8);
+	return WriteBits((uint32_t)Value, 8);
+}
+
+LWBitWriter &LWBitWriter::WriteSignedVarInt(int64_t Value) {
+	return WriteVarInt(ZigZag(Value));
+}
+
+LWBitWriter &LWBitWriter::WriteFloat(float Value) {
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(uint32_t));
+	return WriteBits(Bits, 32);
+}
+
+LWBitWriter &LWBitWriter::WriteQuantized(float Value, float Min, float Max, float Resolution) {
+	return WriteBits(Quantize(Value, Min, Max, Resolution), GetQuantizedBits(Min, Max, Resolution));
+}
+
+uint32_t LWBitWriter::Flush(void) {
+	if (m_ScratchBits) {
+		m_ScratchBits = 8;
+		WriteScratch();
+	}
+	m_ScratchBits = 0;
+	m_Scratch = 0;
+	return m_BytesWritten;
+}
+
+uint32_t LWBitWriter::GetBitsWritten(void) const {
+	return m_BitsWritten;
+}
+
+bool LWBitWriter::isOverflowed(void) const {
+	return m_Overflowed;
+}
+
+void LWBitWriter::WriteScratch(void) {
+	for (; m_ScratchBits >= 8; m_ScratchBits -= 8, m_Scratch >>= 8) {
+		if (m_Buffer->GetPosition() + 1 > m_Buffer->GetBufferSize()) {
+			m_Overflowed = true;
+			continue;
+		}
+		m_BytesWritten += m_Buffer->Write<uint8_t>((uint8_t)m_Scratch);
+	}
+}
+
+LWBitWriter::LWBitWriter(LWByteBuffer &Buffer) : m_Buffer(&Buffer) {}
+
+uint32_t LWBitReader::ReadBits(uint32_t Bits) {
+	if (!Bits) return 0;
+	while (m_ScratchBits < Bits) {
+		if (m_Buffer->GetPosition() >= m_Buffer->GetBufferSize()) m_Overflowed = true;
+		else m_Scratch |= (uint64_t)m_Buffer->Read<uint8_t>() << m_ScratchBits;
+		m_ScratchBits += 8;
+	}
+	uint32_t Value = (uint32_t)(m_Scratch & ((1ull << Bits) - 1));
+	m_Scratch >>= Bits;
+	m_ScratchBits -= Bits;
+	m_BitsRead += Bits;
+	return Value;
+}
+
+bool LWBitReader::ReadBool(void) {
+	return ReadBits(1) != 0;
+}
+
+int32_t LWBitReader::ReadBounded(int32_t Min, int32_t Max) {
+	int64_t Value = (int64_t)Min + ReadBits(LWBitWriter::GetBitsRequired((uint32_t)((int64_t)Max - Min)));
+	return (int32_t)std::min<int64_t>(Value, Max);
+}
+
+uint64_t LWBitReader::ReadVarInt(void) {
+	uint64_t Value = 0;
+	for (uint32_t Shift = 0; Shift < 64; Shift += 7) {
+		uint32_t Byte = ReadBits(8);
+		Value |= (uint64_t)(Byte & 0x7F) << Shift;
+		if (!(Byte & 0x80)) break;
+	}
+	return Value;
+}
+
+int64_t LWBitReader::ReadSignedVarInt(void) {
+	return LWBitWriter::UnZigZag(ReadVarInt());
+}
+
+float LWBitReader::ReadFloat(void) {
+	uint32_t Bits = ReadBits(32);
+	float Value;
+	memcpy(&Value, &Bits, sizeof(float));
+	return Value;
+}
+
+float LWBitReader::ReadQuantized(float Min, float Max, float Resolution) {
+	return LWBitWriter::Dequantize(ReadBits(LWBitWriter::GetQuantizedBits(Min, Max, Resolution)), Min, Max, Resolution);
+}
+
+LWBitReader &LWBitReader::AlignToByte(void) {
+	m_BitsRead += m_ScratchBits;
+	m_Scratch = 0;
+	m_ScratchBits = 0;
+	return *this;
+}
+
+uint32_t LWBitReader::GetBitsRead(void) const {
+	return m_BitsRead;
+}
+
+bool LWBitReader::isOverflowed(void) const {
+	return m_Overflowed;
+}
+
+LWBitReader::LWBitReader(LWByteBuffer &Buffer) : m_Buffer(&Buffer) {}
\ No newline at end of file
@@ -359,6 +359,16 @@ uint32_t LWText::Copy(const char *Pos, uint32_t n, char *Buffer, uint32_t Buffer
 	return Copy((const uint8_t*)Pos, n, (uint8_t*)Buffer, BufferLen);
 }
 
+uint32_t LWText::Appendf(char *Buffer, uint32_t BufferLen, uint32_t &Position, const char *Fmt, ...) {
+	uint32_t Remain = Position < BufferLen ? BufferLen - Position : 0;
+	va_list lst;
+	va_start(lst, Fmt);
+	int32_t Len = vsnprintf(Remain ? Buffer + Position : nullptr, Remain, Fmt, lst);
+	va_end(lst);
+	if (Len > 0) Position += (uint32_t)Len;
+	return Position;
+}
+
 const uint8_t *LWText::FirstString(const uint8_t *Position, const uint8_t *SubString){
 	for(const uint8_t *P = Position; P; P++){
 		bool Valid = true;
@@ -6,6 +6,7 @@ LWPacket *LWPacket::Deserialize(LWByteBuffer *Buffer, uint32_t DeserializeType,
 	LWPacket *Pack = Packet ? Packet : Allocator.Allocate<LWPacket>(0, nullptr, DeserializeType|LWPacketID, 0);
 	Pack->SetPacketID(Buffer->Read<uint32_t>());
 	Pack->SetFlag(Buffer->Read<uint32_t>());
+	if (Pack->GetFlag()&Ack) Pack->SetPacketAckID(Buffer->Read<uint32_t>());
 	return Pack;
 }
 
@@ -13,6 +14,7 @@ uint32_t LWPacket::Serialize(LWByteBuffer *Buffer, LWPacketManager *){
 	uint32_t o = 0;
 	o += Buffer->Write(m_PacketID);
 	o += Buffer->Write(m_Flag);
+	if (m_Flag&Ack) o += Buffer->Write(m_PacketAckID);
 	return o;
 }
 
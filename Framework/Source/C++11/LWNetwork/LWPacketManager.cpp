@@ -2,9 +2,24 @@
 #include "LWCore/LWByteBuffer.h"
 #include "LWNetwork/LWPacketManager.h"
 #include "LWNetwork/LWPacket.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
+//returns true if sequence a is more recent than b, accounting for wrap around.
+inline bool SequenceGreater(uint16_t a, uint16_t b){
+	return (int16_t)(uint16_t)(a - b) > 0;
+}
+
+bool LWPacketChannel::CanSend(void) const{
+	return m_InFlight < (uint32_t)m_CongestionWindow && (uint16_t)(m_NextMessageID - m_OldestUnacked) < Window;
+}
+
+LWPacketChannel::LWPacketChannel(void *Client) : m_Client(Client){
+	std::fill(m_Ordered, m_Ordered + Window, nullptr);
+	std::fill(m_Received, m_Received + Window, 0);
+}
+
 uint32_t LWPacketManager::SerializePacket(LWPacket *Packet, char *Buffer, uint32_t BufferLen){
 	LWByteBuffer ByteBuf((int8_t*)Buffer, BufferLen, LWByteBuffer::Network|LWByteBuffer::BufferNotOwned);
 	uint32_t o = sizeof(LWPacketRawHeader);
@@ -13,15 +28,57 @@ uint32_t LWPacketManager::SerializePacket(LWPacket *Packet, char *Buffer, uint32
 		o += ByteBuf.Write(C->GetRawType());
 		o += C->Serialize(&ByteBuf, this);
 	}
+	uint16_t Sequence = 0;
+	uint16_t Ack = 0;
+	uint32_t AckBits = 0;
+	if (Packet){
+		LWPacketChannel &C = FindChannel(Packet->GetClient());
+		Sequence = C.m_LocalSequence++;
+		LWPacketSent &S = C.m_Sent[Sequence%LWPacketChannel::Window];
+		S.m_SendTime = m_CurrentTime;
+		S.m_Sequence = Sequence;
+		S.m_MessageID = 0xFFFFFFFF;
+		if (Packet->GetFlag()&LWPacket::Ack){
+			uint32_t MessageID = Packet->GetPacketAckID();
+			if (C.m_Unacked[MessageID%LWPacketChannel::Window].m_Packet == Packet) S.m_MessageID = MessageID;
+		}
+		C.m_LastSendTime = m_CurrentTime;
+		C.m_AckPending = false;
+		Ack = C.m_RemoteSequence;
+		AckBits = C.m_HasRemote ? C.m_AckBits : 0;
+	}
 	ByteBuf.SetPosition(0);
 	ByteBuf.Write<uint32_t>(LWPacketManager::Header);
 	ByteBuf.Write(o);
+	ByteBuf.Write(Sequence);
+	ByteBuf.Write(Ack);
+	ByteBuf.Write(AckBits);
 	return o;
 }
 
-LWPacket *LWPacketManager::DeserializePacket(const char *Buffer, uint32_t BufferLen, void *Client, void *Source){
+LWPacket *LWPacketManager::DeserializePacket(const char *Buffer, uint32_t BufferLen, void *Client, void *Source, uint16_t *Sequence){
 	LWByteBuffer ByteBuf((const int8_t*)Buffer, BufferLen, LWByteBuffer::Network | LWByteBuffer::BufferNotOwned);
-	ByteBuf.OffsetPosition(sizeof(LWPacketRawHeader)); //offset past the header.
+	ByteBuf.OffsetPosition(sizeof(uint32_t) * 2); //offset past the header and size.
+	uint16_t Seq = ByteBuf.Read<uint16_t>();
+	uint16_t Ack = ByteBuf.Read<uint16_t>();
+	uint32_t AckBits = ByteBuf.Read<uint32_t>();
+	LWPacketChannel &Chan = FindChannel(Client);
+	if (!Chan.m_HasRemote){
+		Chan.m_RemoteSequence = Seq;
+		Chan.m_AckBits = 1;
+		Chan.m_HasRemote = true;
+	}else if (SequenceGreater(Seq, Chan.m_RemoteSequence)){
+		uint16_t Shift = Seq - Chan.m_RemoteSequence;
+		Chan.m_AckBits = (Shift >= 32 ? 0 : (Chan.m_AckBits << Shift)) | 1;
+		Chan.m_RemoteSequence = Seq;
+	}else{
+		uint16_t Diff = Chan.m_RemoteSequence - Seq;
+		if (Diff < 32) Chan.m_AckBits |= (1u << Diff);
+	}
+	for (uint32_t i = 0; i < 32 && AckBits; i++, AckBits >>= 1){
+		if (AckBits & 1) AckSequence(Chan, Ack - (uint16_t)i, i == 0);
+	}
+	if (Sequence) *Sequence = Seq;
 	LWPacket *F = nullptr;
 	LWPacket *C = nullptr;
 	while(!ByteBuf.EndOfBuffer()){
@@ -50,9 +107,10 @@ bool LWPacketManager::ProcessRawData(void *Client, void *Source, const char *Buf
 	Header.m_Header = ByteBuf.Read<uint32_t>();
 	Header.m_TotalSize = ByteBuf.Read<uint32_t>();
 	uint32_t ReadData = 0;
+	uint16_t Sequence = 0;
 	LWPacket *Pack = nullptr;
 	if (Header.m_Header == LWPacketManager::Header){
-		if (Header.m_TotalSize <= BufferLen) Pack = DeserializePacket(Buffer, BufferLen, Client, Source);
+		if (Header.m_TotalSize <= BufferLen) Pack = DeserializePacket(Buffer, BufferLen, Client, Source, &Sequence);
 		else if (m_PacketBufferPosition + Header.m_TotalSize < m_PacketBufferLength) {
 			BufferHeader = (LWPacketHeader *)(m_PacketBuffer + m_PacketBufferPosition);
 			BufferHeader->m_Client = Client;
@@ -71,7 +129,7 @@ bool LWPacketManager::ProcessRawData(void *Client, void *Source, const char *Buf
 				memcpy(((char*)BufferHeader) + sizeof(LWPacketHeader) + BufferHeader->m_RecvSize, Buffer, sizeof(char)*ReadData);
 				BufferHeader->m_RecvSize += ReadData;
 				if(BufferHeader->m_RecvSize==BufferHeader->m_TotalSize){
-					Pack = DeserializePacket(((char*)BufferHeader) + sizeof(LWPacketHeader), BufferHeader->m_TotalSize, Client, Source);
+					Pack = DeserializePacket(((char*)BufferHeader) + sizeof(LWPacketHeader), BufferHeader->m_TotalSize, Client, Source, &Sequence);
 					uintptr_t Len = (uintptr_t)m_PacketBuffer + m_PacketBufferPosition - (uintptr_t)NextHeader;
 					m_PacketBufferPosition -= BufferHeader->m_TotalSize + sizeof(LWPacketHeader);
 					memcpy(BufferHeader, NextHeader, sizeof(char)*Len);
@@ -83,27 +141,7 @@ bool LWPacketManager::ProcessRawData(void *Client, void *Source, const char *Buf
 		}
 		if (!Pack) return false;
 	}
-	if (!Pack) return true;
-	if (Pack->GetType() == LWPacket::PacketAck){
-		for (uint32_t i = 0; i < m_OutPacketCount;i++){
-			if(m_OutPackets[i]->GetPacketAckID()==Pack->GetPacketID()){
-				for (LWPacket *C = m_OutPackets[i], *N = C->GetNext(); C; C = N, N = N ? N->GetNext() : N) LWAllocator::Destroy(C);
-				m_OutPackets[i] = m_OutPackets[m_OutPacketCount - 1];
-				m_OutPacketCount--;
-				break;
-			}
-		}
-	}else{
-		bool Result = false;
-		if (m_ReceivePacketFunction) Result = m_ReceivePacketFunction(Pack, this);
-		if (Pack->GetFlag()&LWPacket::Ack){
-			LWPacket *AckPack = m_PacketAllocator->Allocate<LWPacket>(Pack->GetPacketAckID(), Client, LWPacket::PacketAck, 0);
-			if(!PushOutPacket(AckPack))	LWAllocator::Destroy(AckPack); //if we failed to add our ack pack, then we'll have to try again later when the client resends the packet.
-		}
-		if (!Result){
-			for (LWPacket *C = Pack, *N = C->GetNext(); C; C = N, N = N ? N->GetNext() : N) LWAllocator::Destroy(C);
-		}
-	}
+	if (Pack) ReceivePacket(Pack, Client, Sequence);
 	return (ReadData==BufferLen)?true:ProcessRawData(Client, Source, Buffer+ReadData, BufferLen-ReadData);
 }
 
@@ -113,33 +151,76 @@ LWPacketManager &LWPacketManager::SetUserData(void *UserData){
 }
 
 LWPacketManager &LWPacketManager::Update(uint64_t lCurrentTime, uint64_t ClockResolution){
-	for (uint32_t i = 0; i < m_OutPacketCount;i++){
-		if(lCurrentTime >=m_OutPackets[i]->GetSendTime()){
-			bool Remove = (m_OutPackets[i]->GetFlag()&LWPacket::Ack) == 0;
-			m_OutPackets[i]->SetSendTime(lCurrentTime + ClockResolution*LWPacketManager::ResendFrequency);
-			if (m_SendPacketFunction){
-				bool Result = m_SendPacketFunction(m_OutPackets[i], this);
-				Remove = Remove ? Result : Remove;
+	m_CurrentTime = lCurrentTime;
+	m_ClockResolution = ClockResolution;
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < m_OutPacketCount; i++){ //count is re-read each pass as the send callback may push new packets.
+		LWPacket *P = m_OutPackets[i];
+		bool Keep = true;
+		if (P->GetFlag()&LWPacket::Ack){
+			LWPacketChannel &C = FindChannel(P->GetClient());
+			if (C.CanSend()){
+				uint16_t MessageID = C.m_NextMessageID++;
+				LWPacketReliable &R = C.m_Unacked[MessageID%LWPacketChannel::Window];
+				R.m_Packet = P;
+				R.m_ResendTime = lCurrentTime + GetResendTimeout(C);
+				R.m_ResendCount = 0;
+				P->SetPacketAckID(MessageID);
+				C.m_InFlight++;
+				if (m_SendPacketFunction) m_SendPacketFunction(P, this);
+				Keep = false;
+			}
+		}else if (lCurrentTime >= P->GetSendTime()){
+			P->SetSendTime(lCurrentTime + ClockResolution*LWPacketManager::ResendFrequency);
+			if (!m_SendPacketFunction || m_SendPacketFunction(P, this)){
+				DestroyPacket(P);
+				Keep = false;
 			}
-			if(Remove){
-				for (LWPacket *C = m_OutPackets[i], *N = C->GetNext(); C; C = N, N = N ? N->GetNext() : N) LWAllocator::Destroy(C);
-				m_OutPackets[i] = m_OutPackets[m_OutPacketCount - 1];
-				m_OutPacketCount--;
-				i--;
+		}
+		if (Keep) m_OutPackets[n++] = P;
+	}
+	m_OutPacketCount = n;
+	for (uint32_t i = 0; i < m_ChannelList.size(); i++){
+		LWPacketChannel &C = *m_ChannelList[i];
+		for (uint16_t id = C.m_OldestUnacked; id != C.m_NextMessageID; id++){
+			LWPacketReliable &R = C.m_Unacked[id%LWPacketChannel::Window];
+			if (!R.m_Packet || lCurrentTime < R.m_ResendTime) continue;
+			if (!C.m_HasRTT || lCurrentTime - C.m_LastLossTime >= C.m_SmoothedRTT){ //only back off once per round trip.
+				C.m_SlowStartThreshold = std::max<float>(C.m_CongestionWindow*0.5f, (float)LWPacketChannel::MinCongestionWindow);
+				C.m_CongestionWindow = C.m_SlowStartThreshold;
+				C.m_LastLossTime = lCurrentTime;
 			}
+			R.m_ResendCount++;
+			uint64_t Timeout = std::min<uint64_t>(GetResendTimeout(C) << std::min<uint32_t>(R.m_ResendCount, 5), ClockResolution*LWPacketManager::ResendFrequency);
+			R.m_ResendTime = lCurrentTime + Timeout;
+			if (m_SendPacketFunction) m_SendPacketFunction(R.m_Packet, this);
+		}
+		if (C.m_AckPending && lCurrentTime - C.m_LastSendTime >= ClockResolution*LWPacketManager::AckDelayMS / 1000){
+			LWPacket AckPack(0, C.m_Client, LWPacket::PacketAck, 0);
+			if (m_SendPacketFunction) m_SendPacketFunction(&AckPack, this);
+			C.m_AckPending = false;
 		}
 	}
 	return *this;
 }
 
 LWPacketManager &LWPacketManager::PurgeClient(void *Client){
+	uint32_t n = 0;
 	for (uint32_t i = 0; i < m_OutPacketCount;i++){
-		if(m_OutPackets[i]->GetClient()==Client){
-			for (LWPacket *C = m_OutPackets[i], *N = C->GetNext(); C; C = N, N = N ? N->GetNext() : N) LWAllocator::Destroy(C);
-			m_OutPackets[i] = m_OutPackets[m_OutPacketCount - 1];
-			m_OutPacketCount--;
-			i--;
+		if (m_OutPackets[i]->GetClient() == Client) DestroyPacket(m_OutPackets[i]);
+		else m_OutPackets[n++] = m_OutPackets[i];
+	}
+	m_OutPacketCount = n;
+	auto Iter = m_Channels.find(Client);
+	if (Iter != m_Channels.end()){
+		LWPacketChannel *C = Iter->second;
+		for (uint32_t i = 0; i < LWPacketChannel::Window; i++){
+			if (C->m_Unacked[i].m_Packet) DestroyPacket(C->m_Unacked[i].m_Packet);
+			if (C->m_Ordered[i]) DestroyPacket(C->m_Ordered[i]);
 		}
+		m_ChannelList.erase(std::find(m_ChannelList.begin(), m_ChannelList.end(), C));
+		m_Channels.erase(Iter);
+		LWAllocator::Destroy(C);
 	}
 	LWPacketHeader *BufferHeader = (LWPacketHeader*)m_PacketBuffer;
 	while((char*)BufferHeader!=m_PacketBuffer+m_PacketBufferPosition){
@@ -161,11 +242,20 @@ LWPacketManager &LWPacketManager::RegisterDeserialization(uint32_t TypeID, std::
 bool LWPacketManager::PushOutPacket(LWPacket *Packet){
 	if (m_OutPacketCount >= LWPacketManager::MaxOutPackets) return false;
 	m_OutPackets[m_OutPacketCount++] = Packet;
-	if (Packet->GetFlag()&LWPacket::Ack) Packet->SetPacketAckID(m_NextAckID++);
 	Packet->SetSendTime(0);
 	return true;
 }
 
+const LWPacketChannel *LWPacketManager::GetChannel(void *Client) const{
+	auto Iter = m_Channels.find(Client);
+	return Iter == m_Channels.end() ? nullptr : Iter->second;
+}
+
+uint64_t LWPacketManager::GetRoundTripTime(void *Client) const{
+	const LWPacketChannel *C = GetChannel(Client);
+	return C ? C->m_SmoothedRTT : 0;
+}
+
 void *LWPacketManager::GetUserData(void) const{
 	return m_UserData;
 }
@@ -174,13 +264,116 @@ LWAllocator &LWPacketManager::GetPacketAllocator(void) const{
 	return *m_PacketAllocator;
 }
 
+LWPacketChannel &LWPacketManager::FindChannel(void *Client){
+	auto Iter = m_Channels.find(Client);
+	if (Iter != m_Channels.end()) return *Iter->second;
+	LWPacketChannel *C = m_PacketAllocator->Allocate<LWPacketChannel>(Client);
+	m_Channels.emplace(Client, C);
+	m_ChannelList.push_back(C);
+	return *C;
+}
+
+uint64_t LWPacketManager::GetResendTimeout(const LWPacketChannel &Channel) const{
+	if (!Channel.m_HasRTT) return m_ClockResolution*LWPacketManager::InitialResendMS / 1000;
+	uint64_t Timeout = Channel.m_SmoothedRTT + Channel.m_RTTVariance * 4;
+	return std::min<uint64_t>(std::max<uint64_t>(Timeout, m_ClockResolution*LWPacketManager::MinResendMS / 1000), m_ClockResolution*LWPacketManager::ResendFrequency);
+}
+
+void LWPacketManager::AckSequence(LWPacketChannel &Channel, uint16_t Sequence, bool Measure){
+	LWPacketSent &S = Channel.m_Sent[Sequence%LWPacketChannel::Window];
+	if (S.m_Sequence != Sequence) return;
+	S.m_Sequence = 0xFFFFFFFF;
+	if (S.m_MessageID == 0xFFFFFFFF) return;
+	//only the newest datagram carrying a reliable message is acked promptly, older ones may only be acked once a later datagram is.
+	//every resend goes out under a new sequence, so each sample is unambiguous.
+	if (Measure){
+		uint64_t Sample = m_CurrentTime >= S.m_SendTime ? m_CurrentTime - S.m_SendTime : 0;
+		if (!Channel.m_HasRTT){
+			Channel.m_SmoothedRTT = Sample;
+			Channel.m_RTTVariance = Sample / 2;
+			Channel.m_HasRTT = true;
+		}else{
+			uint64_t Delta = Sample > Channel.m_SmoothedRTT ? Sample - Channel.m_SmoothedRTT : Channel.m_SmoothedRTT - Sample;
+			Channel.m_RTTVariance = (Channel.m_RTTVariance * 3 + Delta) / 4;
+			Channel.m_SmoothedRTT = (Channel.m_SmoothedRTT * 7 + Sample) / 8;
+		}
+	}
+	LWPacketReliable &R = Channel.m_Unacked[S.m_MessageID%LWPacketChannel::Window];
+	if (!R.m_Packet || R.m_Packet->GetPacketAckID() != S.m_MessageID) return;
+	DestroyPacket(R.m_Packet);
+	R.m_Packet = nullptr;
+	Channel.m_InFlight--;
+	if (Channel.m_CongestionWindow < Channel.m_SlowStartThreshold) Channel.m_CongestionWindow += 1.0f;
+	else Channel.m_CongestionWindow += 1.0f / Channel.m_CongestionWindow;
+	Channel.m_CongestionWindow = std::min<float>(Channel.m_CongestionWindow, (float)LWPacketChannel::Window);
+	while (Channel.m_OldestUnacked != Channel.m_NextMessageID && !Channel.m_Unacked[Channel.m_OldestUnacked%LWPacketChannel::Window].m_Packet) Channel.m_OldestUnacked++;
+}
+
+void LWPacketManager::ReceivePacket(LWPacket *Pack, void *Client, uint16_t Sequence){
+	if (Pack->GetType() == LWPacket::PacketAck){ //ack only datagram, the acks have already been applied.
+		DestroyPacket(Pack);
+		return;
+	}
+	LWPacketChannel &C = FindChannel(Client);
+	uint32_t Flag = Pack->GetFlag();
+	if (Flag&LWPacket::Ack){
+		C.m_AckPending = true;
+		uint16_t MessageID = (uint16_t)Pack->GetPacketAckID();
+		int16_t Dist = (int16_t)(uint16_t)(MessageID - C.m_NextReceiveID);
+		uint32_t &Received = C.m_Received[MessageID%LWPacketChannel::Window];
+		if (Dist < 0 || Dist >= LWPacketChannel::Window || Received == (MessageID | 0x10000u)){ //duplicate or too far ahead, the sender will resend it.
+			DestroyPacket(Pack);
+			return;
+		}
+		Received = MessageID | 0x10000u;
+		if ((Flag&LWPacket::Ordered) && MessageID != C.m_NextReceiveID){
+			C.m_Ordered[MessageID%LWPacketChannel::Window] = Pack;
+			return;
+		}
+		DeliverPacket(Pack);
+		while (C.m_Received[C.m_NextReceiveID%LWPacketChannel::Window] == (C.m_NextReceiveID | 0x10000u)){
+			LWPacket *&Held = C.m_Ordered[C.m_NextReceiveID%LWPacketChannel::Window];
+			C.m_NextReceiveID++;
+			if (!Held) continue;
+			LWPacket *P = Held;
+			Held = nullptr;
+			DeliverPacket(P);
+		}
+		return;
+	}
+	if (Flag&LWPacket::Sequenced){
+		if (C.m_HasSequenced && !SequenceGreater(Sequence, C.m_LastSequenced)){
+			DestroyPacket(Pack);
+			return;
+		}
+		C.m_LastSequenced = Sequence;
+		C.m_HasSequenced = true;
+	}
+	DeliverPacket(Pack);
+}
+
+void LWPacketManager::DeliverPacket(LWPacket *Pack){
+	bool Result = false;
+	if (m_ReceivePacketFunction) Result = m_ReceivePacketFunction(Pack, this);
+	if (!Result) DestroyPacket(Pack);
+}
+
+void LWPacketManager::DestroyPacket(LWPacket *Pack){
+	for (LWPacket *C = Pack, *N = C ? C->GetNext() : C; C; C = N, N = N ? N->GetNext() : N) LWAllocator::Destroy(C);
+}
+
 LWPacketManager::LWPacketManager(uint32_t PacketBufferSize, LWAllocator &BufferAllocator, LWAllocator &PacketAllocator, std::function<bool(LWPacket *Pack, LWPacketManager *Man)> ReceivePacketFunc, std::function<bool(LWPacket *Pack, LWPacketManager *Man)> SendPacketFunc) : m_PacketBuffer(BufferAllocator.AllocateArray<char>(PacketBufferSize)), m_ReceivePacketFunction(ReceivePacketFunc), m_SendPacketFunction(SendPacketFunc), m_PacketBufferLength(PacketBufferSize), m_PacketAllocator(&PacketAllocator), m_OutPacketCount(0){
 	RegisterDeserialization(LWPacket::PacketAck, LWPacket::Deserialize);
 }
 
 LWPacketManager::~LWPacketManager(){
 	LWAllocator::Destroy(m_PacketBuffer);
-	for (uint32_t i = 0;i< m_OutPacketCount;i++){
-		for (LWPacket *C = m_OutPackets[i], *N = C->GetNext(); C; C=N, N=N?N->GetNext():N) LWAllocator::Destroy(N);
+	for (uint32_t i = 0;i< m_OutPacketCount;i++) DestroyPacket(m_OutPackets[i]);
+	for (auto &&C : m_ChannelList){
+		for (uint32_t i = 0; i < LWPacketChannel::Window; i++){
+			if (C->m_Unacked[i].m_Packet) DestroyPacket(C->m_Unacked[i].m_Packet);
+			if (C->m_Ordered[i]) DestroyPacket(C->m_Ordered[i]);
+		}
+		LWAllocator::Destroy(C);
 	}
 }
\ No newline at end of file
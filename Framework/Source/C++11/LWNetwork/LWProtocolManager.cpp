@@ -2,6 +2,8 @@
 #include "LWNetwork/LWProtocol.h"
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <functional>
 
 LWProtocolManager &LWProtocolManager::SetUserData(void *UserData){
 	m_UserData = UserData;
@@ -10,12 +12,29 @@ LWProtocolManager &LWProtocolManager::SetUserData(void *UserData){
 
 LWSocket *LWProtocolManager::PushSocket(LWSocket &Socket){
 	if (m_ActiveSocketCount >= LWProtocolManager::MaxSockets) return nullptr;
-	m_SocketSet[m_ActiveSocketCount].fd = Socket.GetSocketDescriptor();
-	m_SocketSet[m_ActiveSocketCount].events = POLLIN;
-	m_SocketSet[m_ActiveSocketCount].revents = 0;
-	m_Sockets[m_ActiveSocketCount] = std::move(Socket);
+	uint32_t Index = m_ActiveSocketCount;
+	if (Index >= m_SocketBlockCount*SocketBlockSize) {
+		m_SocketBlocks[m_SocketBlockCount] = new LWSocket[SocketBlockSize];
+		if (!isEventQueue()) {
+			pollfd *Set = new pollfd[(m_SocketBlockCount + 1)*SocketBlockSize];
+			if (m_SocketSet) std::copy(m_SocketSet, m_SocketSet + Index, Set);
+			delete[] m_SocketSet;
+			m_SocketSet = Set;
+		}
+		m_SocketBlockCount++;
+	}
+	LWSocket *S = GetSocket(Index);
+	if (isEventQueue()) {
+		if (!EventQueueSet(m_EventQueue, Socket.GetSocketDescriptor(), Index, EventAdd, (m_Flags&EdgeTriggered) != 0)) return nullptr;
+	} else {
+		m_SocketSet[Index].fd = Socket.GetSocketDescriptor();
+		m_SocketSet[Index].events = POLLIN;
+		m_SocketSet[Index].revents = 0;
+	}
+	m_SocketIndices[Socket.GetSocketDescriptor()] = Index;
+	*S = std::move(Socket);
 	m_ActiveSocketCount++;
-	return &m_Sockets[m_ActiveSocketCount-1];
+	return S;
 }
 
 LWProtocolManager &LWProtocolManager::RegisterProtocol(LWProtocol *Protocol, uint32_t ProtocolID){
@@ -28,7 +47,13 @@ LWProtocol *LWProtocolManager::GetProtocol(uint32_t ProtocolID) {
 }
 
 LWSocket *LWProtocolManager::GetSocket(uint32_t Index) {
-	return m_Sockets + Index;
+	return m_SocketBlocks[Index / SocketBlockSize] + (Index%SocketBlockSize);
+}
+
+LWSocket *LWProtocolManager::FindSocket(uint32_t SocketDescriptor) {
+	auto Iter = m_SocketIndices.find(SocketDescriptor);
+	if (Iter == m_SocketIndices.end()) return nullptr;
+	return GetSocket(Iter->second);
 }
 
 void *LWProtocolManager::GetUserData(void) const{
@@ -39,38 +64,136 @@ uint32_t LWProtocolManager::GetActiveSocketCount(void) const{
 	return m_ActiveSocketCount;
 }
 
+bool LWProtocolManager::isEventQueue(void) const {
+	return m_EventQueue != InvalidEventQueue;
+}
+
+void LWProtocolManager::RemoveSocket(uint32_t Index) {
+	LWSocket *S = GetSocket(Index);
+	LWSocket *Last = GetSocket(m_ActiveSocketCount - 1);
+	LWProtocol *P = m_Protocols[S->GetProtocolID()];
+	if (P) P->SocketClosed(*S, this);
+	if (isEventQueue()) EventQueueSet(m_EventQueue, S->GetSocketDescriptor(), Index, EventRemove, false);
+	m_SocketIndices.erase(S->GetSocketDescriptor());
+	S->Close();
+	m_ActiveSocketCount--;
+	if (S == Last) return;
+	*S = std::move(*Last);
+	m_SocketIndices[S->GetSocketDescriptor()] = Index;
+	if (isEventQueue()) EventQueueSet(m_EventQueue, S->GetSocketDescriptor(), Index, EventModify, (m_Flags&EdgeTriggered) != 0, S->GetQueuedBytes() != 0);
+	else m_SocketSet[Index] = m_SocketSet[m_ActiveSocketCount];
+	LWProtocol *NP = m_Protocols[S->GetProtocolID()];
+	if (!NP) return;
+	//The move cleared Last's protocol data, protocols expect to find their data on the previous socket.
+	for (uint32_t i = 0; i < LWSocket::MaxProtocols; i++) Last->SetProtocolData(i, S->GetProtocolData(i));
+	NP->SocketChanged(*Last, *S, this);
+	return;
+}
+
+void LWProtocolManager::WatchWritable(uint32_t Index, bool Writable) {
+	if (isEventQueue()) EventQueueSet(m_EventQueue, GetSocket(Index)->GetSocketDescriptor(), Index, EventModify, (m_Flags&EdgeTriggered) != 0, Writable);
+	else m_SocketSet[Index].events = POLLIN | (Writable ? POLLOUT : 0);
+}
+
+void LWProtocolManager::FlushWritable(uint32_t Index) {
+	LWSocket *S = GetSocket(Index);
+	uint32_t Remaining = S->Flush();
+	if (Remaining == 0xFFFFFFFF) S->MarkClosable();
+	else if (Remaining) return;
+	WatchWritable(Index, false);
+}
+
+void LWProtocolManager::WatchPendingWrites(void) {
+	{
+		std::lock_guard<std::mutex> Lock(m_WriteLock);
+		if (m_PendingWrites.empty()) return;
+		std::swap(m_PendingWrites, m_WatchList);
+	}
+	for (auto &&Descriptor : m_WatchList) {
+		auto Iter = m_SocketIndices.find(Descriptor);
+		if (Iter == m_SocketIndices.end()) continue;
+		if (GetSocket(Iter->second)->GetQueuedBytes()) WatchWritable(Iter->second, true);
+	}
+	m_WatchList.clear();
+}
+
+bool LWProtocolManager::isRemovable(uint32_t Index) {
+	LWSocket *S = GetSocket(Index);
+	if (!(S->GetFlag()&LWSocket::Closeable)) return false;
+	if (!S->GetQueuedBytes()) return true;
+	//A closing socket keeps it's slot until what's already queued has been sent, or the connection fails.
+	uint32_t Remaining = S->Flush();
+	if (!Remaining || Remaining == 0xFFFFFFFF) return true;
+	WatchWritable(Index, true);
+	return false;
+}
+
+bool LWProtocolManager::Flush(LWSocket &Socket) {
+	uint32_t Remaining = Socket.Flush();
+	if (Remaining == 0xFFFFFFFF) return false;
+	if (!Remaining) return true;
+	std::lock_guard<std::mutex> Lock(m_WriteLock);
+	m_PendingWrites.push_back(Socket.GetSocketDescriptor());
+	return true;
+}
+
 bool LWProtocolManager::Poll(uint32_t Timeout) {
 	LWProtocol *P = nullptr;
-	if (!PollSet(m_SocketSet, m_ActiveSocketCount, Timeout)) return false;
-	for (uint32_t i = 0; i < m_ActiveSocketCount; i++) {
-		if (m_SocketSet[i].revents&(POLLIN | POLLHUP)) {
-			P = m_Protocols[m_Sockets[i].GetProtocolID()];
-			if (P) P->Read(m_Sockets[i], this);
+	WatchPendingWrites();
+	if (!isEventQueue()) {
+		if (!PollSet(m_SocketSet, m_ActiveSocketCount, Timeout)) return false;
+		for (uint32_t i = 0; i < m_ActiveSocketCount; i++) {
+			LWSocket *S = GetSocket(i);
+			if (m_SocketSet[i].revents&POLLOUT) FlushWritable(i);
+			if (m_SocketSet[i].revents&(POLLIN | POLLHUP)) {
+				P = m_Protocols[S->GetProtocolID()];
+				if (P) P->Read(*S, this);
+			}
 			m_SocketSet[i].revents = 0;
+			if (isRemovable(i)) {
+				RemoveSocket(i);
+				i--;
+			}
 		}
-		if (m_Sockets[i].GetFlag()&LWSocket::Closeable) {
-			P = m_Protocols[m_Sockets[i].GetProtocolID()];
-			if (P) P->SocketClosed(m_Sockets[i], this);
-			m_Sockets[i].Close();
-			m_Sockets[i] = std::move(m_Sockets[m_ActiveSocketCount - 1]);
-			m_SocketSet[i] = m_SocketSet[m_ActiveSocketCount - 1];
-			LWProtocol *NP = m_Protocols[m_Sockets[i].GetProtocolID()];
-			if (NP) NP->SocketChanged(m_Sockets[m_ActiveSocketCount - 1], m_Sockets[i], this);
-			i--;
-			m_ActiveSocketCount--;
-		}
+		return true;
+	}
+	uint32_t ReadyCount = EventQueueWait(m_EventQueue, m_ReadyList, MaxReadyEvents, Timeout);
+	if (ReadyCount == 0xFFFFFFFF) return false;
+	for (uint32_t i = 0; i < ReadyCount; i++) {
+		uint32_t Events = m_ReadyList[i];
+		m_ReadyList[i] &= EventIndexBits;
+		LWSocket *S = GetSocket(m_ReadyList[i]);
+		if (Events&EventWritable) FlushWritable(m_ReadyList[i]);
+		if (!(Events&EventReadable)) continue;
+		P = m_Protocols[S->GetProtocolID()];
+		if (P) P->Read(*S, this);
+	}
+	//Remove from the highest index down, so a socket swapped into a removed slot is never one still waiting to be checked.
+	std::sort(m_ReadyList, m_ReadyList + ReadyCount, std::greater<uint32_t>());
+	for (uint32_t i = 0; i < ReadyCount; i++) {
+		if (isRemovable(m_ReadyList[i])) RemoveSocket(m_ReadyList[i]);
+	}
+	if (++m_PollCount%CloseSweepInterval) return true;
+	for (uint32_t i = m_ActiveSocketCount; i > 0; i--) {
+		if (isRemovable(i - 1)) RemoveSocket(i - 1);
 	}
 	return true;
 }
 
-LWProtocolManager::LWProtocolManager(){
-	memset(m_Protocols, 0, sizeof(LWProtocol)*LWProtocolManager::MaxProtocols);
+LWProtocolManager::LWProtocolManager(uint32_t Flags) : m_Flags(Flags) {
+	memset(m_Protocols, 0, sizeof(LWProtocol*)*LWProtocolManager::MaxProtocols);
+	memset(m_SocketBlocks, 0, sizeof(LWSocket*)*LWProtocolManager::MaxSocketBlocks);
+	if (Flags&EventQueueBackend) m_EventQueue = CreateEventQueue();
 }
 
 LWProtocolManager::~LWProtocolManager() {
 	for (uint32_t i = 0; i < m_ActiveSocketCount; i++) {
-		LWProtocol *P = m_Protocols[m_Sockets[i].GetProtocolID()];
-		if (P) P->SocketClosed(m_Sockets[i], this);
-		m_Sockets[i].Close();
+		LWSocket *S = GetSocket(i);
+		LWProtocol *P = m_Protocols[S->GetProtocolID()];
+		if (P) P->SocketClosed(*S, this);
+		S->Close();
 	}
-}
\ No newline at end of file
+	for (uint32_t i = 0; i < m_SocketBlockCount; i++) delete[] m_SocketBlocks[i];
+	delete[] m_SocketSet;
+	if (isEventQueue()) DestroyEventQueue(m_EventQueue);
+}
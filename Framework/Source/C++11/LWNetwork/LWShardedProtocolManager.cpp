@@ -0,0 +1,197 @@
+#include "LWNetwork/LWShardedProtocolManager.h"
+#include "LWCore/LWAllocator.h"
+#include <algorithm>
+#include <cstring>
+
+LWProtocol &LWShardedProtocolManager::InternalProtocol::Read(LWSocket &Socket, LWProtocolManager *Manager) {
+	if (Socket.GetFlag()&LWSocket::Listen) {
+		LWSocket Acc;
+		if (!Socket.Accept(Acc, (uint32_t)(uintptr_t)Socket.GetUserData())) return *this;
+		uint32_t Target = m_Owner->m_NextShard.fetch_add(1, std::memory_order_relaxed) % m_Owner->m_ShardCount;
+		if (&m_Owner->GetShard(Target) == Manager) Manager->PushSocket(Acc);
+		else m_Owner->PushSocket(Target, Acc);
+		return *this;
+	}
+	char Buffer[16];
+	uint32_t RemoteIP = 0;
+	uint16_t RemotePort = 0;
+	Socket.Receive(Buffer, sizeof(Buffer), &RemoteIP, &RemotePort);
+	m_Owner->RunTasks(m_Owner->GetShardIndex(Manager));
+	return *this;
+}
+
+LWShardedProtocolManager::InternalProtocol::InternalProtocol(LWShardedProtocolManager *Owner) : m_Owner(Owner) {}
+
+uint32_t LWShardedProtocolManager::CreateListener(uint16_t Port, uint32_t Flag, uint32_t ProtocolID) {
+	LWSocket Listener;
+	Flag |= LWSocket::Listen;
+	uint32_t Err = LWSocket::CreateSocket(Listener, Port, Flag | LWSocket::ReusePort, ProtocolID);
+	if (!Err) {
+		Port = Listener.GetLocalPort();
+		if (!PushSocket(0, Listener)) return LWSocket::ErrSocket;
+		for (uint32_t i = 1; i < m_ShardCount; i++) {
+			Err = LWSocket::CreateSocket(Listener, Port, Flag | LWSocket::ReusePort, ProtocolID);
+			if (Err) return Err;
+			if (!PushSocket(i, Listener)) return LWSocket::ErrSocket;
+		}
+		return 0;
+	}
+	if (Err != LWSocket::ErrCtrlFlags) return Err;
+	//No SO_REUSEPORT, shard 0 accepts every connection and distributes them.
+	Err = LWSocket::CreateSocket(Listener, Port, Flag, InternalProtocolID);
+	if (Err) return Err;
+	Listener.SetUserData((void*)(uintptr_t)ProtocolID);
+	if (!PushSocket(0, Listener)) return LWSocket::ErrSocket;
+	return 0;
+}
+
+LWShardedProtocolManager &LWShardedProtocolManager::RegisterProtocol(uint32_t Shard, LWProtocol *Protocol, uint32_t ProtocolID) {
+	m_Shards[Shard].m_Manager->RegisterProtocol(Protocol, ProtocolID);
+	return *this;
+}
+
+LWShardedProtocolManager &LWShardedProtocolManager::RegisterProtocol(LWProtocol *Protocol, uint32_t ProtocolID) {
+	for (uint32_t i = 0; i < m_ShardCount; i++) RegisterProtocol(i, Protocol, ProtocolID);
+	return *this;
+}
+
+bool LWShardedProtocolManager::PushSocket(LWSocket &Socket) {
+	return PushSocket(m_NextShard.fetch_add(1, std::memory_order_relaxed) % m_ShardCount, Socket);
+}
+
+bool LWShardedProtocolManager::PushSocket(uint32_t Shard, LWSocket &Socket) {
+	LWSocket *Held = m_Allocator.Allocate<LWSocket>(std::move(Socket));
+	if (!Held) return false;
+	if (!Post(Shard, [Held](LWProtocolManager &Manager) {
+		Manager.PushSocket(*Held);
+		LWAllocator::Destroy(Held);
+	})) {
+		Socket = std::move(*Held);
+		LWAllocator::Destroy(Held);
+		return false;
+	}
+	return true;
+}
+
+bool LWShardedProtocolManager::Post(uint32_t Shard, const Task &T) {
+	if (Shard >= m_ShardCount) return false;
+	if (!m_Shards[Shard].m_Tasks->Push(T)) return false;
+	Wake(Shard);
+	return true;
+}
+
+bool LWShardedProtocolManager::Send(uint32_t Shard, uint32_t SocketDescriptor, const char *Buffer, uint32_t Len) {
+	char *Data = m_Allocator.AllocateArray<char>(Len);
+	if (!Data) return false;
+	std::memcpy(Data, Buffer, Len);
+	if (!Post(Shard, [SocketDescriptor, Data, Len](LWProtocolManager &Manager) {
+		LWSocket *Sock = Manager.FindSocket(SocketDescriptor);
+		//Going through the socket's output queue keeps the data behind any frame the shard has only partly flushed.
+		if (Sock && !(Sock->GetFlag()&LWSocket::Closeable)) {
+			if (!Sock->Queue(Data, Len) || !Manager.Flush(*Sock)) Sock->MarkClosable();
+		}
+		LWAllocator::Destroy(Data);
+	})) {
+		LWAllocator::Destroy(Data);
+		return false;
+	}
+	return true;
+}
+
+bool LWShardedProtocolManager::Start(void) {
+	if (m_Running.exchange(true)) return false;
+	for (uint32_t i = 0; i < m_ShardCount; i++) {
+		m_Shards[i].m_Thread = std::thread([this, i]() {
+			Shard &S = m_Shards[i];
+			while (m_Running.load(std::memory_order_acquire)) {
+				S.m_Manager->Poll(PollTimeout);
+				//Catch any tasks whose wake signal was lost.
+				if (S.m_Tasks->Length()) RunTasks(i);
+			}
+		});
+	}
+	return true;
+}
+
+LWShardedProtocolManager &LWShardedProtocolManager::Stop(void) {
+	if (m_Running.exchange(false)) {
+		for (uint32_t i = 0; i < m_ShardCount; i++) {
+			m_Shards[i].m_WakePending.store(false, std::memory_order_relaxed);
+			Wake(i);
+		}
+		for (uint32_t i = 0; i < m_ShardCount; i++) m_Shards[i].m_Thread.join();
+	}
+	for (uint32_t i = 0; i < m_ShardCount; i++) RunTasks(i);
+	return *this;
+}
+
+LWProtocolManager &LWShardedProtocolManager::GetShard(uint32_t Shard) {
+	return *m_Shards[Shard].m_Manager;
+}
+
+uint32_t LWShardedProtocolManager::GetShardIndex(const LWProtocolManager *Manager) const {
+	for (uint32_t i = 0; i < m_ShardCount; i++) {
+		if (m_Shards[i].m_Manager == Manager) return i;
+	}
+	return 0xFFFFFFFF;
+}
+
+uint32_t LWShardedProtocolManager::GetShardCount(void) const {
+	return m_ShardCount;
+}
+
+bool LWShardedProtocolManager::isRunning(void) const {
+	return m_Running.load(std::memory_order_acquire);
+}
+
+void LWShardedProtocolManager::RunTasks(uint32_t ShardIdx) {
+	if (ShardIdx >= m_ShardCount) return;
+	Shard &S = m_Shards[ShardIdx];
+	Task Tasks[TaskBatchSize];
+	//Clear the pending flag before draining so a task pushed during the drain sends a new wake.
+	S.m_WakePending.exchange(false, std::memory_order_acq_rel);
+	uint32_t Cnt = 0;
+	while ((Cnt = S.m_Tasks->PopBatch(Tasks, TaskBatchSize)) != 0) {
+		for (uint32_t i = 0; i < Cnt; i++) {
+			Tasks[i](*S.m_Manager);
+			Tasks[i] = nullptr;
+		}
+	}
+	return;
+}
+
+void LWShardedProtocolManager::Wake(uint32_t ShardIdx) {
+	Shard &S = m_Shards[ShardIdx];
+	if (S.m_WakePending.exchange(true, std::memory_order_acq_rel)) return;
+	char Signal = 0;
+	S.m_WakeSender.Send(&Signal, 1, LWSocket::LocalIP, S.m_WakePort);
+	return;
+}
+
+LWShardedProtocolManager::LWShardedProtocolManager(uint32_t ShardCount, LWAllocator &Allocator, uint32_t ManagerFlags) : m_InternalProtocol(this), m_Allocator(Allocator), m_ShardCount(std::min<uint32_t>(std::max<uint32_t>(ShardCount, 1), MaxShards)) {
+	m_NextShard.store(0);
+	m_Running.store(false);
+	for (uint32_t i = 0; i < MaxShards; i++) m_Shards[i].m_WakePending.store(false);
+	for (uint32_t i = 0; i < m_ShardCount; i++) {
+		Shard &S = m_Shards[i];
+		S.m_Manager = Allocator.Allocate<LWProtocolManager>(ManagerFlags);
+		S.m_Tasks = new(&S.m_TaskStorage) TaskQueue(Allocator);
+		S.m_Manager->RegisterProtocol(&m_InternalProtocol, InternalProtocolID);
+		LWSocket WakeSocket;
+		if (!LWSocket::CreateSocket(WakeSocket, LWSocket::Udp, InternalProtocolID)) {
+			S.m_WakePort = WakeSocket.GetLocalPort();
+			S.m_Manager->PushSocket(WakeSocket);
+		}
+		LWSocket::CreateSocket(S.m_WakeSender, LWSocket::Udp, InternalProtocolID);
+	}
+}
+
+LWShardedProtocolManager::~LWShardedProtocolManager() {
+	Stop();
+	for (uint32_t i = 0; i < m_ShardCount; i++) {
+		Shard &S = m_Shards[i];
+		LWAllocator::Destroy(S.m_Manager);
+		S.m_Tasks->~TaskQueue();
+		S.m_WakeSender.Close();
+	}
+}
@@ -0,0 +1,347 @@
+#include "LWNetwork/LWSnapshot.h"
+#include "LWCore/LWBitStream.h"
+#include <algorithm>
+#include <cstring>
+
+bool LWSnapshotSchema::AddBits(uint32_t BitCount) {
+	if (m_FieldCount >= MaxFields) return false;
+	LWSnapshotField &F = m_Fields[m_FieldCount++];
+	F = LWSnapshotField();
+	F.m_Type = Bits;
+	F.m_Bits = std::min<uint32_t>(BitCount, 32);
+	return true;
+}
+
+bool LWSnapshotSchema::AddBounded(int32_t Min, int32_t Max) {
+	if (m_FieldCount >= MaxFields) return false;
+	LWSnapshotField &F = m_Fields[m_FieldCount++];
+	F = LWSnapshotField();
+	F.m_Type = Bounded;
+	F.m_Min = Min;
+	F.m_Max = Max;
+	F.m_Bits = LWBitWriter::GetBitsRequired((uint32_t)((int64_t)Max - Min));
+	return true;
+}
+
+bool LWSnapshotSchema::AddQuantized(float Min, float Max, float Resolution) {
+	if (m_FieldCount >= MaxFields) return false;
+	LWSnapshotField &F = m_Fields[m_FieldCount++];
+	F = LWSnapshotField();
+	F.m_Type = Quantized;
+	F.m_fMin = Min;
+	F.m_fMax = Max;
+	F.m_Resolution = Resolution;
+	F.m_Bits = LWBitWriter::GetQuantizedBits(Min, Max, Resolution);
+	return true;
+}
+
+bool LWSnapshotSchema::AddVarInt(void) {
+	if (m_FieldCount >= MaxFields) return false;
+	LWSnapshotField &F = m_Fields[m_FieldCount++];
+	F = LWSnapshotField();
+	F.m_Type = VarInt;
+	F.m_Bits = 0;
+	return true;
+}
+
+bool LWSnapshotSchema::AddFloat(void) {
+	if (m_FieldCount >= MaxFields) return false;
+	LWSnapshotField &F = m_Fields[m_FieldCount++];
+	F = LWSnapshotField();
+	F.m_Type = Float;
+	F.m_Bits = 32;
+	return true;
+}
+
+void LWSnapshotSchema::WriteValue(LWBitWriter &Writer, uint32_t Field, uint32_t Value) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	if (F.m_Type == Bounded) Writer.WriteBounded((int32_t)Value, F.m_Min, F.m_Max);
+	else if (F.m_Type == VarInt) Writer.WriteSignedVarInt((int32_t)Value);
+	else Writer.WriteBits(Value, F.m_Bits);
+}
+
+uint32_t LWSnapshotSchema::ReadValue(LWBitReader &Reader, uint32_t Field) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	if (F.m_Type == Bounded) return (uint32_t)Reader.ReadBounded(F.m_Min, F.m_Max);
+	else if (F.m_Type == VarInt) return (uint32_t)(int32_t)Reader.ReadSignedVarInt();
+	return Reader.ReadBits(F.m_Bits);
+}
+
+void LWSnapshotSchema::WriteDelta(LWBitWriter &Writer, uint32_t Field, uint32_t Value, uint32_t Baseline) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	int32_t Diff = (int32_t)(Value - Baseline);
+	if (F.m_Type == VarInt) {
+		Writer.WriteSignedVarInt(Diff);
+		return;
+	}
+	if (F.m_Type == Float) {
+		Writer.WriteBits(Value, F.m_Bits);
+		return;
+	}
+	bool isDiff = LWBitWriter::GetVarIntBits(LWBitWriter::ZigZag(Diff)) < F.m_Bits;
+	Writer.WriteBool(isDiff);
+	if (isDiff) Writer.WriteSignedVarInt(Diff);
+	else WriteValue(Writer, Field, Value);
+}
+
+uint32_t LWSnapshotSchema::ReadDelta(LWBitReader &Reader, uint32_t Field, uint32_t Baseline) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	if (F.m_Type == VarInt) return Baseline + (uint32_t)(int32_t)Reader.ReadSignedVarInt();
+	if (F.m_Type == Float) return Reader.ReadBits(F.m_Bits);
+	if (Reader.ReadBool()) return Baseline + (uint32_t)(int32_t)Reader.ReadSignedVarInt();
+	return ReadValue(Reader, Field);
+}
+
+uint32_t LWSnapshotSchema::MakeValue(uint32_t Field, int32_t Value) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	if (F.m_Type == Bounded) return (uint32_t)std::min<int32_t>(std::max<int32_t>(Value, F.m_Min), F.m_Max);
+	if (F.m_Type == Quantized || F.m_Type == Float) return MakeValue(Field, (float)Value);
+	if (F.m_Type == Bits && F.m_Bits < 32) return (uint32_t)Value & ((1u << F.m_Bits) - 1);
+	return (uint32_t)Value;
+}
+
+uint32_t LWSnapshotSchema::MakeValue(uint32_t Field, float Value) const {
+	const LWSnapshotField &F = m_Fields[Field];
+	if (F.m_Type == Quantized) return LWBitWriter::Quantize(Value, F.m_fMin, F.m_fMax, F.m_Resolution);
+	if (F.m_Type == Float) {
+		uint32_t Bits;
+		memcpy(&Bits, &Value, sizeof(uint32_t));
+		return Bits;
+	}
+	return MakeValue(Field, (int32_t)Value);
+}
+
+const LWSnapshotField &LWSnapshotSchema::GetField(uint32_t Field) const {
+	return m_Fields[Field];
+}
+
+uint32_t LWSnapshotSchema::GetFieldCount(void) const {
+	return m_FieldCount;
+}
+
+LWSnapshot &LWSnapshot::SetID(uint32_t ID) {
+	m_ID = ID;
+	return *this;
+}
+
+LWSnapshot &LWSnapshot::SetValue(uint32_t EntityID, uint32_t Field, uint32_t Value) {
+	AddEntity(EntityID)[Field] = Value;
+	return *this;
+}
+
+LWSnapshot &LWSnapshot::SetInt(uint32_t EntityID, uint32_t Field, int32_t Value) {
+	return SetValue(EntityID, Field, m_Schema->MakeValue(Field, Value));
+}
+
+LWSnapshot &LWSnapshot::SetFloat(uint32_t EntityID, uint32_t Field, float Value) {
+	return SetValue(EntityID, Field, m_Schema->MakeValue(Field, Value));
+}
+
+uint32_t *LWSnapshot::AddEntity(uint32_t EntityID) {
+	uint32_t FieldCount = m_Schema->GetFieldCount();
+	uint32_t Index = LowerBound(EntityID);
+	if (Index < m_EntityIDs.size() && m_EntityIDs[Index] == EntityID) return m_Values.data() + Index*FieldCount;
+	m_EntityIDs.insert(m_EntityIDs.begin() + Index, EntityID);
+	m_Values.insert(m_Values.begin() + Index*FieldCount, FieldCount, 0);
+	return m_Values.data() + Index*FieldCount;
+}
+
+LWSnapshot &LWSnapshot::RemoveEntity(uint32_t EntityID) {
+	uint32_t FieldCount = m_Schema->GetFieldCount();
+	uint32_t Index = LowerBound(EntityID);
+	if (Index >= m_EntityIDs.size() || m_EntityIDs[Index] != EntityID) return *this;
+	m_EntityIDs.erase(m_EntityIDs.begin() + Index);
+	m_Values.erase(m_Values.begin() + Index*FieldCount, m_Values.begin() + (Index + 1)*FieldCount);
+	return *this;
+}
+
+LWSnapshot &LWSnapshot::Clear(void) {
+	m_EntityIDs.clear();
+	m_Values.clear();
+	return *this;
+}
+
+const uint32_t *LWSnapshot::FindEntity(uint32_t EntityID) const {
+	uint32_t Index = LowerBound(EntityID);
+	if (Index >= m_EntityIDs.size() || m_EntityIDs[Index] != EntityID) return nullptr;
+	return m_Values.data() + Index*m_Schema->GetFieldCount();
+}
+
+uint32_t LWSnapshot::GetValue(uint32_t EntityID, uint32_t Field) const {
+	const uint32_t *Values = FindEntity(EntityID);
+	return Values ? Values[Field] : 0;
+}
+
+int32_t LWSnapshot::GetInt(uint32_t EntityID, uint32_t Field) const {
+	return (int32_t)GetValue(EntityID, Field);
+}
+
+float LWSnapshot::GetFloat(uint32_t EntityID, uint32_t Field) const {
+	const LWSnapshotField &F = m_Schema->GetField(Field);
+	uint32_t Value = GetValue(EntityID, Field);
+	if (F.m_Type == LWSnapshotSchema::Quantized) return LWBitWriter::Dequantize(Value, F.m_fMin, F.m_fMax, F.m_Resolution);
+	if (F.m_Type == LWSnapshotSchema::Float) {
+		float fValue;
+		memcpy(&fValue, &Value, sizeof(float));
+		return fValue;
+	}
+	return (float)(int32_t)Value;
+}
+
+uint32_t LWSnapshot::GetEntityID(uint32_t Index) const {
+	return m_EntityIDs[Index];
+}
+
+const uint32_t *LWSnapshot::GetEntityValues(uint32_t Index) const {
+	return m_Values.data() + Index*m_Schema->GetFieldCount();
+}
+
+uint32_t LWSnapshot::GetEntityCount(void) const {
+	return (uint32_t)m_EntityIDs.size();
+}
+
+uint32_t LWSnapshot::GetID(void) const {
+	return m_ID;
+}
+
+const LWSnapshotSchema &LWSnapshot::GetSchema(void) const {
+	return *m_Schema;
+}
+
+uint32_t LWSnapshot::LowerBound(uint32_t EntityID) const {
+	if (!m_EntityIDs.empty() && m_EntityIDs.back() < EntityID) return (uint32_t)m_EntityIDs.size(); //entities are commonly added in order.
+	return (uint32_t)(std::lower_bound(m_EntityIDs.begin(), m_EntityIDs.end(), EntityID) - m_EntityIDs.begin());
+}
+
+LWSnapshot::LWSnapshot(const LWSnapshotSchema &Schema, uint32_t ID) : m_Schema(&Schema), m_ID(ID) {}
+
+//returns true if snapshot id a is more recent than b, accounting for wrap around.
+inline bool SnapshotGreater(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) > 0;
+}
+
+void LWSnapshotEncoder::EncodeDelta(const LWSnapshot *Baseline, const LWSnapshot &Snapshot, LWBitWriter &Writer) {
+	const LWSnapshotSchema &Schema = Snapshot.GetSchema();
+	uint32_t FieldCount = Schema.GetFieldCount();
+	uint32_t BaseCount = Baseline ? Baseline->GetEntityCount() : 0;
+	uint32_t Count = Snapshot.GetEntityCount();
+	Writer.WriteVarInt(Snapshot.GetID());
+	Writer.WriteBool(Baseline != nullptr);
+	if (Baseline) Writer.WriteVarInt(Snapshot.GetID() - Baseline->GetID());
+	uint32_t Prev = 0;
+	uint32_t b = 0;
+	for (uint32_t i = 0; i < Count; i++) {
+		uint32_t EntityID = Snapshot.GetEntityID(i);
+		const uint32_t *Values = Snapshot.GetEntityValues(i);
+		const uint32_t *BaseValues = nullptr;
+		while (b < BaseCount && Baseline->GetEntityID(b) < EntityID) b++;
+		if (b < BaseCount && Baseline->GetEntityID(b) == EntityID) {
+			BaseValues = Baseline->GetEntityValues(b);
+			if (!memcmp(Values, BaseValues, sizeof(uint32_t)*FieldCount)) continue;
+		}
+		Writer.WriteBool(true);
+		Writer.WriteVarInt(EntityID - Prev);
+		Writer.WriteBool(BaseValues == nullptr);
+		Prev = EntityID;
+		for (uint32_t f = 0; f < FieldCount; f++) {
+			uint32_t Base = BaseValues ? BaseValues[f] : 0; //new entities are written as a delta against all 0's.
+			Writer.WriteBool(Values[f] != Base);
+			if (Values[f] != Base) Schema.WriteDelta(Writer, f, Values[f], Base);
+		}
+	}
+	Writer.WriteBool(false);
+	Prev = 0;
+	for (uint32_t i = 0; i < BaseCount; i++) {
+		uint32_t EntityID = Baseline->GetEntityID(i);
+		if (Snapshot.FindEntity(EntityID)) continue;
+		Writer.WriteBool(true);
+		Writer.WriteVarInt(EntityID - Prev);
+		Prev = EntityID;
+	}
+	Writer.WriteBool(false);
+}
+
+LWSnapshotEncoder &LWSnapshotEncoder::PushSnapshot(const LWSnapshot &Snapshot) {
+	m_History[Snapshot.GetID() % HistorySize] = Snapshot;
+	m_Latest = Snapshot.GetID();
+	return *this;
+}
+
+LWSnapshotEncoder &LWSnapshotEncoder::Acknowledge(void *Client, uint32_t SnapshotID) {
+	if (!FindSnapshot(SnapshotID)) return *this;
+	auto Iter = m_Baselines.find(Client);
+	if (Iter == m_Baselines.end()) m_Baselines.emplace(Client, SnapshotID);
+	else if (SnapshotGreater(SnapshotID, Iter->second)) Iter->second = SnapshotID;
+	return *this;
+}
+
+bool LWSnapshotEncoder::Encode(void *Client, LWBitWriter &Writer) const {
+	const LWSnapshot *Snapshot = FindSnapshot(m_Latest);
+	if (!Snapshot) return false;
+	EncodeDelta(FindSnapshot(GetBaseline(Client)), *Snapshot, Writer);
+	return true;
+}
+
+LWSnapshotEncoder &LWSnapshotEncoder::PurgeClient(void *Client) {
+	m_Baselines.erase(Client);
+	return *this;
+}
+
+const LWSnapshot *LWSnapshotEncoder::FindSnapshot(uint32_t SnapshotID) const {
+	if (SnapshotID == NoBaseline) return nullptr;
+	const LWSnapshot &S = m_History[SnapshotID % HistorySize];
+	return S.GetID() == SnapshotID ? &S : nullptr;
+}
+
+uint32_t LWSnapshotEncoder::GetBaseline(void *Client) const {
+	auto Iter = m_Baselines.find(Client);
+	return Iter == m_Baselines.end() ? (uint32_t)NoBaseline : Iter->second;
+}
+
+LWSnapshotEncoder::LWSnapshotEncoder(const LWSnapshotSchema &Schema) : m_History(HistorySize, LWSnapshot(Schema, NoBaseline)) {}
+
+bool LWSnapshotDecoder::Decode(LWBitReader &Reader, LWSnapshot &Result) {
+	const LWSnapshotSchema &Schema = Result.GetSchema();
+	uint32_t FieldCount = Schema.GetFieldCount();
+	uint32_t SnapshotID = (uint32_t)Reader.ReadVarInt();
+	const LWSnapshot *Baseline = nullptr;
+	if (Reader.ReadBool()) {
+		Baseline = FindSnapshot(SnapshotID - (uint32_t)Reader.ReadVarInt());
+		if (!Baseline) return false;
+	}
+	if (m_Latest != LWSnapshotEncoder::NoBaseline && !SnapshotGreater(SnapshotID, m_Latest)) return false;
+	if (Baseline) Result = *Baseline;
+	else Result.Clear();
+	Result.SetID(SnapshotID);
+	uint32_t Prev = 0;
+	while (Reader.ReadBool()) {
+		uint32_t EntityID = Prev + (uint32_t)Reader.ReadVarInt();
+		bool isNew = Reader.ReadBool();
+		Prev = EntityID;
+		if (isNew == (Result.FindEntity(EntityID) != nullptr)) return false;
+		uint32_t *Values = Result.AddEntity(EntityID);
+		for (uint32_t f = 0; f < FieldCount; f++) {
+			if (Reader.ReadBool()) Values[f] = Schema.ReadDelta(Reader, f, Values[f]);
+		}
+		if (Reader.isOverflowed()) return false;
+	}
+	Prev = 0;
+	while (Reader.ReadBool()) {
+		uint32_t EntityID = Prev + (uint32_t)Reader.ReadVarInt();
+		Result.RemoveEntity(EntityID);
+		Prev = EntityID;
+		if (Reader.isOverflowed()) return false;
+	}
+	if (Reader.isOverflowed()) return false;
+	m_History[SnapshotID%LWSnapshotEncoder::HistorySize] = Result;
+	m_Latest = SnapshotID;
+	return true;
+}
+
+const LWSnapshot *LWSnapshotDecoder::FindSnapshot(uint32_t SnapshotID) const {
+	if (SnapshotID == LWSnapshotEncoder::NoBaseline) return nullptr;
+	const LWSnapshot &S = m_History[SnapshotID % LWSnapshotEncoder::HistorySize];
+	return S.GetID() == SnapshotID ? &S : nullptr;
+}
+
+LWSnapshotDecoder::LWSnapshotDecoder(const LWSnapshotSchema &Schema) : m_History(LWSnapshotEncoder::HistorySize, LWSnapshot(Schema, LWSnapshotEncoder::NoBaseline)) {}
\ No newline at end of file
@@ -5,6 +5,63 @@
 #include "LWPlatform/LWPlatform.h"
 #include "LWNetwork/LWProtocolManager.h"
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <deque>
+
+/*! \cond */
+struct LWSocketQueue {
+	struct Block {
+		uint32_t m_Position = 0;
+		uint32_t m_Length = 0;
+		char m_Data[LWSocket::QueueBlockSize];
+	};
+	std::mutex m_Lock;
+	std::deque<Block*> m_Blocks;
+	std::atomic<uint32_t> m_Length;
+	std::atomic<uint32_t> m_References;
+	bool m_Closed;
+
+	/*! \brief drops every queued block and refuses further writes, called with m_Lock held. */
+	void Close(void) {
+		for (auto &&B : m_Blocks) delete B;
+		m_Blocks.clear();
+		m_Length.store(0, std::memory_order_relaxed);
+		m_Closed = true;
+	}
+
+	LWSocketQueue(bool Closed = false) : m_Length(0), m_References(1), m_Closed(Closed) {}
+
+	~LWSocketQueue() {
+		for (auto &&B : m_Blocks) delete B;
+	}
+};
+
+/*! \brief holds a reference to a socket's queue so it outlives a Close or move on another thread. */
+struct LWSocketQueueRef {
+	LWSocketQueue *m_Queue;
+
+	LWSocketQueueRef(LWSocketQueue *Queue) : m_Queue(Queue) {}
+
+	~LWSocketQueueRef() {
+		if (m_Queue && m_Queue->m_References.fetch_sub(1, std::memory_order_acq_rel) == 1) delete m_Queue;
+	}
+};
+/*! \endcond */
+
+//Sockets that were closed or moved from point here, so writes from a thread still holding them fail instead of making a new queue.
+static LWSocketQueue ClosedQueue(true);
+
+//Loading or swapping a socket's queue pointer is done under one of these, picked by the socket's address.
+static std::mutex QueueGuards[32];
+
+static std::mutex &GetQueueGuard(const LWSocket *Socket) {
+	return QueueGuards[((uintptr_t)Socket >> 6) % 32];
+}
+
+static bool isOwnedQueue(LWSocketQueue *Q) {
+	return Q && Q != &ClosedQueue;
+}
 
 uint32_t LWSocket::MakeIP(uint8_t First, uint8_t Second, uint8_t Third, uint8_t Fourth){
 	return First << 24 | (Second << 16) | (Third << 8) | Fourth;
@@ -304,7 +361,155 @@ bool LWSocket::Accept(LWSocket &Result) const{
 	return Accept(Result, m_ProtocolID);
 }
 
+LWSocketQueue *LWSocket::AcquireQueue(bool Create) {
+	std::lock_guard<std::mutex> Lock(GetQueueGuard(this));
+	LWSocketQueue *Q = m_OutQueue.load(std::memory_order_relaxed);
+	if (Q == &ClosedQueue) return nullptr;
+	if (!Q) {
+		if (!Create) return nullptr;
+		Q = new LWSocketQueue();
+		m_OutQueue.store(Q, std::memory_order_relaxed);
+	}
+	Q->m_References.fetch_add(1, std::memory_order_relaxed);
+	return Q;
+}
+
+bool LWSocket::Queue(const LWSocketBuffer *Buffers, uint32_t BufferCount) {
+	uint32_t Total = 0;
+	for (uint32_t i = 0; i < BufferCount; i++) Total += Buffers[i].m_Length;
+	if (!Total) return true;
+	LWSocketQueueRef Ref(AcquireQueue(true));
+	LWSocketQueue *Q = Ref.m_Queue;
+	if (!Q) return false;
+	std::lock_guard<std::mutex> Lock(Q->m_Lock);
+	//The socket may have been closed or moved since the queue was acquired, the descriptor is only stable while it still owns the queue.
+	if (Q->m_Closed || m_OutQueue.load(std::memory_order_relaxed) != Q) return false;
+	uint32_t Length = Q->m_Length.load(std::memory_order_relaxed);
+	if (Length + Total > MaxQueueSize) return false;
+	uint32_t Skip = 0;
+	if (!Length && Total >= QueueBlockSize) {
+		Skip = Send(Buffers, BufferCount, false);
+		if (Skip == 0xFFFFFFFF) return false;
+		if (Skip == Total) return true;
+	}
+	for (uint32_t i = 0; i < BufferCount; i++) {
+		const char *Data = Buffers[i].m_Data;
+		uint32_t Len = Buffers[i].m_Length;
+		if (Skip >= Len) {
+			Skip -= Len;
+			continue;
+		}
+		Data += Skip;
+		Len -= Skip;
+		Skip = 0;
+		while (Len) {
+			LWSocketQueue::Block *B = Q->m_Blocks.empty() ? nullptr : Q->m_Blocks.back();
+			if (!B || B->m_Length == QueueBlockSize) {
+				B = new LWSocketQueue::Block();
+				Q->m_Blocks.push_back(B);
+			}
+			uint32_t n = std::min<uint32_t>(Len, QueueBlockSize - B->m_Length);
+			std::copy(Data, Data + n, B->m_Data + B->m_Length);
+			B->m_Length += n;
+			Data += n;
+			Len -= n;
+			Length += n;
+		}
+	}
+	Q->m_Length.store(Length, std::memory_order_relaxed);
+	return true;
+}
+
+bool LWSocket::Queue(const char *Buffer, uint32_t BufferLen) {
+	LWSocketBuffer Buf = { Buffer, BufferLen };
+	return Queue(&Buf, 1);
+}
+
+uint32_t LWSocket::Flush(void) {
+	LWSocketQueueRef Ref(AcquireQueue(false));
+	LWSocketQueue *Q = Ref.m_Queue;
+	if (!Q) return 0;
+	LWSocketBuffer Buffers[MaxGatherBuffers];
+	std::lock_guard<std::mutex> Lock(Q->m_Lock);
+	if (Q->m_Closed || m_OutQueue.load(std::memory_order_relaxed) != Q) return 0;
+	uint32_t Length = Q->m_Length.load(std::memory_order_relaxed);
+	while (Length) {
+		uint32_t Count = std::min<uint32_t>((uint32_t)Q->m_Blocks.size(), MaxGatherBuffers);
+		uint32_t Total = 0;
+		for (uint32_t i = 0; i < Count; i++) {
+			LWSocketQueue::Block *B = Q->m_Blocks[i];
+			Buffers[i] = { B->m_Data + B->m_Position, B->m_Length - B->m_Position };
+			Total += Buffers[i].m_Length;
+		}
+		uint32_t Res = Send(Buffers, Count, false);
+		if (Res == 0xFFFFFFFF) {
+			//The connection is gone, so nothing left can be delivered.
+			for (auto &&B : Q->m_Blocks) delete B;
+			Q->m_Blocks.clear();
+			Q->m_Length.store(0, std::memory_order_relaxed);
+			return 0xFFFFFFFF;
+		}
+		Length -= Res;
+		for (uint32_t Remain = Res; Remain;) {
+			LWSocketQueue::Block *B = Q->m_Blocks.front();
+			uint32_t n = std::min<uint32_t>(Remain, B->m_Length - B->m_Position);
+			B->m_Position += n;
+			Remain -= n;
+			if (B->m_Position != B->m_Length) continue;
+			Q->m_Blocks.pop_front();
+			delete B;
+		}
+		//The os buffer is full, what's left goes out once the socket is writable again.
+		if (Res < Total) break;
+	}
+	Q->m_Length.store(Length, std::memory_order_relaxed);
+	return Length;
+}
+
+uint32_t LWSocket::GetQueuedBytes(void) const {
+	std::lock_guard<std::mutex> Lock(GetQueueGuard(this));
+	LWSocketQueue *Q = m_OutQueue.load(std::memory_order_relaxed);
+	return Q ? Q->m_Length.load(std::memory_order_relaxed) : 0;
+}
+
+bool LWSocket::isWritable(void) const {
+	return GetQueuedBytes() < QueueHighWater;
+}
+
+void LWSocket::ReleaseQueue(void) {
+	LWSocketQueue *Q = nullptr;
+	{
+		std::lock_guard<std::mutex> Lock(GetQueueGuard(this));
+		Q = m_OutQueue.exchange(&ClosedQueue, std::memory_order_relaxed);
+	}
+	if (!isOwnedQueue(Q)) return;
+	LWSocketQueueRef Ref(Q);
+	//Waits for any Queue or Flush still sending on this socket before the caller closes the descriptor.
+	std::lock_guard<std::mutex> Lock(Q->m_Lock);
+	Q->Close();
+}
+
 LWSocket &LWSocket::operator = (LWSocket &&Other){
+	if (this == &Other) return *this;
+	std::mutex &Guard = GetQueueGuard(this);
+	std::mutex &OtherGuard = GetQueueGuard(&Other);
+	std::unique_lock<std::mutex> GuardLock(Guard, std::defer_lock);
+	std::unique_lock<std::mutex> OtherGuardLock(OtherGuard, std::defer_lock);
+	if (&Guard == &OtherGuard) GuardLock.lock();
+	else std::lock(GuardLock, OtherGuardLock);
+	LWSocketQueue *Q = m_OutQueue.load(std::memory_order_relaxed);
+	LWSocketQueue *OtherQ = Other.m_OutQueue.load(std::memory_order_relaxed);
+	LWSocketQueueRef Ref(isOwnedQueue(Q) ? Q : nullptr);
+	//Holding both queue locks keeps another thread from sending with a descriptor while it's being moved.
+	std::unique_lock<std::mutex> QLock, OtherQLock;
+	if (isOwnedQueue(Q)) QLock = std::unique_lock<std::mutex>(Q->m_Lock, std::defer_lock);
+	if (isOwnedQueue(OtherQ)) OtherQLock = std::unique_lock<std::mutex>(OtherQ->m_Lock, std::defer_lock);
+	if (QLock.mutex() && OtherQLock.mutex()) std::lock(QLock, OtherQLock);
+	else if (QLock.mutex()) QLock.lock();
+	else if (OtherQLock.mutex()) OtherQLock.lock();
+	if (isOwnedQueue(Q)) Q->Close();
+	m_OutQueue.store(OtherQ, std::memory_order_relaxed);
+	Other.m_OutQueue.store(&ClosedQueue, std::memory_order_relaxed);
 	m_UserData = Other.m_UserData;
 	std::copy(Other.m_ProtocolData, Other.m_ProtocolData + MaxProtocols, m_ProtocolData);
 	m_SocketID = Other.m_SocketID;
@@ -361,18 +566,15 @@ void *LWSocket::GetProtocolData(uint32_t ProtocolID) const{
 	return m_ProtocolData[ProtocolID];
 }
 
-LWSocket::LWSocket() : m_UserData(nullptr), m_SocketID(0), m_Flag(0) {
+LWSocket::LWSocket() : m_UserData(nullptr), m_SocketID(0), m_Flag(0), m_OutQueue(nullptr) {
 	memset(m_ProtocolData, 0, sizeof(void*)*MaxProtocols);
 }
 
 
-LWSocket::LWSocket(LWSocket &&Other) : m_UserData(Other.m_UserData), m_SocketID(Other.m_SocketID), m_ProtocolID(Other.m_ProtocolID), m_LocalIP(Other.m_LocalIP), m_RemoteIP(Other.m_RemoteIP), m_Flag(Other.m_Flag), m_RemotePort(Other.m_RemotePort), m_LocalPort(Other.m_LocalPort){
-	std::copy(Other.m_ProtocolData, Other.m_ProtocolData + MaxProtocols, m_ProtocolData);
-	Other.m_UserData = nullptr;
-	memset(Other.m_ProtocolData, 0, sizeof(void*)*MaxProtocols);
-	Other.m_SocketID = 0;
+LWSocket::LWSocket(LWSocket &&Other) : LWSocket() {
+	*this = std::move(Other);
 }
 
-LWSocket::LWSocket(uint32_t SocketID, uint32_t ProtocolID, uint32_t LocalIP, uint16_t LocalPort, uint32_t RemoteIP, uint16_t RemotePort, uint32_t Flag) : m_UserData(nullptr), m_SocketID(SocketID), m_ProtocolID(ProtocolID), m_LocalIP(LocalIP), m_RemoteIP(RemoteIP), m_Flag(Flag), m_RemotePort(RemotePort), m_LocalPort(LocalPort) {
+LWSocket::LWSocket(uint32_t SocketID, uint32_t ProtocolID, uint32_t LocalIP, uint16_t LocalPort, uint32_t RemoteIP, uint16_t RemotePort, uint32_t Flag) : m_UserData(nullptr), m_SocketID(SocketID), m_ProtocolID(ProtocolID), m_LocalIP(LocalIP), m_RemoteIP(RemoteIP), m_Flag(Flag), m_RemotePort(RemotePort), m_LocalPort(LocalPort), m_OutQueue(nullptr) {
 	memset(m_ProtocolData, 0, sizeof(void*)*MaxProtocols);
 }
@@ -552,7 +552,21 @@ LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_
 	return LWFont::LoadFontTTF(Stream, Driver, emSize, 1, &FirstChar, &NbrChars, Allocator);
 }
 
-LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_t emSize, uint32_t RangeCount, const uint32_t *FirstChar, const uint32_t *NbrChars, LWAllocator &Allocator){
+LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_t emSize, uint32_t RangeCount, const uint32_t *FirstChar, const uint32_t *NbrChars, LWAllocator &Allocator) {
+	LWImage Atlas;
+	LWFont *F = LoadFontTTF(Stream, Driver, emSize, RangeCount, FirstChar, NbrChars, Atlas, Allocator);
+	if (!F) return nullptr;
+	LWTexture *Tex = Driver->CreateTexture(LWTexture::MinLinear | LWTexture::MagLinear, Atlas, Allocator);
+	if (!Tex) {
+		std::cout << "Error making texture!" << std::endl;
+		LWAllocator::Destroy(F);
+		return nullptr;
+	}
+	F->SetTexture(0, Tex);
+	return F;
+}
+
+LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_t emSize, uint32_t RangeCount, const uint32_t *FirstChar, const uint32_t *NbrChars, LWImage &Atlas, LWAllocator &Allocator){
 	FT_Library ftLib = nullptr;
 	FT_Face ftFace = nullptr;
 	FT_StreamDesc desc;
@@ -643,7 +657,8 @@ LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_
 	TextureWidth = LWNext2N(LongestLineWidth);
 	TextureHeight = LWNext2N(TallestCharacter*LineCount);
 	//std::cout << "Creating texture: " << TextureWidth << " " << TextureHeight << std::endl;
-	unsigned char *Texels = Allocator.AllocateArray<unsigned char>(TextureWidth*PackSize*TextureHeight);
+	Atlas = LWImage(LWVector2i(TextureWidth, TextureHeight), LWImage::RGBA8, nullptr, 0, Allocator);
+	unsigned char *Texels = Atlas.GetTexels(0);
 	//unsigned char *DTexels = Allocator.AllocateArray<unsigned char>(TextureWidth*PackSize*TextureHeight);
 	//memset(Texels, 0, PackSize*TextureWidth*TextureHeight);
 	//std::cout << "Width: " << TextureWidth << " Height: " << TextureHeight << " Total Lines: " << LineCount << " Tallest: " << TallestCharacter << " Total: " << TotalGlyphCount << std::endl;
@@ -687,20 +702,9 @@ LWFont *LWFont::LoadFontTTF(LWFileStream *Stream, LWVideoDriver *Driver, uint32_
 		}
 	}
 	//BuildTransformTable(DTexels, Texels, PackSize*TextureWidth, TextureWidth, TextureHeight, 4);
-	LWTexture *Tex = Driver->CreateTexture2D(LWTexture::MinLinear|LWTexture::MagLinear, LWImage::RGBA8, LWVector2i(TextureWidth, TextureHeight), &Texels, 0, Allocator);
-
-	if (Tex) F->SetTexture(0, Tex);
-
-	LWAllocator::Destroy(Texels);
 	//LWAllocator::Destroy(DTexels);
 	FT_Done_Face(ftFace);
 	FT_Done_FreeType(ftLib);
-	if (!Tex) {
-		std::cout << "Error making texture!" << std::endl;
-		LWAllocator::Destroy(F);
-		F = nullptr;
-	}
-
 	return F;
 }
 
@@ -20,6 +20,22 @@ bool LWProtocolManager::PollSet(pollfd *SocketSet, uint32_t SetCnt, uint32_t Tim
 	return true;
 }
 
+uint32_t LWProtocolManager::CreateEventQueue(void) {
+	return InvalidEventQueue;
+}
+
+void LWProtocolManager::DestroyEventQueue(uint32_t) {
+	return;
+}
+
+bool LWProtocolManager::EventQueueSet(uint32_t, uint32_t, uint32_t, uint32_t, bool, bool) {
+	return false;
+}
+
+uint32_t LWProtocolManager::EventQueueWait(uint32_t, uint32_t *, uint32_t, uint32_t) {
+	return 0xFFFFFFFF;
+}
+
 uint32_t LWProtocolManager::GetHostIPs(uint32_t *IPBuffer, uint32_t BufferSize) {
 	char hostbuffer[128];
 	addrinfo hint = { AI_CANONNAME, AF_INET, 0, 0, 0, nullptr, nullptr, nullptr }, *servinfo = nullptr;
@@ -5,6 +5,8 @@
 #include "LWPlatform/LWPlatform.h"
 #include <arpa/inet.h>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
 
 //we must do forward declartion of resolv functions since android doesn't believe in us!
 int res_init(void);
@@ -71,6 +73,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
 	uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
 	uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
 	uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+	uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
 	uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
 
 	if (SockID == INVALID_SOCKET) return LWSocket::ErrSocket;
@@ -86,6 +89,11 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
 	}
 
 	if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+#ifdef SO_REUSEPORT
+	if (ReusePort && setsockopt(SockID, SOL_SOCKET, SO_REUSEPORT, (char*)&ReusePort, sizeof(ReusePort))) return LWSocket::ErrCtrlFlags;
+#else
+	if (ReusePort) return LWSocket::ErrCtrlFlags;
+#endif
 	if (bind(SockID, (sockaddr*)&Addr, AddrLen)) return LWSocket::ErrBind;
 	if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
 	if (getsockname(SockID, (sockaddr*)&lAddr, &AddrLen)) return LWSocket::ErrGetSock;
@@ -104,6 +112,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
 	uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
 	uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
 	uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+	uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
 
 	uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
 
@@ -116,6 +125,11 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
 	}
 
 	if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+#ifdef SO_REUSEPORT
+	if (ReusePort && setsockopt(SockID, SOL_SOCKET, SO_REUSEPORT, (char*)&ReusePort, sizeof(ReusePort))) return LWSocket::ErrCtrlFlags;
+#else
+	if (ReusePort) return LWSocket::ErrCtrlFlags;
+#endif
 	if (bind(SockID, (sockaddr*)&lAddr, lAddrLen)) return LWSocket::ErrBind;
 	if (connect(SockID, (sockaddr*)&rAddr, rAddrLen)) return LWSocket::ErrConnect;
 	if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
@@ -158,6 +172,63 @@ uint32_t LWSocket::Send(char *Buffer, uint32_t BufferLen, uint32_t RemoteIP, uin
 	return sendto(m_SocketID, Buffer, BufferLen, 0, (sockaddr*)&rAddr, sizeof(rAddr));
 }
 
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, bool Block) const {
+	iovec Vectors[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+	msghdr Msg = {};
+	Msg.msg_iov = Vectors;
+	Msg.msg_iovlen = Count;
+	ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL | (Block ? 0 : MSG_DONTWAIT));
+	if (Res >= 0) return (uint32_t)Res;
+	return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : 0xFFFFFFFF;
+}
+
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, uint32_t RemoteIP, uint16_t RemotePort) const {
+	sockaddr_in rAddr = { AF_INET, LWByteBuffer::MakeNetwork(RemotePort), 0,{ 0 } };
+	rAddr.sin_addr.s_addr = LWByteBuffer::MakeNetwork(RemoteIP);
+	iovec Vectors[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+	msghdr Msg = {};
+	Msg.msg_name = &rAddr;
+	Msg.msg_namelen = sizeof(rAddr);
+	Msg.msg_iov = Vectors;
+	Msg.msg_iovlen = Count;
+	ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL);
+	return Res < 0 ? 0xFFFFFFFF : (uint32_t)Res;
+}
+
+uint32_t LWSocket::SendBatch(const LWSocketDatagram *Datagrams, uint32_t DatagramCount) const {
+	mmsghdr Msgs[MaxBatchDatagrams];
+	sockaddr_in Addrs[MaxBatchDatagrams];
+	iovec Vectors[MaxGatherBuffers];
+	uint32_t Sent = 0;
+	while (Sent < DatagramCount) {
+		uint32_t Count = 0;
+		uint32_t VectorCount = 0;
+		for (; Sent + Count < DatagramCount && Count < MaxBatchDatagrams; Count++) {
+			const LWSocketDatagram &D = Datagrams[Sent + Count];
+			uint32_t n = std::min<uint32_t>(D.m_BufferCount, MaxGatherBuffers);
+			if (VectorCount + n > MaxGatherBuffers) break;
+			for (uint32_t i = 0; i < n; i++) Vectors[VectorCount + i] = { (void*)D.m_Buffers[i].m_Data, D.m_Buffers[i].m_Length };
+			sockaddr_in &rAddr = Addrs[Count];
+			rAddr = { AF_INET, LWByteBuffer::MakeNetwork(D.m_RemotePort), 0,{ 0 } };
+			rAddr.sin_addr.s_addr = LWByteBuffer::MakeNetwork(D.m_RemoteIP);
+			Msgs[Count].msg_hdr = {};
+			Msgs[Count].msg_hdr.msg_name = &rAddr;
+			Msgs[Count].msg_hdr.msg_namelen = sizeof(rAddr);
+			Msgs[Count].msg_hdr.msg_iov = Vectors + VectorCount;
+			Msgs[Count].msg_hdr.msg_iovlen = n;
+			VectorCount += n;
+		}
+		int32_t Res = sendmmsg(m_SocketID, Msgs, Count, MSG_NOSIGNAL);
+		if (Res <= 0) return Sent ? Sent : 0xFFFFFFFF;
+		Sent += (uint32_t)Res;
+	}
+	return Sent;
+}
+
 bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
 	sockaddr_in rAddr, lAddr;
 	socklen_t rAddrLen = sizeof(rAddr);
@@ -174,6 +245,7 @@ bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
 }
 
 LWSocket &LWSocket::Close(void) {
+	ReleaseQueue();
 	if (m_SocketID) {
 		m_Flag |= LWSocket::Closeable;
 		close(m_SocketID);
@@ -183,5 +255,6 @@ LWSocket &LWSocket::Close(void) {
 }
 
 LWSocket::~LWSocket() {
+	ReleaseQueue();
 	if (m_SocketID) close(m_SocketID);
 }
\ No newline at end of file
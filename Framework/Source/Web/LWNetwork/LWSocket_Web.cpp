@@ -6,6 +6,12 @@
 #include <arpa/inet.h>
 #include <resolv.h>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 uint32_t LWSocket::MakeIP(const LWText &Address) {
 	in_addr Addr;
@@ -132,6 +138,41 @@ uint32_t LWSocket::Send(char *Buffer, uint32_t BufferLen, uint32_t RemoteIP, uin
 	return sendto(m_SocketID, Buffer, BufferLen, 0, (sockaddr*)&rAddr, sizeof(rAddr));
 }
 
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, bool Block) const {
+	iovec Vectors[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+	msghdr Msg = {};
+	Msg.msg_iov = Vectors;
+	Msg.msg_iovlen = Count;
+	ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL | (Block ? 0 : MSG_DONTWAIT));
+	if (Res >= 0) return (uint32_t)Res;
+	return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : 0xFFFFFFFF;
+}
+
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, uint32_t RemoteIP, uint16_t RemotePort) const {
+	sockaddr_in rAddr = { AF_INET, LWByteBuffer::MakeNetwork(RemotePort), 0,{ 0 } };
+	rAddr.sin_addr.s_addr = LWByteBuffer::MakeNetwork(RemoteIP);
+	iovec Vectors[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+	msghdr Msg = {};
+	Msg.msg_name = &rAddr;
+	Msg.msg_namelen = sizeof(rAddr);
+	Msg.msg_iov = Vectors;
+	Msg.msg_iovlen = Count;
+	ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL);
+	return Res < 0 ? 0xFFFFFFFF : (uint32_t)Res;
+}
+
+uint32_t LWSocket::SendBatch(const LWSocketDatagram *Datagrams, uint32_t DatagramCount) const {
+	for (uint32_t i = 0; i < DatagramCount; i++) {
+		const LWSocketDatagram &D = Datagrams[i];
+		if (Send(D.m_Buffers, D.m_BufferCount, D.m_RemoteIP, D.m_RemotePort) == 0xFFFFFFFF) return i ? i : 0xFFFFFFFF;
+	}
+	return DatagramCount;
+}
+
 bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
 	sockaddr_in rAddr, lAddr;
 	socklen_t rAddrLen = sizeof(rAddr);
@@ -148,6 +189,7 @@ bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
 }
 
 LWSocket &LWSocket::Close(void) {
+	ReleaseQueue();
 	if (m_SocketID) {
 		m_Flag |= LWSocket::Closeable;
 		close(m_SocketID);
@@ -157,5 +199,6 @@ LWSocket &LWSocket::Close(void) {
 }
 
 LWSocket::~LWSocket() {
+	ReleaseQueue();
 	if (m_SocketID) close(m_SocketID);
 }
\ No newline at end of file
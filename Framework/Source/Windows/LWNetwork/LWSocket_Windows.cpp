@@ -4,6 +4,7 @@
 #include "LWCore/LWByteBuffer.h"
 #include "LWPlatform/LWPlatform.h"
 #include <iostream>
+#include <algorithm>
 
 uint32_t LWSocket::MakeIP(const LWText &Address) {
 	IN_ADDR Addr;
@@ -56,6 +57,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
 	uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
 	uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
 	uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+	uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
 	uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
 	DWORD BytesReturned = 0;
 
@@ -68,6 +70,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
 	}
 
 	if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+	if (ReusePort) return LWSocket::ErrCtrlFlags;
 	if (bind(SockID, (sockaddr*)&Addr, AddrLen)) return LWSocket::ErrBind;
 	if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
 	if (getsockname(SockID, (sockaddr*)&lAddr, &AddrLen)) return LWSocket::ErrGetSock;
@@ -86,6 +89,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
 	uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
 	uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
 	uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+	uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
 
 	uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
 
@@ -98,6 +102,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
 	}
 
 	if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+	if (ReusePort) return LWSocket::ErrCtrlFlags;
 	if (bind(SockID, (sockaddr*)&lAddr, lAddrLen)) return LWSocket::ErrBind;
 	if (connect(SockID, (sockaddr*)&rAddr, rAddrLen)) return LWSocket::ErrConnect;
 	if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
@@ -140,6 +145,34 @@ uint32_t LWSocket::Send(char *Buffer, uint32_t BufferLen, uint32_t RemoteIP, uin
 	return sendto(m_SocketID, Buffer, BufferLen, 0, (sockaddr*)&rAddr, sizeof(rAddr));
 }
 
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, bool Block) const {
+	WSABUF Bufs[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Bufs[i] = { Buffers[i].m_Length, (CHAR*)Buffers[i].m_Data };
+	DWORD Sent = 0;
+	if (WSASend(m_SocketID, Bufs, Count, &Sent, 0, nullptr, nullptr) == 0) return (uint32_t)Sent;
+	return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : 0xFFFFFFFF;
+}
+
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, uint32_t RemoteIP, uint16_t RemotePort) const {
+	sockaddr_in rAddr = { AF_INET, LWByteBuffer::MakeNetwork(RemotePort), 0,{ 0 } };
+	rAddr.sin_addr.S_un.S_addr = LWByteBuffer::MakeNetwork(RemoteIP);
+	WSABUF Bufs[MaxGatherBuffers];
+	uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+	for (uint32_t i = 0; i < Count; i++) Bufs[i] = { Buffers[i].m_Length, (CHAR*)Buffers[i].m_Data };
+	DWORD Sent = 0;
+	if (WSASendTo(m_SocketID, Bufs, Count, &Sent, 0, (sockaddr*)&rAddr, sizeof(rAddr), nullptr, nullptr)) return 0xFFFFFFFF;
+	return (uint32_t)Sent;
+}
+
+uint32_t LWSocket::SendBatch(const LWSocketDatagram *Datagrams, uint32_t DatagramCount) const {
+	for (uint32_t i = 0; i < DatagramCount; i++) {
+		const LWSocketDatagram &D = Datagrams[i];
+		if (Send(D.m_Buffers, D.m_BufferCount, D.m_RemoteIP, D.m_RemotePort) == 0xFFFFFFFF) return i ? i : 0xFFFFFFFF;
+	}
+	return DatagramCount;
+}
+
 bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const{
 	sockaddr_in rAddr, lAddr;
 	int32_t rAddrLen = sizeof(rAddr);
@@ -156,6 +189,7 @@ bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const{
 }
 
 LWSocket &LWSocket::Close(void){
+	ReleaseQueue();
 	if (m_SocketID){
 		m_Flag |= LWSocket::Closeable;
 		closesocket(m_SocketID);
@@ -165,5 +199,6 @@ LWSocket &LWSocket::Close(void){
 }
 
 LWSocket::~LWSocket() {
+	ReleaseQueue();
 	if (m_SocketID) closesocket(m_SocketID);
 }
\ No newline at end of file
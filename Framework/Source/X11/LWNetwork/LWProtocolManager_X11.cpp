@@ -4,6 +4,8 @@
 #include <LWCore/LWByteBuffer.h>
 #include <algorithm>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 bool LWProtocolManager::InitateNetwork(void) {
 	return true;
@@ -20,6 +22,37 @@ bool LWProtocolManager::PollSet(pollfd *SocketSet, uint32_t SetCnt, uint32_t Tim
 	return true;
 }
 
+uint32_t LWProtocolManager::CreateEventQueue(void) {
+	int32_t Queue = epoll_create1(EPOLL_CLOEXEC);
+	if (Queue < 0) return InvalidEventQueue;
+	return (uint32_t)Queue;
+}
+
+void LWProtocolManager::DestroyEventQueue(uint32_t EventQueue) {
+	close((int32_t)EventQueue);
+	return;
+}
+
+bool LWProtocolManager::EventQueueSet(uint32_t EventQueue, uint32_t SocketDescriptor, uint32_t Index, uint32_t Op, bool EdgeTriggered, bool Writable) {
+	const int32_t Ops[] = { EPOLL_CTL_ADD, EPOLL_CTL_MOD, EPOLL_CTL_DEL };
+	epoll_event Event;
+	Event.events = EPOLLIN | EPOLLRDHUP | (EdgeTriggered ? EPOLLET : 0) | (Writable ? EPOLLOUT : 0);
+	Event.data.u64 = 0;
+	Event.data.u32 = Index;
+	return epoll_ctl((int32_t)EventQueue, Ops[Op], (int32_t)SocketDescriptor, &Event) == 0;
+}
+
+uint32_t LWProtocolManager::EventQueueWait(uint32_t EventQueue, uint32_t *ReadyList, uint32_t ReadyListSize, uint32_t Timeout) {
+	epoll_event Events[MaxReadyEvents];
+	int32_t r = epoll_wait((int32_t)EventQueue, Events, (int32_t)std::min<uint32_t>(ReadyListSize, MaxReadyEvents), Timeout == 0xFFFFFFFF ? -1 : (int32_t)Timeout);
+	if (r < 0) return errno == EINTR ? 0 : 0xFFFFFFFF;
+	for (int32_t i = 0; i < r; i++) {
+		uint32_t Flags = Events[i].events;
+		ReadyList[i] = Events[i].data.u32 | ((Flags&EPOLLOUT) ? EventWritable : 0) | ((Flags&~EPOLLOUT) ? EventReadable : 0);
+	}
+	return (uint32_t)r;
+}
+
 uint32_t LWProtocolManager::GetHostIPs(uint32_t *IPBuffer, uint32_t BufferSize) {
 	char hostbuffer[128];
 	addrinfo hint = { AI_CANONNAME, AF_INET, 0, 0, 0, nullptr, nullptr, nullptr }, *servinfo = nullptr;
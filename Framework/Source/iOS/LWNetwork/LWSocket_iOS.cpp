@@ -6,6 +6,12 @@
 #include <resolv.h>
 #include <arpa/inet.h>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 uint32_t LWSocket::MakeIP(const LWText &Address) {
     in_addr Addr;
@@ -61,6 +67,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
     uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
     uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
     uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+    uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
     uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
     
     if (SockID == INVALID_SOCKET) return LWSocket::ErrSocket;
@@ -76,6 +83,11 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint16_t Port, uint32_t Flag,
     }
     
     if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+#ifdef SO_REUSEPORT
+    if (ReusePort && setsockopt(SockID, SOL_SOCKET, SO_REUSEPORT, (char*)&ReusePort, sizeof(ReusePort))) return LWSocket::ErrCtrlFlags;
+#else
+    if (ReusePort) return LWSocket::ErrCtrlFlags;
+#endif
     if (bind(SockID, (sockaddr*)&Addr, AddrLen)) return LWSocket::ErrBind;
     if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
     if (getsockname(SockID, (sockaddr*)&lAddr, &AddrLen)) return LWSocket::ErrGetSock;
@@ -103,6 +115,7 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
     uint32_t SockBroadcast = (Flag&LWSocket::Broadcast) ? true : false;
     uint32_t TcpNoDelay = (Flag&LWSocket::TcpNoDelay) ? true : false;
     uint32_t ReuseAddr = (Flag&LWSocket::ReuseAddr) ? true : false;
+    uint32_t ReusePort = (Flag&LWSocket::ReusePort) ? true : false;
     
     uint32_t SockID = (uint32_t)socket(AF_INET, Flag&LWSocket::Udp ? SOCK_DGRAM : SOCK_STREAM, Flag&LWSocket::Udp ? IPPROTO_UDP : IPPROTO_TCP);
     
@@ -115,6 +128,11 @@ uint32_t LWSocket::CreateSocket(LWSocket &Socket, uint32_t RemoteIP, uint16_t Re
     }
     
     if (setsockopt(SockID, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddr, sizeof(ReuseAddr))) return LWSocket::ErrCtrlFlags;
+#ifdef SO_REUSEPORT
+    if (ReusePort && setsockopt(SockID, SOL_SOCKET, SO_REUSEPORT, (char*)&ReusePort, sizeof(ReusePort))) return LWSocket::ErrCtrlFlags;
+#else
+    if (ReusePort) return LWSocket::ErrCtrlFlags;
+#endif
     if (bind(SockID, (sockaddr*)&lAddr, lAddrLen)) return LWSocket::ErrBind;
     if (connect(SockID, (sockaddr*)&rAddr, rAddrLen)) return LWSocket::ErrConnect;
     if (Flag&LWSocket::Listen) if (listen(SockID, LWSocket::MaxBacklog)) return LWSocket::ErrListen;
@@ -160,6 +178,44 @@ uint32_t LWSocket::Send(char *Buffer, uint32_t BufferLen, uint32_t RemoteIP, uin
     return sendto(m_SocketID, Buffer, BufferLen, 0, (sockaddr*)&rAddr, sizeof(rAddr));
 }
 
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, bool Block) const {
+    iovec Vectors[MaxGatherBuffers];
+    uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+    for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+    msghdr Msg = {};
+    Msg.msg_iov = Vectors;
+    Msg.msg_iovlen = Count;
+    ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL | (Block ? 0 : MSG_DONTWAIT));
+    if (Res >= 0) return (uint32_t)Res;
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : 0xFFFFFFFF;
+}
+
+uint32_t LWSocket::Send(const LWSocketBuffer *Buffers, uint32_t BufferCount, uint32_t RemoteIP, uint16_t RemotePort) const {
+    sockaddr_in rAddr;
+    rAddr.sin_family = AF_INET;
+    rAddr.sin_port = LWByteBuffer::MakeNetwork(RemotePort);
+    rAddr.sin_addr.s_addr = LWByteBuffer::MakeNetwork(RemoteIP);
+    rAddr.sin_zero[0] = '\0';
+    iovec Vectors[MaxGatherBuffers];
+    uint32_t Count = std::min<uint32_t>(BufferCount, MaxGatherBuffers);
+    for (uint32_t i = 0; i < Count; i++) Vectors[i] = { (void*)Buffers[i].m_Data, Buffers[i].m_Length };
+    msghdr Msg = {};
+    Msg.msg_name = &rAddr;
+    Msg.msg_namelen = sizeof(rAddr);
+    Msg.msg_iov = Vectors;
+    Msg.msg_iovlen = Count;
+    ssize_t Res = sendmsg(m_SocketID, &Msg, MSG_NOSIGNAL);
+    return Res < 0 ? 0xFFFFFFFF : (uint32_t)Res;
+}
+
+uint32_t LWSocket::SendBatch(const LWSocketDatagram *Datagrams, uint32_t DatagramCount) const {
+    for (uint32_t i = 0; i < DatagramCount; i++) {
+        const LWSocketDatagram &D = Datagrams[i];
+        if (Send(D.m_Buffers, D.m_BufferCount, D.m_RemoteIP, D.m_RemotePort) == 0xFFFFFFFF) return i ? i : 0xFFFFFFFF;
+    }
+    return DatagramCount;
+}
+
 bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
     sockaddr_in rAddr, lAddr;
     socklen_t rAddrLen = sizeof(rAddr);
@@ -176,6 +232,7 @@ bool LWSocket::Accept(LWSocket &Result, uint32_t ProtocolID) const {
 }
 
 LWSocket &LWSocket::Close(void) {
+    ReleaseQueue();
     if (m_SocketID) {
         m_Flag |= LWSocket::Closeable;
         close(m_SocketID);
@@ -185,5 +242,6 @@ LWSocket &LWSocket::Close(void) {
 }
 
 LWSocket::~LWSocket() {
+    ReleaseQueue();
     if (m_SocketID) close(m_SocketID);
 }
\ No newline at end of file